@@ -0,0 +1,347 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+/*
+ *  MCIS event journal decoder
+ * 
+ * Lists the events in one or more journals written by MCIS (see 
+ * MCIS_journal.h), then how long engaging and parking took in each, and
+ * over all of them.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <algorithm>
+#include "include/MCIS_journal.h"
+#include "include/MCIS_MB_interface.h"
+
+
+/*
+ *  phaseTimes
+ * 
+ * Durations of one phase of the engage or park sequence, in s
+ */
+class phaseTimes
+{
+    public:
+
+    const char *name;
+    std::vector<double> durations;
+
+    void print(std::ostream& dest) const
+    {
+        dest << "  " << std::left << std::setw(28) << name << std::right;
+        if (durations.empty())
+        {
+            dest << "never" << std::endl;
+            return;
+        }
+        double sum = 0;
+        for (double duration : durations)
+        {
+            sum += duration;
+        }
+        dest << std::fixed << std::setprecision(3)
+             << std::setw(4) << durations.size() << " times, min " 
+             << *std::min_element(durations.begin(), durations.end()) << " s, mean "
+             << sum / durations.size() << " s, max "
+             << *std::max_element(durations.begin(), durations.end()) << " s" << std::endl;
+        dest.unsetf(std::ios::fixed);
+    }
+};
+
+//Phases of the engage and park sequences, see sessionTimer
+enum journal_phase {PHASE_COMMS, PHASE_ENGAGE_COMMAND, PHASE_MB_ENGAGE, PHASE_READY_COMMAND,
+                    PHASE_RATE_LIMITED, PHASE_ENGAGE_TOTAL, PHASE_PARK, PHASE_COUNT};
+
+static const char *phaseNames[PHASE_COUNT] = {
+    "Establishing comms",           //Start to leaving ESTABLISH_COMMS
+    "ENGAGE command to ENGAGING",   //User command issued to the state changing
+    "MB engaging",                  //ENGAGING to WAIT_FOR_READY
+    "READY command to moving",      //User command issued to RATE_LIMITED
+    "Rate limited",                 //RATE_LIMITED to ENGAGED
+    "ENGAGING to ENGAGED",          //The whole sequence, waiting for the user included
+    "Parking"                       //PARKING to WAIT_FOR_ENGAGE
+};
+
+/*
+ *  sessionTimer
+ * 
+ * Follows the events of one journal and times each phase when it ends. A 
+ * phase only counts if it was seen to start in the same journal.
+ */
+class sessionTimer
+{
+    private:
+
+    phaseTimes *phases;
+    int64_t start = 0;
+    int64_t engage_issued = 0;
+    int64_t ready_issued = 0;
+    int64_t state_entered[MB_RECOVERABLE_FAULT + 1] = {};
+
+    void add(journal_phase phase, int64_t from, int64_t to)
+    {
+        if (from && (to >= from))
+        {
+            phases[phase].durations.push_back((to - from) / 1e9);
+        }
+    }
+
+    public:
+
+    sessionTimer(phaseTimes *phase_times) : phases{phase_times} {}
+
+    void event(const journalEvent& event)
+    {
+        switch (event.type)
+        {
+            case JOURNAL_START:
+                start = event.time;
+                break;
+            case JOURNAL_USER_COMMAND:
+                if (CMD_ENGAGE == event.a)
+                {
+                    engage_issued = event.c;
+                }
+                else if (CMD_READY == event.a)
+                {
+                    ready_issued = event.c;
+                }
+                break;
+            case JOURNAL_STATE:
+                if (event.b > MB_RECOVERABLE_FAULT)
+                {
+                    break;
+                }
+                if (ESTABLISH_COMMS == event.a)
+                {
+                    add(PHASE_COMMS, start, event.time);
+                }
+                switch (event.b)
+                {
+                    case ENGAGING:
+                        add(PHASE_ENGAGE_COMMAND, engage_issued, event.time);
+                        engage_issued = 0;
+                        break;
+                    case WAIT_FOR_READY:
+                        if (ENGAGING == event.a)
+                        {
+                            add(PHASE_MB_ENGAGE, state_entered[ENGAGING], event.time);
+                        }
+                        break;
+                    case RATE_LIMITED:
+                        add(PHASE_READY_COMMAND, ready_issued, event.time);
+                        ready_issued = 0;
+                        break;
+                    case ENGAGED:
+                        if (RATE_LIMITED == event.a)
+                        {
+                            add(PHASE_RATE_LIMITED, state_entered[RATE_LIMITED], event.time);
+                        }
+                        add(PHASE_ENGAGE_TOTAL, state_entered[ENGAGING], event.time);
+                        state_entered[ENGAGING] = 0;
+                        break;
+                    case WAIT_FOR_ENGAGE:
+                        if (PARKING == event.a)
+                        {
+                            add(PHASE_PARK, state_entered[PARKING], event.time);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                state_entered[event.b] = event.time;
+                break;
+            default:
+                break;
+        }
+    }
+};
+
+static const char *engineName(uint32_t engine)
+{
+    switch (engine)
+    {
+        case CUEING_CLASSICAL:
+            return "classical";
+        case CUEING_MPC:
+            return "mpc";
+        case CUEING_ADAPTIVE:
+            return "adaptive";
+    }
+    return "unknown";
+}
+
+/*
+ *  printEvent
+ * 
+ * One line per event, its time in s since the journal started
+ */
+static void printEvent(std::ostream& dest, const journalHeader& header, const journalEvent& event)
+{
+    dest << std::fixed << std::setprecision(6) << std::setw(14) 
+         << (event.time - header.start_monotonic) / 1e9 << "  ";
+    dest.unsetf(std::ios::fixed);
+    dest << std::left << std::setw(15) << eventJournal::eventName((journal_event_type)event.type)
+         << std::right;
+
+    switch (event.type)
+    {
+        case JOURNAL_START:
+            dest << "engine " << engineName(event.a) << ", tick mode " << tickModeName((tick_mode)event.b);
+            break;
+        case JOURNAL_STATE:
+            dest << mbinterface::status_name((iface_status)event.a) << " -> " 
+                 << mbinterface::status_name((iface_status)event.b);
+            if (event.c != NONE)
+            {
+                dest << " (" << mbinterface::error_name((iface_error)event.c) << ")";
+            }
+            break;
+        case JOURNAL_USER_COMMAND:
+            dest << mbinterface::command_name((user_command)event.a) << ", issued " 
+                 << (event.time - event.c) / 1e6 << " ms before";
+            break;
+        case JOURNAL_MB_STATE:
+            dest << ((0xFFFFFFFF == event.a) ? "NONE" : mbinterface::mb_state_name(event.a)) 
+                 << " -> " << mbinterface::mb_state_name(event.b);
+            break;
+        case JOURNAL_LATCHED_FAULT:
+        case JOURNAL_DISCRETE_IO:
+            dest << std::hex << std::setfill('0') << "0x" << std::setw(8) << event.a 
+                 << " -> 0x" << std::setw(8) << event.b << ", set 0x" << std::setw(8) 
+                 << (event.b & ~event.a) << ", cleared 0x" << std::setw(8) << (event.a & ~event.b)
+                 << std::dec << std::setfill(' ');
+            break;
+        case JOURNAL_REPLY_TIMEOUT:
+            dest << (event.a ? "MB stopped replying" : "MB replying again") 
+                 << ", " << event.c << " timeouts";
+            break;
+        case JOURNAL_STOP:
+            dest << event.c << " events dropped";
+            break;
+        default:
+            dest << event.a << " " << event.b << " " << event.c;
+            break;
+    }
+    dest << std::endl;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: MCIS-journal [-s] journal_file..." << std::endl;
+        std::cout << "  -s  only the engage and park timing, not every event" << std::endl;
+        return 0;
+    }
+
+    bool summaryOnly = false;
+    int firstFile = 1;
+    while ((firstFile < argc) && ('-' == argv[firstFile][0]))
+    {
+        std::string option = argv[firstFile];
+        if (option == "-s")
+        {
+            summaryOnly = true;
+        }
+        else
+        {
+            std::cout << "Unknown option: " << option << std::endl;
+            return 0;
+        }
+        firstFile++;
+    }
+
+    phaseTimes allPhases[PHASE_COUNT];
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+        allPhases[i].name = phaseNames[i];
+    }
+    int sessions = 0;
+
+    for (int file = firstFile; file < argc; file++)
+    {
+        journalHeader header;
+        std::vector<journalEvent> events;
+        if (!eventJournal::load(argv[file], header, events))
+        {
+            std::cout << argv[file] << ": not an MCIS journal, or from a different version" << std::endl;
+            continue;
+        }
+        sessions++;
+
+        time_t startTime = (time_t)(header.start_realtime / 1000000000);
+        char startString[64];
+        std::strftime(startString, sizeof(startString), "%Y-%m-%d %H:%M:%S", std::localtime(&startTime));
+        std::cout << argv[file] << ": started " << startString << ", " << events.size() << " events";
+        if (events.empty() || (JOURNAL_STOP != events.back().type))
+        {
+            std::cout << ", CUT SHORT";
+        }
+        std::cout << std::endl;
+
+        phaseTimes phases[PHASE_COUNT];
+        for (int i = 0; i < PHASE_COUNT; i++)
+        {
+            phases[i].name = phaseNames[i];
+        }
+        sessionTimer timer(phases);
+        for (const journalEvent& event : events)
+        {
+            if (!summaryOnly)
+            {
+                printEvent(std::cout, header, event);
+            }
+            timer.event(event);
+        }
+
+        for (int i = 0; i < PHASE_COUNT; i++)
+        {
+            phases[i].print(std::cout);
+            allPhases[i].durations.insert(allPhases[i].durations.end(), 
+                                          phases[i].durations.begin(), phases[i].durations.end());
+        }
+        std::cout << std::endl;
+    }
+
+    if (sessions > 1)
+    {
+        std::cout << "All " << sessions << " sessions:" << std::endl;
+        for (int i = 0; i < PHASE_COUNT; i++)
+        {
+            allPhases[i].print(std::cout);
+        }
+    }
+
+    return 0;
+}
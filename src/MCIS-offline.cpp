@@ -32,8 +32,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <string>
+#include <cmath>
+#include <limits>
+#include <chrono>
 #include "include/MCIS_config.h"
 #include "include/MCIS_MDA.h"
+#include "include/MCIS_MPC.h"
+#include "include/MCIS_MDA_adaptive.h"
+#include "include/MOOG6DOF2000E.h"
 #include "include/discreteMath.h"
 #include "include/MCIS_fileio.h"
 
@@ -46,6 +53,176 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define testStart 1
 
 
+/*
+ *  precisionReport
+ * 
+ * Keeps track of how far the single precision MDA strays from the double
+ * precision one, output by output (x, y, z, roll, pitch, yaw).
+ * 
+ * The deviation is given relative to the largest output seen on that channel
+ * and in float32 quanta (ulp) of that output. The MB only ever receives 
+ * floats, so that is the best the double precision MDA can do anyway. The
+ * washout filters have poles very close to z = 1, so expect the single 
+ * precision filter states to be off by a good number of ulp.
+ */
+class precisionReport
+{
+    private:
+    double maxDev[6];
+    double sumSqDev[6];
+    double maxAbs[6];
+    unsigned long samples;
+
+    public:
+    precisionReport() : maxDev{0}, sumSqDev{0}, maxAbs{0}, samples{0} {}
+
+    void addSample(const MCISvector& pos, const MCISvector& ang, 
+                   const MCISvectorf& posf, const MCISvectorf& angf)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            double ref = (i < 3) ? pos[i]  : ang[i - 3];
+            double val = (i < 3) ? posf[i] : angf[i - 3];
+            double dev = fabs(ref - val);
+
+            if (dev > maxDev[i])
+            {
+                maxDev[i] = dev;
+            }
+            if (fabs(ref) > maxAbs[i])
+            {
+                maxAbs[i] = fabs(ref);
+            }
+            sumSqDev[i] += dev * dev;
+        }
+        samples++;
+    }
+
+    void print(std::ostream& dest)
+    {
+        const char *names[6] = {"x", "y", "z", "roll", "pitch", "yaw"};
+
+        dest << "  Single vs double precision over " << samples << " samples:" << std::endl;
+        if (0 == samples)
+        {
+            return;
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            //Spacing between adjacent floats around the largest output
+            double ulp = maxAbs[i] * std::numeric_limits<float>::epsilon();
+            if (ulp < std::numeric_limits<float>::min())
+            {
+                ulp = std::numeric_limits<float>::min();
+            }
+
+            dest << "    " << names[i] << ":\tmax dev " << maxDev[i] 
+                 << "\trms dev " << sqrt(sumSqDev[i] / samples)
+                 << "\tmax |out| " << maxAbs[i] 
+                 << "\t(" << 100 * maxDev[i] / ulp * std::numeric_limits<float>::epsilon() << "%, " 
+                 << maxDev[i] / ulp << " float32 ulp)" << std::endl;
+        }
+    }
+};
+
+
+/*
+ *  cueReport
+ * 
+ * Specific force cue error statistics for one cueing engine, per 
+ * translational axis, plus compute time and workspace usage.
+ */
+class cueReport
+{
+    private:
+    double sumSqErr[3];
+    double totalTime, worstTime;
+    unsigned long samples, clamped;
+
+    public:
+    cueReport() : sumSqErr{0}, totalTime{0}, worstTime{0}, samples{0}, clamped{0} {}
+
+    void addSample(const MCISvector& err, double computeTime, bool outside)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            sumSqErr[i] += err[i] * err[i];
+        }
+        totalTime += computeTime;
+        if (computeTime > worstTime)
+        {
+            worstTime = computeTime;
+        }
+        clamped += outside ? 1 : 0;
+        samples++;
+    }
+
+    void print(std::ostream& dest, const char *name)
+    {
+        if (0 == samples)
+        {
+            return;
+        }
+        dest << "    " << name << ":\trms cue error x " << sqrt(sumSqErr[0] / samples)
+             << "  y " << sqrt(sumSqErr[1] / samples) 
+             << "  z " << sqrt(sumSqErr[2] / samples) << " m/s^2" << std::endl;
+        dest << "    \tcompute time: mean " << totalTime / samples / 1000 << " us, worst " 
+             << worstTime / 1000 << " us" << std::endl;
+        dest << "    \tsamples outside the workspace: " << clamped << std::endl;
+    }
+};
+
+
+/*
+ *  sameOutputs
+ * 
+ * Bit for bit comparison of two sets of MDA outputs
+ */
+static bool sameOutputs(const MCISvector& pos, const MCISvector& ang, const MCISvector& angNoTC,
+                        const MCISvector& pos2, const MCISvector& ang2, const MCISvector& angNoTC2)
+{
+    return (pos == pos2) && (ang == ang2) && (angNoTC == angNoTC2);
+}
+
+
+/*
+ *  printSizeReport
+ * 
+ * Bytes per MDA instance, with and without shared parameters
+ */
+static void printSizeReport(std::ostream& dest)
+{
+    const double million = 1e6;
+
+    dest << "  Bytes per MDA instance:" << std::endl;
+    dest << "    MCIS_MDA " << sizeof(MCIS_MDA) << ", MCIS_MDAf " << sizeof(MCIS_MDAf) << std::endl;
+    dest << "    MDAstate " << sizeof(MDAstate) << ", MDAstatef " << sizeof(MDAstatef) 
+         << " (+ one shared MDAparams of " << sizeof(MDAparams) << ", MDAparamsf " 
+         << sizeof(MDAparamsf) << ")" << std::endl;
+    dest << "    A million instances: " << sizeof(MCIS_MDA) * million / (1 << 20) << " MiB as MCIS_MDA, " 
+         << sizeof(MDAstate) * million / (1 << 20) << " MiB as MDAstate, " 
+         << sizeof(MDAstatef) * million / (1 << 20) << " MiB as MDAstatef" << std::endl;
+}
+
+
+/*
+ *  workspaceExceeded
+ * 
+ * Would output_limiter have to clamp this output? Same offsets and limits.
+ */
+static bool workspaceExceeded(const MCISvector& pos, const MCISvector& ang)
+{
+    double z = pos[2] + MB_OFFSET_z;
+
+    return (pos[0] < MB_LIM_LOW_x)      || (pos[0] > MB_LIM_HIGH_x)     ||
+           (pos[1] < MB_LIM_LOW_y)      || (pos[1] > MB_LIM_HIGH_y)     ||
+           (z < MB_LIM_LOW_z)           || (z > MB_LIM_HIGH_z)          ||
+           (ang[0] < MB_LIM_LOW_roll)   || (ang[0] > MB_LIM_HIGH_roll)  ||
+           (ang[1] < MB_LIM_LOW_pitch)  || (ang[1] > MB_LIM_HIGH_pitch) ||
+           (ang[2] < MB_LIM_LOW_yaw)    || (ang[2] > MB_LIM_HIGH_yaw);
+}
+
+
 int main (int argc, char **argv)
 {
     MCISconfig config;
@@ -56,18 +233,67 @@ int main (int argc, char **argv)
     //Check if we have enough arguments to do anything
     if (argc < 2)
     {
-        std::cout << "Usage: MCIStest input_file" << std::endl;
+        std::cout << "Usage: MCIStest [-c] [-m] [-a] [-s] input_file" << std::endl;
+        std::cout << "  -c  also run the single precision MDA and report the deviation" << std::endl;
+        std::cout << "  -m  also run the MPC cueing engine, write its outputs to input_filempcout.csv" << std::endl;
+        std::cout << "      and report its solve times" << std::endl;
+        std::cout << "  -a  also run the adaptive washout, write its outputs to input_fileadaptout.csv" << std::endl;
+        std::cout << "      and benchmark it against the classical MDA" << std::endl;
+        std::cout << "  -s  also run the compact (shared parameter) MDA, check that it matches" << std::endl;
+        std::cout << "      the classical MDA bit for bit and report the bytes per instance" << std::endl;
         return 0;
     }
 
+    //Compare single and double precision? Run the MPC engine? The adaptive one?
+    bool compare = false;
+    bool runMPC = false;
+    bool runAdaptive = false;
+    bool runCompact = false;
+    int firstFile = 1;
+    while ((firstFile < argc) && ('-' == argv[firstFile][0]))
+    {
+        std::string option = argv[firstFile];
+        if (option == "-c")
+        {
+            compare = true;
+        }
+        else if (option == "-m")
+        {
+            runMPC = true;
+        }
+        else if (option == "-a")
+        {
+            runAdaptive = true;
+        }
+        else if (option == "-s")
+        {
+            runCompact = true;
+        }
+        else
+        {
+            std::cout << "Unknown option: " << option << std::endl;
+            return 0;
+        }
+        firstFile++;
+    }
+
     config.load(configFileName);
     std::cout << "Configuration loaded." << std::endl;
 
+    //One set of parameters for every compact MDA
+    static const MDAparams compactParams{config, true};
+    if (runCompact)
+    {
+        printSizeReport(std::cout);
+    }
+
     std::string path;
     std::ifstream infile;
     std::ofstream outfile;
+    std::ofstream mpcOutfile;
+    std::ofstream adaptiveOutfile;
 
-    for (int i = 1; i < argc; i++)
+    for (int i = firstFile; i < argc; i++)
     {
         infile.open(argv[i]);
         if (!infile.good())
@@ -90,22 +316,132 @@ int main (int argc, char **argv)
             continue;
         }
 
+        if (runMPC)
+        {
+            mpcOutfile.open(std::string(argv[i]) + "mpcout.csv");
+        }
+        if (runAdaptive)
+        {
+            adaptiveOutfile.open(std::string(argv[i]) + "adaptout.csv");
+        }
+
         MCIS_MDA mda{config, true};
+        MCIS_MDAf mdaf{config, true};
+        MCIS_MPC mpc{config, true};
+        MCIS_MDA_adaptive adaptive{config};
+        cueErrorEstimator classicalCue{config};
+        precisionReport report;
+        cueReport classicalReport, adaptiveReport;
+        //Compact MDAs, one starting at rest and one from the steady state,
+        //each checked against an MCIS_MDA started the same way
+        MDAstate compactState, compactStateSS;
+        MCIS_MDA mdaSS{config, true};
+        unsigned long compactMismatches = 0;
+        unsigned long samples = 0, mdaClamped = 0, mpcClamped = 0;
+        double totalSolveTime = 0;
 
         MCISvector sfIn, angIn, attIn, posOut, angOut;
 
         //while (readMCISinputs(infile, sfIn, angIn))
         while (readMCISinputs(infile, sfIn, angIn, attIn))
         {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
             mda.nextSample(sfIn, angIn, attIn);
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
             writeMCISfullOutputs(outfile, mda.getPos(), mda.getangle(), mda.getAngleNoTC());
             //writeMCISfullOutputsBin(outfile, mda.getPos(), mda.getangle(), mda.getAngleNoTC());
+
+            if (compare)
+            {
+                mdaf.nextSample(MCISvectorf{sfIn}, MCISvectorf{angIn}, MCISvectorf{attIn});
+                report.addSample(mda.getPos(), mda.getangle(), mdaf.getPos(), mdaf.getangle());
+            }
+            if (runMPC)
+            {
+                mpc.nextSample(sfIn, angIn, attIn);
+                writeMCISfullOutputs(mpcOutfile, mpc.getPos(), mpc.getangle(), mpc.getAngleNoTC());
+                totalSolveTime += mpc.getLastSolveTime();
+                mdaClamped += workspaceExceeded(mda.getPos(), mda.getangle()) ? 1 : 0;
+                mpcClamped += workspaceExceeded(mpc.getPos(), mpc.getangle()) ? 1 : 0;
+            }
+            if (runCompact)
+            {
+                if (0 == samples)
+                {
+                    mdaSS.initSteadyState(sfIn, angIn, attIn);
+                    MDAinitSteadyState(compactParams, compactStateSS, sfIn, angIn, attIn);
+                    compactMismatches += sameOutputs(mdaSS.getPos(), mdaSS.getangle(), mdaSS.getAngleNoTC(),
+                                                     compactStateSS.posOut, compactStateSS.angleOut, 
+                                                     compactStateSS.angleNoTCout) ? 0 : 1;
+                }
+                mdaSS.nextSample(sfIn, angIn, attIn);
+                MDAnextSample(compactParams, compactState, sfIn, angIn, attIn);
+                MDAnextSample(compactParams, compactStateSS, sfIn, angIn, attIn);
+                compactMismatches += sameOutputs(mda.getPos(), mda.getangle(), mda.getAngleNoTC(),
+                                                 compactState.posOut, compactState.angleOut, 
+                                                 compactState.angleNoTCout) ? 0 : 1;
+                compactMismatches += sameOutputs(mdaSS.getPos(), mdaSS.getangle(), mdaSS.getAngleNoTC(),
+                                                 compactStateSS.posOut, compactStateSS.angleOut, 
+                                                 compactStateSS.angleNoTCout) ? 0 : 1;
+            }
+            if (runAdaptive)
+            {
+                //Classical MDA timed the same way as the adaptive one
+                double classicalTime = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+                classicalReport.addSample(classicalCue.nextSample(classicalCue.reference(sfIn, attIn), mda.getPos(), 
+                                                                  mda.getangle(), mda.getAngleNoTC()),
+                                          classicalTime, workspaceExceeded(mda.getPos(), mda.getangle()));
+
+                adaptive.nextSample(sfIn, angIn, attIn);
+                writeMCISfullOutputs(adaptiveOutfile, adaptive.getPos(), adaptive.getangle(), adaptive.getAngleNoTC());
+                adaptiveReport.addSample(adaptive.getCueError(), adaptive.getLastComputeTime(), 
+                                         workspaceExceeded(adaptive.getPos(), adaptive.getangle()));
+            }
+            samples++;
         }
 
         std::cout << "done." << std::endl;
+        if (compare)
+        {
+            report.print(std::cout);
+        }
+        if (runMPC && (samples > 0))
+        {
+            std::cout << "  MPC over " << samples << " samples:" << std::endl;
+            std::cout << "    solve time: mean " << totalSolveTime / samples / 1000 << " us, worst " 
+                      << mpc.getWorstSolveTime() / 1000.0 << " us (budget " << MPC_SOLVE_BUDGET_NS / 1000 << " us)" << std::endl;
+            std::cout << "    worst iteration count: " << mpc.getWorstIterations() 
+                      << " of " << MPC_MAX_ITERATIONS << std::endl;
+            std::cout << "    iteration cap hit without converging: " << mpc.getCapHits() 
+                      << " samples (" << 100.0 * mpc.getCapHits() / samples << "%)" << std::endl;
+            std::cout << "    samples outside the workspace: classical " << mdaClamped
+                      << ", MPC " << mpcClamped << std::endl;
+        }
+        if (runCompact)
+        {
+            std::cout << "  Compact MDA: " << compactMismatches << " samples differing from MCIS_MDA" << std::endl;
+        }
+        if (runAdaptive && (samples > 0))
+        {
+            MCISvector scaling = adaptive.getScaling();
+            MCISvector tilt = adaptive.getTiltGains();
+            MCISvector freqs = adaptive.getBreakFrequencies();
+
+            std::cout << "  Adaptive washout vs classical over " << samples << " samples:" << std::endl;
+            classicalReport.print(std::cout, "classical");
+            adaptiveReport.print(std::cout, "adaptive");
+            std::cout << "    \tworst compute time vs budget: " << adaptive.getWorstComputeTime() / 1000.0 
+                      << " us of " << ADAPTIVE_COMPUTE_BUDGET_NS / 1000 << " us" << std::endl;
+            std::cout << "    \tfinal K_SF " << scaling[0] << ", " << scaling[1] << ", " << scaling[2]
+                      << "  K_TC " << tilt[0] << ", " << tilt[1] 
+                      << "  break freq. " << freqs[0] << ", " << freqs[1] << ", " << freqs[2] 
+                      << " rad/s" << std::endl;
+        }
 
         infile.close();
         outfile.close();
+        mpcOutfile.close();
+        adaptiveOutfile.close();
     }
     
     return 0;
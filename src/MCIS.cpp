@@ -26,9 +26,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 
+#include <cstdio>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <string>
 #include <unistd.h>
 #include <ncurses.h>
@@ -37,6 +39,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <arpa/inet.h>
 #include "include/MCIS_MB_interface.h"
 #include "include/MCIS_config.h"
+#include "include/MCIS_diag.h"
 
 // The MCIS parameters config file will be loaded from here:
 #define appConfigFilename "MCISinit.cfg"
@@ -53,6 +56,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 void sig_handler(int signo);
 
 bool cont = true;
+//Set on SIGINT, which also dumps the flight recorder
+volatile sig_atomic_t interrupted = 0;
 
 int main(int argc, char *argv[])
 {
@@ -64,6 +69,14 @@ int main(int argc, char *argv[])
                 MDAlogFilename = MDA_LOGNAME,
                 MDAlogFileext  = MDA_LOGEXT;
     bool subgrav = true;
+    bool singlePrecision = false;
+    std::string flightRecorderFilename = FLIGHT_RECORDER_FILENAME;
+    std::string journalFilename = JOURNAL_FILENAME;
+    std::string diagFilename = DIAG_FILENAME;
+    std::string engineName = "classical";
+    cueing_engine engine = CUEING_CLASSICAL;
+    rtTimingConfig rtConfig;
+    std::string rtClock = rtClockName(rtConfig.clock);
 
 
      /*
@@ -134,6 +147,9 @@ int main(int argc, char *argv[])
     {
         std::cout << "Using default MDA log filename: " << MDAlogFilename << std::endl;
     }
+    appConf.lookupValue("MCIS.flight_recorder_filename", flightRecorderFilename);
+    appConf.lookupValue("MCIS.journal_filename", journalFilename);
+    appConf.lookupValue("MCIS.diagnostics_filename", diagFilename);
     appConf.lookupValue("MCIS.subtract_gravity", subgrav);
     if (!subgrav)
     {
@@ -143,6 +159,64 @@ int main(int argc, char *argv[])
         std::cout << "          RESEARCH PURPOSES. To continue, press return." << std::endl;
         getchar();
     }
+    appConf.lookupValue("MCIS.single_precision", singlePrecision);
+    appConf.lookupValue("MCIS.cueing_engine", engineName);
+    if (engineName == "mpc")
+    {
+        engine = CUEING_MPC;
+    }
+    else if (engineName == "adaptive")
+    {
+        engine = CUEING_ADAPTIVE;
+    }
+    else if (engineName != "classical")
+    {
+        std::cout << "Error: Unknown cueing engine: " << engineName << std::endl;
+        std::cout << "Valid options are \"classical\", \"mpc\" and \"adaptive\"." << std::endl;
+        return 0;
+    }
+
+    // Real-time settings for the MB send thread, all optional
+    appConf.lookupValue("RT.clock", rtClock);
+    if (!rtClockFromName(rtClock, rtConfig.clock))
+    {
+        std::cout << "Error: Unknown RT clock: " << rtClock << std::endl;
+        std::cout << "Valid options are \"sleep_until\", \"clock_nanosleep\" and \"timerfd\"." << std::endl;
+        return 0;
+    }
+    appConf.lookupValue("RT.fifo_priority", rtConfig.fifo_priority);
+    appConf.lookupValue("RT.cpu", rtConfig.cpu);
+    appConf.lookupValue("RT.lock_memory", rtConfig.lock_memory);
+    appConf.lookupValue("RT.prefault_stack", rtConfig.prefault_stack);
+    appConf.lookupValue("RT.arena_huge_pages", rtConfig.arena_huge_pages);
+    appConf.lookupValue("RT.xp_busy_poll_us", rtConfig.xp_busy_poll_us);
+    std::string netBackend = netBackendName(rtConfig.net);
+    appConf.lookupValue("RT.net_backend", netBackend);
+    if (!netBackendFromName(netBackend, rtConfig.net))
+    {
+        std::cout << "Error: Unknown network backend: " << netBackend << std::endl;
+        std::cout << "Valid options are \"epoll\" and \"io_uring\"." << std::endl;
+        return 0;
+    }
+    appConf.lookupValue("RT.uring_sqpoll", rtConfig.uring_sqpoll);
+    std::string overrunPolicy = rtOverrunName(rtConfig.overrun);
+    appConf.lookupValue("RT.overrun_policy", overrunPolicy);
+    if (!rtOverrunFromName(overrunPolicy, rtConfig.overrun))
+    {
+        std::cout << "Error: Unknown overrun policy: " << overrunPolicy << std::endl;
+        std::cout << "Valid options are \"catch_up\" and \"drop\"." << std::endl;
+        return 0;
+    }
+    appConf.lookupValue("RT.overrun_skip_logging", rtConfig.overrun_skip_logging);
+    appConf.lookupValue("RT.overrun_resend", rtConfig.overrun_resend);
+    std::string tickMode = tickModeName(rtConfig.ticks);
+    appConf.lookupValue("RT.tick_mode", tickMode);
+    if (!tickModeFromName(tickMode, rtConfig.ticks))
+    {
+        std::cout << "Error: Unknown tick mode: " << tickMode << std::endl;
+        std::cout << "Valid options are \"fixed\", \"event\", \"jit\" and \"pll\"." << std::endl;
+        return 0;
+    }
 
 
     MCISconfig config;
@@ -266,11 +340,28 @@ int main(int argc, char *argv[])
      * 
      * It will spawn its own threads and get out of our way while we handle the
      * UI
+     * 
+     * It lives in a locked, prefaulted arena, so that nothing the send thread
+     * touches in it can take a page fault.
      */
+    std::ofstream diagFile(diagFilename, std::ios::app);
+    if (!diagFile.good())
+    {
+        std::cout << "Failed to open diagnostics file: " << diagFilename << std::endl;
+        return 0;
+    }
+    //Diagnostics from the interface's threads go to the file, never to the screen
+    diagDrain diagnostics(diagFile);
+
     std::cout << "Initializing MB interface...   ";
-    mbinterface motion_base(MBport, localPort, MBaddr, 
-                            XPport, config, MDA_log, subgrav);
+    rtArena arena(sizeof(mbinterface), rtConfig.arena_huge_pages);
+    mbinterface& motion_base = *arena.create<mbinterface>(MBport, localPort, MBaddr, 
+                            XPport, config, MDA_log, subgrav, singlePrecision,
+                            engine, rtConfig, flightRecorderFilename, journalFilename);
     std::cout << "Done." << std::endl;
+    std::cout << "Interface arena: " << arena.getSize() / 1024 << " KiB" 
+              << (arena.isLocked() ? ", locked" : ", NOT LOCKED")
+              << (arena.usesHugePages() ? ", huge pages" : "") << std::endl;
 
 
     /* --- End of init --- */
@@ -346,6 +437,18 @@ int main(int argc, char *argv[])
         {
             mvprintw(2, 40, "NO GRAVITY SUBTRACTION");
         }
+        if (CUEING_MPC == engine)
+        {
+            mvprintw(2, 65, "MPC cueing");
+        }
+        else if (CUEING_ADAPTIVE == engine)
+        {
+            mvprintw(2, 65, "Adaptive washout");
+        }
+        else if (singlePrecision)
+        {
+            mvprintw(2, 65, "Single precision MDA");
+        }
 
         mvprintw(3, 5, "Interface status: ");
         switch (motion_base.get_iface_status())
@@ -404,7 +507,281 @@ int main(int argc, char *argv[])
         vector_stream.getline(out_str, 128);
         mvprintw(11, 5, "Output angles:          %s", out_str);
 
+        uint64_t input_sequence;
+        int64_t  input_age;
+        motion_base.get_input_status(input_sequence, input_age);
+        if (input_sequence)
+        {
+            mvprintw(13, 5, "X-Plane messages: %llu, age at send: %6.1f ms    ",
+                     (unsigned long long)input_sequence, input_age / 1e6);
+        }
+        else
+        {
+            mvprintw(13, 5, "X-Plane messages: none received yet");
+        }
+
+        /*
+         *  Page faults in the send thread. Once ENGAGED there should be none.
+         */
+        {
+            pageFaultCounts before, since;
+            if (motion_base.get_page_faults(before, since))
+            {
+                mvprintw(9, 5, "Send thread page faults: %llu before ENGAGED, %llu since (%llu major)    ",
+                         (unsigned long long)(before.minor + before.major), 
+                         (unsigned long long)(since.minor + since.major),
+                         (unsigned long long)since.major);
+            }
+        }
+
+        /*
+         *  Overruns. Ticks run late (and, under "drop", skipped) come from
+         *  the ticker, load shed from the interface.
+         */
+        {
+            rtStatus rt = motion_base.get_rt_status();
+            uint64_t log_lines, mda_steps;
+            motion_base.get_shed_counts(log_lines, mda_steps);
+            mvprintw(12, 5, "Overruns (%s): late ticks %lu, dropped %lu, log lines shed %llu, MDA steps shed %llu",
+                     rtOverrunName(rtConfig.overrun), rt.missed_ticks, rt.dropped_ticks,
+                     (unsigned long long)log_lines, (unsigned long long)mda_steps);
+        }
+
+        uint64_t duplicated, skipped;
+        motion_base.get_sample_continuity(duplicated, skipped);
+        uint64_t burstDropped;
+        int busyPollUs;
+        motion_base.get_receive_status(burstDropped, busyPollUs);
+        std::string continuityLine = "X-Plane messages reused: " + std::to_string(duplicated) + 
+                                     ", never used: " + std::to_string(skipped) + 
+                                     " (" + std::to_string(burstDropped) + " in bursts)";
+        if (TICK_PLL == motion_base.get_tick_mode())
+        {
+            bool locked;
+            int64_t message_period, phase_error;
+            motion_base.get_pll_status(locked, message_period, phase_error);
+            char pllLine[96];
+            snprintf(pllLine, sizeof(pllLine), ", PLL %s, period %6.2f ms, phase error %7.1f us    ",
+                     locked ? "locked" : "UNLOCKED", message_period / 1e6, phase_error / 1e3);
+            continuityLine += pllLine;
+        }
+        mvprintw(14, 5, "%s", continuityLine.c_str());
+
         mvprintw(15, 5, "Send clock ticks: %d", motion_base.get_ticks());
+        {
+            uint64_t replies, timeouts;
+            int64_t lastReplyAge;
+            bool timedOut;
+            motion_base.get_MB_reply_status(replies, lastReplyAge, timedOut, timeouts);
+            if (replies)
+            {
+                mvprintw(15, 35, "MB replies: %llu, last %8.1f ms ago, %llu timeouts %s",
+                         (unsigned long long)replies, lastReplyAge / 1e6, 
+                         (unsigned long long)timeouts, timedOut ? "- MB NOT REPLYING" : "                ");
+            }
+            else
+            {
+                mvprintw(15, 35, "MB replies: none yet");
+            }
+        }
+        if (CUEING_MPC == engine)
+        {
+            mvprintw(16, 5, "MPC worst solve time: %8.1f us", 
+                     motion_base.get_MPC_worst_solve_time() / 1000.0);
+        }
+        else if (CUEING_ADAPTIVE == engine)
+        {
+            MCISvector scaling, tilt_gains, break_freqs;
+            motion_base.get_adaptive_params(scaling, tilt_gains, break_freqs);
+            mvprintw(16, 5, "Adaptive K_SF: %6.3f %6.3f %6.3f  K_TC: %6.4f %6.4f  break freq.: %5.2f %5.2f %5.2f rad/s",
+                     scaling[0], scaling[1], scaling[2], tilt_gains[0], tilt_gains[1],
+                     break_freqs[0], break_freqs[1], break_freqs[2]);
+        }
+
+        /*
+         *  Real-time settings. Anything requested but not in effect is
+         *  flagged, most likely the process lacks the privileges for it.
+         */
+        rtStatus rt = motion_base.get_rt_status();
+        if (rt.started)
+        {
+            std::string rtLine = std::string("RT clock: ") + rtClockName(rt.clock);
+            if (rt.clock != rtConfig.clock)
+            {
+                rtLine += " (" + std::string(rtClockName(rtConfig.clock)) + " unavailable)";
+            }
+            if (rt.fifo_priority > 0)
+            {
+                rtLine += ", SCHED_FIFO " + std::to_string(rt.fifo_priority);
+            }
+            else if (rtConfig.fifo_priority > 0)
+            {
+                rtLine += ", NO SCHED_FIFO";
+            }
+            if (rt.cpu >= 0)
+            {
+                rtLine += ", CPU " + std::to_string(rt.cpu);
+            }
+            else if (rtConfig.cpu >= 0)
+            {
+                rtLine += ", NO AFFINITY";
+            }
+            if (rt.memory_locked)
+            {
+                rtLine += ", memory locked";
+            }
+            else if (arena.isLocked())
+            {
+                rtLine += ", arena locked";
+            }
+            else if (rtConfig.lock_memory)
+            {
+                rtLine += ", MEMORY NOT LOCKED";
+            }
+            {
+                uint64_t burstDropped;
+                int busyPollUs;
+                motion_base.get_receive_status(burstDropped, busyPollUs);
+                if (busyPollUs > 0)
+                {
+                    rtLine += ", busy poll " + std::to_string(busyPollUs) + " us";
+                }
+                else if (rtConfig.xp_busy_poll_us > 0)
+                {
+                    rtLine += ", NO BUSY POLL";
+                }
+            }
+            if (NET_URING == rtConfig.net)
+            {
+                bool uringReceive, uringSend, sqPolled;
+                motion_base.get_net_status(uringReceive, uringSend, sqPolled);
+                if (uringReceive && uringSend)
+                {
+                    rtLine += sqPolled ? ", io_uring (SQPOLL)" : ", io_uring";
+                }
+                else if (uringReceive || uringSend)
+                {
+                    rtLine += uringReceive ? ", io_uring receive only" : ", io_uring send only";
+                }
+                else
+                {
+                    rtLine += ", NO IO_URING";
+                }
+                if (uringSend && rtConfig.uring_sqpoll && !sqPolled)
+                {
+                    rtLine += ", NO SQPOLL";
+                }
+            }
+            tick_mode ticks = motion_base.get_tick_mode();
+            rtLine += std::string(", ticks: ") + tickModeName(ticks);
+            if (ticks != rtConfig.ticks)
+            {
+                rtLine += " (" + std::string(tickModeName(rtConfig.ticks)) + " unavailable)";
+            }
+            if (TICK_JIT == ticks)
+            {
+                rtLine += ", margin " + std::to_string(motion_base.get_jit_margin() / 1000) + " us";
+            }
+            rtLine += ", missed ticks: " + std::to_string(rt.missed_ticks);
+            mvprintw(17, 5, "%s", rtLine.c_str());
+        }
+
+        {
+            //Latencies are only as true as the arrival times behind them
+            bool xplaneKernel, mbKernel;
+            motion_base.get_timestamp_status(xplaneKernel, mbKernel);
+            mvprintw(18, 5, "MDA log lines written: %llu, dropped: %llu, arrival times: X-Plane %s, MB %s",
+                     (unsigned long long)motion_base.get_log_written(),
+                     (unsigned long long)motion_base.get_log_dropped(),
+                     xplaneKernel ? "kernel" : "USER SPACE", mbKernel ? "kernel" : "USER SPACE");
+        }
+
+        //Per-tick timing histograms
+        mvprintw(19, 5, "%-16s %10s %10s %10s %10s  (us)", "", "p50", "p99", "p99.9", "max");
+        for (int i = 0; i < HIST_COUNT; i++)
+        {
+            timing_histogram which = (timing_histogram)i;
+            histogramSummary summary = motion_base.get_timing_summary(which);
+            mvprintw(20 + i, 5, "%-16s %10.1f %10.1f %10.1f %10.1f", 
+                     mbinterface::timing_histogram_name(which), 
+                     summary.p50 / 1000.0, summary.p99 / 1000.0, 
+                     summary.p999 / 1000.0, summary.max / 1000.0);
+        }
+
+        //MB tracking, next to the histograms. Errors in mm or mrad.
+        {
+            trackingStatus tracking = motion_base.get_tracking_status();
+            mvprintw(19, 72, "%-8s %9s %6s %9s %9s  %s", "Tracking", "delay ms", "corr.", 
+                     "error", "aligned", tracking.ready ? "          " : "(warming up)");
+            for (unsigned int i = 0; i < TRACKING_AXES; i++)
+            {
+                const trackingAxisStatus& axis = tracking.axes[i];
+                if (axis.delay_valid)
+                {
+                    mvprintw(20 + i, 72, "%-8s %9.1f %6.3f %9.2f %9.2f", trackingMonitor::axisName(i),
+                             axis.delay / 1e6, axis.correlation, 
+                             axis.error_rms * 1e3, axis.aligned_error_rms * 1e3);
+                }
+                else
+                {
+                    mvprintw(20 + i, 72, "%-8s %9s %6s %9.2f %9.2f", trackingMonitor::axisName(i),
+                             "-", "-", axis.error_rms * 1e3, axis.aligned_error_rms * 1e3);
+                }
+            }
+        }
+
+        //Flight recorder and event journal, under the tracking table
+        {
+            flightRecorderStatus recorder = motion_base.get_flight_recorder_status();
+            if (recorder.dumps)
+            {
+                mvprintw(27, 72, "Flight recorder: %llu dumps%s, last %s (%s)    ",
+                         (unsigned long long)recorder.dumps, recorder.failed ? " SOME FAILED" : "",
+                         recorder.last_path, flightRecorder::triggerName(recorder.last_trigger));
+            }
+            else
+            {
+                mvprintw(27, 72, "Flight recorder: recording");
+            }
+
+            std::string journalPath;
+            uint64_t journalWritten, journalDropped;
+            motion_base.get_journal_status(journalPath, journalWritten, journalDropped);
+            mvprintw(28, 72, "Event journal: %s, %llu events, %llu dropped", journalPath.c_str(),
+                     (unsigned long long)journalWritten, (unsigned long long)journalDropped);
+        }
+
+        //Latest diagnostic from the real-time threads
+        {
+            diag_id diagId;
+            diagStatus diag;
+            if (diagLatest(diagId, diag))
+            {
+                char diagLine[DIAG_LINE_LEN];
+                diagFormat(diagId, diag.last_value, diagLine, sizeof(diagLine));
+                mvprintw(29, 72, "Diagnostics: %llu, last: %s    ",
+                         (unsigned long long)diagTotal(), diagLine);
+            }
+            else
+            {
+                mvprintw(29, 72, "Diagnostics: none");
+            }
+        }
+
+        //Instrumentation build only: allocations and syscalls while ENGAGED
+        if (auditEnabled())
+        {
+            for (int i = 0; i < AUDIT_REGION_COUNT; i++)
+            {
+                audit_region_id which = (audit_region_id)i;
+                auditReport report = motion_base.get_audit_report(which);
+                double runs = report.runs ? (double)report.runs : 1.0;
+                mvprintw(21 + HIST_COUNT + i, 5, "%-16s allocations/run %6.2f  syscalls/run %6.2f  (%llu runs)",
+                         mbinterface::audit_region_name(which), 
+                         report.total.allocations / runs, report.total.syscalls / runs,
+                         (unsigned long long)report.runs);
+            }
+        }
 
         refresh();
 
@@ -470,6 +847,97 @@ int main(int argc, char *argv[])
     motion_base.stop();
 
     std::cout << "Threads should be joining now..." << std::endl;
+
+    if (interrupted)
+    {
+        std::string dumpPath = motion_base.dump_flight_recorder();
+        if (dumpPath.empty())
+        {
+            std::cout << "Failed to dump the flight recorder" << std::endl;
+        }
+        else
+        {
+            std::cout << "Flight recorder dumped to " << dumpPath << std::endl;
+        }
+    }
+    flightRecorderStatus recorder = motion_base.get_flight_recorder_status();
+    std::cout << "Flight recorder dumps: " << recorder.dumps << ", failed: " << recorder.failed << std::endl;
+    std::string journalPath;
+    uint64_t journalWritten, journalDropped;
+    motion_base.get_journal_status(journalPath, journalWritten, journalDropped);
+    std::cout << "Event journal: " << journalPath << ", events written: " << journalWritten 
+              << ", dropped: " << journalDropped << std::endl;
+    diagnostics.stop();
+    std::cout << "Diagnostics reported: " << diagTotal() << ", see " << diagFilename << std::endl;
+
+    std::cout << "MDA log lines written: " << motion_base.get_log_written() 
+              << ", dropped: " << motion_base.get_log_dropped() << std::endl;
+    std::cout << "User commands dropped: " << motion_base.get_commands_dropped() << std::endl;
+    uint64_t duplicated, skipped;
+    motion_base.get_sample_continuity(duplicated, skipped);
+    uint64_t burstDropped;
+    int busyPollUs;
+    motion_base.get_receive_status(burstDropped, busyPollUs);
+    std::cout << "X-Plane messages reused: " << duplicated << ", never used: " << skipped 
+              << " (" << burstDropped << " in bursts)" << std::endl;
+    rtStatus rt = motion_base.get_rt_status();
+    uint64_t log_lines, mda_steps;
+    motion_base.get_shed_counts(log_lines, mda_steps);
+    std::cout << "Overruns (" << rtOverrunName(rtConfig.overrun) << "): late ticks " << rt.missed_ticks 
+              << ", dropped " << rt.dropped_ticks << ", log lines shed " << log_lines 
+              << ", MDA steps shed " << mda_steps << std::endl;
+    pageFaultCounts before, since;
+    if (motion_base.get_page_faults(before, since))
+    {
+        std::cout << "Send thread page faults: " << before.minor + before.major << " before ENGAGED, " 
+                  << since.minor + since.major << " since (" << since.major << " major)" << std::endl;
+    }
+    pageFaultCounts process = processPageFaults();
+    std::cout << "Process page faults: " << process.minor + process.major 
+              << " (" << process.major << " major)" << std::endl;
+    uint64_t replies, timeouts;
+    int64_t lastReplyAge;
+    bool timedOut;
+    motion_base.get_MB_reply_status(replies, lastReplyAge, timedOut, timeouts);
+    std::cout << "MB replies: " << replies << ", reply timeouts: " << timeouts 
+              << ", commands left out of tracking: " << motion_base.get_tracking_dropped() << std::endl;
+    trackingStatus tracking = motion_base.get_tracking_status();
+    std::cout << "MB tracking over the last " << TRACKING_WINDOW << " commands:" << std::endl;
+    for (unsigned int i = 0; i < TRACKING_AXES; i++)
+    {
+        const trackingAxisStatus& axis = tracking.axes[i];
+        std::cout << "  " << std::left << std::setw(16) << trackingMonitor::axisName(i) << std::right;
+        if (axis.delay_valid)
+        {
+            std::cout << "delay " << axis.delay / 1e6 << " ms (correlation " << axis.correlation << "), ";
+        }
+        else
+        {
+            std::cout << "no delay estimate, ";
+        }
+        std::cout << "RMS error " << axis.error_rms << ", aligned " << axis.aligned_error_rms << std::endl;
+    }
+    std::cout << "Per-tick timing:" << std::endl;
+    for (int i = 0; i < HIST_COUNT; i++)
+    {
+        timing_histogram which = (timing_histogram)i;
+        std::cout << "  " << std::left << std::setw(16) << mbinterface::timing_histogram_name(which) 
+                  << std::right;
+        motion_base.get_timing_summary(which).print(std::cout);
+        std::cout << std::endl;
+    }
+    if (auditEnabled())
+    {
+        std::cout << "Allocations and syscalls while ENGAGED:" << std::endl;
+        for (int i = 0; i < AUDIT_REGION_COUNT; i++)
+        {
+            audit_region_id which = (audit_region_id)i;
+            std::cout << "  " << std::left << std::setw(16) << mbinterface::audit_region_name(which) 
+                      << std::right;
+            motion_base.get_audit_report(which).print(std::cout);
+            std::cout << std::endl;
+        }
+    }
     
     MDA_log.close();
     
@@ -480,5 +948,6 @@ int main(int argc, char *argv[])
 
 void sig_handler(int signo)
 {
+    interrupted = 1;
     cont = false;
 }
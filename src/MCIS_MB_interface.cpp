@@ -25,8 +25,12 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
 */
 
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <cmath>
 #include <chrono>
+#include <cstring>
 #include <iostream>
 #include <type_traits>
 #include <unistd.h>
@@ -34,38 +38,97 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "include/MCIS_MB_interface.h"
 #include "include/MCIS_util.h"
 #include "include/MCIS_fileio.h"
+#include "include/MCIS_diag.h"
 
 mbinterface::mbinterface(uint16_t mb_send_port, uint16_t mb_recv_port, 
                          uint32_t mb_IP, uint16_t xp_recv_port, 
                          MCISconfig mdaconfig, std::fstream& MDA_log,
-                         bool subtract_gravity) :
-                         simSocket{xp_recv_port, XP9},
+                         bool subtract_gravity, bool single_precision,
+                         cueing_engine engine, 
+                         const rtTimingConfig& rt_config,
+                         const std::string& flight_recorder_prefix,
+                         const std::string& journal_prefix) :
+                         subgrav{subtract_gravity},
+                         single_precision{single_precision},
+                         engine{engine},
+                         send_ticker{rt_config, (int64_t)(1e9 / 120)},
+                         requested_ticks{rt_config.ticks},
+                         tick_pll{(int64_t)(1e9 / 120)},
+                         overrun_skip_logging{rt_config.overrun_skip_logging},
+                         overrun_resend{rt_config.overrun_resend},
+                         flight_recorder{flight_recorder_prefix},
+                         journal{journal_prefix},
+                         simSocket{xp_recv_port, XP9, false, rt_config.xp_busy_poll_us},
+                         io_reactor{rt_config.net},
                          mda{mdaconfig, subtract_gravity},
-                         subgrav{subtract_gravity}
+                         mdaf{mdaconfig, subtract_gravity},
+                         mpc{mdaconfig, subtract_gravity},
+                         adaptive{mdaconfig},
+                         mda_log{MDA_log}
 {
     send_sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    //For HIST_MB_RTT. Without it, replies are stamped when read.
+    mb_kernel_timestamps = enableRxTimestamps(send_sock_fd);
 
     //Send socket addressing
     sendAddr.sin_family = AF_INET;
     sendAddr.sin_addr.s_addr = htonl(mb_IP);
     sendAddr.sin_port = htons(mb_send_port);
 
-    MDA_logfile = &MDA_log;
+#ifdef MCIS_HAVE_URING
+    //A send ring that can't poll (SQPOLL needs CAP_SYS_NICE before Linux 
+    //5.11) is still better than none
+    if (NET_URING == rt_config.net)
+    {
+        if (!(rt_config.uring_sqpoll && send_ring.init(2 * MB_SEND_SLOTS, true)))
+        {
+            send_ring.init(2 * MB_SEND_SLOTS);
+        }
+        struct iovec slots;
+        slots.iov_base = (void *)send_slots;
+        slots.iov_len  = sizeof(send_slots);
+        uring_send = send_ring.isReady() && send_ring.registerBuffers(&slots, 1) &&
+                     send_ring.registerFiles(&send_sock_fd, 1);
+        uring_send_sq_polled = uring_send && send_ring.isSqPolled();
+    }
+#endif
 
     //We start in the first state
     current_status = ESTABLISH_COMMS;
 
-    //Spawn other threads
-    MB_recv_thread = std::thread(&mbinterface::mb_recv_func, this);
+    //Nothing has run yet, but the UI may ask before the first tick
+    publish_status();
+    tracking_status.store(trackingStatus());
+
+    //One thread receives from X-Plane and from the MB. The MB socket is 
+    //only bound by the first sendto, until then it just never gets readable.
+    if (!io_reactor.watchDatagrams(simSocket.getSocketFd(), &simSocket) ||
+        !io_reactor.watchDatagrams(send_sock_fd, this))
+    {
+        std::runtime_error except("Failed to watch the sockets for reads!\n");
+        throw except;
+    }
+    io_reactor.setTimerHandler(this);
+    io_reactor.start();
+
+    //Spawn the send thread
     MB_send_thread = std::thread(&mbinterface::mb_send_func, this);
 }
 
 void mbinterface::stop()
 {
-    simSocket.stop();
     continue_operation = false;
 
+    //The send thread may be waiting on simSocket's eventfd, so it goes first,
+    //then the reactor, which may be in the middle of reading simSocket
     MB_send_thread.join();
+    //Nothing else will be recorded, a dump already underway is finished
+    flight_recorder.stop();
+    journal.stop();
+    io_reactor.stop();
+    simSocket.stop();
+    //Nothing else will be logged, write out the rest
+    mda_log.stop();
 
     int ret = shutdown(send_sock_fd, SHUT_RDWR);
     if (ret != 0 && errno != ENOTCONN)
@@ -74,39 +137,47 @@ void mbinterface::stop()
             "MB Socket shutdown did not return 0. You're deep in undefined behavior now.\n");
         throw except;
     }
-
-    MB_recv_thread.join();
 }
 
 void mbinterface::setEngage()
 {
-    if (current_status == WAIT_FOR_ENGAGE)
-    {
-        userEngage = true;
-    }
+    queue_user_command(CMD_ENGAGE);
 }
 
 void mbinterface::setPark()
 {
-    userPark = true;
+    queue_user_command(CMD_PARK);
 }
 
 void mbinterface::setReady()
 {
-    if (current_status == WAIT_FOR_READY)
-    {
-        userReady = true;
-    }
+    queue_user_command(CMD_READY);
 }
 
 void mbinterface::setOverride()
 {
-    userOverride = true;
+    queue_user_command(CMD_OVERRIDE);
 }
 
 void mbinterface::setReset()
 {
-    userReset = true;
+    queue_user_command(CMD_RESET);
+}
+
+uint64_t mbinterface::get_commands_dropped()
+{
+    return user_commands_dropped;
+}
+
+void mbinterface::queue_user_command(user_command command)
+{
+    userCommandMsg msg;
+    msg.command = command;
+    msg.issued  = monotonicNs();
+    if (!user_commands.push(msg))
+    {
+        user_commands_dropped++;
+    }
 }
 
 int mbinterface::get_ticks()
@@ -119,6 +190,15 @@ unsigned int mbinterface::get_MB_status()
     return MB_state_reply;
 }
 
+void mbinterface::get_MB_reply_status(uint64_t& replies, int64_t& last_reply_age, 
+                                      bool& timed_out, uint64_t& timeouts)
+{
+    replies = MB_replies;
+    last_reply_age = replies ? monotonicNs() - MB_last_reply : 0;
+    timed_out = MB_reply_timed_out;
+    timeouts = MB_reply_timeouts;
+}
+
 iface_status mbinterface::get_iface_status()
 {
     return current_status;
@@ -127,14 +207,300 @@ iface_status mbinterface::get_iface_status()
 void mbinterface::get_MDA_status(MCISvector& sf_in, MCISvector& angv_in, MCISvector& ang_in,
                         MCISvector& MB_pos_out, MCISvector& MB_rot_out)
 {
-    //Mutex is locked here, to insure consistent reads
-    std::lock_guard<std::mutex> lock(output_mutex);
-    sf_in   = curr_acceleration_in;
-    angv_in = curr_ang_velocity_in;
-    ang_in  = curr_attitude_in;
-    MB_pos_out  = curr_pos_out;
-    MB_rot_out  = curr_rot_out; 
-    //Mutex is unlocked here, as the lock guard is destructed at the end of its scope
+    //All five come from the same tick
+    mbStatusSnapshot snapshot = status_snapshot.load();
+    sf_in   = snapshot.sf_in;
+    angv_in = snapshot.angv_in;
+    ang_in  = snapshot.ang_in;
+    MB_pos_out  = snapshot.pos_out;
+    MB_rot_out  = snapshot.rot_out; 
+}
+
+void mbinterface::get_input_status(uint64_t& sequence, int64_t& age)
+{
+    mbStatusSnapshot snapshot = status_snapshot.load();
+    sequence = snapshot.input_sequence;
+    age      = snapshot.input_age;
+}
+
+cueing_engine mbinterface::get_cueing_engine()
+{
+    return engine;
+}
+
+int64_t mbinterface::get_MPC_worst_solve_time()
+{
+    return status_snapshot.load().mpc_worst_solve_time;
+}
+
+void mbinterface::get_adaptive_params(MCISvector& scaling, MCISvector& tilt_gains, MCISvector& break_freqs)
+{
+    if (CUEING_ADAPTIVE != engine)
+    {
+        return;
+    }
+    mbStatusSnapshot snapshot = status_snapshot.load();
+    scaling     = snapshot.adaptive_scaling;
+    tilt_gains  = snapshot.adaptive_tilt_gains;
+    break_freqs = snapshot.adaptive_break_freqs;
+}
+
+rtStatus mbinterface::get_rt_status()
+{
+    return status_snapshot.load().rt;
+}
+
+tick_mode mbinterface::get_tick_mode()
+{
+    return status_snapshot.load().ticks;
+}
+
+int64_t mbinterface::get_jit_margin()
+{
+    return status_snapshot.load().jit_margin;
+}
+
+void mbinterface::get_sample_continuity(uint64_t& duplicated, uint64_t& skipped)
+{
+    mbStatusSnapshot snapshot = status_snapshot.load();
+    duplicated = snapshot.samples_duplicated;
+    skipped    = snapshot.samples_skipped;
+}
+
+void mbinterface::get_net_status(bool& uring_receive, bool& uring_send_out, bool& sq_polled)
+{
+    uring_receive = io_reactor.usesUring();
+    uring_send_out = uring_send;
+    sq_polled = uring_send_sq_polled;
+}
+
+void mbinterface::get_timestamp_status(bool& xplane_kernel, bool& mb_kernel)
+{
+    xplane_kernel = simSocket.hasKernelTimestamps();
+    mb_kernel = mb_kernel_timestamps;
+}
+
+void mbinterface::get_receive_status(uint64_t& dropped, int& busy_poll_us)
+{
+    dropped = simSocket.getMessagesDropped();
+    busy_poll_us = simSocket.getBusyPollUs();
+}
+
+void mbinterface::get_shed_counts(uint64_t& log_lines, uint64_t& mda_steps)
+{
+    mbStatusSnapshot snapshot = status_snapshot.load();
+    log_lines = snapshot.log_lines_shed;
+    mda_steps = snapshot.mda_steps_shed;
+}
+
+bool mbinterface::get_page_faults(pageFaultCounts& before_engage, pageFaultCounts& since_engage)
+{
+    mbStatusSnapshot snapshot = status_snapshot.load();
+    before_engage = snapshot.faults_before_engage;
+    since_engage  = snapshot.faults_since_engage;
+    return snapshot.engaged_once;
+}
+
+#ifdef MCIS_AUDIT
+void mbinterface::inject_delay(int64_t ns)
+{
+    injected_delay = ns;
+}
+#endif
+
+void mbinterface::get_pll_status(bool& locked, int64_t& message_period, int64_t& phase_error)
+{
+    mbStatusSnapshot snapshot = status_snapshot.load();
+    locked         = snapshot.pll_locked;
+    message_period = snapshot.pll_message_period;
+    phase_error    = snapshot.pll_phase_error;
+}
+
+uint64_t mbinterface::get_log_written()
+{
+    return mda_log.get_written();
+}
+
+uint64_t mbinterface::get_log_dropped()
+{
+    return mda_log.get_dropped();
+}
+
+trackingStatus mbinterface::get_tracking_status()
+{
+    return tracking_status.load();
+}
+
+uint64_t mbinterface::get_tracking_dropped()
+{
+    return tracking_dropped;
+}
+
+flightRecorderStatus mbinterface::get_flight_recorder_status()
+{
+    return flight_recorder.getStatus();
+}
+
+std::string mbinterface::dump_flight_recorder()
+{
+    return flight_recorder.dump(TRIGGER_SHUTDOWN);
+}
+
+void mbinterface::get_journal_status(std::string& path, uint64_t& written, uint64_t& dropped)
+{
+    path = journal.getPath();
+    written = journal.get_written();
+    dropped = journal.get_dropped();
+}
+
+histogramSummary mbinterface::get_timing_summary(timing_histogram which)
+{
+    return timing_hists[which].getSummary();
+}
+
+auditReport mbinterface::get_audit_report(audit_region_id which)
+{
+    if (AUDIT_REACTOR == which)
+    {
+        return io_reactor.getAuditReport();
+    }
+    return audit_regions[which].getReport();
+}
+
+const char *mbinterface::audit_region_name(audit_region_id which)
+{
+    switch (which)
+    {
+        case AUDIT_TICK:
+            return "Send tick";
+        case AUDIT_MDA_STEP:
+            return "MDA step";
+        case AUDIT_REACTOR:
+            return "Reactor wakeup";
+        case AUDIT_REGION_COUNT:
+            break;
+    }
+    return "Unknown";
+}
+
+const char *mbinterface::status_name(iface_status status)
+{
+    switch (status)
+    {
+        case ESTABLISH_COMMS:
+            return "ESTABLISH_COMMS";
+        case WAIT_FOR_ENGAGE:
+            return "WAIT_FOR_ENGAGE";
+        case ENGAGING:
+            return "ENGAGING";
+        case WAIT_FOR_READY:
+            return "WAIT_FOR_READY";
+        case RATE_LIMITED:
+            return "RATE_LIMITED";
+        case ENGAGED:
+            return "ENGAGED";
+        case PARKING:
+            return "PARKING";
+        case MB_FAULT:
+            return "MB_FAULT";
+        case MB_RECOVERABLE_FAULT:
+            return "MB_RECOVERABLE_FAULT";
+    }
+    return "UNKNOWN";
+}
+
+const char *mbinterface::error_name(iface_error error)
+{
+    switch (error)
+    {
+        case NONE:
+            return "NONE";
+        case MB_FAULT_1:
+            return "MB_FAULT_1";
+        case MB_FAULT_2:
+            return "MB_FAULT_2";
+        case MB_FAULT_3:
+            return "MB_FAULT_3";
+        case MB_RESPONSE_TIMED_OUT:
+            return "MB_RESPONSE_TIMED_OUT";
+        case MB_ENGAGE_FAILED:
+            return "MB_ENGAGE_FAILED";
+        case MB_ESTOP:
+            return "MB_ESTOP";
+    }
+    return "UNKNOWN";
+}
+
+const char *mbinterface::command_name(user_command command)
+{
+    switch (command)
+    {
+        case CMD_ENGAGE:
+            return "ENGAGE";
+        case CMD_READY:
+            return "READY";
+        case CMD_PARK:
+            return "PARK";
+        case CMD_OVERRIDE:
+            return "OVERRIDE";
+        case CMD_RESET:
+            return "RESET";
+    }
+    return "UNKNOWN";
+}
+
+const char *mbinterface::mb_state_name(unsigned int mb_state)
+{
+    switch (mb_state)
+    {
+        case MB_STATE_POWER_UP:
+            return "POWER UP";
+        case MB_STATE_IDLE:
+            return "IDLE";
+        case MB_STATE_STANDBY:
+            return "STANDBY";
+        case MB_STATE_ENGAGED:
+            return "ENGAGED";
+        case MB_STATE_PARKING:
+            return "PARKING";
+        case MB_STATE_FAULT1:
+            return "FAULT1";
+        case MB_STATE_FAULT2:
+            return "FAULT2";
+        case MB_STATE_FAULT3:
+            return "FAULT3";
+        case MB_STATE_DISABLED:
+            return "DISABLED";
+        case MB_STATE_INHIBITED:
+            return "INHIBITED";
+    }
+    return "UNKNOWN";
+}
+
+const char *mbinterface::timing_histogram_name(timing_histogram which)
+{
+    switch (which)
+    {
+        case HIST_WAKE_LATENESS:
+            return "Wake lateness";
+        case HIST_MDA_COMPUTE:
+            return "MDA compute";
+        case HIST_LOGGING:
+            return "Logging";
+        case HIST_SEND:
+            return "Send";
+        case HIST_COMMAND:
+            return "Command";
+        case HIST_INPUT_AGE:
+            return "Input age";
+        case HIST_INPUT_TO_OUTPUT:
+            return "Input to output";
+        case HIST_MB_RTT:
+            return "MB round trip";
+        case HIST_COUNT:
+            break;
+    }
+    return "Unknown";
 }
 
 void mbinterface::testsend_mb_command()
@@ -156,7 +522,7 @@ void mbinterface::testsend_mb_command()
                         (sockaddr *)&sendAddr, sizeof(sendAddr));
     if (bytes != sizeof(testPacket))
     {
-        std::cout << "Error sending! Sent " << bytes << std::endl;
+        diagReport(DIAG_MB_SEND_FAILED, bytes);
     }
 
 }
@@ -183,11 +549,20 @@ void mbinterface::send_mb_command(int MCW, MCISvector& pos, MCISvector& rot)
     static_assert(sizeof(packet) == 32, 
                 "DOF packet structure does not match the correct size (probably due to padding)");
 
-    long int bytes = sendto(send_sock_fd, (void*)&packet, sizeof(packet), 0, 
-                        (sockaddr *)&sendAddr, sizeof(sendAddr));
-    if (bytes != sizeof(packet))
+    send_packet(packet);
+
+    //How old the X-Plane data behind this command is, now that it's out,
+    //and the first time it goes out, the latency of the whole chain
+    if (curr_output_sequence)
     {
-        std::cout << "Error sending! Sent " << bytes << std::endl;
+        int64_t age = monotonicNs() - curr_output_input_time;
+        timing_hists[HIST_INPUT_AGE].record(age);
+        if (curr_output_sequence != last_sent_sequence)
+        {
+            timing_hists[HIST_INPUT_TO_OUTPUT].record(age);
+            last_input_to_output = age;
+            last_sent_sequence = curr_output_sequence;
+        }
     }
 }
 
@@ -208,34 +583,170 @@ void mbinterface::send_mb_neutral_command(int MCW)
     static_assert(sizeof(packet) == 32, 
                 "DOF packet structure does not match the correct size (probably due to padding)");
 
-    long int bytes = sendto(send_sock_fd, (void*)&packet, sizeof(packet), 0, 
+    send_packet(packet);
+}
+
+void mbinterface::send_packet(const DOFpacket& packet)
+{
+    int64_t start = monotonicNs();
+    last_sent_packet = packet;
+    //Set before it goes, the reply may beat sendto back
+    MB_command_sent = start;
+    trackingCommandMsg sent_command;
+    sent_command.packet = packet;
+    sent_command.sent = start;
+    sent_command.seq = tracking_sent_seq + 1;
+    //While timed out, nothing is going to answer it, see onTimer
+    if (!MB_reply_timed_out && !tracking_commands.push(sent_command))
+    {
+        tracking_dropped++;
+    }
+    //After the push, so that track_feedback finds it queued if it was
+    tracking_sent_seq = sent_command.seq;
+#ifdef MCIS_HAVE_URING
+    if (uring_send && send_packet_uring(packet))
+    {
+        last_send_time = monotonicNs() - start;
+        timing_hists[HIST_SEND].record(last_send_time);
+        return;
+    }
+#endif
+    long int bytes = sendto(send_sock_fd, (const void*)&packet, sizeof(packet), 0, 
                         (sockaddr *)&sendAddr, sizeof(sendAddr));
+    last_send_time = monotonicNs() - start;
+    timing_hists[HIST_SEND].record(last_send_time);
+
     if (bytes != sizeof(packet))
     {
-        std::cout << "Error sending! Sent " << bytes << std::endl;
+        diagReport(DIAG_MB_SEND_FAILED, bytes);
     }
 }
 
+/*
+ *  send_packet_uring
+ * 
+ * Sends packet as a zero-copy send from one of the registered send_slots,
+ * through the registered send_sock_fd. Returns once it is queued, so 
+ * HIST_SEND only covers queueing. Completions are reaped on the next call,
+ * from memory, without a syscall.
+ * 
+ * Theory of operation:
+ * 
+ * 1) Reap completions. Each send posts its result, then, if it got as far 
+ *      as the network stack, a notification once the slot may be reused. 
+ *      A send the kernel won't do at all turns io_uring sends off for good.
+ * 2) Take the next free slot. If none is free, the MB gets a plain sendto.
+ * 3) Copy packet in, queue the send and submit. With SQPOLL that is usually
+ *      no syscall at all.
+ */
+bool mbinterface::send_packet_uring(const DOFpacket& packet)
+{
+#ifdef MCIS_HAVE_URING
+    // 1) Reap
+    io_uring_cqe *cqe;
+    while ((cqe = send_ring.peekCqe()))
+    {
+        unsigned int slot = (unsigned int)cqe->user_data % MB_SEND_SLOTS;
+        if (!(cqe->flags & IORING_CQE_F_NOTIF))
+        {
+            if ((-EINVAL == cqe->res) || (-EOPNOTSUPP == cqe->res))
+            {
+                uring_send = false;
+            }
+            else if (cqe->res != sizeof(packet))
+            {
+                diagReport(DIAG_MB_SEND_FAILED, cqe->res);
+            }
+        }
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+        {
+            send_slot_busy[slot] = false;
+        }
+        send_ring.seenCqe();
+    }
+    if (!uring_send)
+    {
+        return false;
+    }
+
+    // 2) Slot
+    unsigned int slot = next_send_slot;
+    if (send_slot_busy[slot])
+    {
+        return false;
+    }
+    io_uring_sqe *sqe = send_ring.getSqe();
+    if (!sqe)
+    {
+        return false;
+    }
+    next_send_slot = (slot + 1) % MB_SEND_SLOTS;
+
+    // 3) Send
+    send_slots[slot] = packet;
+    send_slot_busy[slot] = true;
+    sqe->opcode = IORING_OP_SEND_ZC;
+    sqe->fd = 0;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = (uint64_t)(uintptr_t)&send_slots[slot];
+    sqe->len = sizeof(packet);
+    sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+    sqe->buf_index = 0;
+    sqe->addr2 = (uint64_t)(uintptr_t)&sendAddr;
+    sqe->addr_len = sizeof(sendAddr);
+    sqe->user_data = slot;
+    if (send_ring.submit() < 0)
+    {
+        //Never seen by the kernel, so no completion will free it
+        send_slot_busy[slot] = false;
+        return false;
+    }
+    return true;
+#else
+    (void)packet;
+    return false;
+#endif
+}
+
 
 void mbinterface::mb_send_func()
 {
     //std::cout << "Send thread spawned!" << std::endl;
 
-    auto nextTick = std::chrono::high_resolution_clock::now();
-    //std::chrono::high_resolution_clock::duration oneSecond(std::chrono::duration<long long>(1));
-    auto sampleTime = std::chrono::nanoseconds( (int)(1e9 / 120));
-    //auto sampleTime = std::chrono::microseconds((unsigned long)(10e9));
+    //Real-time settings apply to this thread, so they are applied here.
+    send_ticker.start();
+
+    //In event mode, each tick waits for a new X-Plane message before 
+    //running the MDA
+    rtEventWait input_wait(simSocket.getEventFd());
+    if ((TICK_EVENT == requested_ticks) && input_wait.ready())
+    {
+        active_ticks = TICK_EVENT;
+    }
+    else if ((TICK_JIT == requested_ticks) || (TICK_PLL == requested_ticks))
+    {
+        active_ticks = requested_ticks;
+    }
+
+    journal.log(JOURNAL_START, engine, active_ticks);
 
     send_mb_neutral_command(MCW_DOF_MODE);
-    sock_bound = true;
 
     while (continue_operation)
     {
-        nextTick += sampleTime;
+        bool audit_tick = (ENGAGED == current_status);
+        audit_regions[AUDIT_TICK].begin();
+        uint32_t flight_flags = late_tick ? FLIGHT_LATE_TICK : 0;
+
+        //Whatever the MB reported since the last tick, before the state 
+        //machine acts on it
+        journal_mb_changes();
 
         if (send_ticks % ticks_per_tock == 0)
         {
-            
+            flight_flags |= FLIGHT_TOCK;
+            take_user_commands();
+
             if (!(current_status == ESTABLISH_COMMS)    && 
                 !(current_status == WAIT_FOR_ENGAGE)    &&
                 !(current_status == MB_FAULT)           &&
@@ -243,7 +754,7 @@ void mbinterface::mb_send_func()
             {
                 if (userPark)
                 {
-                    current_status = PARKING;
+                    change_status(PARKING);
                 }
                 
             }
@@ -252,11 +763,11 @@ void mbinterface::mb_send_func()
             if (MB_state_reply == MB_STATE_FAULT1 ||
                 MB_state_reply == MB_STATE_FAULT3 )
             {
-                current_status = MB_FAULT;
+                change_status(MB_FAULT);
             }
             else if (MB_state_reply == MB_STATE_FAULT2)
             {
-                current_status = MB_RECOVERABLE_FAULT;
+                change_status(MB_RECOVERABLE_FAULT);
             }
 
             //Communicate with MB
@@ -266,7 +777,7 @@ void mbinterface::mb_send_func()
                     mb_send_func_ESTABLISH_COMMS();
                     if (userOverride)
                     {
-                        current_status = WAIT_FOR_ENGAGE;
+                        change_status(WAIT_FOR_ENGAGE);
                         userOverride = false;
                     }
                     break;
@@ -274,7 +785,7 @@ void mbinterface::mb_send_func()
                     mb_send_func_WAIT_FOR_ENGAGE();
                     if (userOverride)
                     {
-                        current_status = ENGAGING;
+                        change_status(ENGAGING);
                         userOverride = false;
                     }
                     break;
@@ -282,7 +793,7 @@ void mbinterface::mb_send_func()
                     mb_send_func_ENGAGING();
                     if (userOverride)
                     {
-                        current_status = WAIT_FOR_READY;
+                        change_status(WAIT_FOR_READY);
                         userOverride = false;
                     }
                     break;
@@ -290,7 +801,7 @@ void mbinterface::mb_send_func()
                     mb_send_func_WAIT_FOR_READY();
                     if (userOverride)
                     {
-                        current_status = ENGAGED;
+                        change_status(ENGAGED);
                         userOverride = false;
                     }
                     break;
@@ -301,7 +812,7 @@ void mbinterface::mb_send_func()
                     mb_send_func_ENGAGED();
                     if (userOverride)
                     {
-                        current_status = PARKING;
+                        change_status(PARKING);
                         userOverride = false;
                     }
                     break;
@@ -318,59 +829,496 @@ void mbinterface::mb_send_func()
             //Delete any unused user input
             reset_user_commands();
         }
-        // This block exists only to allow the lock guard object to be 
-        // destructed before the loop iteration ends.
+        if (TICK_EVENT == active_ticks)
+        {
+            //Returns as soon as a message arrives. One that arrived since
+            //the last getData counts too, so this returns at once.
+            input_wait.waitUntil(send_ticker.getNextDeadline() - EVENT_TICK_MARGIN_NS);
+        }
+        int64_t jit_wake = 0;
+        if (TICK_JIT == active_ticks)
+        {
+            jit_wake = send_ticker.getNextDeadline() - jit_margin;
+            sleepUntilNs(jit_wake);
+        }
+        if (late_tick && overrun_resend)
+        {
+            //Shed the whole tick. Outputs are left alone, so the next tock
+            //sends the same command again.
+            mda_steps_shed++;
+            flight_flags |= FLIGHT_MDA_SHED;
+        }
+        else
+        {
+            //If no new message came in, this is the previous sample again
+            uint64_t prev_sequence = curr_input_sequence;
+            bool new_input = simSocket.getData(curr_acceleration_in, curr_ang_velocity_in, 
+                                               curr_attitude_in, curr_input_sequence, 
+                                               curr_input_recv_time);
+            if (new_input)
+            {
+                flight_flags |= FLIGHT_NEW_INPUT;
+            }
+            if (!new_input && curr_input_sequence)
+            {
+                samples_duplicated++;
+            }
+            else if (new_input && prev_sequence)
+            {
+                samples_skipped += curr_input_sequence - prev_sequence - 1;
+            }
+            if (new_input && (TICK_PLL == active_ticks))
+            {
+                tick_pll.arrival(curr_input_sequence, curr_input_recv_time);
+            }
+            int64_t mda_start = monotonicNs();
+            mda_next_sample();
+            int64_t log_start = monotonicNs();
+#ifdef MCIS_AUDIT
+            int64_t delay = injected_delay.exchange(0);
+            if (delay > 0)
+            {
+                sleepUntilNs(log_start + delay);
+            }
+#endif
+            if (late_tick && overrun_skip_logging)
+            {
+                log_lines_shed++;
+            }
+            else
+            {
+                //If the reactor is mid-update, the previous one will do
+                tracking_status.tryLoad(curr_tracking);
+                mda_log.log(curr_acceleration_in, curr_ang_velocity_in,
+                            curr_attitude_in, curr_pos_out, curr_rot_out,
+                            last_input_to_output, MB_last_rtt, curr_tracking);
+            }
+            timing_hists[HIST_LOGGING].record(monotonicNs() - log_start);
+            timing_hists[HIST_MDA_COMPUTE].record(log_start - mda_start);
+
+            //The cueing engine's own outputs, before they are limited
+            flight_record.mda_compute = log_start - mda_start;
+            for (unsigned int i = 0; i < 3; i++)
+            {
+                flight_record.mda_pos[i] = curr_pos_out[i];
+                flight_record.mda_rot[i] = curr_rot_out[i];
+                flight_record.mda_rot_no_tc[i] = curr_rot_no_tc[i];
+            }
+
+            /*Clamp outputs down and offset them if needed (z)*/
+            output_limiter(curr_pos_out, curr_rot_out);
+
+            if (TICK_JIT == active_ticks)
+            {
+                jit_window.record(monotonicNs() - jit_wake);
+                if (send_ticks % JIT_RELEARN_TICKS == 0)
+                {
+                    update_jit_margin();
+                }
+            }
+        }
+
+        if (TICK_PLL == active_ticks)
+        {
+            int64_t adjust = tick_pll.update(send_ticker.getNextDeadline(), monotonicNs());
+            if (adjust || (tick_pll.getTickPeriod() != send_ticker.getPeriod()))
+            {
+                send_ticker.retime(tick_pll.getTickPeriod(), adjust);
+            }
+        }
+
+        if (engaged_once)
+        {
+            if (send_ticks % PAGE_FAULT_SAMPLE_TICKS == 0)
+            {
+                faults_since_engage = threadPageFaults() - faults_at_engage;
+            }
+        }
+        else if (ENGAGED == current_status)
         {
-            //Lock the mutex
-            std::lock_guard<std::mutex> lock(output_mutex);
-            simSocket.getData(curr_acceleration_in, curr_ang_velocity_in, curr_attitude_in);
-            mda.nextSample(curr_acceleration_in, curr_ang_velocity_in, curr_attitude_in);
-            curr_pos_out = mda.getPos();
-            curr_rot_out = mda.getangle();
-            //Mutex is unlocked here, as the lock guard is destructed due to end of scope
-            write_MDA_log(*MDA_logfile, curr_acceleration_in, curr_ang_velocity_in,
-                            curr_attitude_in, curr_pos_out, curr_rot_out);
+            faults_at_engage = threadPageFaults();
+            engaged_once = true;
+            io_reactor.resetAudit();
         }
 
-        /*Clamp outputs down and offset them if needed (z)*/
-        output_limiter(curr_pos_out, curr_rot_out);
+        record_flight(flight_flags);
+        publish_status();
 
         send_ticks++;
-        std::this_thread::sleep_until(nextTick);
+        late_tick = send_ticker.wait();
+        //Dropped ticks still count, so that timeouts stay in real time
+        send_ticks += send_ticker.getLastDropped();
+        timing_hists[HIST_WAKE_LATENESS].record(send_ticker.getLastLateness());
+
+        audit_regions[AUDIT_TICK].end(audit_tick);
     }
 }
 
 
 /*
- *  recv_func
+ *  change_status
+ * 
+ * Every state transition goes through here, so that it is journaled. 
+ * Entering a fault also triggers the flight recorder, to keep what led up
+ * to it, and what came right after.
+ */
+void mbinterface::change_status(iface_status next)
+{
+    iface_status previous = current_status;
+    if (next == previous)
+    {
+        return;
+    }
+    //Whatever the MB reported that led to this goes before it
+    journal_mb_changes();
+    current_status = next;
+    journal.log(JOURNAL_STATE, previous, next, current_error);
+
+    if (MB_FAULT == next)
+    {
+        flight_recorder.trigger(TRIGGER_MB_FAULT, next, monotonicNs());
+    }
+    else if (MB_RECOVERABLE_FAULT == next)
+    {
+        flight_recorder.trigger(TRIGGER_MB_RECOVERABLE_FAULT, next, monotonicNs());
+    }
+}
+
+/*
+ *  journal_mb_changes
+ * 
+ * The reactor thread only keeps the latest of what the MB reports, so the
+ * send thread journals changes as it sees them, once per tick. A change 
+ * that comes and goes within a tick is missed, but the MB holds its state 
+ * and faults for far longer than that.
+ */
+void mbinterface::journal_mb_changes()
+{
+    if (!MB_replies)
+    {
+        return;
+    }
+    int64_t last_reply = MB_last_reply;
+
+    uint32_t mb_state = MB_state_reply;
+    if (mb_state != journaled_mb_state)
+    {
+        journal.log(JOURNAL_MB_STATE, journaled_mb_state, mb_state, last_reply);
+        journaled_mb_state = mb_state;
+    }
+    uint32_t latched_fault = ntohl(MB_latched_fault_raw);
+    if (latched_fault != journaled_latched_fault)
+    {
+        journal.log(JOURNAL_LATCHED_FAULT, journaled_latched_fault, latched_fault, last_reply);
+        journaled_latched_fault = latched_fault;
+    }
+    uint32_t discrete_io = ntohl(MB_discrete_io_raw);
+    if (discrete_io != journaled_discrete_io)
+    {
+        journal.log(JOURNAL_DISCRETE_IO, journaled_discrete_io, discrete_io, last_reply);
+        journaled_discrete_io = discrete_io;
+    }
+    bool timed_out = MB_reply_timed_out;
+    if (timed_out != journaled_reply_timed_out)
+    {
+        journal.log(JOURNAL_REPLY_TIMEOUT, timed_out, 0, (int64_t)MB_reply_timeouts.load());
+        journaled_reply_timed_out = timed_out;
+    }
+}
+
+/*
+ *  record_flight
  * 
- * Loop around, receiving the MB's replies
+ * Fill in the rest of this tick's flight record and record it. The cueing 
+ * engine's part was filled in as it ran, so on a tick that shed it, it is
+ * the last tick's again, as the outputs are.
+ */
+void mbinterface::record_flight(uint32_t flags)
+{
+    flightRecord& rec = flight_record;
+    rec.tick = send_ticks;
+    rec.time = monotonicNs();
+    rec.status = current_status;
+    rec.error = current_error;
+    if (MB_reply_timed_out)
+    {
+        flags |= FLIGHT_REPLY_TIMED_OUT;
+    }
+    rec.flags = flags;
+    rec.mcw = ntohl(last_sent_packet.MCW);
+
+    rec.wake_lateness = send_ticker.getLastLateness();
+    rec.send_time = last_send_time;
+    rec.input_to_output = last_input_to_output;
+    rec.mb_rtt = MB_last_rtt;
+
+    rec.input_sequence = curr_input_sequence;
+    rec.input_recv_time = curr_input_recv_time;
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        rec.sf_in[i]   = curr_acceleration_in[i];
+        rec.angv_in[i] = curr_ang_velocity_in[i];
+        rec.att_in[i]  = curr_attitude_in[i];
+    }
+    command_axes(last_sent_packet, rec.command);
+
+    //If the reactor is mid-update, the previous one will do
+    tracking_status.tryLoad(curr_tracking);
+    rec.mb_latched_fault = MB_latched_fault_raw;
+    rec.mb_discrete_io = MB_discrete_io_raw;
+    rec.mb_state_info = MB_state_info_raw;
+    rec.reserved = 0;
+    rec.mb_replies = MB_replies;
+    rec.mb_last_reply = MB_last_reply;
+    for (unsigned int i = 0; i < TRACKING_AXES; i++)
+    {
+        rec.feedback[i] = curr_tracking.feedback[i];
+    }
+
+    flight_recorder.record(rec);
+}
+
+
+/*
+ *  onReadable
  * 
- * TODO - consider adding a timeout
+ * Runs in the reactor thread whenever MB replies are waiting: take them all,
+ * without blocking, and keep the MB state from the last one. Anything that
+ * is not a whole DOFresponse is ignored. recvmsg, for the kernel timestamp.
  */
-void mbinterface::mb_recv_func()
+void mbinterface::onReadable(int fd)
 {
     DOFresponse mb_response;
+    struct iovec iov;
+    struct msghdr msg;
+
+    while (true)
+    {
+        //recv(recv_sock_fd, (void *)&mb_response, sizeof(mb_response), 0);
+        iov.iov_base = &mb_response;
+        iov.iov_len  = sizeof(mb_response);
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = MB_recv_control;
+        msg.msg_controllen = sizeof(MB_recv_control);
+        ssize_t bytes = recvmsg(fd, &msg, MSG_DONTWAIT);
+        if (bytes < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+            {
+                diagReport(DIAG_MB_RECV_FAILED, errno);
+            }
+            return;
+        }
+        if (bytes == sizeof(mb_response))
+        {
+            int64_t rx_time = rxTimestampNs(&msg);
+            handle_MB_response(mb_response, rx_time ? rx_time : monotonicNs());
+        }
+    }
+}
+
+/*
+ *  onDatagram
+ * 
+ * Same, one reply at a time, from an io_uring reactor
+ */
+void mbinterface::onDatagram(int fd, const unsigned char *data, int length, int64_t rx_time)
+{
+    (void)fd;
+    if (length == sizeof(DOFresponse))
+    {
+        DOFresponse mb_response;
+        memcpy(&mb_response, data, sizeof(mb_response));
+        handle_MB_response(mb_response, rx_time);
+    }
+}
+
+/*
+ *  handle_MB_response
+ * 
+ * Keeps the MB state from one reply, restarts the reply timeout and hands
+ * the feedback to track_feedback.
+ * 
+ * The MB answers every command, so a reply is matched to the last command
+ * sent, for HIST_MB_RTT. Taking the send time clears it, so that a second 
+ * reply to the same command isn't counted. One that lands after the next 
+ * command went out would have arrived before it was sent, so it is 
+ * dropped, and that next command goes unmeasured.
+ */
+void mbinterface::handle_MB_response(const DOFresponse& mb_response, int64_t rx_time)
+{
     static_assert(sizeof(DOFresponse) == 40, 
                 "DOF response structure does not match the correct size (probably due to padding)");
-    
-    while (!sock_bound)
+
+    if (mb_response.latched_fault_data)
     {
-        sleep(1);
+        MB_error_asserted = true;
     }
+    MB_state_info_raw  = mb_response.machine_state_info;
+    MB_latched_fault_raw = mb_response.latched_fault_data;
+    MB_discrete_io_raw = mb_response.discrete_IO_info;
+    MB_state_reply =  ntohl(mb_response.machine_state_info) & MASK_STATE_ENCODED;
+    int64_t now = monotonicNs();
+    MB_last_reply = now;
+    //The reply timeout starts with the first reply, and again after it
+    //expired. In between, onTimer keeps pushing it back.
+    if (!MB_replies || MB_reply_timed_out)
+    {
+        io_reactor.armTimer(now + MB_REPLY_TIMEOUT_NS);
+    }
+    MB_replies++;
+    MB_reply_timed_out = false;
 
-    while(continue_operation)
+    int64_t sent = MB_command_sent.exchange(0);
+    if (sent && (rx_time >= sent))
     {
-        //recv(recv_sock_fd, (void *)&mb_response, sizeof(mb_response), 0);
-        recv(send_sock_fd, (void *)&mb_response, sizeof(mb_response), 0);
-        if (mb_response.latched_fault_data)
+        timing_hists[HIST_MB_RTT].record(rx_time - sent);
+        MB_last_rtt = rx_time - sent;
+    }
+
+    track_feedback(mb_response);
+    //std::cout << "Received reply from MB" << std::endl;
+}
+
+/*
+ *  track_feedback
+ * 
+ * Pairs the feedback in a reply with the command it answers, the last one
+ * sent, for trackingMonitor. Runs in the reactor thread.
+ * 
+ * A command that never got a reply still takes its place in the history, 
+ * so that lags stay counted in commands, paired with the last feedback 
+ * there was: the best guess at where the MB was. A second reply to the 
+ * same command is not paired at all.
+ * 
+ * If the last command sent never made it to tracking_commands (it didn't 
+ * fit, or it went out during a reply timeout), the reply is its own, not 
+ * the one of whatever was queued before it. Then nothing is paired with 
+ * the reply, and the queued commands are left unanswered.
+ */
+void mbinterface::track_feedback(const DOFresponse& mb_response)
+{
+    //Before popping: anything sent up to here is queued by now, or never was
+    uint64_t sent_seq = tracking_sent_seq;
+    pop_tracking_commands();
+    if (tracking_has_pending && (tracking_pending.seq < sent_seq))
+    {
+        track_unanswered();
+    }
+    if (!tracking_has_pending)
+    {
+        feedback_axes(mb_response, tracking_held_feedback);
+        return;
+    }
+
+    double command[TRACKING_AXES];
+    command_axes(tracking_pending.packet, command);
+    feedback_axes(mb_response, tracking_held_feedback);
+    tracking.addSample(command, tracking_pending.sent, tracking_held_feedback);
+    tracking_has_pending = false;
+    tracking_status.store(tracking.getStatus());
+}
+
+/*
+ *  pop_tracking_commands
+ * 
+ * Takes every queued command. The newest is left in tracking_pending, the
+ * ones before it go into the history with the last feedback there was.
+ */
+void mbinterface::pop_tracking_commands()
+{
+    trackingCommandMsg msg;
+    while (tracking_commands.pop(msg))
+    {
+        if (tracking_has_pending)
         {
-            MB_error_asserted = true;
+            double command[TRACKING_AXES];
+            command_axes(tracking_pending.packet, command);
+            tracking.addSample(command, tracking_pending.sent, tracking_held_feedback);
         }
-        MB_state_info_raw  = mb_response.machine_state_info;
-        MB_state_reply =  ntohl(mb_response.machine_state_info) & MASK_STATE_ENCODED;
-        //std::cout << "Received reply from MB" << std::endl;
+        tracking_pending = msg;
+        tracking_has_pending = true;
+    }
+}
+
+/*
+ *  track_unanswered
+ * 
+ * Every command waiting for a reply goes into the history with the last 
+ * feedback there was, as if it had gone unanswered. Reactor thread only.
+ */
+void mbinterface::track_unanswered()
+{
+    pop_tracking_commands();
+    if (tracking_has_pending)
+    {
+        double command[TRACKING_AXES];
+        command_axes(tracking_pending.packet, command);
+        tracking.addSample(command, tracking_pending.sent, tracking_held_feedback);
+        tracking_has_pending = false;
+        tracking_status.store(tracking.getStatus());
+    }
+}
 
+/*
+ *  command_axes and feedback_axes
+ * 
+ * Both in trackingMonitor's order, i.e. as send_mb_command fills the packet
+ * from the position and angle vectors
+ */
+void mbinterface::command_axes(const DOFpacket& packet, double (&axes)[TRACKING_AXES])
+{
+    axes[0] = floatNetToHost(packet.surge_cmd);
+    axes[1] = floatNetToHost(packet.lateral_cmd);
+    axes[2] = floatNetToHost(packet.heave_cmd);
+    axes[3] = floatNetToHost(packet.roll_cmd);
+    axes[4] = floatNetToHost(packet.pitch_cmd);
+    axes[5] = floatNetToHost(packet.yaw_cmd);
+}
+
+void mbinterface::feedback_axes(const DOFresponse& response, double (&axes)[TRACKING_AXES])
+{
+    axes[0] = floatNetToHost(response.surge_feedback);
+    axes[1] = floatNetToHost(response.lateral_feedback);
+    axes[2] = floatNetToHost(response.heave_feedback);
+    axes[3] = floatNetToHost(response.roll_feedback);
+    axes[4] = floatNetToHost(response.pitch_feedback);
+    axes[5] = floatNetToHost(response.yaw_feedback);
+}
+
+/*
+ *  onTimer
+ * 
+ * Runs in the reactor thread when the reply timeout may have expired. It 
+ * is armed for MB_REPLY_TIMEOUT_NS after some earlier reply, so if a later
+ * one came in, it is simply moved to MB_REPLY_TIMEOUT_NS after that one. 
+ * That costs a wake-up every MB_REPLY_TIMEOUT_NS or so, instead of a timer
+ * syscall per reply.
+ * 
+ * An MB that has never replied has not timed out, it may simply not be 
+ * there yet (that is ESTABLISH_COMMS' business), so the timer is only armed
+ * by replies.
+ */
+void mbinterface::onTimer(int64_t now)
+{
+    int64_t deadline = MB_last_reply + MB_REPLY_TIMEOUT_NS;
+    if (now >= deadline)
+    {
+        MB_reply_timed_out = true;
+        MB_reply_timeouts++;
+        //Whatever is still queued won't be answered, and mustn't be paired
+        //with the next reply when the MB comes back
+        track_unanswered();
+    }
+    else
+    {
+        io_reactor.armTimer(deadline);
     }
 }
 
@@ -389,7 +1337,7 @@ void mbinterface::mb_send_func_ESTABLISH_COMMS()
 
     if (MB_state_info_raw != 0xFFFFFFFF)
     {
-        current_status = WAIT_FOR_ENGAGE;
+        change_status(WAIT_FOR_ENGAGE);
     }
 }
 
@@ -404,7 +1352,7 @@ void mbinterface::mb_send_func_WAIT_FOR_ENGAGE()
 
     if (userEngage)
     {
-        current_status = ENGAGING;
+        change_status(ENGAGING);
         state_start = send_ticks;
     }
 }
@@ -421,7 +1369,7 @@ void mbinterface::mb_send_func_ENGAGING()
 
     if (MB_state_reply == MB_STATE_ENGAGED)
     {
-        current_status = WAIT_FOR_READY;
+        change_status(WAIT_FOR_READY);
         return;
     }
 
@@ -432,8 +1380,8 @@ void mbinterface::mb_send_func_ENGAGING()
     if (elapsed > engage_timeout_period)
     {
         //We have timed out
-        current_status  = MB_FAULT;
         current_error   = MB_ENGAGE_FAILED; 
+        change_status(MB_FAULT);
     }
 }
 
@@ -449,10 +1397,14 @@ void mbinterface::mb_send_func_WAIT_FOR_READY()
 
     if (userReady)
     {
-        current_status = RATE_LIMITED;
+        change_status(RATE_LIMITED);
         //Set the timer for the next state
         //state_start = std::chrono::high_resolution_clock::now();
         state_start = send_ticks;
+        rate_limit_converged_tocks = 0;
+        //Start the MDA from the steady state for the current input, so that
+        //there is no filter transient left to rate limit
+        mda_init_steady_state();
         //Reset the rate limiters
         pos_rate_limiter.overrideOutput(init_pos_out);
         rot_rate_limiter.overrideOutput(init_rot_out);
@@ -462,11 +1414,18 @@ void mbinterface::mb_send_func_WAIT_FOR_READY()
 /*
  *  RATE_LIMITED state function
  * 
- * We have to rate limit the output for a few seconds to allow for non-neutral
- * starting positions, which basically happen *all* the time.
+ * We have to rate limit the output to allow for non-neutral starting 
+ * positions, which basically happen *all* the time.
+ * 
+ * Once the rate-limited output has caught up with the MDA output for a few
+ * tocks, there is nothing left to limit and we move on. The timeout is kept
+ * as an upper bound.
  */
 void mbinterface::mb_send_func_RATE_LIMITED()
 {
+    MCISvector pos_target = curr_pos_out;
+    MCISvector rot_target = curr_rot_out;
+
     //First apply the rate limits
     pos_rate_limiter.nextSample(curr_pos_out);
     rot_rate_limiter.nextSample(curr_rot_out);
@@ -475,13 +1434,24 @@ void mbinterface::mb_send_func_RATE_LIMITED()
     send_mb_command(MCW_NEW_POSITION, curr_pos_out, curr_rot_out);
 
     //Verify if we're ready to move on
+    if (outputs_converged(pos_target, curr_pos_out, pos_converged_tol) &&
+        outputs_converged(rot_target, curr_rot_out, rot_converged_tol))
+    {
+        rate_limit_converged_tocks++;
+    }
+    else
+    {
+        rate_limit_converged_tocks = 0;
+    }
+
     //state_current = std::chrono::high_resolution_clock::now();
     //auto period = state_current - state_start;
     auto elapsed = send_ticks - state_start;
-    if (elapsed > rate_limit_timeout_period)
+    if (elapsed > rate_limit_timeout_period || 
+        rate_limit_converged_tocks >= rate_limit_settle_tocks)
     {
         //We're ready
-        current_status = ENGAGED;
+        change_status(ENGAGED);
     }
 }
 
@@ -506,7 +1476,7 @@ void mbinterface::mb_send_func_PARKING()
 
     if (MB_state_reply == MB_STATE_IDLE)
     {
-        current_status = WAIT_FOR_ENGAGE;
+        change_status(WAIT_FOR_ENGAGE);
     }
 }
 
@@ -540,7 +1510,7 @@ void mbinterface::mb_send_func_MB_RECOVERABLE_FAULT()
     // We only cancel the error condition if the MB has done so already
     if (MB_state_reply == MB_STATE_IDLE)
     {
-        current_status = WAIT_FOR_ENGAGE;
+        change_status(WAIT_FOR_ENGAGE);
     }
 
     // The RESET command is sent out of sync, in addition to the regular 60Hz
@@ -571,6 +1541,192 @@ void mbinterface::reset_user_commands()
     userReady   = false;
     userPark    = false;
     userReset   = false;
+    userOverride = false;
+}
+
+/*
+ *  take_user_commands
+ * 
+ * Called at the start of every tock. Everything the UI queued since the 
+ * last tock is turned into the user* flags that the state functions look at,
+ * and those flags are cleared again at the end of the tock. So a command 
+ * always acts on the first tock after it was issued, or not at all if the 
+ * state at that tock has no use for it.
+ * 
+ * The time from issue to this tock is recorded as the command latency.
+ */
+void mbinterface::take_user_commands()
+{
+    userCommandMsg msg;
+    int64_t now = monotonicNs();
+    while (user_commands.pop(msg))
+    {
+        switch (msg.command)
+        {
+            case CMD_ENGAGE:
+                userEngage = true;
+                break;
+            case CMD_READY:
+                userReady = true;
+                break;
+            case CMD_PARK:
+                userPark = true;
+                break;
+            case CMD_OVERRIDE:
+                userOverride = true;
+                break;
+            case CMD_RESET:
+                userReset = true;
+                break;
+        }
+        timing_hists[HIST_COMMAND].record(now - msg.issued);
+        journal.log(JOURNAL_USER_COMMAND, msg.command, 0, msg.issued);
+    }
+}
+
+/*
+ *  mda_next_sample
+ *
+ * Run one iteration of the selected cueing engine on the current inputs and 
+ * store the result in curr_pos_out and curr_rot_out.
+ *
+ * X-Plane sends floats and the MB takes floats, so in single precision mode
+ * the inputs are simply narrowed back down and the outputs widened for the
+ * limiter and the log. Neither conversion loses anything.
+ *
+ * Only ever called from the send thread.
+ */
+void mbinterface::mda_next_sample()
+{
+    audit_regions[AUDIT_MDA_STEP].begin();
+
+    if (CUEING_MPC == engine)
+    {
+        mpc.nextSample(curr_acceleration_in, curr_ang_velocity_in, curr_attitude_in);
+        curr_pos_out = mpc.getPos();
+        curr_rot_out = mpc.getangle();
+        curr_rot_no_tc = mpc.getAngleNoTC();
+    }
+    else if (CUEING_ADAPTIVE == engine)
+    {
+        adaptive.nextSample(curr_acceleration_in, curr_ang_velocity_in, curr_attitude_in);
+        curr_pos_out = adaptive.getPos();
+        curr_rot_out = adaptive.getangle();
+        curr_rot_no_tc = adaptive.getAngleNoTC();
+    }
+    else if (single_precision)
+    {
+        mdaf.nextSample(MCISvectorf{curr_acceleration_in}, MCISvectorf{curr_ang_velocity_in},
+                        MCISvectorf{curr_attitude_in});
+        curr_pos_out = MCISvector{mdaf.getPos()};
+        curr_rot_out = MCISvector{mdaf.getangle()};
+        curr_rot_no_tc = MCISvector{mdaf.getAngleNoTC()};
+    }
+    else
+    {
+        mda.nextSample(curr_acceleration_in, curr_ang_velocity_in, curr_attitude_in);
+        curr_pos_out = mda.getPos();
+        curr_rot_out = mda.getangle();
+        curr_rot_no_tc = mda.getAngleNoTC();
+    }
+    curr_output_sequence   = curr_input_sequence;
+    curr_output_input_time = curr_input_recv_time;
+
+    audit_regions[AUDIT_MDA_STEP].end(ENGAGED == current_status);
+}
+
+/*
+ *  mda_init_steady_state
+ *
+ * Initialize the selected cueing engine to the steady state for the current inputs
+ */
+void mbinterface::mda_init_steady_state()
+{
+    if (CUEING_MPC == engine)
+    {
+        mpc.initSteadyState(curr_acceleration_in, curr_ang_velocity_in, curr_attitude_in);
+    }
+    else if (CUEING_ADAPTIVE == engine)
+    {
+        adaptive.initSteadyState(curr_acceleration_in, curr_ang_velocity_in, curr_attitude_in);
+    }
+    else if (single_precision)
+    {
+        mdaf.initSteadyState(MCISvectorf{curr_acceleration_in}, MCISvectorf{curr_ang_velocity_in},
+                             MCISvectorf{curr_attitude_in});
+    }
+    else
+    {
+        mda.initSteadyState(curr_acceleration_in, curr_ang_velocity_in, curr_attitude_in);
+    }
+}
+
+/*
+ *  update_jit_margin
+ * 
+ * Called every JIT_RELEARN_TICKS ticks in TICK_JIT mode. Takes the p99 of 
+ * the wake-up to output times since the last call, adds the guard and clamps 
+ * it. A longer margin is adopted right away, since being late means a stale 
+ * or missed tick, while a shorter one is approached gradually so that one 
+ * quiet second doesn't undo it.
+ */
+void mbinterface::update_jit_margin()
+{
+    histogramSummary window = jit_window.getSummary();
+    jit_window.reset();
+    if (0 == window.count)
+    {
+        return;
+    }
+
+    int64_t wanted = window.p99 + JIT_GUARD_NS;
+    int64_t floor  = jit_margin - jit_margin * JIT_SHRINK_PERCENT / 100;
+    jit_margin = std::max(wanted, floor);
+    jit_margin = std::min(std::max(jit_margin, (int64_t)JIT_MIN_MARGIN_NS), 
+                          (int64_t)JIT_MAX_MARGIN_NS);
+}
+
+/*
+ *  publish_status
+ * 
+ * Hand the UI a consistent copy of this tick's inputs, outputs and engine
+ * parameters. The seqlock makes this a handful of stores, it never waits on
+ * a reader.
+ */
+void mbinterface::publish_status()
+{
+    mbStatusSnapshot snapshot;
+    snapshot.sf_in   = curr_acceleration_in;
+    snapshot.angv_in = curr_ang_velocity_in;
+    snapshot.ang_in  = curr_attitude_in;
+    snapshot.pos_out = curr_pos_out;
+    snapshot.rot_out = curr_rot_out;
+    snapshot.input_sequence = curr_input_sequence;
+    snapshot.input_age = monotonicNs() - curr_input_recv_time;
+    if (CUEING_MPC == engine)
+    {
+        snapshot.mpc_worst_solve_time = mpc.getWorstSolveTime();
+    }
+    else if (CUEING_ADAPTIVE == engine)
+    {
+        snapshot.adaptive_scaling     = adaptive.getScaling();
+        snapshot.adaptive_tilt_gains  = adaptive.getTiltGains();
+        snapshot.adaptive_break_freqs = adaptive.getBreakFrequencies();
+    }
+    snapshot.rt = send_ticker.getStatus();
+    snapshot.ticks = active_ticks;
+    snapshot.jit_margin = (TICK_JIT == active_ticks) ? jit_margin : 0;
+    snapshot.samples_duplicated = samples_duplicated;
+    snapshot.samples_skipped    = samples_skipped;
+    snapshot.log_lines_shed     = log_lines_shed;
+    snapshot.mda_steps_shed     = mda_steps_shed;
+    snapshot.pll_locked         = tick_pll.isLocked();
+    snapshot.pll_message_period = tick_pll.getMessagePeriod();
+    snapshot.pll_phase_error    = tick_pll.getPhaseError();
+    snapshot.engaged_once         = engaged_once;
+    snapshot.faults_before_engage = faults_at_engage;
+    snapshot.faults_since_engage  = faults_since_engage;
+    status_snapshot.store(snapshot);
 }
 
 /*
@@ -651,4 +1807,22 @@ void mbinterface::output_limiter(MCISvector& pos, MCISvector& rot)
     {
         rot.setVal(2, MB_LIM_HIGH_yaw);
     }
-}
\ No newline at end of file
+}
+
+/*
+ *  outputs_converged
+ * 
+ * Returns true if every element of output is within tolerance of target
+ */
+bool mbinterface::outputs_converged(const MCISvector& target, const MCISvector& output, 
+                                    double tolerance)
+{
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        if (fabs(target.getVal(i) - output.getVal(i)) > tolerance)
+        {
+            return false;
+        }
+    }
+    return true;
+}
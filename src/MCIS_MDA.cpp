@@ -27,11 +27,86 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <iostream>
 #include <vector>
+#include <cmath>
 #include <stdexcept>
 #include "include/MCIS_MDA.h"
 
 
 
+/*
+ *  Saturation and rate limit on shared limits
+ * 
+ * Same operations as saturation::nextSample and rateLimit::nextSample. The 
+ * rate limit keeps its last output in the caller's state.
+ */
+template <typename T>
+static inline T mdaSaturation(T input, T limit)
+{
+    if (input > limit)
+    {
+        return limit;
+    }
+    else if (input < -limit)
+    {
+        return -limit;
+    }
+    return input;
+}
+
+template <typename T>
+static inline T mdaRateLimit(T input, T& output, T limit)
+{
+    T inputRate = input - output;
+    T absRate = std::fabs(inputRate);
+
+    if (absRate > limit)
+    {
+        if (inputRate < 0)
+        {
+            output -= limit;
+        }
+        else
+        {
+            output += limit;
+        }
+    }
+    else
+    {
+        output = input;
+    }
+    return output;
+}
+
+/*
+ *  mdaPrepareInputs
+ * 
+ * Copy the inputs, subtract gravity (if required) and apply the input scaling.
+ */
+template <typename T>
+static void mdaPrepareInputs(const basicMDAparams<T>& params, 
+                             const basicMCISvector<T>& accelerations, const basicMCISvector<T>& angularVelocities,
+                             const basicMCISvector<T>& attitude, 
+                             basicMCISvector<T>& accInput, basicMCISvector<T>& angvInput)
+{
+    accInput  = accelerations;
+    angvInput = angularVelocities;
+    // Subtract gravity, if required
+    if (params.subgrav)
+    {
+        basicMCISvector<T> gravVector{0, 0, gravity};
+        basicMCISmatrix<T> DCM;
+        DCM.euler2DCM_ZYX(attitude);
+        gravVector = DCM * gravVector;
+        accInput -= gravVector;
+    } 
+    
+    // Scale inputs
+    accInput.applyScalarGains(params.kSF[0], params.kSF[1], params.kSF[2]);
+    angvInput.applyScalarGains(params.kAngv[0], params.kAngv[1], params.kAngv[2]);
+}
+
+
+
 
 
 
@@ -43,81 +118,42 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *  MCIS_MDA constructor
  * 
  * This one is very simple. It just forwards the configuration reference
- * to the member class constructors and sets the gains for the input scaling
- * again using the config reference.
- */
-MCIS_MDA::MCIS_MDA(const MCISconfig& config, bool subtract_gravity)
-    :   subgrav{subtract_gravity},
-        angleBlock{config},
-        tiltBlock{config},
-        posBlock{config, subtract_gravity},
-        posOut{0,0,0},
-        angleOut{0,0,0},
-        angleNoTCout{0,0,0},
-        accInput{0,0,0},
-        angvInput{0,0,0},
-        kX{config.K_SF_x},
-        kY{config.K_SF_y},
-        kZ{config.K_SF_z},
-        kp{config.K_p}, 
-        kq{config.K_q},
-        kr{config.K_r}
+ * to the parameters, which hold the input scaling and every block's 
+ * coefficients. The state starts at rest.
+ */
+template <typename T>
+basicMCIS_MDA<T>::basicMCIS_MDA(const MCISconfig& config, bool subtract_gravity)
+    :   params{config, subtract_gravity},
+        state{}
 {}
 
 /*
  *  MCIS_MDA::nextSample
  * 
- * Run one iteration of the MCIS MDA
- * 
- * Theory of operation / signal path:
- * 
- * 1) - NOT IMPLEMENTED YET - Linear acceleration is offset from CG
- * 2) Subtract gravity
- * 3) Inputs are scaled
- * 4) Scaled angular velocities from 2) are used as input for the 
- *      Motion Base Orientation block, angleBlock, by calling
- *      angleBlock.nextSample().
- *      Feedback of the last iteration's angle output is used.
- *      The output is stored in angleNoTCout
- * 5) The previous iteration's angle output is fed into the Tilt Coordination Block,
- *      tiltBlock, to be used along with the scaled linear accelerations from 
- *      2) in tiltBlock.nextSample().
- *      The output is stored in angleOut.
- * 6) The output of tiltBlock from 4) is used along with the scaled linear 
- *      accelerations from 2) as the input for the Motion Base Position block,
- *      posBlock, specifically posBlock.nextSample()
- *      The output is stored in posOut.
+ * Run one iteration of the MCIS MDA, see MDAnextSample.
  * 
  * All outputs can be later retrieved using the getter functions.
  */
-void MCIS_MDA::nextSample(const MCISvector& accelerations, const MCISvector& angularVelocities,
-                          const MCISvector& attitude)
+template <typename T>
+void basicMCIS_MDA<T>::nextSample(const basicMCISvector<T>& accelerations, const basicMCISvector<T>& angularVelocities,
+                                  const basicMCISvector<T>& attitude)
 {
-    accInput  = accelerations;
-    angvInput = angularVelocities;
-    attInput  = attitude;
-    // 1) Subtract gravity, if required
-    if (subgrav)
-    {
-        MCISvector gravVector{0, 0, gravity};
-        MCISmatrix DCM;
-        DCM.euler2DCM_ZYX(attInput);
-        gravVector = DCM * gravVector;
-        accInput -= gravVector;
-    } 
-    
-    // 3) Scale inputs
-    accInput.applyScalarGains(kX, kY, kZ);
-    angvInput.applyScalarGains(kp, kq, kr);
-
-    // 4) Calculate the Motion Base position from the angular velocity input
-    angleNoTCout = angleBlock.nextSample(angvInput, angleOut);
-
-    // 5) Calculate Tilt Coordination using known MB orientation and acceleration input
-    angleOut = tiltBlock.nextSample(accInput, angleOut, angleNoTCout);
+    MDAnextSample(params, state, accelerations, angularVelocities, attitude);
+}
 
-    // 6) Calculate the Motion Base position from the acceleration input
-    posOut = posBlock.nextSample(accInput, angleOut);
+/*
+ *  MCIS_MDA::initSteadyState
+ * 
+ * Initialize the MDA as if the given input had been applied forever, see
+ * MDAinitSteadyState.
+ * 
+ * The outputs are updated and can be retrieved using the getter functions.
+ */
+template <typename T>
+void basicMCIS_MDA<T>::initSteadyState(const basicMCISvector<T>& accelerations, const basicMCISvector<T>& angularVelocities,
+                                       const basicMCISvector<T>& attitude)
+{
+    MDAinitSteadyState(params, state, accelerations, angularVelocities, attitude);
 }
 
 
@@ -134,37 +170,36 @@ void MCIS_MDA::nextSample(const MCISvector& accelerations, const MCISvector& ang
  * 1) - NOT IMPLEMENTED YET - Linear acceleration is offset from CG
  * 2) Inputs are scaled
  * 3) Scaled angular velocities from 2) are used as input for the 
- *      Motion Base Orientation block, angleBlock, by calling
- *      angleBlock.nextSample().
+ *      Motion Base Orientation block, rotated using its own last output.
  *      The output is stored in angleNoTCout
- * 4) The output of angleBlock from 3) is fed into the Tilt Coordination Block,
- *      tiltBlock, to be used along with the scaled linear accelerations from 
- *      2) in tiltBlock.nextSample().
+ * 4) The previous iteration's angle output is fed into the Tilt Coordination
+ *      block, to be used along with the scaled linear accelerations from 2).
  *      The output is stored in angleOut.
- * 5) The output of tiltBlock from 4) is used along with the scaled linear 
- *      accelerations from 2) as the input for the Motion Base Position block,
- *      posBlock, specifically posBlock.nextSample()
+ * 5) The output of the Tilt Coordination block from 4) is used along with 
+ *      the scaled linear accelerations from 2) as the input for the Motion
+ *      Base Position block.
  *      The output is stored in posOut.
  * 
  * All outputs can be later retrieved using the getter functions.
  */
-void MCIS_MDA::nextSample_MCISv2(const MCISvector& accelerations, const MCISvector& angularVelocities)
+template <typename T>
+void basicMCIS_MDA<T>::nextSample_MCISv2(const basicMCISvector<T>& accelerations, const basicMCISvector<T>& angularVelocities)
 {
-    accInput = accelerations;
-    angvInput = angularVelocities;
+    basicMCISvector<T> accInput = accelerations;
+    basicMCISvector<T> angvInput = angularVelocities;
     
     // 2) Scale inputs
-    accInput.applyScalarGains(kX, kY, kZ);
-    angvInput.applyScalarGains(kp, kq, kr);
+    accInput.applyScalarGains(params.kSF[0], params.kSF[1], params.kSF[2]);
+    angvInput.applyScalarGains(params.kAngv[0], params.kAngv[1], params.kAngv[2]);
 
     // 3) Calculate the Motion Base position from the angular velocity input
-    angleNoTCout = angleBlock.nextSample_MCISv2(angvInput);
+    state.angleNoTCout = params.ang.nextSample_MCISv2(state.ang, angvInput, state.angleNoTCout);
 
     // 4) Calculate Tilt Coordination using known MB orientation and acceleration input
-    angleOut = tiltBlock.nextSample_MCISv2(accInput, angleOut);
+    state.angleOut = params.tilt.nextSample_MCISv2(state.tilt, accInput, state.angleOut);
 
     // 5) Calculate the Motion Base position from the acceleration input
-    posOut = posBlock.nextSample(accInput, angleOut);
+    state.posOut = params.pos.nextSample(state.pos, accInput, state.angleOut);
 }
 
 
@@ -175,17 +210,147 @@ void MCIS_MDA::nextSample_MCISv2(const MCISvector& accelerations, const MCISvect
  * These functions are used to get the results from the MCIS MDA algorithm
  * after each iteration
  */
-MCISvector& MCIS_MDA::getPos()
+template <typename T>
+basicMCISvector<T>& basicMCIS_MDA<T>::getPos()
 {
-    return posOut;
+    return state.posOut;
 }
-MCISvector& MCIS_MDA::getangle()
+template <typename T>
+basicMCISvector<T>& basicMCIS_MDA<T>::getangle()
 {
-    return angleOut;
+    return state.angleOut;
 }
-MCISvector& MCIS_MDA::getAngleNoTC()
+template <typename T>
+basicMCISvector<T>& basicMCIS_MDA<T>::getAngleNoTC()
 {
-    return angleNoTCout;
+    return state.angleNoTCout;
+}
+
+
+
+
+
+
+
+
+
+
+/*
+ *  MDAparams constructor
+ * 
+ * Takes the input scaling from the MCISconfig and forwards it to the
+ * parameters of every block.
+ */
+template <typename T>
+basicMDAparams<T>::basicMDAparams(const MCISconfig& config, bool subtract_gravity)
+    :   kSF{(T)config.K_SF_x, (T)config.K_SF_y, (T)config.K_SF_z},
+        kAngv{(T)config.K_p, (T)config.K_q, (T)config.K_r},
+        subgrav{subtract_gravity},
+        ang{config},
+        tilt{config},
+        pos{config, subtract_gravity}
+{}
+
+/*
+ *  MDAstate constructor
+ */
+template <typename T>
+basicMDAstate<T>::basicMDAstate()
+{
+    reset();
+}
+
+/*
+ *  MDAstate::reset
+ * 
+ * Zero every delay, rate limit and output
+ */
+template <typename T>
+void basicMDAstate<T>::reset()
+{
+    ang.reset();
+    tilt.reset();
+    pos.reset();
+    posOut.assign(0, 0, 0);
+    angleOut.assign(0, 0, 0);
+    angleNoTCout.assign(0, 0, 0);
+}
+
+/*
+ *  MDAnextSample
+ * 
+ * Run one iteration of the MCIS MDA
+ * 
+ * Theory of operation / signal path:
+ * 
+ * 1) - NOT IMPLEMENTED YET - Linear acceleration is offset from CG
+ * 2) Subtract gravity
+ * 3) Inputs are scaled
+ * 4) Scaled angular velocities from 2) are used as input for the 
+ *      Motion Base Orientation block, params.ang.nextSample().
+ *      Feedback of the last iteration's angle output is used.
+ *      The output is stored in angleNoTCout
+ * 5) The previous iteration's angle output is fed into the Tilt Coordination
+ *      block, params.tilt.nextSample(), along with the scaled linear 
+ *      accelerations from 2).
+ *      The output is stored in angleOut.
+ * 6) The output of the Tilt Coordination block from 4) is used along with 
+ *      the scaled linear accelerations from 2) as the input for the Motion 
+ *      Base Position block, params.pos.nextSample().
+ *      The output is stored in posOut.
+ */
+template <typename T>
+void MDAnextSample(const basicMDAparams<T>& params, basicMDAstate<T>& state,
+                   const basicMCISvector<T>& accelerations, const basicMCISvector<T>& angularVelocities, 
+                   const basicMCISvector<T>& attitude)
+{
+    basicMCISvector<T> accInput, angvInput;
+
+    // 1) to 3) Subtract gravity, if required, and scale inputs
+    mdaPrepareInputs(params, accelerations, angularVelocities, attitude, accInput, angvInput);
+
+    // 4) Calculate the Motion Base position from the angular velocity input
+    state.angleNoTCout = params.ang.nextSample(state.ang, angvInput, state.angleOut);
+
+    // 5) Calculate Tilt Coordination using known MB orientation and acceleration input
+    state.angleOut = params.tilt.nextSample(state.tilt, accInput, state.angleOut, state.angleNoTCout);
+
+    // 6) Calculate the Motion Base position from the acceleration input
+    state.posOut = params.pos.nextSample(state.pos, accInput, state.angleOut);
+}
+
+/*
+ *  MDAinitSteadyState
+ * 
+ * Initialize the MDA as if the given input had been applied forever.
+ * 
+ * Starting from the zero state while the aircraft is already flying means 
+ * every high-pass filter sees a step, and the resulting transient has to be
+ * rate limited away before motion can start. Instead, every filter and rate 
+ * limit is set to its equilibrium for the current input.
+ * 
+ * The blocks are coupled through the output attitude (tilt coordination 
+ * rotates the inputs of the other blocks), so the attitude is found by
+ * fixed-point iteration first. The tilt angles are small, so this converges
+ * within a handful of iterations.
+ */
+template <typename T>
+void MDAinitSteadyState(const basicMDAparams<T>& params, basicMDAstate<T>& state,
+                        const basicMCISvector<T>& accelerations, const basicMCISvector<T>& angularVelocities, 
+                        const basicMCISvector<T>& attitude)
+{
+    const int iterations = 10;
+    basicMCISvector<T> accInput, angvInput;
+
+    mdaPrepareInputs(params, accelerations, angularVelocities, attitude, accInput, angvInput);
+
+    for (int i = 0; i < iterations; i++)
+    {
+        state.angleNoTCout = params.ang.initSteadyState(state.ang, angvInput, state.angleOut);
+        state.angleOut = params.tilt.initSteadyState(state.tilt, accInput, state.angleOut, state.angleNoTCout);
+    }
+
+    state.posOut = params.pos.initSteadyState(state.pos, accInput, state.angleOut);
 }
 
 
@@ -213,10 +378,11 @@ MCISvector& MCIS_MDA::getAngleNoTC()
  * from body to pseudo-inertial axes with the inverse DCM and the overwritten
  * vector will now be expressed in Earth-fixed axes.
  */
-void body2inert(MCISvector& vec, const MCISvector& eulerAngles)
+template <typename T>
+void body2inert(basicMCISvector<T>& vec, const basicMCISvector<T>& eulerAngles)
 {
     //Generate an empty matrix which we will soon fill with the DCM contents
-    MCISmatrix DCM{};
+    basicMCISmatrix<T> DCM{};
     DCM.euler2DCM_ZYX_inv(eulerAngles);
 
     //Our DCM is ready, we can multiply the vector
@@ -232,10 +398,11 @@ void body2inert(MCISvector& vec, const MCISvector& eulerAngles)
  * Basically, we just apply the transformation matrix, calculated using the
  * Motion Base's Euler angles.
  */
-void pqr2eulerRates(MCISvector& vec, const MCISvector& eulerAngles)
+template <typename T>
+void pqr2eulerRates(basicMCISvector<T>& vec, const basicMCISvector<T>& eulerAngles)
 {
     //Generate an empty matrix that we will fill with the transformation
-    MCISmatrix transform{};
+    basicMCISmatrix<T> transform{};
     transform.pqr2eulerRates(eulerAngles);
 
     //Now we just multiply the vector
@@ -251,137 +418,187 @@ void pqr2eulerRates(MCISvector& vec, const MCISvector& eulerAngles)
 
 
 /*
- *  angHPchannel constructor
+ *  angHPparams constructor
  * 
- * Takes an MCISconfig reference and constructs its members
- * using members of the MCISconfig instance
- */
-angHPchannel::angHPchannel(const MCISconfig& config) 
-    :   rollFilt{config.filt_p_HP_disc.biquads[0]},
-        pitchFilt{config.filt_q_HP_disc.biquads[0]},
-        yawFilt{config.filt_r_HP_disc.biquads[0]},
-        rollSat{config.lim_p, 0},
-        pitchSat{config.lim_q, 0},
-        yawSat{config.lim_r, 0},
-        rollFiltK{config.filt_p_HP_disc.biquads[0].gain},
-        pitchFiltK{config.filt_q_HP_disc.biquads[0].gain},
-        yawFiltK{config.filt_r_HP_disc.biquads[0].gain},
-        lastOutput{0,0,0}
-{}
+ * Takes an MCISconfig reference and derives the coefficients, gains and
+ * limits from it
+ */
+template <typename T>
+basicAngHPparams<T>::basicAngHPparams(const MCISconfig& config)
+    :   filtK{(T)config.filt_p_HP_disc.biquads[0].gain, 
+              (T)config.filt_q_HP_disc.biquads[0].gain,
+              (T)config.filt_r_HP_disc.biquads[0].gain},
+        lim{(T)config.lim_p, (T)config.lim_q, (T)config.lim_r}
+{
+    filt[0].setParams(config.filt_p_HP_disc.biquads[0]);
+    filt[1].setParams(config.filt_q_HP_disc.biquads[0]);
+    filt[2].setParams(config.filt_r_HP_disc.biquads[0]);
+}
 
 /*
- *  angHPchannel::nextSample
+ *  angHPparams::nextSample
  * 
  * Run one iteration of the filter bank
  * 
  * Theory of operation/signal path:
  * 1) Input signal frame of reference is rotated to inertial frame using
  *      external feedback
- * 2) The vector is split  up into its three components
- * 3) Inputs are clamped down to their limits (saturation)
- * 4) Each element is used as the input for the 
+ * 2) Each component is clamped down to its limit (saturation)
+ * 3) Each component is used as the input for the 
  *      the respective filter (which includes the integrator)
- * 5) Filter output gets reassembled into an MCISvector and is returned
- *      and stored for the next iteration.
+ * 4) Filter output gets reassembled into an MCISvector and is returned.
  */
-MCISvector angHPchannel::nextSample(const MCISvector& input, const MCISvector& eulerAngles)
+template <typename T>
+basicMCISvector<T> basicAngHPparams<T>::nextSample(basicAngHPstate<T>& state, const basicMCISvector<T>& input, 
+                                                   const basicMCISvector<T>& eulerAngles) const
 {
     //Copy the input vector so that we can operate on it safely
-    MCISvector omega = input;
+    basicMCISvector<T> omega = input;
     
     // 1) Rotate input's frame of reference from body to inertial
     pqr2eulerRates(omega, eulerAngles);
 
-    // 2) Split up the vector
-    double pChannel = omega.getVal(0);
-    double qChannel = omega.getVal(1);
-    double rChannel = omega.getVal(2);
-
-    // 3) Run the inputs through the saturations
-    pChannel = rollSat.nextSample(pChannel);
-    qChannel = pitchSat.nextSample(qChannel);
-    rChannel = yawSat.nextSample(rChannel);
+    // 2) to 4) Saturate and filter each channel
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        T channel = mdaSaturation(omega[i], lim[i]);
+        omega[i] = filtK[i] * filt[i].nextSample(state.filt[i], channel);
+    }
+    return omega;
+}
 
-    // 4) Run the saturated inputs through the filters
-    pChannel = rollFiltK  * rollFilt.nextSample(pChannel);
-    qChannel = pitchFiltK * pitchFilt.nextSample(qChannel);
-    rChannel = yawFiltK   * yawFilt.nextSample(rChannel);
+/*
+ *  angHPparams::initSteadyState
+ * 
+ * Same signal path as nextSample, but every filter is set to its steady state
+ * for the resulting input instead of being run for one sample.
+ * 
+ * The filters include the integrator, so only a zero angular velocity has a 
+ * real equilibrium. Anything else leaves the filters at the zero state.
+ */
+template <typename T>
+basicMCISvector<T> basicAngHPparams<T>::initSteadyState(basicAngHPstate<T>& state, const basicMCISvector<T>& input, 
+                                                        const basicMCISvector<T>& eulerAngles) const
+{
+    basicMCISvector<T> omega = input;
+    pqr2eulerRates(omega, eulerAngles);
 
-    lastOutput.assign(pChannel, qChannel, rChannel);
-    return lastOutput;
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        T channel = mdaSaturation(omega[i], lim[i]);
+        omega[i] = filtK[i] * filt[i].initSteadyState(state.filt[i], channel);
+    }
+    return omega;
 }
 
 /*
  *  --------------------OBSOLETE-----------------------------
- *  angHPchannel::nextSample_MCISv2
+ *  angHPparams::nextSample_MCISv2
  * 
  * THIS FUNCTION IS OBSOLETE AS OF MCISv3.
  * 
- * Run one iteration of the filter bank
- * 
- * Theory of operation/signal path:
- * 1) Input signal frame of reference is rotated to inertial frame using
- *      the previous period's output
- * 2) The vector is split  up into its three components
- * 3) Inputs are clamped down to their limits (saturation)
- * 4) Each element is used as the input for the 
- *      the respective filter (which includes the integrator)
- * 5) Filter output gets reassembled into an MCISvector and is returned
- *      and stored for the next iteration.
+ * Same as nextSample, but the input is rotated from body to inertial frame
+ * using the channel's own previous output instead of external feedback.
  */
-MCISvector angHPchannel::nextSample_MCISv2(const MCISvector& input)
+template <typename T>
+basicMCISvector<T> basicAngHPparams<T>::nextSample_MCISv2(basicAngHPstate<T>& state, const basicMCISvector<T>& input, 
+                                                          const basicMCISvector<T>& lastOutput) const
 {
-    //Copy the input vector so that we can operate on it safely
-    MCISvector omega = input;
-    
-    // 1) Rotate input's frame of reference from body to inertial
+    basicMCISvector<T> omega = input;
     body2inert(omega, lastOutput);
 
-    // 2) Split up the vector
-    double pChannel = omega.getVal(0);
-    double qChannel = omega.getVal(1);
-    double rChannel = omega.getVal(2);
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        T channel = mdaSaturation(omega[i], lim[i]);
+        omega[i] = filtK[i] * filt[i].nextSample(state.filt[i], channel);
+    }
+    return omega;
+}
 
-    // 3) Run the inputs through the saturations
-    pChannel = rollSat.nextSample(pChannel);
-    qChannel = pitchSat.nextSample(qChannel);
-    rChannel = yawSat.nextSample(rChannel);
+/*
+ *  angHPstate constructor and reset
+ */
+template <typename T>
+basicAngHPstate<T>::basicAngHPstate()
+{
+    reset();
+}
 
-    // 4) Run the saturated inputs through the filters
-    pChannel = rollFiltK  * rollFilt.nextSample(pChannel);
-    qChannel = pitchFiltK * pitchFilt.nextSample(qChannel);
-    rChannel = yawFiltK   * yawFilt.nextSample(rChannel);
+template <typename T>
+void basicAngHPstate<T>::reset()
+{
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        filt[i][0] = 0;
+        filt[i][1] = 0;
+    }
+}
 
-    lastOutput.assign(pChannel, qChannel, rChannel);
+/*
+ *  angHPchannel constructor
+ * 
+ * Takes an MCISconfig reference and constructs its parameters from it. The
+ * state starts at rest.
+ */
+template <typename T>
+basicAngHPchannel<T>::basicAngHPchannel(const MCISconfig& config) 
+    :   params{config},
+        state{},
+        lastOutput{0,0,0}
+{}
+
+/*
+ *  angHPchannel::nextSample, initSteadyState and nextSample_MCISv2
+ * 
+ * Run the channel's parameters on its own state, see angHPparams. The output
+ * is stored for nextSample_MCISv2.
+ */
+template <typename T>
+basicMCISvector<T> basicAngHPchannel<T>::nextSample(const basicMCISvector<T>& input, const basicMCISvector<T>& eulerAngles)
+{
+    lastOutput = params.nextSample(state, input, eulerAngles);
+    return lastOutput;
+}
+
+template <typename T>
+basicMCISvector<T> basicAngHPchannel<T>::initSteadyState(const basicMCISvector<T>& input, const basicMCISvector<T>& eulerAngles)
+{
+    lastOutput = params.initSteadyState(state, input, eulerAngles);
+    return lastOutput;
+}
+
+template <typename T>
+basicMCISvector<T> basicAngHPchannel<T>::nextSample_MCISv2(const basicMCISvector<T>& input)
+{
+    lastOutput = params.nextSample_MCISv2(state, input, lastOutput);
     return lastOutput;
 }
 
 /*
- *  posHPchannel constructor
+ *  posHPparams constructor
  * 
- * Takes an MCISconfig reference and constructs its members
- * using members of the MCISconfig instance
+ * Takes an MCISconfig reference and derives the coefficients, gains and
+ * limits from it
  */
-posHPchannel::posHPchannel(const MCISconfig& config, bool subtract_gravity)
-    :   xFilt1{config.filt_SF_HP_x_disc.biquads[0]},
-        yFilt1{config.filt_SF_HP_y_disc.biquads[0]},
-        zFilt1{config.filt_SF_HP_z_disc.biquads[0]},
-        xFilt2{config.filt_SF_HP_x_disc.biquads[1]},
-        yFilt2{config.filt_SF_HP_y_disc.biquads[1]},
-        zFilt2{config.filt_SF_HP_z_disc.biquads[1]},
-        xFiltK{config.filt_SF_HP_x_disc.biquads[0].gain},
-        yFiltK{config.filt_SF_HP_y_disc.biquads[0].gain},
-        zFiltK{config.filt_SF_HP_z_disc.biquads[0].gain},
-        xSat{config.lim_SF_x, 0},
-        ySat{config.lim_SF_y, 0},
-        zSat{config.lim_SF_z, 0},
-        subgrav{subtract_gravity}
+template <typename T>
+basicPosHPparams<T>::basicPosHPparams(const MCISconfig& config, bool subtract_gravity)
+    :   filtK{(T)config.filt_SF_HP_x_disc.biquads[0].gain,
+              (T)config.filt_SF_HP_y_disc.biquads[0].gain,
+              (T)config.filt_SF_HP_z_disc.biquads[0].gain},
+        lim{(T)config.lim_SF_x, (T)config.lim_SF_y, (T)config.lim_SF_z},
+        subgrav{subtract_gravity},
+        zGravSub{(T)(gravity * config.K_SF_z)}
 {
-    zGravSub = gravity * config.K_SF_z;
+    filt1[0].setParams(config.filt_SF_HP_x_disc.biquads[0]);
+    filt1[1].setParams(config.filt_SF_HP_y_disc.biquads[0]);
+    filt1[2].setParams(config.filt_SF_HP_z_disc.biquads[0]);
+    filt2[0].setParams(config.filt_SF_HP_x_disc.biquads[1]);
+    filt2[1].setParams(config.filt_SF_HP_y_disc.biquads[1]);
+    filt2[2].setParams(config.filt_SF_HP_z_disc.biquads[1]);
 }
 
 /*
- *  posHPchannel::nextSample
+ *  posHPparams::nextSample
  * 
  * Run one iteration of the filter bank
  * 
@@ -390,78 +607,142 @@ posHPchannel::posHPchannel(const MCISconfig& config, bool subtract_gravity)
  *      the MBangles input vector, corresponding to the orientation
  *      calculated before this function is called 
  *      (inclusive of Tilt Coordination).
- * 2) The vector is split  up into its three components
- * 3*) Gravity is subtracted from the Z axis to bring it down to the 
+ * 2*) Gravity is subtracted from the Z axis to bring it down to the 
  *      [-limit ; limit] range.
  *      ONLY IF GRAVITY IS NOT BEING SUBTRACTED IN THE BODY FRAME
- * 4) Inputs are clamped down to their limits (saturation)
- * 5) Each element is used as the input for the 
+ * 3) Each component is clamped down to its limit (saturation)
+ * 4) Each component is used as the input for the 
  *      the respective filter (which includes the integrator)
- * 6) Filter output gets reassembled into an MCISvector
+ * 5) Filter output gets reassembled into an MCISvector
  */
-MCISvector posHPchannel::nextSample(const MCISvector& input, const MCISvector& MBangles)
+template <typename T>
+basicMCISvector<T> basicPosHPparams<T>::nextSample(basicPosHPstate<T>& state, const basicMCISvector<T>& input, 
+                                                   const basicMCISvector<T>& MBangles) const
 {
     //Copy the input vector so that we can operate on it safely
-    MCISvector sf = input;
+    basicMCISvector<T> sf = input;
 
     // 1) Rotate input's frame of reference from body to inertial
     body2inert(sf, MBangles);
 
-    // 2) Split up the vector
-    double xChannel = sf.getVal(0);
-    double yChannel = sf.getVal(1);
-    double zChannel = sf.getVal(2);
-
-    // 3) Subtract gravity in the Z-axis, if needed
+    // 2) Subtract gravity in the Z-axis, if needed
     if (!subgrav)
     {
-        zChannel -= zGravSub;
+        sf[2] -= zGravSub;
     }
 
-    // 4) Apply saturation
-    xChannel = xSat.nextSample(xChannel);
-    yChannel = ySat.nextSample(yChannel);
-    zChannel = zSat.nextSample(zChannel);
+    // 3) to 5) Saturate and filter each channel
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        T channel = mdaSaturation(sf[i], lim[i]);
+        channel  = filt1[i].nextSample(state.filt1[i], channel);
+        channel  = filt2[i].nextSample(state.filt2[i], channel);
+        channel *= filtK[i];
+        sf[i] = channel;
+    }
+    return sf;
+}
 
-    // 5) Run through the filters
-    xChannel =  xFilt1.nextSample(xChannel);
-    xChannel =  xFilt2.nextSample(xChannel);
-    xChannel *= xFiltK;
+/*
+ *  posHPparams::initSteadyState
+ * 
+ * Same signal path as nextSample, but the filters are set to their steady 
+ * state instead of being run for one sample. The second biquad section sees 
+ * the steady-state output of the first one.
+ */
+template <typename T>
+basicMCISvector<T> basicPosHPparams<T>::initSteadyState(basicPosHPstate<T>& state, const basicMCISvector<T>& input, 
+                                                        const basicMCISvector<T>& MBangles) const
+{
+    basicMCISvector<T> sf = input;
+    body2inert(sf, MBangles);
 
-    yChannel =  yFilt1.nextSample(yChannel);
-    yChannel =  yFilt2.nextSample(yChannel);
-    yChannel *= yFiltK;
+    if (!subgrav)
+    {
+        sf[2] -= zGravSub;
+    }
 
-    zChannel =  zFilt1.nextSample(zChannel);
-    zChannel =  zFilt2.nextSample(zChannel);
-    zChannel *= zFiltK;
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        T channel = mdaSaturation(sf[i], lim[i]);
+        channel  = filt2[i].initSteadyState(state.filt2[i], filt1[i].initSteadyState(state.filt1[i], channel));
+        channel *= filtK[i];
+        sf[i] = channel;
+    }
+    return sf;
+}
 
-    // 6) Reassemble vector and return it
-    MCISvector output{xChannel, yChannel, zChannel};
-    return output;
+/*
+ *  posHPstate constructor and reset
+ */
+template <typename T>
+basicPosHPstate<T>::basicPosHPstate()
+{
+    reset();
+}
+
+template <typename T>
+void basicPosHPstate<T>::reset()
+{
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        filt1[i][0] = 0;
+        filt1[i][1] = 0;
+        filt2[i][0] = 0;
+        filt2[i][1] = 0;
+    }
 }
 
 /*
- *  tiltCoordination constructor
+ *  posHPchannel constructor
  * 
- * Takes an MCISconfig reference and constructs its members
- * using members of the MCISconfig instance
- */
-tiltCoordination::tiltCoordination(const MCISconfig& config)
-    :   xFilt{config.filt_SF_LP_x_disc.biquads[0]},
-        yFilt{config.filt_SF_LP_y_disc.biquads[0]},
-        xFiltK{config.filt_SF_LP_x_disc.biquads[0].gain},
-        yFiltK{config.filt_SF_LP_y_disc.biquads[0].gain},
-        xSat{config.lim_TC_x, 0},
-        ySat{config.lim_TC_y, 0},
-        xRatelim{config.ratelim_TC_x / config.sampleRate, 0},
-        yRatelim{config.ratelim_TC_y / config.sampleRate, 0},
-        xGain{config.K_TC_x},
-        yGain{config.K_TC_y}
+ * Takes an MCISconfig reference and constructs its parameters from it. The
+ * state starts at rest.
+ */
+template <typename T>
+basicPosHPchannel<T>::basicPosHPchannel(const MCISconfig& config, bool subtract_gravity)
+    :   params{config, subtract_gravity},
+        state{}
 {}
 
 /*
- *  tiltCoordination::nextSample
+ *  posHPchannel::nextSample and initSteadyState
+ * 
+ * Run the channel's parameters on its own state, see posHPparams.
+ */
+template <typename T>
+basicMCISvector<T> basicPosHPchannel<T>::nextSample(const basicMCISvector<T>& input, const basicMCISvector<T>& MBangles)
+{
+    return params.nextSample(state, input, MBangles);
+}
+
+template <typename T>
+basicMCISvector<T> basicPosHPchannel<T>::initSteadyState(const basicMCISvector<T>& input, const basicMCISvector<T>& MBangles)
+{
+    return params.initSteadyState(state, input, MBangles);
+}
+
+/*
+ *  tiltParams constructor
+ * 
+ * Takes an MCISconfig reference and derives the coefficients, gains and
+ * limits from it
+ */
+template <typename T>
+basicTiltParams<T>::basicTiltParams(const MCISconfig& config)
+    :   filtK{(T)config.filt_SF_LP_x_disc.biquads[0].gain, 
+              (T)config.filt_SF_LP_y_disc.biquads[0].gain},
+        lim{(T)config.lim_TC_x, (T)config.lim_TC_y},
+        gain{(T)config.K_TC_x, (T)config.K_TC_y},
+        rateLim{(T)(config.ratelim_TC_x / config.sampleRate), 
+                (T)(config.ratelim_TC_y / config.sampleRate)}
+{
+    filt[0].setParams(config.filt_SF_LP_x_disc.biquads[0]);
+    filt[1].setParams(config.filt_SF_LP_y_disc.biquads[0]);
+}
+
+/*
+ *  tiltParams::nextSample
  * 
  * Run one iteration of the filter bank
  * 
@@ -480,103 +761,228 @@ tiltCoordination::tiltCoordination(const MCISconfig& config)
  *      z acceleration has no tilt coordination
  * 8) This vector is summed with the hpAngles input and returned.
  */
-MCISvector tiltCoordination::nextSample(const MCISvector& input, const MCISvector& MBangles, 
-                                        const MCISvector& hpAngles)
+template <typename T>
+basicMCISvector<T> basicTiltParams<T>::nextSample(basicTiltState<T>& state, const basicMCISvector<T>& input, 
+                                                  const basicMCISvector<T>& MBangles, const basicMCISvector<T>& hpAngles) const
 {
     //Copy the input vector so that we can operate on it safely
-    MCISvector sf = input;
+    basicMCISvector<T> sf = input;
     
     // 1) Rotate input's frame of reference from body to inertial
     body2inert(sf, MBangles);
 
-    // 2) Split up the vector
-    double xChannel = sf.getVal(0);
-    double yChannel = sf.getVal(1);
-
-    // 3) Apply saturation
-    xChannel = xSat.nextSample(xChannel);
-    yChannel = ySat.nextSample(yChannel);
+    // 2) and 3) Split up the vector and apply saturation
+    T xChannel = mdaSaturation(sf[0], lim[0]);
+    T yChannel = mdaSaturation(sf[1], lim[1]);
 
     // 4) Apply TC gain
-    xChannel *=  xGain;
-    yChannel *= -yGain; //Positive y acceleration means negative roll
+    xChannel *=  gain[0];
+    yChannel *= -gain[1]; //Positive y acceleration means negative roll
 
     // 5) Run through the filters
-    xChannel = xFiltK * xFilt.nextSample(xChannel);
-    yChannel = yFiltK * yFilt.nextSample(yChannel);
+    xChannel = filtK[0] * filt[0].nextSample(state.filt[0], xChannel);
+    yChannel = filtK[1] * filt[1].nextSample(state.filt[1], yChannel);
 
     // 6) Apply rate limiting
-    xChannel = xRatelim.nextSample(xChannel);
-    yChannel = yRatelim.nextSample(yChannel);
+    xChannel = mdaRateLimit(xChannel, state.rateLim[0], rateLim[0]);
+    yChannel = mdaRateLimit(yChannel, state.rateLim[1], rateLim[1]);
 
     // 7) Reassemble the vector
     //Note that it's [y, x, 0]
-    MCISvector output{yChannel, xChannel, 0};
+    basicMCISvector<T> output{yChannel, xChannel, 0};
 
     // 8) Sum the tilt coordination part to the existing orientation
     output += hpAngles;
     return output;
 }
 
+/*
+ *  tiltParams::initSteadyState
+ * 
+ * Same signal path as nextSample, but the filters are set to their steady 
+ * state and the rate limits are overriden to match, so that the tilt is
+ * available immediately instead of being slowly ramped in.
+ */
+template <typename T>
+basicMCISvector<T> basicTiltParams<T>::initSteadyState(basicTiltState<T>& state, const basicMCISvector<T>& input, 
+                                                       const basicMCISvector<T>& MBangles, const basicMCISvector<T>& hpAngles) const
+{
+    basicMCISvector<T> sf = input;
+    body2inert(sf, MBangles);
+
+    T xChannel = mdaSaturation(sf[0], lim[0]);
+    T yChannel = mdaSaturation(sf[1], lim[1]);
+
+    xChannel *=  gain[0];
+    yChannel *= -gain[1]; //Positive y acceleration means negative roll
 
+    xChannel = filtK[0] * filt[0].initSteadyState(state.filt[0], xChannel);
+    yChannel = filtK[1] * filt[1].initSteadyState(state.filt[1], yChannel);
 
+    state.rateLim[0] = xChannel;
+    state.rateLim[1] = yChannel;
 
+    basicMCISvector<T> output{yChannel, xChannel, 0};
+    output += hpAngles;
+    return output;
+}
 
 /*
  * ----------------------OBSOLETE---------------------------------------------------------- 
  * 
- * tiltCoordination::nextSample_MCISv2
- * 
- * Run one iteration of the filter bank
+ * tiltParams::nextSample_MCISv2
  * 
- * Theory of operation/signal path:
- * 1) Input signal frame of reference is rotated to inertial frame using
- *      the MBangles input vector, corresponding to the orientation
- *      calculated before this function is called.
- * 2) The vector is split  up into its three components and z gets dumped
- * 3) Inputs are clamped down to their limits (saturation)
- * 4) Each element is multiplied by the Tilt Coordination gain for its axis
- * 5) Each element is used as the input for the respective filter
- * 6) Each element is rate-limited   
- * 7) Filter output gets reassembled into an MCISvector - note that
- *      the output vector is constructed as [y, x, 0], because y acceleration
- *      affects the roll output, x acceleration affects the pitch output and
- *      z acceleration has no tilt coordination
- * 8) This vector is summed with the MBangles input and returned.
+ * Same as nextSample, except that the y gain is not negated and the result
+ * is summed with the MBangles input, i.e. the orientation calculated before
+ * this function is called.
  */
-MCISvector tiltCoordination::nextSample_MCISv2(const MCISvector& input, const MCISvector& MBangles)
+template <typename T>
+basicMCISvector<T> basicTiltParams<T>::nextSample_MCISv2(basicTiltState<T>& state, const basicMCISvector<T>& input, 
+                                                         const basicMCISvector<T>& MBangles) const
 {
-    //Copy the input vector so that we can operate on it safely
-    MCISvector sf = input;
-    
-    // 1) Rotate input's frame of reference from body to inertial
+    basicMCISvector<T> sf = input;
     body2inert(sf, MBangles);
 
-    // 2) Split up the vector
-    double xChannel = sf.getVal(0);
-    double yChannel = sf.getVal(1);
+    T xChannel = mdaSaturation(sf[0], lim[0]);
+    T yChannel = mdaSaturation(sf[1], lim[1]);
 
-    // 3) Apply saturation
-    xChannel = xSat.nextSample(xChannel);
-    yChannel = ySat.nextSample(yChannel);
+    xChannel *= gain[0];
+    yChannel *= gain[1];
 
-    // 4) Apply TC gain
-    xChannel *= xGain;
-    yChannel *= yGain;
+    xChannel = filtK[0] * filt[0].nextSample(state.filt[0], xChannel);
+    yChannel = filtK[1] * filt[1].nextSample(state.filt[1], yChannel);
 
-    // 5) Run through the filters
-    xChannel = xFiltK * xFilt.nextSample(xChannel);
-    yChannel = yFiltK * yFilt.nextSample(yChannel);
+    xChannel = mdaRateLimit(xChannel, state.rateLim[0], rateLim[0]);
+    yChannel = mdaRateLimit(yChannel, state.rateLim[1], rateLim[1]);
 
-    // 6) Apply rate limiting
-    xChannel = xRatelim.nextSample(xChannel);
-    yChannel = yRatelim.nextSample(yChannel);
-
-    // 7) Reassemble the vector
-    //Note that it's [y, x, 0]
-    MCISvector output{yChannel, xChannel, 0};
-
-    // 8) Sum the tilt coordination part to the existing orientation
+    basicMCISvector<T> output{yChannel, xChannel, 0};
     output += MBangles;
     return output;
-}
\ No newline at end of file
+}
+
+/*
+ *  tiltState constructor and reset
+ */
+template <typename T>
+basicTiltState<T>::basicTiltState()
+{
+    reset();
+}
+
+template <typename T>
+void basicTiltState<T>::reset()
+{
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        filt[i][0] = 0;
+        filt[i][1] = 0;
+        rateLim[i] = 0;
+    }
+}
+
+/*
+ *  tiltCoordination constructor
+ * 
+ * Takes an MCISconfig reference and constructs its parameters from it. The
+ * state starts at rest.
+ */
+template <typename T>
+basicTiltCoordination<T>::basicTiltCoordination(const MCISconfig& config)
+    :   params{config},
+        state{}
+{}
+
+/*
+ *  tiltCoordination::nextSample, initSteadyState and nextSample_MCISv2
+ * 
+ * Run the channel's parameters on its own state, see tiltParams.
+ */
+template <typename T>
+basicMCISvector<T> basicTiltCoordination<T>::nextSample(const basicMCISvector<T>& input, const basicMCISvector<T>& MBangles, 
+                                                        const basicMCISvector<T>& hpAngles)
+{
+    return params.nextSample(state, input, MBangles, hpAngles);
+}
+
+template <typename T>
+basicMCISvector<T> basicTiltCoordination<T>::initSteadyState(const basicMCISvector<T>& input, const basicMCISvector<T>& MBangles, 
+                                                             const basicMCISvector<T>& hpAngles)
+{
+    return params.initSteadyState(state, input, MBangles, hpAngles);
+}
+
+template <typename T>
+basicMCISvector<T> basicTiltCoordination<T>::nextSample_MCISv2(const basicMCISvector<T>& input, const basicMCISvector<T>& MBangles)
+{
+    return params.nextSample_MCISv2(state, input, MBangles);
+}
+
+/*
+ *  tiltCoordination::setGains
+ * 
+ * Replace the Tilt Coordination gains. The filter and rate limit states are
+ * kept, so the tilt follows the new gains smoothly (and no faster than the 
+ * rate limits allow).
+ */
+template <typename T>
+void basicTiltCoordination<T>::setGains(T xGainIn, T yGainIn)
+{
+    params.gain[0] = xGainIn;
+    params.gain[1] = yGainIn;
+}
+
+
+
+/*
+ *  Explicit instantiations
+ * 
+ * The MDA is built in double precision (MCIS_MDA) and single precision
+ * (MCIS_MDAf). See discreteMath.h for the reasoning.
+ */
+template class basicAngHPparams<double>;
+template class basicAngHPparams<float>;
+template class basicAngHPstate<double>;
+template class basicAngHPstate<float>;
+template class basicAngHPchannel<double>;
+template class basicAngHPchannel<float>;
+
+template class basicPosHPparams<double>;
+template class basicPosHPparams<float>;
+template class basicPosHPstate<double>;
+template class basicPosHPstate<float>;
+template class basicPosHPchannel<double>;
+template class basicPosHPchannel<float>;
+
+template class basicTiltParams<double>;
+template class basicTiltParams<float>;
+template class basicTiltState<double>;
+template class basicTiltState<float>;
+template class basicTiltCoordination<double>;
+template class basicTiltCoordination<float>;
+
+template class basicMDAparams<double>;
+template class basicMDAparams<float>;
+template class basicMDAstate<double>;
+template class basicMDAstate<float>;
+
+template class basicMCIS_MDA<double>;
+template class basicMCIS_MDA<float>;
+
+template void MDAnextSample<double>(const basicMDAparams<double>&, basicMDAstate<double>&,
+                                    const basicMCISvector<double>&, const basicMCISvector<double>&,
+                                    const basicMCISvector<double>&);
+template void MDAnextSample<float>(const basicMDAparams<float>&, basicMDAstate<float>&,
+                                   const basicMCISvector<float>&, const basicMCISvector<float>&,
+                                   const basicMCISvector<float>&);
+template void MDAinitSteadyState<double>(const basicMDAparams<double>&, basicMDAstate<double>&,
+                                         const basicMCISvector<double>&, const basicMCISvector<double>&,
+                                         const basicMCISvector<double>&);
+template void MDAinitSteadyState<float>(const basicMDAparams<float>&, basicMDAstate<float>&,
+                                        const basicMCISvector<float>&, const basicMCISvector<float>&,
+                                        const basicMCISvector<float>&);
+
+template void body2inert(MCISvector& vec, const MCISvector& eulerAngles);
+template void body2inert(MCISvectorf& vec, const MCISvectorf& eulerAngles);
+
+template void pqr2eulerRates(MCISvector& vec, const MCISvector& eulerAngles);
+template void pqr2eulerRates(MCISvectorf& vec, const MCISvectorf& eulerAngles);
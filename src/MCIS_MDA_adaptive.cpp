@@ -0,0 +1,429 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+#include <cmath>
+#include <chrono>
+#include "include/MCIS_MDA_adaptive.h"
+
+
+
+/*
+ *  clampParam
+ * 
+ * Keep an adapted parameter within its bounds
+ */
+static inline double clampParam(double val, double low, double high)
+{
+    if (val < low)
+    {
+        return low;
+    }
+    if (val > high)
+    {
+        return high;
+    }
+    return val;
+}
+
+
+
+
+
+/*
+ *  cueErrorEstimator constructor
+ * 
+ * Only the sample period and the specific force scaling are needed.
+ * The MB is assumed to start out at rest in neutral.
+ */
+cueErrorEstimator::cueErrorEstimator(const MCISconfig& config)
+    :   dt{1.0 / config.sampleRate},
+        kX{config.K_SF_x},
+        kY{config.K_SF_y},
+        kZ{config.K_SF_z},
+        lastPos{0,0,0},
+        lastPos2{0,0,0},
+        platformAcc{0,0,0},
+        platformVel{0,0,0},
+        tiltSF{0,0,0},
+        error{0,0,0}
+{}
+
+/*
+ *  cueErrorEstimator::reference
+ * 
+ * The cue the MDA is configured to deliver: the aircraft specific force
+ * without gravity, scaled by K_SF. Same as MCIS_MDA with gravity subtraction.
+ */
+MCISvector cueErrorEstimator::reference(const MCISvector& accelerations, const MCISvector& attitude) const
+{
+    MCISvector ref = accelerations;
+    MCISvector gravVector{0, 0, gravity};
+    MCISmatrix DCM;
+
+    DCM.euler2DCM_ZYX(attitude);
+    gravVector = DCM * gravVector;
+    ref -= gravVector;
+    ref.applyScalarGains(kX, kY, kZ);
+
+    return ref;
+}
+
+/*
+ *  cueErrorEstimator::nextSample
+ * 
+ * Theory of operation:
+ * 
+ * 1) MB acceleration and velocity are the second and first differences of 
+ *      the position output.
+ * 2) The tilt coordination angles are the orientation output minus 
+ *      angleNoTC. Tilting by theta gives g*sin(theta) of specific force, 
+ *      with positive pitch for positive x and negative roll for positive y,
+ *      as in tiltCoordination.
+ * 3) The error is the reference minus both contributions. The reference is 
+ *      in aircraft body axes and the MB outputs are in inertial axes, the 
+ *      difference is second order in the MB angles and is ignored.
+ */
+const MCISvector& cueErrorEstimator::nextSample(const MCISvector& reference, const MCISvector& pos, 
+                                                const MCISvector& angle, const MCISvector& angleNoTC)
+{
+    // 1) Translation
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        platformAcc[i] = (pos[i] - 2 * lastPos[i] + lastPos2[i]) / (dt * dt);
+        platformVel[i] = (pos[i] - lastPos[i]) / dt;
+    }
+    lastPos2 = lastPos;
+    lastPos  = pos;
+
+    // 2) Tilt coordination
+    tiltSF.assign( gravity * std::sin(angle[1] - angleNoTC[1]),
+                  -gravity * std::sin(angle[0] - angleNoTC[0]),
+                   0);
+
+    // 3) Error
+    error  = reference;
+    error -= platformAcc;
+    error -= tiltSF;
+
+    return error;
+}
+
+/*
+ *  cueErrorEstimator::reset
+ */
+void cueErrorEstimator::reset(const MCISvector& pos)
+{
+    lastPos  = pos;
+    lastPos2 = pos;
+    platformAcc.assign(0, 0, 0);
+    platformVel.assign(0, 0, 0);
+    tiltSF.assign(0, 0, 0);
+    error.assign(0, 0, 0);
+}
+
+/*
+ *  cueErrorEstimator getters
+ */
+const MCISvector& cueErrorEstimator::getPlatformAcc() const
+{
+    return platformAcc;
+}
+const MCISvector& cueErrorEstimator::getPlatformVel() const
+{
+    return platformVel;
+}
+const MCISvector& cueErrorEstimator::getTiltSF() const
+{
+    return tiltSF;
+}
+const MCISvector& cueErrorEstimator::getError() const
+{
+    return error;
+}
+
+
+
+
+
+/*
+ *  MCIS_MDA_adaptive constructor
+ * 
+ * The blocks are built exactly as in MCIS_MDA. The adapted parameters start
+ * at the configured gains and with the extra high-pass stage disabled, so 
+ * until the first adaptation step the output matches the classical washout
+ * with gravity subtraction.
+ */
+MCIS_MDA_adaptive::MCIS_MDA_adaptive(const MCISconfig& config)
+    :   dt{1.0 / config.sampleRate},
+        angleBlock{config},
+        tiltBlock{config},
+        posBlock{config, true},
+        cueError{config},
+        posOut{0,0,0},
+        angleOut{0,0,0},
+        angleNoTCout{0,0,0},
+        angvInput{0,0,0},
+        posInput{0,0,0},
+        refInput{0,0,0},
+        kSF0{config.K_SF_x, config.K_SF_y, config.K_SF_z},
+        kTC0{config.K_TC_x, config.K_TC_y},
+        kp{config.K_p},
+        kq{config.K_q},
+        kr{config.K_r},
+        gainSF{1, 1, 1},
+        gainTC{1, 1},
+        omega{0, 0, 0},
+        hpOut{0, 0, 0},
+        hpLastIn{0, 0, 0},
+        hpSens{0, 0, 0},
+        velSens{0, 0, 0},
+        posSens{0, 0, 0},
+        lastComputeTime{0},
+        worstComputeTime{0}
+{}
+
+/*
+ *  MCIS_MDA_adaptive::prepareInputs
+ * 
+ * The configured cue goes to refInput, the scaled angular velocities to 
+ * angvInput.
+ */
+void MCIS_MDA_adaptive::prepareInputs(const MCISvector& accelerations, const MCISvector& angularVelocities, 
+                                      const MCISvector& attitude)
+{
+    refInput  = cueError.reference(accelerations, attitude);
+    angvInput = angularVelocities;
+    angvInput.applyScalarGains(kp, kq, kr);
+}
+
+/*
+ *  MCIS_MDA_adaptive::nextSample
+ * 
+ * Run one iteration of the adaptive washout
+ * 
+ * Theory of operation / signal path:
+ * 
+ * 1) Subtract gravity and scale the inputs at the configured gains
+ * 2) Angular channel, exactly as in MCIS_MDA
+ * 3) Tilt coordination, with the current K_TC
+ * 4) The cue goes through the adaptive first order high-pass stage,
+ *      y[n] = a (y[n-1] + x[n] - x[n-1]),  a = 1 / (1 + omega dt)
+ *      which is a wire for omega = 0. Its sensitivity to omega, 
+ *      S = dy/domega, follows from differentiating the recursion:
+ *      S[n] = a (S[n-1] - dt y[n])
+ * 5) The result is scaled by the current K_SF and goes through posHPchannel
+ * 6) The delivered cue is worked out from the new outputs and compared
+ *      with the configured one
+ * 7) One steepest descent step on every parameter, see adapt()
+ * 
+ * The new parameters take effect on the next sample.
+ */
+void MCIS_MDA_adaptive::nextSample(const MCISvector& accelerations, const MCISvector& angularVelocities, 
+                                   const MCISvector& attitude)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // 1) Gravity and scaling
+    prepareInputs(accelerations, angularVelocities, attitude);
+
+    // 2) Angular channel
+    angleNoTCout = angleBlock.nextSample(angvInput, angleOut);
+
+    // 3) Tilt coordination
+    tiltBlock.setGains(kTC0[0] * gainTC[0], kTC0[1] * gainTC[1]);
+    angleOut = tiltBlock.nextSample(refInput, angleOut, angleNoTCout);
+
+    // 4) and 5) Adaptive high-pass, scaling and position channel
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        double a = 1 / (1 + omega[i] * dt);
+
+        hpOut[i]    = a * (hpOut[i] + refInput[i] - hpLastIn[i]);
+        hpLastIn[i] = refInput[i];
+        hpSens[i]   = a * (hpSens[i] - dt * hpOut[i]);
+
+        posInput[i] = gainSF[i] * hpOut[i];
+    }
+    posOut = posBlock.nextSample(posInput, angleOut);
+
+    // 6) Cue error
+    cueError.nextSample(refInput, posOut, angleOut, angleNoTCout);
+
+    // 7) Adaptation
+    adapt();
+
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    lastComputeTime = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    if (lastComputeTime > worstComputeTime)
+    {
+        worstComputeTime = lastComputeTime;
+    }
+}
+
+/*
+ *  MCIS_MDA_adaptive::adapt
+ * 
+ * One steepest descent step on the cost described in MCIS_MDA_adaptive.h.
+ * 
+ * The gradients use the usual approximations for adaptive washout, so that
+ * each one is a handful of multiplications:
+ * 
+ *  - Everything downstream of the gains is treated as linear, so the MB 
+ *      acceleration, velocity and position are proportional to K_SF and the
+ *      tilt specific force is proportional to K_TC. The sensitivity of each
+ *      is then just its current value over the gain.
+ *  - posHPchannel is treated as a pair of integrators when it comes to the
+ *      break frequency: the MB acceleration sensitivity is K_SF*S from the 
+ *      high-pass stage, and the velocity and position sensitivities are its
+ *      (leaky) integrals.
+ * 
+ * Every step is clamped to the parameter bounds.
+ */
+void MCIS_MDA_adaptive::adapt()
+{
+    const MCISvector& err = cueError.getError();
+    const MCISvector& acc = cueError.getPlatformAcc();
+    const MCISvector& vel = cueError.getPlatformVel();
+    const MCISvector& tilt = cueError.getTiltSF();
+    const double leak = 1 - ADAPTIVE_SENS_LEAK * dt;
+
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        double accSens = gainSF[i] * hpSens[i];
+        velSens[i] = leak * velSens[i] + dt * accSens;
+        posSens[i] = leak * posSens[i] + dt * velSens[i];
+
+        double gradK = (-ADAPTIVE_W_ERR * err[i] * acc[i] 
+                        + ADAPTIVE_W_POS * posOut[i] * posOut[i]
+                        + ADAPTIVE_W_VEL * vel[i] * vel[i]) / gainSF[i]
+                       + ADAPTIVE_W_K * (gainSF[i] - 1);
+
+        double gradOmega = -ADAPTIVE_W_ERR * err[i] * accSens
+                           + ADAPTIVE_W_POS * posOut[i] * posSens[i]
+                           + ADAPTIVE_W_VEL * vel[i] * velSens[i]
+                           + ADAPTIVE_W_OMEGA * omega[i];
+
+        gainSF[i] = clampParam(gainSF[i] - ADAPTIVE_MU_K * gradK, ADAPTIVE_K_MIN, ADAPTIVE_K_MAX);
+        omega[i]  = clampParam(omega[i] - ADAPTIVE_MU_OMEGA * gradOmega, 0, ADAPTIVE_OMEGA_MAX);
+    }
+
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        double gradTC = -ADAPTIVE_W_ERR * err[i] * tilt[i] / gainTC[i]
+                        + ADAPTIVE_W_TC * (gainTC[i] - 1);
+
+        gainTC[i] = clampParam(gainTC[i] - ADAPTIVE_MU_TC * gradTC, ADAPTIVE_K_MIN, ADAPTIVE_K_MAX);
+    }
+}
+
+/*
+ *  MCIS_MDA_adaptive::initSteadyState
+ * 
+ * Back to the configured parameters, then the same steady state as 
+ * MCIS_MDA::initSteadyState. The high-pass stage is a wire at omega = 0, so
+ * its steady state output is its input.
+ */
+void MCIS_MDA_adaptive::initSteadyState(const MCISvector& accelerations, const MCISvector& angularVelocities, 
+                                        const MCISvector& attitude)
+{
+    const int iterations = 10;
+
+    prepareInputs(accelerations, angularVelocities, attitude);
+
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        gainSF[i]   = 1;
+        omega[i]    = 0;
+        hpOut[i]    = refInput[i];
+        hpLastIn[i] = refInput[i];
+        hpSens[i]   = 0;
+        velSens[i]  = 0;
+        posSens[i]  = 0;
+    }
+    gainTC[0] = 1;
+    gainTC[1] = 1;
+    tiltBlock.setGains(kTC0[0], kTC0[1]);
+
+    for (int i = 0; i < iterations; i++)
+    {
+        angleNoTCout = angleBlock.initSteadyState(angvInput, angleOut);
+        angleOut = tiltBlock.initSteadyState(refInput, angleOut, angleNoTCout);
+    }
+
+    posInput = refInput;
+    posOut = posBlock.initSteadyState(posInput, angleOut);
+    cueError.reset(posOut);
+}
+
+/*
+ *  MCIS_MDA_adaptive getters
+ */
+MCISvector& MCIS_MDA_adaptive::getPos()
+{
+    return posOut;
+}
+MCISvector& MCIS_MDA_adaptive::getangle()
+{
+    return angleOut;
+}
+MCISvector& MCIS_MDA_adaptive::getAngleNoTC()
+{
+    return angleNoTCout;
+}
+MCISvector MCIS_MDA_adaptive::getScaling() const
+{
+    MCISvector scaling{kSF0[0] * gainSF[0], kSF0[1] * gainSF[1], kSF0[2] * gainSF[2]};
+    return scaling;
+}
+MCISvector MCIS_MDA_adaptive::getTiltGains() const
+{
+    MCISvector gains{kTC0[0] * gainTC[0], kTC0[1] * gainTC[1], 0};
+    return gains;
+}
+MCISvector MCIS_MDA_adaptive::getBreakFrequencies() const
+{
+    MCISvector freqs{omega[0], omega[1], omega[2]};
+    return freqs;
+}
+const MCISvector& MCIS_MDA_adaptive::getCueError() const
+{
+    return cueError.getError();
+}
+int64_t MCIS_MDA_adaptive::getLastComputeTime() const
+{
+    return lastComputeTime;
+}
+int64_t MCIS_MDA_adaptive::getWorstComputeTime() const
+{
+    return worstComputeTime;
+}
+void MCIS_MDA_adaptive::resetComputeStats()
+{
+    lastComputeTime  = 0;
+    worstComputeTime = 0;
+}
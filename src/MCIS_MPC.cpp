@@ -0,0 +1,825 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+#include <cmath>
+#include <chrono>
+#include <stdexcept>
+#include "include/MCIS_MPC.h"
+#include "include/MOOG6DOF2000E.h"
+
+
+
+/*
+ *          ---=== mpcQPsolver function definitions ===---
+ */
+
+/*
+ *  Constructor
+ * 
+ * The ADMM parameters are fixed, so that the matrix factorized in setup() 
+ * never changes. alpha is the usual over-relaxation factor.
+ */
+mpcQPsolver::mpcQPsolver() : rho{0.03}, sigma{1e-6}, alpha{1.6}, epsAbs{1e-5}, epsRel{1e-4}, 
+                             lastIterations{0}, lastConverged{true}
+{
+    for (unsigned int i = 0; i < N; i++)
+    {
+        for (unsigned int j = 0; j < N; j++)
+        {
+            P[i][j] = 0;
+            L[i][j] = 0;
+        }
+    }
+    for (unsigned int i = 0; i < M; i++)
+    {
+        for (unsigned int j = 0; j < N; j++)
+        {
+            A[i][j] = 0;
+        }
+        rowScale[i] = 1;
+    }
+    this -> reset();
+}
+
+/*
+ *  setup
+ * 
+ * Store P and A and compute the Cholesky factor of K = P + sigma*I + rho*A'A,
+ * which is the matrix of the linear system solved every ADMM iteration.
+ * 
+ * This is the only O(N^3) step and only happens at construction.
+ */
+void mpcQPsolver::setup(const double (&Pin)[N][N], const double (&Ain)[M][N])
+{
+    double K[N][N];
+
+    for (unsigned int i = 0; i < N; i++)
+    {
+        for (unsigned int j = 0; j < N; j++)
+        {
+            P[i][j] = Pin[i][j];
+        }
+    }
+    //Scale every constraint row to a unit infinity norm. The position rows 
+    //and the input rows differ by orders of magnitude otherwise, and a single
+    //rho can't suit both.
+    for (unsigned int i = 0; i < M; i++)
+    {
+        double rowNorm = 0;
+        for (unsigned int j = 0; j < N; j++)
+        {
+            rowNorm = std::fmax(rowNorm, fabs(Ain[i][j]));
+        }
+        rowScale[i] = (rowNorm > 0) ? 1 / rowNorm : 1;
+
+        for (unsigned int j = 0; j < N; j++)
+        {
+            A[i][j] = rowScale[i] * Ain[i][j];
+        }
+    }
+
+    //K = P + sigma*I + rho*A'A
+    for (unsigned int i = 0; i < N; i++)
+    {
+        for (unsigned int j = 0; j < N; j++)
+        {
+            double ata = 0;
+            for (unsigned int k = 0; k < M; k++)
+            {
+                ata += A[k][i] * A[k][j];
+            }
+            K[i][j] = P[i][j] + rho * ata + ((i == j) ? sigma : 0);
+        }
+    }
+
+    //Plain Cholesky, K = L L'
+    for (unsigned int j = 0; j < N; j++)
+    {
+        double diag = K[j][j];
+        for (unsigned int k = 0; k < j; k++)
+        {
+            diag -= L[j][k] * L[j][k];
+        }
+        if (diag <= 0)
+        {
+            std::runtime_error notPositiveDefiniteException("MPC cost matrix is not positive definite!\n");
+            throw notPositiveDefiniteException;
+        }
+        L[j][j] = sqrt(diag);
+
+        for (unsigned int i = j + 1; i < N; i++)
+        {
+            double sum = K[i][j];
+            for (unsigned int k = 0; k < j; k++)
+            {
+                sum -= L[i][k] * L[j][k];
+            }
+            L[i][j] = sum / L[j][j];
+        }
+        for (unsigned int i = 0; i < j; i++)
+        {
+            L[i][j] = 0;
+        }
+    }
+
+    this -> reset();
+}
+
+/*
+ *  reset
+ * 
+ * Drop the warm start. The next solve starts from zero.
+ */
+void mpcQPsolver::reset()
+{
+    for (unsigned int i = 0; i < N; i++)
+    {
+        x[i] = 0;
+    }
+    for (unsigned int i = 0; i < M; i++)
+    {
+        z[i] = 0;
+        y[i] = 0;
+    }
+    lastIterations = 0;
+}
+
+/*
+ *  cholSolve
+ * 
+ * Forward and back substitution with the factor computed in setup()
+ */
+void mpcQPsolver::cholSolve(const double *in, double *out)
+{
+    //L w = in
+    for (unsigned int i = 0; i < N; i++)
+    {
+        double sum = in[i];
+        for (unsigned int k = 0; k < i; k++)
+        {
+            sum -= L[i][k] * out[k];
+        }
+        out[i] = sum / L[i][i];
+    }
+    //L' out = w
+    for (int i = N - 1; i >= 0; i--)
+    {
+        double sum = out[i];
+        for (unsigned int k = i + 1; k < N; k++)
+        {
+            sum -= L[k][i] * out[k];
+        }
+        out[i] = sum / L[i][i];
+    }
+}
+
+/*
+ *  solve
+ * 
+ * Run ADMM from the previous solution until the residuals are small enough or
+ * MPC_MAX_ITERATIONS is reached, whichever comes first. If the iteration cap
+ * is hit, the best estimate so far is left in place; for MPC this is fine,
+ * since only the first input is used and the problem is solved again next sample.
+ * Whether it converged is kept for getLastConverged.
+ * 
+ * Theory of operation (one iteration):
+ * 1) xt = K^-1 (sigma*x - q + A'(rho*z - y))
+ * 2) zt = A xt
+ * 3) x  = alpha*xt + (1 - alpha)*x                 (over-relaxation)
+ * 4) z  = clamp(alpha*zt + (1 - alpha)*z + y/rho, l, u)
+ * 5) y += rho*(alpha*zt + (1 - alpha)*zold - z)
+ * 
+ * Convergence is checked every few iterations, since computing the dual 
+ * residual costs as much as an iteration.
+ */
+unsigned int mpcQPsolver::solve(const double (&q)[N], const double (&l)[M], const double (&u)[M])
+{
+    const unsigned int checkInterval = 5;
+    unsigned int it;
+    bool converged = false;
+
+    for (it = 1; it <= MPC_MAX_ITERATIONS; it++)
+    {
+        // 1)
+        for (unsigned int i = 0; i < N; i++)
+        {
+            double sum = sigma * x[i] - q[i];
+            for (unsigned int k = 0; k < M; k++)
+            {
+                sum += A[k][i] * (rho * z[k] - y[k]);
+            }
+            rhs[i] = sum;
+        }
+        cholSolve(rhs, xt);
+
+        // 2) to 5)
+        for (unsigned int k = 0; k < M; k++)
+        {
+            double sum = 0;
+            for (unsigned int i = 0; i < N; i++)
+            {
+                sum += A[k][i] * xt[i];
+            }
+            zt[k] = sum;
+        }
+        for (unsigned int i = 0; i < N; i++)
+        {
+            x[i] = alpha * xt[i] + (1 - alpha) * x[i];
+        }
+        for (unsigned int k = 0; k < M; k++)
+        {
+            double zRelaxed = alpha * zt[k] + (1 - alpha) * z[k];
+            double zNew = zRelaxed + y[k] / rho;
+            if (zNew < rowScale[k] * l[k])
+            {
+                zNew = rowScale[k] * l[k];
+            }
+            else if (zNew > rowScale[k] * u[k])
+            {
+                zNew = rowScale[k] * u[k];
+            }
+            y[k] += rho * (zRelaxed - zNew);
+            z[k] = zNew;
+        }
+
+        //Check the residuals
+        if (0 == it % checkInterval)
+        {
+            double primRes = 0, dualRes = 0, normAx = 0, normZ = 0, normPx = 0, normATy = 0, normQ = 0;
+
+            for (unsigned int k = 0; k < M; k++)
+            {
+                double ax = 0;
+                for (unsigned int i = 0; i < N; i++)
+                {
+                    ax += A[k][i] * x[i];
+                }
+                primRes = std::fmax(primRes, fabs(ax - z[k]));
+                normAx  = std::fmax(normAx, fabs(ax));
+                normZ   = std::fmax(normZ, fabs(z[k]));
+            }
+            for (unsigned int i = 0; i < N; i++)
+            {
+                double px = 0, aty = 0;
+                for (unsigned int j = 0; j < N; j++)
+                {
+                    px += P[i][j] * x[j];
+                }
+                for (unsigned int k = 0; k < M; k++)
+                {
+                    aty += A[k][i] * y[k];
+                }
+                dualRes = std::fmax(dualRes, fabs(px + q[i] + aty));
+                normPx  = std::fmax(normPx, fabs(px));
+                normATy = std::fmax(normATy, fabs(aty));
+                normQ   = std::fmax(normQ, fabs(q[i]));
+            }
+
+            if ((primRes <= epsAbs + epsRel * std::fmax(normAx, normZ)) &&
+                (dualRes <= epsAbs + epsRel * std::fmax(normPx, std::fmax(normATy, normQ))))
+            {
+                converged = true;
+                break;
+            }
+        }
+    }
+
+    lastIterations = (it > MPC_MAX_ITERATIONS) ? MPC_MAX_ITERATIONS : it;
+    lastConverged = converged;
+    return lastIterations;
+}
+
+/*
+ *  Getters
+ */
+double mpcQPsolver::getSolution(unsigned int index) const
+{
+    if (index >= N)
+    {
+        //Requested element does not exist, throw exception
+        std::out_of_range invalidSubscriptException("Requested solution element is out of bounds!\n");
+        throw invalidSubscriptException;
+    }
+    return x[index];
+}
+unsigned int mpcQPsolver::getLastIterations() const
+{
+    return lastIterations;
+}
+bool mpcQPsolver::getLastConverged() const
+{
+    return lastConverged;
+}
+
+
+
+
+/*
+ *          ---=== mpcAxis function definitions ===---
+ */
+
+/*
+ *  Constructor
+ * 
+ * Builds the condensed QP for this axis and hands it to the solver.
+ * 
+ * Theory of operation:
+ * 1) Step k lasts one sample for k = 0 and MPC_STEP_SAMPLES samples otherwise,
+ *      so that the horizon reaches far ahead with few variables.
+ * 2) The model is simulated for a unit input on each step to get Gp and Gv, the 
+ *      predicted position and velocity at the end of every step. The response
+ *      to the initial state (the free response) is pos + vel*T[k] and vel.
+ * 3) Each stage is weighted in proportion to its length, so the long steps 
+ *      don't get drowned out by the short one, or vice versa.
+ * 4) The cost
+ *          sum_k c_k*(w_input*(u_k - ref)^2 + w_pos*p_k^2 + w_vel*v_k^2) 
+ *        + w_smooth*sum_k (u_k - u_k-1)^2
+ *      is expanded into 1/2 U'PU + q'U. P is constant; q depends on the state
+ *      and reference and is rebuilt every sample from gp1, gpT and gv1.
+ * 5) The constraints are the predicted positions (rows 0 to N-1, A = Gp)
+ *      and the inputs themselves (rows N to 2N-1, A = I).
+ */
+mpcAxis::mpcAxis(unsigned int modelOrder, double samplePeriod, const mpcAxisWeights& axisWeights,
+                 double lowerLim, double upperLim, double inputLimit)
+    :   order{modelOrder},
+        dt{samplePeriod},
+        weights(axisWeights),
+        posMin{lowerLim},
+        posMax{upperLim},
+        inputLim{inputLimit}
+{
+    double stepLen[N];
+    double Pm[N][N];
+    double Am[M][N];
+
+    if ((1 != order) && (2 != order))
+    {
+        std::invalid_argument badOrderException("MPC axis model order must be 1 or 2!\n");
+        throw badOrderException;
+    }
+
+    // 1) Step lengths and elapsed time
+    for (unsigned int k = 0; k < N; k++)
+    {
+        stepLen[k] = (0 == k) ? dt : dt * MPC_STEP_SAMPLES;
+        T[k] = stepLen[k] + ((0 == k) ? 0 : T[k - 1]);
+        c[k] = stepLen[k] / (dt * MPC_STEP_SAMPLES);
+    }
+
+    // 2) Unit input responses
+    for (unsigned int j = 0; j < N; j++)
+    {
+        double p = 0, v = 0;
+        for (unsigned int k = 0; k < N; k++)
+        {
+            double input = (j == k) ? 1 : 0;
+            if (2 == order)
+            {
+                p += stepLen[k] * v + 0.5 * stepLen[k] * stepLen[k] * input;
+                v += stepLen[k] * input;
+            }
+            else
+            {
+                p += stepLen[k] * input;
+            }
+            Gp[k][j] = p;
+            Gv[k][j] = v;
+        }
+    }
+
+    // 3) and 4) The quadratic term
+    for (unsigned int i = 0; i < N; i++)
+    {
+        for (unsigned int j = 0; j < N; j++)
+        {
+            double sum = 0;
+            for (unsigned int k = 0; k < N; k++)
+            {
+                sum += c[k] * (weights.pos * Gp[k][i] * Gp[k][j] + weights.vel * Gv[k][i] * Gv[k][j]);
+            }
+            Pm[i][j] = sum;
+        }
+        Pm[i][i] += c[i] * weights.input;
+
+        //Input changes. The first one is relative to the last applied input,
+        //which goes into q.
+        Pm[i][i] += ((N - 1 == i) ? 1 : 2) * weights.smooth;
+        if (i > 0)
+        {
+            Pm[i][i - 1] -= weights.smooth;
+            Pm[i - 1][i] -= weights.smooth;
+        }
+    }
+    // The linear term, up to the state and reference
+    for (unsigned int j = 0; j < N; j++)
+    {
+        gp1[j] = 0;
+        gpT[j] = 0;
+        gv1[j] = 0;
+        for (unsigned int k = 0; k < N; k++)
+        {
+            gp1[j] += c[k] * Gp[k][j];
+            gpT[j] += c[k] * Gp[k][j] * T[k];
+            gv1[j] += c[k] * Gv[k][j];
+        }
+    }
+
+    // 5) The constraints
+    for (unsigned int k = 0; k < N; k++)
+    {
+        for (unsigned int j = 0; j < N; j++)
+        {
+            Am[k][j] = Gp[k][j];
+            Am[N + k][j] = (j == k) ? 1 : 0;
+        }
+        l[N + k] = -inputLim;
+        u[N + k] =  inputLim;
+    }
+
+    solver.setup(Pm, Am);
+    this -> reset();
+}
+
+/*
+ *  mpcAxis::nextSample
+ * 
+ * Theory of operation/signal path:
+ * 1) Build q from the current state, the last input and the reference, 
+ *      which is assumed constant over the horizon.
+ * 2) Shift the position bounds by the free response
+ * 3) Solve, warm-started from the last solution
+ * 4) Apply the first input to the model for one sample and return the position
+ */
+double mpcAxis::nextSample(double reference)
+{
+    // 1) Linear term
+    for (unsigned int j = 0; j < N; j++)
+    {
+        q[j] =  weights.pos * (gp1[j] * pos + gpT[j] * vel) + weights.vel * gv1[j] * vel
+              - weights.input * c[j] * reference;
+    }
+    q[0] -= weights.smooth * lastInput;
+
+    // 2) Position bounds
+    for (unsigned int k = 0; k < N; k++)
+    {
+        double free = pos + vel * T[k];
+        l[k] = posMin - free;
+        u[k] = posMax - free;
+    }
+
+    // 3) Solve
+    solver.solve(q, l, u);
+    double input = solver.getSolution(0);
+
+    //The solver may stop before converging, keep the input within bounds
+    if (input > inputLim)
+    {
+        input = inputLim;
+    }
+    else if (input < -inputLim)
+    {
+        input = -inputLim;
+    }
+
+    // 4) Move the model forward
+    if (2 == order)
+    {
+        pos += dt * vel + 0.5 * dt * dt * input;
+        vel += dt * input;
+    }
+    else
+    {
+        pos += dt * input;
+    }
+    lastInput = input;
+
+    return pos;
+}
+
+/*
+ *  mpcAxis::reset
+ * 
+ * Back to neutral, at rest, and without a warm start
+ */
+void mpcAxis::reset()
+{
+    pos = 0;
+    vel = 0;
+    lastInput = 0;
+    solver.reset();
+}
+
+unsigned int mpcAxis::getLastIterations() const
+{
+    return solver.getLastIterations();
+}
+bool mpcAxis::getLastConverged() const
+{
+    return solver.getLastConverged();
+}
+
+
+
+
+/*
+ *          ---=== MCIS_MPC function definitions ===---
+ */
+
+/*
+ *  Default cost weights
+ * 
+ * The translational axes are expressed in metres and m/s^2, the rotational 
+ * ones in radians and rad/s. The washout terms are small compared to the 
+ * tracking term, so onsets are reproduced faithfully and the MB drifts back
+ * to neutral over a few seconds.
+ */
+static const mpcAxisWeights translationalWeights = {1.0, 4.0, 2.0, 0.05};
+static const mpcAxisWeights rotationalWeights    = {1.0, 0.5, 0.0, 0.01};
+
+/*
+ *  MCIS_MPC constructor
+ * 
+ * Builds the six axes with the workspace limits from MOOG6DOF2000E.h, 
+ * relative to the neutral position and shrunk by MPC_WORKSPACE_MARGIN. Roll 
+ * and pitch also give up whatever tilt coordination can use.
+ */
+MCIS_MPC::MCIS_MPC(const MCISconfig& config, bool subtract_gravity)
+    :   subgrav{subtract_gravity},
+        tiltBlock{config},
+        xSat{config.lim_SF_x, 0},
+        ySat{config.lim_SF_y, 0},
+        zSat{config.lim_SF_z, 0},
+        rollSat{config.lim_p, 0},
+        pitchSat{config.lim_q, 0},
+        yawSat{config.lim_r, 0},
+        xAxis{2, 1.0 / config.sampleRate, translationalWeights, 
+              MPC_WORKSPACE_MARGIN * (MB_LIM_LOW_x - MB_OFFSET_x), 
+              MPC_WORKSPACE_MARGIN * (MB_LIM_HIGH_x - MB_OFFSET_x), MPC_LIM_ACC},
+        yAxis{2, 1.0 / config.sampleRate, translationalWeights, 
+              MPC_WORKSPACE_MARGIN * (MB_LIM_LOW_y - MB_OFFSET_y), 
+              MPC_WORKSPACE_MARGIN * (MB_LIM_HIGH_y - MB_OFFSET_y), MPC_LIM_ACC},
+        zAxis{2, 1.0 / config.sampleRate, translationalWeights, 
+              MPC_WORKSPACE_MARGIN * (MB_LIM_LOW_z - MB_OFFSET_z), 
+              MPC_WORKSPACE_MARGIN * (MB_LIM_HIGH_z - MB_OFFSET_z), MPC_LIM_ACC},
+        rollAxis{1, 1.0 / config.sampleRate, rotationalWeights, 
+              MPC_WORKSPACE_MARGIN * (MB_LIM_LOW_roll - MB_OFFSET_roll) 
+                + tiltAllowance(config.K_TC_y, config.lim_TC_y, config.filt_SF_LP_y_disc.biquads[0],
+                                MB_LIM_HIGH_roll),
+              MPC_WORKSPACE_MARGIN * (MB_LIM_HIGH_roll - MB_OFFSET_roll)
+                - tiltAllowance(config.K_TC_y, config.lim_TC_y, config.filt_SF_LP_y_disc.biquads[0],
+                                MB_LIM_HIGH_roll),
+              MPC_LIM_ANGV},
+        pitchAxis{1, 1.0 / config.sampleRate, rotationalWeights, 
+              MPC_WORKSPACE_MARGIN * (MB_LIM_LOW_pitch - MB_OFFSET_pitch)
+                + tiltAllowance(config.K_TC_x, config.lim_TC_x, config.filt_SF_LP_x_disc.biquads[0],
+                                MB_LIM_HIGH_pitch),
+              MPC_WORKSPACE_MARGIN * (MB_LIM_HIGH_pitch - MB_OFFSET_pitch)
+                - tiltAllowance(config.K_TC_x, config.lim_TC_x, config.filt_SF_LP_x_disc.biquads[0],
+                                MB_LIM_HIGH_pitch),
+              MPC_LIM_ANGV},
+        yawAxis{1, 1.0 / config.sampleRate, rotationalWeights, 
+              MPC_WORKSPACE_MARGIN * (MB_LIM_LOW_yaw - MB_OFFSET_yaw), 
+              MPC_WORKSPACE_MARGIN * (MB_LIM_HIGH_yaw - MB_OFFSET_yaw), MPC_LIM_ANGV},
+        posOut{0,0,0},
+        angleOut{0,0,0},
+        angleNoTCout{0,0,0},
+        accInput{0,0,0},
+        angvInput{0,0,0},
+        kX{config.K_SF_x},
+        kY{config.K_SF_y},
+        kZ{config.K_SF_z},
+        kp{config.K_p}, 
+        kq{config.K_q},
+        kr{config.K_r}
+{
+    zGravSub = gravity * config.K_SF_z;
+    this -> resetSolveStats();
+}
+
+/*
+ *  tiltAllowance
+ * 
+ * The largest angle tilt coordination can produce: the input saturation,
+ * times the TC gain, times the DC gain of the low-pass filter. This is kept
+ * out of the angular workspace given to the MPC.
+ * 
+ * Capped at half the axis' angular limit, so the MPC always has some room.
+ */
+double MCIS_MPC::tiltAllowance(double K_TC, double lim_TC, const discreteBiquadSectionParams& lp,
+                               double limit)
+{
+    double dcGain = 0;
+    double denominator = 1 + lp.a1 + lp.a2;
+
+    if (fabs(denominator) > 1e-12)
+    {
+        dcGain = lp.gain * (lp.b0 + lp.b1 + lp.b2) / denominator;
+    }
+
+    double allowance = fabs(K_TC * lim_TC * dcGain);
+    double cap = 0.5 * MPC_WORKSPACE_MARGIN * limit;
+    return (allowance > cap) ? cap : allowance;
+}
+
+/*
+ *  MCIS_MPC::prepareInputs
+ * 
+ * Copy the inputs, subtract gravity (if required) and apply the input scaling.
+ * Identical to MCIS_MDA::prepareInputs, so both engines see the same cues.
+ */
+void MCIS_MPC::prepareInputs(const MCISvector& accelerations, const MCISvector& angularVelocities,
+                             const MCISvector& attitude)
+{
+    accInput  = accelerations;
+    angvInput = angularVelocities;
+    attInput  = attitude;
+    // Subtract gravity, if required
+    if (subgrav)
+    {
+        MCISvector gravVector{0, 0, gravity};
+        MCISmatrix DCM;
+        DCM.euler2DCM_ZYX(attInput);
+        gravVector = DCM * gravVector;
+        accInput -= gravVector;
+    } 
+    
+    // Scale inputs
+    accInput.applyScalarGains(kX, kY, kZ);
+    angvInput.applyScalarGains(kp, kq, kr);
+}
+
+/*
+ *  MCIS_MPC::nextSample
+ * 
+ * Run one iteration of the MPC cueing engine
+ * 
+ * Theory of operation / signal path:
+ * 
+ * 1) Subtract gravity and scale inputs, as in MCIS_MDA
+ * 2) The scaled angular velocities are converted to Euler angle rates 
+ *      using the last output attitude and saturated. These are the references
+ *      for the roll, pitch and yaw MPC axes, whose output is stored in
+ *      angleNoTCout.
+ * 3) Tilt coordination is added on top, exactly as in MCIS_MDA.
+ *      The output is stored in angleOut.
+ * 4) The scaled linear accelerations are rotated to inertial axes using
+ *      the output attitude, gravity is removed from z if it wasn't already
+ *      and the result is saturated. These are the references for the x, y
+ *      and z MPC axes, whose output is stored in posOut.
+ * 
+ * The time taken by 2) to 4) is recorded.
+ */
+void MCIS_MPC::nextSample(const MCISvector& accelerations, const MCISvector& angularVelocities,
+                          const MCISvector& attitude)
+{
+    auto start = std::chrono::steady_clock::now();
+    unsigned int iterations = 0;
+    bool converged = true;
+
+    // 1) Subtract gravity, if required, and scale inputs
+    prepareInputs(accelerations, angularVelocities, attitude);
+
+    // 2) Angular axes
+    MCISvector omega = angvInput;
+    pqr2eulerRates(omega, angleOut);
+
+    angleNoTCout.assign(rollAxis.nextSample(rollSat.nextSample(omega[0])),
+                        pitchAxis.nextSample(pitchSat.nextSample(omega[1])),
+                        yawAxis.nextSample(yawSat.nextSample(omega[2])));
+
+    // 3) Tilt coordination
+    angleOut = tiltBlock.nextSample(accInput, angleOut, angleNoTCout);
+
+    // 4) Linear axes
+    MCISvector sf = accInput;
+    body2inert(sf, angleOut);
+    if (!subgrav)
+    {
+        sf[2] -= zGravSub;
+    }
+
+    posOut.assign(xAxis.nextSample(xSat.nextSample(sf[0])),
+                  yAxis.nextSample(ySat.nextSample(sf[1])),
+                  zAxis.nextSample(zSat.nextSample(sf[2])));
+
+    //Bookkeeping
+    lastSolveTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+    if (lastSolveTime > worstSolveTime)
+    {
+        worstSolveTime = lastSolveTime;
+    }
+
+    const mpcAxis *axes[6] = {&xAxis, &yAxis, &zAxis, &rollAxis, &pitchAxis, &yawAxis};
+    for (int i = 0; i < 6; i++)
+    {
+        if (axes[i] -> getLastIterations() > iterations)
+        {
+            iterations = axes[i] -> getLastIterations();
+        }
+        converged = converged && axes[i] -> getLastConverged();
+    }
+    if (iterations > worstIterations)
+    {
+        worstIterations = iterations;
+    }
+    if (!converged)
+    {
+        capHits++;
+    }
+}
+
+/*
+ *  MCIS_MPC::initSteadyState
+ * 
+ * The MPC washes out to neutral on its own, so its steady state for any 
+ * input is the MB at rest in the neutral position. Only tilt coordination
+ * has a non-trivial steady state, found the same way as in MCIS_MDA.
+ */
+void MCIS_MPC::initSteadyState(const MCISvector& accelerations, const MCISvector& angularVelocities,
+                               const MCISvector& attitude)
+{
+    const int iterations = 10;
+
+    prepareInputs(accelerations, angularVelocities, attitude);
+
+    xAxis.reset();
+    yAxis.reset();
+    zAxis.reset();
+    rollAxis.reset();
+    pitchAxis.reset();
+    yawAxis.reset();
+
+    angleNoTCout.assign(0, 0, 0);
+    for (int i = 0; i < iterations; i++)
+    {
+        angleOut = tiltBlock.initSteadyState(accInput, angleOut, angleNoTCout);
+    }
+    posOut.assign(0, 0, 0);
+}
+
+/*
+ *  MCIS_MPC getters
+ */
+MCISvector& MCIS_MPC::getPos()
+{
+    return posOut;
+}
+MCISvector& MCIS_MPC::getangle()
+{
+    return angleOut;
+}
+MCISvector& MCIS_MPC::getAngleNoTC()
+{
+    return angleNoTCout;
+}
+
+int64_t MCIS_MPC::getLastSolveTime() const
+{
+    return lastSolveTime;
+}
+int64_t MCIS_MPC::getWorstSolveTime() const
+{
+    return worstSolveTime;
+}
+unsigned int MCIS_MPC::getWorstIterations() const
+{
+    return worstIterations;
+}
+unsigned long MCIS_MPC::getCapHits() const
+{
+    return capHits;
+}
+void MCIS_MPC::resetSolveStats()
+{
+    lastSolveTime   = 0;
+    worstSolveTime  = 0;
+    worstIterations = 0;
+    capHits         = 0;
+}
@@ -0,0 +1,515 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include <cstdlib>
+#include <new>
+#include <iomanip>
+#include "include/MCIS_audit.h"
+
+#ifdef MCIS_AUDIT
+#include <dlfcn.h>
+#include <cstdarg>
+#include <time.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
+
+
+/*
+ *  Per-thread running totals. Plain thread_locals with constant 
+ * initializers, so touching them never runs any code, not even from
+ * operator new.
+ */
+static thread_local uint64_t threadAllocations = 0;
+static thread_local uint64_t threadFrees = 0;
+static thread_local uint64_t threadBytes = 0;
+static thread_local uint64_t threadSyscalls = 0;
+
+
+/*
+ *  auditThreadCounts
+ */
+auditCounts auditThreadCounts()
+{
+    auditCounts counts;
+    counts.allocations  = threadAllocations;
+    counts.frees        = threadFrees;
+    counts.bytes        = threadBytes;
+    counts.syscalls     = threadSyscalls;
+    return counts;
+}
+
+/*
+ *  auditEnabled
+ */
+bool auditEnabled()
+{
+#ifdef MCIS_AUDIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+ *  auditCounts::operator-
+ */
+auditCounts auditCounts::operator-(const auditCounts& rhs) const
+{
+    auditCounts difference;
+    difference.allocations  = allocations - rhs.allocations;
+    difference.frees        = frees - rhs.frees;
+    difference.bytes        = bytes - rhs.bytes;
+    difference.syscalls     = syscalls - rhs.syscalls;
+    return difference;
+}
+
+
+
+#ifdef MCIS_AUDIT
+
+/*
+ *      ---=== Heap hooks ===---
+ * 
+ * Replacements for every form of the global operator new and delete, on top
+ * of malloc and free. Failure behaves as the standard requires, minus the 
+ * new_handler, which MCIS never installs.
+ */
+
+static void *auditedAlloc(std::size_t size)
+{
+    threadAllocations++;
+    threadBytes += size;
+    return std::malloc(size ? size : 1);
+}
+
+static void auditedFree(void *block)
+{
+    if (block)
+    {
+        threadFrees++;
+        std::free(block);
+    }
+}
+
+void *operator new(std::size_t size)
+{
+    void *block = auditedAlloc(size);
+    if (!block)
+    {
+        std::bad_alloc failure;
+        throw failure;
+    }
+    return block;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return auditedAlloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return auditedAlloc(size);
+}
+
+void operator delete(void *block) noexcept
+{
+    auditedFree(block);
+}
+
+void operator delete[](void *block) noexcept
+{
+    auditedFree(block);
+}
+
+void operator delete(void *block, const std::nothrow_t&) noexcept
+{
+    auditedFree(block);
+}
+
+void operator delete[](void *block, const std::nothrow_t&) noexcept
+{
+    auditedFree(block);
+}
+
+#if __cpp_sized_deallocation
+void operator delete(void *block, std::size_t) noexcept
+{
+    auditedFree(block);
+}
+
+void operator delete[](void *block, std::size_t) noexcept
+{
+    auditedFree(block);
+}
+#endif
+
+#if __cpp_aligned_new
+static void *auditedAlignedAlloc(std::size_t size, std::align_val_t alignment)
+{
+    std::size_t align = (std::size_t)alignment;
+    //aligned_alloc wants a multiple of the alignment
+    std::size_t rounded = ((size ? size : 1) + align - 1) & ~(align - 1);
+    threadAllocations++;
+    threadBytes += size;
+    return aligned_alloc(align, rounded);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    void *block = auditedAlignedAlloc(size, alignment);
+    if (!block)
+    {
+        std::bad_alloc failure;
+        throw failure;
+    }
+    return block;
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return auditedAlignedAlloc(size, alignment);
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return auditedAlignedAlloc(size, alignment);
+}
+
+void operator delete(void *block, std::align_val_t) noexcept
+{
+    auditedFree(block);
+}
+
+void operator delete[](void *block, std::align_val_t) noexcept
+{
+    auditedFree(block);
+}
+
+void operator delete(void *block, std::size_t, std::align_val_t) noexcept
+{
+    auditedFree(block);
+}
+
+void operator delete[](void *block, std::size_t, std::align_val_t) noexcept
+{
+    auditedFree(block);
+}
+
+void operator delete(void *block, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    auditedFree(block);
+}
+
+void operator delete[](void *block, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    auditedFree(block);
+}
+#endif
+
+
+
+/*
+ *      ---=== Syscall hooks ===---
+ * 
+ * Each one counts the call and passes it on to the next definition of the
+ * symbol, which is libc's. The lookup happens on the first call, from 
+ * whichever thread makes it; dlsym is thread-safe and always returns the 
+ * same answer, so a race only costs a second lookup.
+ * 
+ * The prototypes must match libc's exactly, down to the exception 
+ * specification, hence __THROW on the few that are not cancellation points.
+ */
+
+template <typename F>
+static F nextSymbol(F& cache, const char *name)
+{
+    if (!cache)
+    {
+        cache = reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+    }
+    return cache;
+}
+
+#define AUDITED_SYSCALL(name, ...)                                  \
+    static decltype(&::name) next;                                  \
+    threadSyscalls++;                                               \
+    return nextSymbol(next, #name)(__VA_ARGS__)
+
+extern "C"
+{
+
+ssize_t read(int fd, void *buf, size_t count)
+{
+    AUDITED_SYSCALL(read, fd, buf, count);
+}
+
+ssize_t write(int fd, const void *buf, size_t count)
+{
+    AUDITED_SYSCALL(write, fd, buf, count);
+}
+
+ssize_t send(int sockfd, const void *buf, size_t len, int flags)
+{
+    AUDITED_SYSCALL(send, sockfd, buf, len, flags);
+}
+
+ssize_t sendto(int sockfd, const void *buf, size_t len, int flags, 
+               const struct sockaddr *dest_addr, socklen_t addrlen)
+{
+    AUDITED_SYSCALL(sendto, sockfd, buf, len, flags, dest_addr, addrlen);
+}
+
+ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags)
+{
+    AUDITED_SYSCALL(sendmsg, sockfd, msg, flags);
+}
+
+ssize_t recv(int sockfd, void *buf, size_t len, int flags)
+{
+    AUDITED_SYSCALL(recv, sockfd, buf, len, flags);
+}
+
+ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags,
+                 struct sockaddr *src_addr, socklen_t *addrlen)
+{
+    AUDITED_SYSCALL(recvfrom, sockfd, buf, len, flags, src_addr, addrlen);
+}
+
+ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags)
+{
+    AUDITED_SYSCALL(recvmsg, sockfd, msg, flags);
+}
+
+int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags, 
+             struct timespec *timeout)
+{
+    AUDITED_SYSCALL(recvmmsg, sockfd, msgvec, vlen, flags, timeout);
+}
+
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+    AUDITED_SYSCALL(epoll_wait, epfd, events, maxevents, timeout);
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    AUDITED_SYSCALL(poll, fds, nfds, timeout);
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem)
+{
+    AUDITED_SYSCALL(nanosleep, req, rem);
+}
+
+int clock_nanosleep(clockid_t clockid, int flags, const struct timespec *request,
+                    struct timespec *remain)
+{
+    AUDITED_SYSCALL(clock_nanosleep, clockid, flags, request, remain);
+}
+
+int timerfd_settime(int fd, int flags, const struct itimerspec *new_value,
+                    struct itimerspec *old_value) __THROW
+{
+    AUDITED_SYSCALL(timerfd_settime, fd, flags, new_value, old_value);
+}
+
+int sched_yield(void) __THROW
+{
+    AUDITED_SYSCALL(sched_yield);
+}
+
+//For the syscalls glibc has no wrapper for, i.e. io_uring. No syscall takes
+//more than six arguments, so six are always passed on, as glibc's own 
+//syscall() reads them.
+long syscall(long number, ...) __THROW
+{
+    va_list args;
+    va_start(args, number);
+    long a1 = va_arg(args, long);
+    long a2 = va_arg(args, long);
+    long a3 = va_arg(args, long);
+    long a4 = va_arg(args, long);
+    long a5 = va_arg(args, long);
+    long a6 = va_arg(args, long);
+    va_end(args);
+    AUDITED_SYSCALL(syscall, number, a1, a2, a3, a4, a5, a6);
+}
+
+}
+
+#endif //MCIS_AUDIT
+
+
+
+/*
+ *      ---=== class auditRegion ===---
+ */
+
+#ifdef MCIS_AUDIT
+static void countsToArray(const auditCounts& counts, uint64_t (&values)[4])
+{
+    values[0] = counts.allocations;
+    values[1] = counts.frees;
+    values[2] = counts.bytes;
+    values[3] = counts.syscalls;
+}
+#endif
+
+static auditCounts countsFromArray(const uint64_t (&values)[4])
+{
+    auditCounts counts;
+    counts.allocations  = values[0];
+    counts.frees        = values[1];
+    counts.bytes        = values[2];
+    counts.syscalls     = values[3];
+    return counts;
+}
+
+/*
+ *  auditRegion constructor
+ */
+auditRegion::auditRegion()
+{
+    reset();
+}
+
+/*
+ *  auditRegion::begin
+ */
+void auditRegion::begin()
+{
+#ifdef MCIS_AUDIT
+    start = auditThreadCounts();
+#endif
+}
+
+/*
+ *  auditRegion::end
+ * 
+ * Adds what the calling thread did since begin() to the totals. Only the
+ * recording thread writes, so plain loads and stores are enough.
+ */
+void auditRegion::end(bool record)
+{
+#ifdef MCIS_AUDIT
+    if (!record)
+    {
+        return;
+    }
+
+    uint64_t values[4];
+    countsToArray(auditThreadCounts() - start, values);
+
+    for (int i = 0; i < 4; i++)
+    {
+        totals[i].store(totals[i].load(std::memory_order_relaxed) + values[i], 
+                        std::memory_order_relaxed);
+        if (values[i] > worst[i].load(std::memory_order_relaxed))
+        {
+            worst[i].store(values[i], std::memory_order_relaxed);
+        }
+    }
+    if (values[0])
+    {
+        allocatingRuns.store(allocatingRuns.load(std::memory_order_relaxed) + 1,
+                             std::memory_order_relaxed);
+    }
+    runs.store(runs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+#else
+    (void)record;
+#endif
+}
+
+/*
+ *  auditRegion::reset
+ */
+void auditRegion::reset()
+{
+    runs = 0;
+    allocatingRuns = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        totals[i] = 0;
+        worst[i] = 0;
+    }
+}
+
+/*
+ *  auditRegion::getReport
+ */
+auditReport auditRegion::getReport() const
+{
+    auditReport report;
+    uint64_t values[4];
+
+    report.runs = runs.load(std::memory_order_relaxed);
+    report.allocating_runs = allocatingRuns.load(std::memory_order_relaxed);
+    for (int i = 0; i < 4; i++)
+    {
+        values[i] = totals[i].load(std::memory_order_relaxed);
+    }
+    report.total = countsFromArray(values);
+    for (int i = 0; i < 4; i++)
+    {
+        values[i] = worst[i].load(std::memory_order_relaxed);
+    }
+    report.worst = countsFromArray(values);
+
+    return report;
+}
+
+/*
+ *  auditReport::print
+ */
+void auditReport::print(std::ostream& dest) const
+{
+    double perRun = runs ? 1.0 / runs : 0;
+    std::ios_base::fmtflags flags = dest.flags();
+
+    dest << std::fixed << std::setprecision(2)
+         << runs << " runs, allocations " << total.allocations * perRun << "/run"
+         << " (worst " << worst.allocations << ", " << allocating_runs << " runs allocated)"
+         << ", syscalls " << total.syscalls * perRun << "/run"
+         << " (worst " << worst.syscalls << ")";
+    dest.flags(flags);
+}
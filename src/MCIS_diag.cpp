@@ -0,0 +1,215 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include "include/MCIS_diag.h"
+#include "include/MCIS_util.h"
+
+
+/*
+ *  One diagnostic's slot, on a cache line of its own so that threads 
+ * reporting different ones don't contend
+ */
+class diagSlot
+{
+    public:
+
+    alignas(64) std::atomic<uint64_t> count{0};
+    std::atomic<int64_t> last_time{0};
+    std::atomic<int64_t> last_value{0};
+};
+
+static diagSlot diagSlots[DIAG_COUNT];
+
+
+/*
+ *  diagReport
+ * 
+ * The count goes last, so that whoever sees it sees the value too (or a 
+ * later one)
+ */
+void diagReport(diag_id id, int64_t value)
+{
+    diagSlot& slot = diagSlots[id];
+    slot.last_value.store(value, std::memory_order_relaxed);
+    slot.last_time.store(monotonicNs(), std::memory_order_relaxed);
+    slot.count.fetch_add(1, std::memory_order_release);
+}
+
+diagStatus diagGetStatus(diag_id id)
+{
+    diagSlot& slot = diagSlots[id];
+    diagStatus status;
+    status.count = slot.count.load(std::memory_order_acquire);
+    status.last_time = slot.last_time.load(std::memory_order_relaxed);
+    status.last_value = slot.last_value.load(std::memory_order_relaxed);
+    return status;
+}
+
+uint64_t diagTotal()
+{
+    uint64_t total = 0;
+    for (int i = 0; i < DIAG_COUNT; i++)
+    {
+        total += diagSlots[i].count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+const char *diagText(diag_id id)
+{
+    switch (id)
+    {
+        case DIAG_MB_SEND_FAILED:
+            return "Error sending to the MB! Sent %lld";
+        case DIAG_MB_RECV_FAILED:
+            return "MB receive socket failed, errno %lld";
+        case DIAG_XP_RECV_FAILED:
+            return "X-Plane receive socket failed, errno %lld";
+        case DIAG_XP_WRONG_LENGTH:
+            return "Message received has wrong length for X-Plane 9 message: %lld bytes";
+        case DIAG_COUNT:
+            break;
+    }
+    return "Unknown diagnostic %lld";
+}
+
+void diagFormat(diag_id id, int64_t value, char *line, std::size_t length)
+{
+    std::snprintf(line, length, diagText(id), (long long)value);
+}
+
+bool diagLatest(diag_id& id, diagStatus& status)
+{
+    bool any = false;
+    for (int i = 0; i < DIAG_COUNT; i++)
+    {
+        diagStatus candidate = diagGetStatus((diag_id)i);
+        if (candidate.count && (!any || (candidate.last_time > status.last_time)))
+        {
+            id = (diag_id)i;
+            status = candidate;
+            any = true;
+        }
+    }
+    return any;
+}
+
+
+/*
+ *  diagDrain constructor
+ */
+diagDrain::diagDrain(std::ostream& output)
+    :   out{&output}
+{
+    drain = std::thread(&diagDrain::drain_func, this);
+}
+
+diagDrain::~diagDrain()
+{
+    stop();
+}
+
+/*
+ *  diagDrain::print_due
+ * 
+ * One line per diagnostic reported since its last line, stamped with the 
+ * wall clock time of the latest report
+ */
+void diagDrain::print_due(bool force)
+{
+    int64_t now = monotonicNs();
+    int64_t realtimeOffset = realtimeNs() - now;
+
+    for (int i = 0; i < DIAG_COUNT; i++)
+    {
+        diag_id id = (diag_id)i;
+        diagStatus status = diagGetStatus(id);
+        if (status.count == printed[i])
+        {
+            continue;
+        }
+        if (!force && last_line[i] && (now - last_line[i] < DIAG_REPORT_INTERVAL_NS))
+        {
+            continue;
+        }
+
+        int64_t when = status.last_time + realtimeOffset;
+        time_t seconds = (time_t)(when / 1000000000);
+        char timeString[32];
+        std::strftime(timeString, sizeof(timeString), "%Y-%m-%d %H:%M:%S", std::localtime(&seconds));
+        char text[DIAG_LINE_LEN];
+        diagFormat(id, status.last_value, text, sizeof(text));
+        char line[DIAG_LINE_LEN + 64];
+        std::snprintf(line, sizeof(line), "%s.%03d %s", timeString, 
+                      (int)((when / 1000000) % 1000), text);
+
+        *out << line;
+        uint64_t times = status.count - printed[i];
+        if (times > 1)
+        {
+            *out << " (" << times << " times)";
+        }
+        *out << std::endl;
+
+        printed[i] = status.count;
+        last_line[i] = now;
+        lines.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/*
+ *  diagDrain::drain_func
+ */
+void diagDrain::drain_func()
+{
+    while (running.load(std::memory_order_acquire))
+    {
+        print_due(false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(DIAG_DRAIN_SLEEP_MS));
+    }
+    print_due(true);
+}
+
+/*
+ *  diagDrain::stop
+ */
+void diagDrain::stop()
+{
+    running.store(false, std::memory_order_release);
+    if (drain.joinable())
+    {
+        drain.join();
+    }
+}
+
+uint64_t diagDrain::get_lines() const
+{
+    return lines.load(std::memory_order_relaxed);
+}
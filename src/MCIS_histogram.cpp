@@ -0,0 +1,215 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+#include <iomanip>
+#include "include/MCIS_histogram.h"
+
+
+
+/*
+ *  latencyHistogram constructor
+ */
+latencyHistogram::latencyHistogram()
+{
+    reset();
+}
+
+/*
+ *  latencyHistogram::bucketIndex
+ * 
+ * Values below 2^HIST_SUB_BITS index their own bucket. Above that, the 
+ * position of the most significant bit picks the group of buckets and the
+ * next HIST_SUB_BITS bits the bucket within it. The groups line up, so that 
+ * the index increases with the value throughout.
+ */
+unsigned int latencyHistogram::bucketIndex(uint64_t value)
+{
+    const uint64_t subBuckets = (uint64_t)1 << HIST_SUB_BITS;
+
+    if (value >= ((uint64_t)1 << HIST_MAX_BITS))
+    {
+        return HIST_BUCKETS - 1;
+    }
+    if (value < subBuckets)
+    {
+        return (unsigned int)value;
+    }
+
+    unsigned int msb = 63 - __builtin_clzll(value);
+    unsigned int shift = msb - HIST_SUB_BITS;
+
+    return ((shift + 1) << HIST_SUB_BITS) + (unsigned int)((value >> shift) - subBuckets);
+}
+
+/*
+ *  latencyHistogram::bucketValue
+ * 
+ * Inverse of bucketIndex, returning the top of the bucket
+ */
+int64_t latencyHistogram::bucketValue(unsigned int index)
+{
+    const uint64_t subBuckets = (uint64_t)1 << HIST_SUB_BITS;
+
+    if (index < subBuckets)
+    {
+        return index;
+    }
+
+    unsigned int shift = (index >> HIST_SUB_BITS) - 1;
+    uint64_t sub = index & (subBuckets - 1);
+    uint64_t low = (subBuckets + sub) << shift;
+
+    return (int64_t)(low + ((uint64_t)1 << shift) - 1);
+}
+
+/*
+ *  latencyHistogram::record
+ * 
+ * Relaxed atomics throughout. There is no ordering to preserve between the
+ * counters, only each counter's own consistency.
+ */
+void latencyHistogram::record(int64_t ns)
+{
+    if (ns < 0)
+    {
+        ns = 0;
+    }
+
+    buckets[bucketIndex((uint64_t)ns)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(ns, std::memory_order_relaxed);
+
+    int64_t currentMax = maximum.load(std::memory_order_relaxed);
+    while ((ns > currentMax) && 
+           !maximum.compare_exchange_weak(currentMax, ns, std::memory_order_relaxed))
+    {
+        //currentMax was reloaded by the failed exchange
+    }
+}
+
+/*
+ *  latencyHistogram::reset
+ * 
+ * Not atomic as a whole, samples recorded while resetting may be partly lost
+ */
+void latencyHistogram::reset()
+{
+    for (unsigned int i = 0; i < HIST_BUCKETS; i++)
+    {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+/*
+ *  latencyHistogram::getSummary
+ * 
+ * Two passes over the buckets: one to count (so that the percentiles are 
+ * consistent with the buckets, whatever total says) and one to find the 
+ * percentiles.
+ */
+histogramSummary latencyHistogram::getSummary() const
+{
+    histogramSummary summary;
+    uint64_t count = 0;
+
+    for (unsigned int i = 0; i < HIST_BUCKETS; i++)
+    {
+        count += buckets[i].load(std::memory_order_relaxed);
+    }
+    summary.count = count;
+    if (0 == count)
+    {
+        return summary;
+    }
+
+    //Rank of each percentile, rounded up
+    const uint64_t rank50  = (count * 500  + 999)  / 1000;
+    const uint64_t rank99  = (count * 990  + 999)  / 1000;
+    const uint64_t rank999 = (count * 9990 + 9999) / 10000;
+
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < HIST_BUCKETS; i++)
+    {
+        uint64_t inBucket = buckets[i].load(std::memory_order_relaxed);
+        if (0 == inBucket)
+        {
+            continue;
+        }
+        uint64_t before = seen;
+        seen += inBucket;
+        if ((before < rank50) && (seen >= rank50))
+        {
+            summary.p50 = bucketValue(i);
+        }
+        if ((before < rank99) && (seen >= rank99))
+        {
+            summary.p99 = bucketValue(i);
+        }
+        if ((before < rank999) && (seen >= rank999))
+        {
+            summary.p999 = bucketValue(i);
+        }
+    }
+
+    summary.max  = maximum.load(std::memory_order_relaxed);
+    summary.mean = (double)sum.load(std::memory_order_relaxed) / count;
+
+    //The exact maximum is known, no percentile can be above it
+    if (summary.p50 > summary.max)
+    {
+        summary.p50 = summary.max;
+    }
+    if (summary.p99 > summary.max)
+    {
+        summary.p99 = summary.max;
+    }
+    if (summary.p999 > summary.max)
+    {
+        summary.p999 = summary.max;
+    }
+    return summary;
+}
+
+/*
+ *  histogramSummary::print
+ */
+void histogramSummary::print(std::ostream& dest) const
+{
+    std::ios_base::fmtflags flags = dest.flags();
+
+    dest << std::fixed << std::setprecision(1)
+         << "p50 "    << std::setw(9) << p50  / 1000.0 
+         << "  p99 "  << std::setw(9) << p99  / 1000.0
+         << "  p99.9 "<< std::setw(9) << p999 / 1000.0
+         << "  max "  << std::setw(9) << max  / 1000.0 << " us"
+         << "  (" << count << " samples)";
+    dest.flags(flags);
+}
@@ -0,0 +1,224 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include <chrono>
+#include <cstring>
+#include <type_traits>
+#include "include/MCIS_journal.h"
+#include "include/MCIS_util.h"
+
+
+static_assert(std::is_trivially_copyable<journalEvent>::value, 
+              "journal events are written as they are in memory");
+
+
+/*
+ *  eventJournal constructor
+ * 
+ * The header goes out right away, so that even an empty journal says when
+ * the session started
+ */
+eventJournal::eventJournal(const std::string& file_prefix)
+    :   path{nextFreeFilename(file_prefix, ".jnl")}
+{
+    outfile.open(path, std::ios::binary);
+    if (!outfile)
+    {
+        return;
+    }
+
+    journalHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.event_size = sizeof(journalEvent);
+    header.start_monotonic = monotonicNs();
+    header.start_realtime = realtimeNs();
+    outfile.write((const char *)&header, sizeof(header));
+    outfile.flush();
+
+    writer = std::thread(&eventJournal::writer_func, this);
+}
+
+eventJournal::~eventJournal()
+{
+    stop();
+}
+
+/*
+ *  eventJournal::log
+ * 
+ * Nothing here can block. Without a file, events are dropped.
+ */
+bool eventJournal::log(journal_event_type type, uint32_t a, uint32_t b, int64_t c)
+{
+    journalEvent event;
+    event.time = monotonicNs();
+    event.type = type;
+    event.a = a;
+    event.b = b;
+    event.reserved = 0;
+    event.c = c;
+
+    if (!writer.joinable() || !ring.push(event))
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void eventJournal::write_event(const journalEvent& event)
+{
+    outfile.write((const char *)&event, sizeof(event));
+    written.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ *  eventJournal::writer_func
+ * 
+ * Same as asyncMDAlog's: drain, flush, nap, and drain once more when 
+ * stopped. Then the JOURNAL_STOP event, straight to the file.
+ */
+void eventJournal::writer_func()
+{
+    journalEvent event;
+
+    while (running.load(std::memory_order_acquire))
+    {
+        bool any = false;
+        while (ring.pop(event))
+        {
+            write_event(event);
+            any = true;
+        }
+        if (any)
+        {
+            outfile.flush();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(JOURNAL_WRITER_SLEEP_MS));
+    }
+
+    while (ring.pop(event))
+    {
+        write_event(event);
+    }
+
+    std::memset(&event, 0, sizeof(event));
+    event.time = monotonicNs();
+    event.type = JOURNAL_STOP;
+    event.c = (int64_t)dropped.load(std::memory_order_relaxed);
+    write_event(event);
+    outfile.flush();
+}
+
+/*
+ *  eventJournal::stop
+ * 
+ * The producer must be done logging before this is called
+ */
+void eventJournal::stop()
+{
+    running.store(false, std::memory_order_release);
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+}
+
+bool eventJournal::isOpen() const
+{
+    return outfile.is_open();
+}
+
+const std::string& eventJournal::getPath() const
+{
+    return path;
+}
+
+uint64_t eventJournal::get_written() const
+{
+    return written.load(std::memory_order_relaxed);
+}
+
+uint64_t eventJournal::get_dropped() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+const char *eventJournal::eventName(journal_event_type type)
+{
+    switch (type)
+    {
+        case JOURNAL_START:
+            return "Start";
+        case JOURNAL_STATE:
+            return "State";
+        case JOURNAL_USER_COMMAND:
+            return "User command";
+        case JOURNAL_MB_STATE:
+            return "MB state";
+        case JOURNAL_LATCHED_FAULT:
+            return "Latched fault";
+        case JOURNAL_DISCRETE_IO:
+            return "Discrete IO";
+        case JOURNAL_REPLY_TIMEOUT:
+            return "Reply timeout";
+        case JOURNAL_STOP:
+            return "Stop";
+        case JOURNAL_EVENT_TYPES:
+            break;
+    }
+    return "Unknown";
+}
+
+/*
+ *  eventJournal::load
+ */
+bool eventJournal::load(const std::string& path, journalHeader& header, 
+                        std::vector<journalEvent>& events)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.read((char *)&header, sizeof(header)))
+    {
+        return false;
+    }
+    if (std::memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) ||
+        (header.version != JOURNAL_VERSION) ||
+        (header.event_size != sizeof(journalEvent)))
+    {
+        return false;
+    }
+
+    events.clear();
+    journalEvent event;
+    while (in.read((char *)&event, sizeof(event)))
+    {
+        events.push_back(event);
+    }
+    return true;
+}
@@ -0,0 +1,173 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+#include <chrono>
+#include <cmath>
+#include "include/MCIS_logger.h"
+#include "include/MCIS_fileio.h"
+
+
+
+/*
+ *  asyncMDAlog constructor
+ */
+asyncMDAlog::asyncMDAlog(std::ostream& out)
+    :   outfile{&out},
+        running{true},
+        written{0},
+        dropped{0}
+{
+    writer = std::thread(&asyncMDAlog::writer_func, this);
+}
+
+asyncMDAlog::~asyncMDAlog()
+{
+    stop();
+}
+
+/*
+ *  asyncMDAlog::log
+ * 
+ * Copy the values into a record and queue it. Nothing here can block.
+ */
+bool asyncMDAlog::log(const MCISvector& acc_in, const MCISvector& angv_in, const MCISvector& att_in,
+                      const MCISvector& pos_out, const MCISvector& ang_out,
+                      int64_t input_to_output, int64_t mb_rtt,
+                      const trackingStatus& tracking)
+{
+    mdaLogRecord record;
+
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        record.acc_in[i]  = acc_in[i];
+        record.angv_in[i] = angv_in[i];
+        record.att_in[i]  = att_in[i];
+        record.pos_out[i] = pos_out[i];
+        record.ang_out[i] = ang_out[i];
+    }
+    record.input_to_output = input_to_output;
+    record.mb_rtt = mb_rtt;
+    for (unsigned int i = 0; i < TRACKING_AXES; i++)
+    {
+        record.feedback[i]    = tracking.feedback[i];
+        record.delay_valid[i] = tracking.axes[i].delay_valid;
+        record.delay[i]       = tracking.axes[i].delay;
+        record.error_rms[i]   = tracking.axes[i].error_rms;
+    }
+
+    if (!ring.push(record))
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+/*
+ *  asyncMDAlog::write_record
+ * 
+ * Back to vectors and through write_MDA_log, with the latencies in us and
+ * the tracking delays in ms
+ */
+void asyncMDAlog::write_record(const mdaLogRecord& record)
+{
+    MCISvector acc_in{record.acc_in[0], record.acc_in[1], record.acc_in[2]};
+    MCISvector angv_in{record.angv_in[0], record.angv_in[1], record.angv_in[2]};
+    MCISvector att_in{record.att_in[0], record.att_in[1], record.att_in[2]};
+    MCISvector pos_out{record.pos_out[0], record.pos_out[1], record.pos_out[2]};
+    MCISvector ang_out{record.ang_out[0], record.ang_out[1], record.ang_out[2]};
+
+    //Tracking figures go in as position and angle triplets, delays in ms,
+    //NaN where there is no estimate
+    double delay_ms[TRACKING_AXES];
+    for (unsigned int i = 0; i < TRACKING_AXES; i++)
+    {
+        delay_ms[i] = record.delay_valid[i] ? record.delay[i] / 1e6 : NAN;
+    }
+    MCISvector pos_fb{record.feedback[0], record.feedback[1], record.feedback[2]};
+    MCISvector ang_fb{record.feedback[3], record.feedback[4], record.feedback[5]};
+    MCISvector pos_delay{delay_ms[0], delay_ms[1], delay_ms[2]};
+    MCISvector ang_delay{delay_ms[3], delay_ms[4], delay_ms[5]};
+    MCISvector pos_error{record.error_rms[0], record.error_rms[1], record.error_rms[2]};
+    MCISvector ang_error{record.error_rms[3], record.error_rms[4], record.error_rms[5]};
+
+    write_MDA_log(*outfile, acc_in, angv_in, att_in, pos_out, ang_out,
+                  record.input_to_output / 1000.0, record.mb_rtt / 1000.0,
+                  pos_fb, ang_fb, pos_delay, ang_delay, pos_error, ang_error);
+    written.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ *  asyncMDAlog::writer_func
+ * 
+ * Drain the ring, then nap. Once stopped, drain it one last time, since the
+ * producer may have pushed something between the last pop and the stop.
+ */
+void asyncMDAlog::writer_func()
+{
+    mdaLogRecord record;
+
+    while (running.load(std::memory_order_acquire))
+    {
+        while (ring.pop(record))
+        {
+            write_record(record);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(MDA_LOG_WRITER_SLEEP_MS));
+    }
+
+    while (ring.pop(record))
+    {
+        write_record(record);
+    }
+    outfile -> flush();
+}
+
+/*
+ *  asyncMDAlog::stop
+ * 
+ * The producer must be done logging before this is called
+ */
+void asyncMDAlog::stop()
+{
+    running.store(false, std::memory_order_release);
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+}
+
+uint64_t asyncMDAlog::get_written() const
+{
+    return written.load(std::memory_order_relaxed);
+}
+
+uint64_t asyncMDAlog::get_dropped() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
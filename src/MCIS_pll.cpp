@@ -0,0 +1,167 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+
+#include <cmath>
+#include <algorithm>
+#include "include/MCIS_pll.h"
+
+/*
+ *  framePLL constructor
+ */
+framePLL::framePLL(int64_t nominal_period_ns, int64_t offset_ns) :
+                   nominalPeriod{nominal_period_ns},
+                   offset{offset_ns},
+                   tickPeriod{nominal_period_ns}
+{
+}
+
+/*
+ *  framePLL::arrival
+ * 
+ * Step 1: track the arrival phase and the message period.
+ */
+void framePLL::arrival(uint64_t sequence, int64_t recvTime)
+{
+    if (sequence == lastSequence)
+    {
+        return;
+    }
+
+    if ((arrivals > 0) && (sequence > lastSequence))
+    {
+        double steps = (double)(sequence - lastSequence);
+        if (messagePeriod <= 0)
+        {
+            //Second message, first guess at the period
+            messagePeriod = (recvTime - lastArrival) / steps;
+            predictedArrival = recvTime;
+        }
+        else
+        {
+            double predicted = predictedArrival + steps * messagePeriod;
+            double error = recvTime - predicted;
+            if (std::fabs(error) > messagePeriod / 2)
+            {
+                //Lost track, start over from here
+                arrivals = 0;
+                messagePeriod = 0;
+                predictedArrival = recvTime;
+            }
+            else
+            {
+                predictedArrival = predicted + PLL_ALPHA * error;
+                messagePeriod   += PLL_BETA * error / steps;
+            }
+        }
+    }
+    else
+    {
+        predictedArrival = recvTime;
+    }
+
+    arrivals++;
+    lastSequence = sequence;
+    lastArrival  = recvTime;
+}
+
+/*
+ *  framePLL::update
+ * 
+ * Steps 2 to 4.
+ */
+int64_t framePLL::update(int64_t next_deadline, int64_t now)
+{
+    // 4) Lost the messages
+    if ((arrivals < PLL_MIN_ARRIVALS) || (now - lastArrival > PLL_TIMEOUT_NS) ||
+        (messagePeriod <= 0))
+    {
+        locked = false;
+        tickPeriod = nominalPeriod;
+        phaseError = 0;
+        return 0;
+    }
+
+    // 2) Whole-number ratio, either way round
+    double period;
+    if (messagePeriod >= nominalPeriod)
+    {
+        double ticksPerMessage = std::round(messagePeriod / nominalPeriod);
+        period = messagePeriod / ticksPerMessage;
+    }
+    else
+    {
+        double messagesPerTick = std::round(nominalPeriod / messagePeriod);
+        period = messagePeriod * messagesPerTick;
+    }
+
+    if (std::fabs(period - nominalPeriod) * 100 > nominalPeriod * PLL_MAX_RATE_PERCENT)
+    {
+        locked = false;
+        tickPeriod = nominalPeriod;
+        phaseError = 0;
+        return 0;
+    }
+    locked = true;
+    tickPeriod = (int64_t)std::llround(period);
+
+    // 3) Phase error, wrapped to [-period/2, period/2)
+    int64_t error = (next_deadline - ((int64_t)predictedArrival + offset)) % tickPeriod;
+    if (error < 0)
+    {
+        error += tickPeriod;
+    }
+    if (error >= tickPeriod / 2)
+    {
+        error -= tickPeriod;
+    }
+    phaseError = error;
+
+    int64_t step = (int64_t)std::llround(-PLL_GAIN * error);
+    return std::max(std::min(step, (int64_t)PLL_MAX_STEP_NS), -(int64_t)PLL_MAX_STEP_NS);
+}
+
+bool framePLL::isLocked() const
+{
+    return locked;
+}
+
+int64_t framePLL::getTickPeriod() const
+{
+    return tickPeriod;
+}
+
+int64_t framePLL::getMessagePeriod() const
+{
+    return (int64_t)messagePeriod;
+}
+
+int64_t framePLL::getPhaseError() const
+{
+    return phaseError;
+}
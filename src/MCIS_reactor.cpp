@@ -0,0 +1,586 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+#include "include/MCIS_reactor.h"
+#include "include/MCIS_util.h"
+
+//epoll tags for the reactor's own fds. Sources are tagged with their index.
+#define REACTOR_TAG_TIMER   (REACTOR_MAX_SOURCES)
+#define REACTOR_TAG_WAKE    (REACTOR_MAX_SOURCES + 1)
+
+
+/*
+ *  ioReactor constructor
+ * 
+ * Sets up the io_uring, if asked for, or else the epoll set, with the 
+ * timerfd and the wake-up eventfd. The ring gets one request per fd and 
+ * room in the completion queue for every provided buffer. If any of it 
+ * can't be had, the reactor uses epoll, or poll() if that fails as well.
+ */
+ioReactor::ioReactor(net_backend backend)
+{
+#ifdef __linux__
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    wake_fd  = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+#ifdef MCIS_HAVE_URING
+    memset(&recvTemplate, 0, sizeof(recvTemplate));
+    recvTemplate.msg_controllen = RX_TIMESTAMP_CONTROL_SIZE;
+    if ((NET_URING == backend) && (timer_fd >= 0) && (wake_fd >= 0))
+    {
+        uring = ring.init(REACTOR_URING_BUFFERS) &&
+                ring.provideBuffers(0, REACTOR_URING_BUFFERS, REACTOR_URING_BUFFER_SIZE);
+    }
+#endif
+    if (!uring)
+    {
+        setupEpoll();
+    }
+#endif
+    (void)backend;
+}
+
+/*
+ *  ioReactor::setupEpoll
+ */
+bool ioReactor::setupEpoll()
+{
+#ifdef __linux__
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    bool ok = (epoll_fd >= 0) && (timer_fd >= 0) && (wake_fd >= 0);
+    if (ok)
+    {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = REACTOR_TAG_TIMER;
+        ok = (0 == epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev));
+        ev.data.u32 = REACTOR_TAG_WAKE;
+        ok = ok && (0 == epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev));
+    }
+    if (!ok && (epoll_fd >= 0))
+    {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+    return ok;
+#else
+    return false;
+#endif
+}
+
+ioReactor::~ioReactor()
+{
+    stop();
+    if (epoll_fd >= 0)
+    {
+        close(epoll_fd);
+    }
+    if (timer_fd >= 0)
+    {
+        close(timer_fd);
+    }
+    if (wake_fd >= 0)
+    {
+        close(wake_fd);
+    }
+}
+
+/*
+ *  ioReactor::watch
+ */
+bool ioReactor::watch(int fd, reactorHandler *handler)
+{
+    if (sourceCount >= REACTOR_MAX_SOURCES)
+    {
+        return false;
+    }
+#ifdef __linux__
+    if (epoll_fd >= 0)
+    {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = sourceCount;
+        if (0 != epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev))
+        {
+            return false;
+        }
+    }
+#endif
+    sourceFds[sourceCount] = fd;
+    sourceHandlers[sourceCount] = handler;
+    sourceDatagrams[sourceCount] = false;
+    sourceCount++;
+    return true;
+}
+
+/*
+ *  ioReactor::watchDatagrams
+ */
+bool ioReactor::watchDatagrams(int fd, reactorHandler *handler)
+{
+    if (!watch(fd, handler))
+    {
+        return false;
+    }
+    sourceDatagrams[sourceCount - 1] = uring;
+    return true;
+}
+
+/*
+ *  ioReactor::setTimerHandler
+ */
+void ioReactor::setTimerHandler(reactorHandler *handler)
+{
+    timerHandler = handler;
+}
+
+/*
+ *  ioReactor::armTimer
+ * 
+ * With epoll or io_uring, the deadline goes straight into the timerfd, 
+ * which either one watches. A zero it_value would disarm it, so deadlines 
+ * are clamped to 1 ns. With poll(), runPoll picks timerDeadline up on its 
+ * next wait.
+ */
+void ioReactor::armTimer(int64_t deadline)
+{
+    timerDeadline = deadline;
+#ifdef __linux__
+    if (timer_fd >= 0)
+    {
+        struct itimerspec spec;
+        spec.it_interval.tv_sec  = 0;
+        spec.it_interval.tv_nsec = 0;
+        if ((deadline != 0) && (deadline < 1))
+        {
+            deadline = 1;
+        }
+        spec.it_value.tv_sec  = deadline / 1000000000;
+        spec.it_value.tv_nsec = deadline % 1000000000;
+        timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+#endif
+}
+
+/*
+ *  ioReactor::start
+ * 
+ * Spawns the thread
+ */
+void ioReactor::start()
+{
+    if (running)
+    {
+        return;
+    }
+    running = true;
+
+    if (uring)
+    {
+        reactorThread = std::thread(&ioReactor::runUring, this);
+        return;
+    }
+#ifdef __linux__
+    if (epoll_fd >= 0)
+    {
+        reactorThread = std::thread(&ioReactor::runEpoll, this);
+        return;
+    }
+#endif
+    reactorThread = std::thread(&ioReactor::runPoll, this);
+}
+
+/*
+ *  ioReactor::stop
+ */
+void ioReactor::stop()
+{
+    if (!running)
+    {
+        return;
+    }
+    running = false;
+
+    if (wake_fd >= 0)
+    {
+        uint64_t one = 1;
+        ssize_t bytes = write(wake_fd, &one, sizeof(one));
+        (void)bytes;
+    }
+    reactorThread.join();
+}
+
+/*
+ *  ioReactor::runEpoll
+ * 
+ * Theory of operation:
+ * 
+ * 1) epoll_wait with no timeout, retrying on EINTR. The timer and stop() 
+ *      both show up as events.
+ * 2) Hand each readable source to its handler.
+ * 3) On a timer event, drain the timerfd, disarm and call the timer handler,
+ *      which may arm it again.
+ * 4) Go again until stop() clears running.
+ */
+void ioReactor::runEpoll()
+{
+#ifdef __linux__
+    struct epoll_event events[REACTOR_MAX_SOURCES + 2];
+
+    while (running)
+    {
+        // 1) Wait
+        wakeupAudit.begin();
+        int count = epoll_wait(epoll_fd, events, REACTOR_MAX_SOURCES + 2, -1);
+        if (count < 0)
+        {
+            wakeupAudit.end(false);
+            continue;
+        }
+        wakeups++;
+
+        for (int i = 0; (i < count) && running; i++)
+        {
+            uint32_t tag = events[i].data.u32;
+            // 2) Sources
+            if (tag < sourceCount)
+            {
+                sourceHandlers[tag]->onReadable(sourceFds[tag]);
+            }
+            // 3) Timer
+            else if (REACTOR_TAG_TIMER == tag)
+            {
+                uint64_t expirations;
+                ssize_t bytes = read(timer_fd, &expirations, sizeof(expirations));
+                if ((bytes == sizeof(expirations)) && timerHandler)
+                {
+                    timerDeadline = 0;
+                    timerHandler->onTimer(monotonicNs());
+                }
+            }
+            //The wake-up eventfd needs no handling, running is already false
+        }
+        wakeupAudit.end();
+    }
+#endif
+}
+
+/*
+ *  ioReactor::armUring
+ * 
+ * Datagram sources get a multishot recvmsg into the provided buffers, the
+ * rest a multishot poll. The tag goes in user_data.
+ */
+void ioReactor::armUring(uint32_t tag)
+{
+#ifdef MCIS_HAVE_URING
+    io_uring_sqe *sqe = ring.getSqe();
+    if (!sqe)
+    {
+        return;
+    }
+    sqe->user_data = tag;
+    if ((tag < sourceCount) && sourceDatagrams[tag])
+    {
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = sourceFds[tag];
+        sqe->addr = (uint64_t)(uintptr_t)&recvTemplate;
+        sqe->len = 1;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = 0;
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->poll32_events = POLLIN;
+    if (tag < sourceCount)
+    {
+        sqe->fd = sourceFds[tag];
+    }
+    else if (REACTOR_TAG_TIMER == tag)
+    {
+        sqe->fd = timer_fd;
+    }
+    else
+    {
+        sqe->fd = wake_fd;
+    }
+#else
+    (void)tag;
+#endif
+}
+
+/*
+ *  ioReactor::runUring
+ * 
+ * Theory of operation:
+ * 
+ * 1) Arm every source, the timer and the wake-up eventfd, once
+ * 2) Submit whatever needs (re)arming and sleep in io_uring_enter until at
+ *      least one completion is in
+ * 3) For each completion:
+ *      - A datagram: hand it to the handler, give the buffer back
+ *      - A readable source: onReadable, as with epoll
+ *      - The timer: drain the timerfd, disarm, call the timer handler
+ *      - The wake-up eventfd: nothing, running is already false
+ *      If the multishot request is over (no IORING_CQE_F_MORE), arm it 
+ *      again. Running out of buffers or being interrupted ends one for 
+ *      good reason, anything else means multishot receive doesn't work on
+ *      that fd, which is then handed to onReadable instead.
+ * 4) onDatagramsDone for each source that got datagrams
+ * 5) Go again until stop() clears running
+ */
+void ioReactor::runUring()
+{
+#ifdef MCIS_HAVE_URING
+    // 1) Arm
+    for (uint32_t tag = 0; tag < sourceCount; tag++)
+    {
+        armUring(tag);
+    }
+    armUring(REACTOR_TAG_TIMER);
+    armUring(REACTOR_TAG_WAKE);
+
+    while (running)
+    {
+        // 2) Wait
+        wakeupAudit.begin();
+        int ret = ring.submit(1);
+        if ((ret < 0) && (-EINTR != ret) && (-EBUSY != ret))
+        {
+            wakeupAudit.end(false);
+            continue;
+        }
+        wakeups++;
+
+        // 3) Completions
+        uint32_t gotDatagrams = 0;
+        io_uring_cqe *cqe;
+        while (running && (cqe = ring.peekCqe()))
+        {
+            uint32_t tag = (uint32_t)cqe->user_data;
+            int res = cqe->res;
+            uint32_t flags = cqe->flags;
+            ring.seenCqe();
+
+            if ((tag < sourceCount) && sourceDatagrams[tag])
+            {
+                if (flags & IORING_CQE_F_BUFFER)
+                {
+                    unsigned id = flags >> IORING_CQE_BUFFER_SHIFT;
+                    deliverDatagram(tag, ring.getBuffer(id), res);
+                    ring.recycleBuffer(id);
+                    gotDatagrams |= 1u << tag;
+                }
+                else if ((res < 0) && (-ENOBUFS != res) && (-EINTR != res) && 
+                         (-EAGAIN != res))
+                {
+                    sourceDatagrams[tag] = false;
+                }
+            }
+            else if ((tag < sourceCount) && (res > 0))
+            {
+                sourceHandlers[tag]->onReadable(sourceFds[tag]);
+            }
+            else if (REACTOR_TAG_TIMER == tag)
+            {
+                uint64_t expirations;
+                ssize_t bytes = read(timer_fd, &expirations, sizeof(expirations));
+                if ((bytes == sizeof(expirations)) && timerHandler)
+                {
+                    timerDeadline = 0;
+                    timerHandler->onTimer(monotonicNs());
+                }
+            }
+
+            if (!(flags & IORING_CQE_F_MORE))
+            {
+                armUring(tag);
+            }
+        }
+
+        // 4) End of the burst
+        for (uint32_t tag = 0; tag < sourceCount; tag++)
+        {
+            if (gotDatagrams & (1u << tag))
+            {
+                sourceHandlers[tag]->onDatagramsDone(sourceFds[tag]);
+            }
+        }
+        wakeupAudit.end();
+    }
+#endif
+}
+
+/*
+ *  ioReactor::deliverDatagram
+ * 
+ * A multishot recvmsg lays each buffer out as an io_uring_recvmsg_out, 
+ * then the space recvTemplate reserves for the address and the control 
+ * messages, then the datagram. One that didn't fit is cut short, so its 
+ * length is what is there.
+ */
+void ioReactor::deliverDatagram(uint32_t tag, const unsigned char *buffer, int res)
+{
+#ifdef MCIS_HAVE_URING
+    io_uring_recvmsg_out out;
+    size_t headerSize = sizeof(out) + recvTemplate.msg_namelen + recvTemplate.msg_controllen;
+    if ((res < 0) || ((size_t)res < headerSize))
+    {
+        return;
+    }
+    memcpy(&out, buffer, sizeof(out));
+
+    struct msghdr control;
+    memset(&control, 0, sizeof(control));
+    control.msg_control = (void *)(buffer + sizeof(out) + recvTemplate.msg_namelen);
+    control.msg_controllen = out.controllen;
+    int64_t rxTime = rxTimestampNs(&control);
+    if (0 == rxTime)
+    {
+        rxTime = monotonicNs();
+    }
+
+    int length = res - (int)headerSize;
+    if (out.payloadlen < (uint32_t)length)
+    {
+        length = (int)out.payloadlen;
+    }
+    sourceHandlers[tag]->onDatagram(sourceFds[tag], buffer + headerSize, length, rxTime);
+#else
+    (void)tag;
+    (void)buffer;
+    (void)res;
+#endif
+}
+
+/*
+ *  ioReactor::runPoll
+ * 
+ * Same as runEpoll, with poll(). The timer is the poll timeout, rounded up
+ * to ms. If the wake-up eventfd is missing, the timeout is at most 100 ms,
+ * which is then how long stop() may take.
+ */
+void ioReactor::runPoll()
+{
+    const int64_t maxWait = 100000000;
+    struct pollfd fds[REACTOR_MAX_SOURCES + 1];
+    nfds_t fdCount = sourceCount;
+
+    for (unsigned int i = 0; i < sourceCount; i++)
+    {
+        fds[i].fd = sourceFds[i];
+        fds[i].events = POLLIN;
+    }
+    if (wake_fd >= 0)
+    {
+        fds[fdCount].fd = wake_fd;
+        fds[fdCount].events = POLLIN;
+        fdCount++;
+    }
+
+    while (running)
+    {
+        int64_t now = monotonicNs();
+        int timeoutMs = -1;
+        if (timerDeadline)
+        {
+            timeoutMs = (timerDeadline > now) ? (int)((timerDeadline - now + 999999) / 1000000) : 0;
+        }
+        if ((wake_fd < 0) && ((timeoutMs < 0) || (timeoutMs > maxWait / 1000000)))
+        {
+            timeoutMs = maxWait / 1000000;
+        }
+        wakeupAudit.begin();
+        int count = poll(fds, fdCount, timeoutMs);
+        wakeups++;
+
+        for (unsigned int i = 0; (count > 0) && (i < sourceCount) && running; i++)
+        {
+            if (fds[i].revents & POLLIN)
+            {
+                sourceHandlers[i]->onReadable(sourceFds[i]);
+            }
+        }
+
+        now = monotonicNs();
+        if (timerDeadline && (now >= timerDeadline) && running)
+        {
+            timerDeadline = 0;
+            if (timerHandler)
+            {
+                timerHandler->onTimer(now);
+            }
+        }
+        wakeupAudit.end();
+    }
+}
+
+/*
+ *  ioReactor::usesEpoll
+ */
+bool ioReactor::usesEpoll() const
+{
+    return epoll_fd >= 0;
+}
+
+/*
+ *  ioReactor::usesUring
+ */
+bool ioReactor::usesUring() const
+{
+    return uring;
+}
+
+/*
+ *  ioReactor::getWakeups
+ */
+uint64_t ioReactor::getWakeups() const
+{
+    return wakeups;
+}
+
+auditReport ioReactor::getAuditReport() const
+{
+    return wakeupAudit.getReport();
+}
+
+void ioReactor::resetAudit()
+{
+    wakeupAudit.reset();
+}
@@ -0,0 +1,267 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include "include/MCIS_recorder.h"
+#include "include/MCIS_util.h"
+
+
+static_assert(std::is_trivially_copyable<flightRecord>::value, 
+              "flight records are copied and dumped as they are in memory");
+
+
+/*
+ *  flightRecorder constructor
+ */
+flightRecorder::flightRecorder(const std::string& file_prefix)
+    :   prefix{file_prefix}
+{
+    status.store(flightRecorderStatus());
+    dumper = std::thread(&flightRecorder::dumper_func, this);
+}
+
+flightRecorder::~flightRecorder()
+{
+    stop();
+}
+
+/*
+ *  flightRecorder::record
+ * 
+ * Copy rec into the next slot, unless the ring is frozen for a dump. Once
+ * a trigger has had its FLIGHT_RECORDER_POST_TRIGGER records, freeze it.
+ */
+void flightRecorder::record(const flightRecord& rec)
+{
+    ring_state current = state.load(std::memory_order_acquire);
+    if (FROZEN == current)
+    {
+        missed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t n = recorded.load(std::memory_order_relaxed);
+    ring[n % FLIGHT_RECORDER_RECORDS] = rec;
+    recorded.store(n + 1, std::memory_order_release);
+
+    if ((TRIGGERED == current) && (n + 1 >= freeze_at))
+    {
+        state.store(FROZEN, std::memory_order_release);
+    }
+}
+
+/*
+ *  flightRecorder::trigger
+ * 
+ * The trigger's details are written before the state, and the dump thread 
+ * only reads them once it sees the ring frozen, which comes later still
+ */
+void flightRecorder::trigger(flight_trigger reason, uint32_t status_at_trigger, int64_t now)
+{
+    if (RECORDING != state.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    freeze_at = recorded.load(std::memory_order_relaxed) + FLIGHT_RECORDER_POST_TRIGGER;
+    trigger_reason = reason;
+    trigger_status = status_at_trigger;
+    trigger_time = now;
+    state.store(TRIGGERED, std::memory_order_release);
+}
+
+/*
+ *  flightRecorder::dumper_func
+ * 
+ * Wait for a frozen ring, dump it and hand it back
+ */
+void flightRecorder::dumper_func()
+{
+    while (running.load(std::memory_order_acquire))
+    {
+        if (FROZEN == state.load(std::memory_order_acquire))
+        {
+            std::string path;
+            dump_ring(trigger_reason, trigger_status, trigger_time, path);
+            state.store(RECORDING, std::memory_order_release);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(FLIGHT_RECORDER_POLL_MS));
+    }
+
+    if (FROZEN == state.load(std::memory_order_acquire))
+    {
+        std::string path;
+        dump_ring(trigger_reason, trigger_status, trigger_time, path);
+        state.store(RECORDING, std::memory_order_release);
+    }
+}
+
+/*
+ *  flightRecorder::dump_ring
+ * 
+ * Pick the first <prefix><n>.bin that doesn't exist yet, the way the MDA 
+ * log picks its file, and write the ring there
+ */
+bool flightRecorder::dump_ring(flight_trigger reason, uint32_t status_at_trigger, int64_t time,
+                               std::string& path)
+{
+    path = nextFreeFilename(prefix, ".bin");
+
+    bool ok = write_ring(path, reason, status_at_trigger, time);
+
+    flightRecorderStatus current = status.load();
+    current.dumps++;
+    if (!ok)
+    {
+        current.failed++;
+    }
+    current.last_trigger = reason;
+    std::strncpy(current.last_path, path.c_str(), FLIGHT_RECORDER_PATH_LEN - 1);
+    current.last_path[FLIGHT_RECORDER_PATH_LEN - 1] = '\0';
+    status.store(current);
+    return ok;
+}
+
+/*
+ *  flightRecorder::write_ring
+ * 
+ * Header, then whatever the ring holds, oldest first
+ */
+bool flightRecorder::write_ring(const std::string& path, flight_trigger reason, 
+                                uint32_t status_at_trigger, int64_t time)
+{
+    uint64_t total = recorded.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>(total, FLIGHT_RECORDER_RECORDS);
+
+    flightRecordingHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, FLIGHT_RECORDER_MAGIC, sizeof(header.magic));
+    header.version = FLIGHT_RECORDER_VERSION;
+    header.record_size = sizeof(flightRecord);
+    header.records = count;
+    header.trigger = reason;
+    header.trigger_status = status_at_trigger;
+    header.trigger_time = time;
+    header.recorded = total;
+    header.missed = missed.load(std::memory_order_relaxed);
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        return false;
+    }
+    out.write((const char *)&header, sizeof(header));
+    for (uint64_t i = total - count; i < total; i++)
+    {
+        out.write((const char *)&ring[i % FLIGHT_RECORDER_RECORDS], sizeof(flightRecord));
+    }
+    out.flush();
+    return out.good();
+}
+
+/*
+ *  flightRecorder::stop
+ */
+void flightRecorder::stop()
+{
+    running.store(false, std::memory_order_release);
+    if (dumper.joinable())
+    {
+        dumper.join();
+    }
+}
+
+/*
+ *  flightRecorder::dump
+ * 
+ * With the dump thread gone, the ring is ours
+ */
+std::string flightRecorder::dump(flight_trigger reason)
+{
+    std::string path;
+    if (!dump_ring(reason, 0, 0, path))
+    {
+        return "";
+    }
+    return path;
+}
+
+flightRecorderStatus flightRecorder::getStatus() const
+{
+    return status.load();
+}
+
+uint64_t flightRecorder::getRecorded() const
+{
+    return recorded.load(std::memory_order_relaxed);
+}
+
+const char *flightRecorder::triggerName(flight_trigger reason)
+{
+    switch (reason)
+    {
+        case TRIGGER_NONE:
+            return "None";
+        case TRIGGER_MB_FAULT:
+            return "MB fault";
+        case TRIGGER_MB_RECOVERABLE_FAULT:
+            return "MB recoverable fault";
+        case TRIGGER_SHUTDOWN:
+            return "Shutdown";
+    }
+    return "Unknown";
+}
+
+/*
+ *  flightRecorder::load
+ */
+bool flightRecorder::load(const std::string& path, flightRecordingHeader& header, 
+                          std::vector<flightRecord>& records)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.read((char *)&header, sizeof(header)))
+    {
+        return false;
+    }
+    if (std::memcmp(header.magic, FLIGHT_RECORDER_MAGIC, sizeof(header.magic)) ||
+        (header.version != FLIGHT_RECORDER_VERSION) ||
+        (header.record_size != sizeof(flightRecord)) ||
+        (header.records > FLIGHT_RECORDER_RECORDS))
+    {
+        return false;
+    }
+    records.resize(header.records);
+    if (header.records && 
+        !in.read((char *)records.data(), header.records * sizeof(flightRecord)))
+    {
+        return false;
+    }
+    return true;
+}
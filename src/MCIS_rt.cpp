@@ -0,0 +1,699 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <sys/epoll.h>
+#endif
+#include "include/MCIS_rt.h"
+#include "include/MCIS_util.h"
+
+
+
+/*
+ *  prefaultStack
+ * 
+ * Touch one byte per page of a large stack frame, so that those pages are 
+ * mapped (and, after mlockall, locked) before they are needed.
+ * Must not be inlined, or the frame could be merged into the caller's.
+ */
+static void __attribute__((noinline)) prefaultStack()
+{
+    volatile unsigned char stack[RT_PREFAULT_STACK_BYTES];
+    long pageSize = sysconf(_SC_PAGESIZE);
+
+    if (pageSize <= 0)
+    {
+        pageSize = 4096;
+    }
+    for (unsigned long i = 0; i < sizeof(stack); i += pageSize)
+    {
+        stack[i] = 0;
+    }
+}
+
+/*
+ *  timespecAddNs
+ * 
+ * Add a non-negative number of nanoseconds to a timespec, keeping it 
+ * normalized
+ */
+static void timespecAddNs(struct timespec& ts, int64_t ns)
+{
+    const int64_t billion = 1000000000;
+
+    int64_t nsec = ts.tv_nsec + ns;
+    ts.tv_sec  += nsec / billion;
+    ts.tv_nsec  = nsec % billion;
+}
+
+/*
+ *  timespecNs
+ */
+static int64_t timespecNs(const struct timespec& ts)
+{
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ *  nsTimespec
+ */
+static struct timespec nsTimespec(int64_t ns)
+{
+    struct timespec ts;
+    ts.tv_sec  = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    return ts;
+}
+
+
+
+
+
+/*
+ *  rtTicker constructor
+ * 
+ * Nothing is applied until start()
+ */
+rtTicker::rtTicker(const rtTimingConfig& rt_config, int64_t period_ns)
+    :   config(rt_config),
+        period{period_ns}
+{
+    nextDeadline.tv_sec  = 0;
+    nextDeadline.tv_nsec = 0;
+}
+
+rtTicker::~rtTicker()
+{
+    if (timer_fd >= 0)
+    {
+        close(timer_fd);
+    }
+}
+
+/*
+ *  rtTicker::applyThreadSettings
+ * 
+ * Apply every requested setting to the calling thread (and process, for
+ * mlockall). Each one is independent, failing one doesn't stop the rest.
+ */
+void rtTicker::applyThreadSettings()
+{
+    //Lock memory first, so that the prefaulted stack stays put
+    if (config.lock_memory)
+    {
+        status.memory_locked = (0 == mlockall(MCL_CURRENT | MCL_FUTURE));
+    }
+
+    if (config.prefault_stack)
+    {
+        prefaultStack();
+        status.stack_prefaulted = true;
+    }
+
+#ifdef __linux__
+    if (config.cpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(config.cpu, &cpus);
+        if (0 == pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus))
+        {
+            status.cpu = config.cpu;
+        }
+    }
+#endif
+
+    if (config.fifo_priority > 0)
+    {
+        struct sched_param param;
+        int minPrio = sched_get_priority_min(SCHED_FIFO);
+        int maxPrio = sched_get_priority_max(SCHED_FIFO);
+
+        std::memset(&param, 0, sizeof(param));
+        param.sched_priority = config.fifo_priority;
+        if (param.sched_priority < minPrio)
+        {
+            param.sched_priority = minPrio;
+        }
+        if (param.sched_priority > maxPrio)
+        {
+            param.sched_priority = maxPrio;
+        }
+        //Typically EPERM without CAP_SYS_NICE or an RLIMIT_RTPRIO
+        if (0 == pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+        {
+            status.fifo_priority = param.sched_priority;
+        }
+    }
+}
+
+/*
+ *  rtTicker::startTimerfd
+ * 
+ * Arm a periodic timerfd with its first expiry at nextDeadline.
+ * Returns false if timerfds are not available, in which case the caller 
+ * falls back to clock_nanosleep.
+ */
+bool rtTicker::startTimerfd()
+{
+#ifdef __linux__
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer_fd < 0)
+    {
+        return false;
+    }
+
+    struct itimerspec spec;
+    spec.it_value = nextDeadline;
+    spec.it_interval.tv_sec  = period / 1000000000;
+    spec.it_interval.tv_nsec = period % 1000000000;
+    if (0 != timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr))
+    {
+        close(timer_fd);
+        timer_fd = -1;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+ *  rtTicker::start
+ * 
+ * Theory of operation:
+ * 
+ * 1) Apply the thread settings
+ * 2) Take the current time as the epoch, the first tick is one period later
+ * 3) Set up the requested clock, falling back from timerfd to 
+ *      clock_nanosleep if needed
+ */
+void rtTicker::start()
+{
+    // 1) Thread settings
+    applyThreadSettings();
+
+    // 2) Epoch
+    nextTick = std::chrono::steady_clock::now() + std::chrono::nanoseconds(period);
+    clock_gettime(CLOCK_MONOTONIC, &nextDeadline);
+    timespecAddNs(nextDeadline, period);
+
+    // 3) Clock
+    status.clock = config.clock;
+    if ((RT_CLOCK_TIMERFD == config.clock) && !startTimerfd())
+    {
+        status.clock = RT_CLOCK_NANOSLEEP;
+    }
+
+    status.started = true;
+}
+
+/*
+ *  rtTicker::wait
+ * 
+ * Block until the next tick is due. If it already is, return immediately
+ * and count the tick as missed. What happens to any further ticks that are
+ * also already due depends on the overrun policy:
+ * 
+ *  - RT_OVERRUN_CATCH_UP: nothing, so the next wait()s return at once until
+ *      the schedule is caught up with. For the timerfd, the extra expirations
+ *      are kept in pendingTicks for that.
+ *  - RT_OVERRUN_DROP: they are skipped here, by moving the deadline up to 
+ *      the last one already due (re-arming the timerfd, which also clears
+ *      its expirations).
+ */
+bool rtTicker::wait()
+{
+    int64_t now = monotonicNs();
+    int64_t deadline = getNextDeadline();
+    bool overrun = (now > deadline);
+
+    lastDropped = 0;
+    if (overrun)
+    {
+        missed++;
+        if (RT_OVERRUN_DROP == config.overrun)
+        {
+            lastDropped = (now - deadline) / period;
+            if (lastDropped > 0)
+            {
+                dropped += lastDropped;
+                pendingTicks = 0;
+                retime(period, lastDropped * period);
+            }
+        }
+    }
+
+    switch (status.clock)
+    {
+        case RT_CLOCK_TIMERFD:
+        {
+            if (pendingTicks > 0)
+            {
+                //An expiration already read, catching up
+                pendingTicks--;
+            }
+            else
+            {
+                uint64_t expirations = 0;
+                ssize_t bytes;
+                do
+                {
+                    bytes = read(timer_fd, &expirations, sizeof(expirations));
+                } while ((bytes < 0) && (EINTR == errno));
+
+                //More than one expiration means the caller overran a tick
+                if (expirations > 1)
+                {
+                    pendingTicks = expirations - 1;
+                }
+            }
+            lastLateness = monotonicNs() - timespecNs(nextDeadline);
+            timespecAddNs(nextDeadline, period);
+            break;
+        }
+        case RT_CLOCK_NANOSLEEP:
+        {
+            while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &nextDeadline, nullptr))
+            {
+                //Interrupted by a signal, the deadline is absolute so just go again
+            }
+            lastLateness = monotonicNs() - timespecNs(nextDeadline);
+            timespecAddNs(nextDeadline, period);
+            break;
+        }
+        case RT_CLOCK_SLEEP_UNTIL:
+        default:
+        {
+            std::this_thread::sleep_until(nextTick);
+            lastLateness = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - nextTick).count();
+            nextTick += std::chrono::nanoseconds(period);
+            break;
+        }
+    }
+
+    return overrun;
+}
+
+/*
+ *  rtTicker::getLastDropped
+ */
+int64_t rtTicker::getLastDropped() const
+{
+    return lastDropped;
+}
+
+/*
+ *  rtTicker::getLastLateness
+ */
+int64_t rtTicker::getLastLateness() const
+{
+    return lastLateness;
+}
+
+/*
+ *  rtTicker::getNextDeadline
+ */
+int64_t rtTicker::getNextDeadline() const
+{
+    if (RT_CLOCK_SLEEP_UNTIL == status.clock)
+    {
+        //steady_clock is CLOCK_MONOTONIC, so the epochs match
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    nextTick.time_since_epoch()).count();
+    }
+    return timespecNs(nextDeadline);
+}
+
+/*
+ *  rtTicker::retime
+ * 
+ * For the timerfd, the timer is re-armed with the new first expiry and 
+ * interval. An adjustment that puts the deadline in the past just makes the
+ * next wait() return at once.
+ */
+void rtTicker::retime(int64_t period_ns, int64_t adjust)
+{
+    period = period_ns;
+    nextTick += std::chrono::nanoseconds(adjust);
+    nextDeadline = nsTimespec(timespecNs(nextDeadline) + adjust);
+
+#ifdef __linux__
+    if ((RT_CLOCK_TIMERFD == status.clock) && (timer_fd >= 0))
+    {
+        struct itimerspec spec;
+        spec.it_value    = nextDeadline;
+        spec.it_interval = nsTimespec(period);
+        timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+#endif
+}
+
+/*
+ *  rtTicker::getPeriod
+ */
+int64_t rtTicker::getPeriod() const
+{
+    return period;
+}
+
+/*
+ *  rtTicker::getStatus
+ */
+rtStatus rtTicker::getStatus() const
+{
+    rtStatus current = status;
+    current.missed_ticks = missed;
+    current.dropped_ticks = dropped;
+    return current;
+}
+
+
+
+
+
+/*
+ *  rtEventWait constructor
+ * 
+ * Both fds go into one epoll set. The deadline timerfd is armed for each 
+ * wait, with an absolute expiry.
+ */
+rtEventWait::rtEventWait(int event_fd) : event_fd{event_fd}
+{
+#ifdef __linux__
+    if (event_fd < 0)
+    {
+        return;
+    }
+    epoll_fd    = epoll_create1(EPOLL_CLOEXEC);
+    deadline_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if ((epoll_fd < 0) || (deadline_fd < 0))
+    {
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events  = EPOLLIN;
+    ev.data.fd = event_fd;
+    bool ok = (0 == epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event_fd, &ev));
+    ev.data.fd = deadline_fd;
+    ok = ok && (0 == epoll_ctl(epoll_fd, EPOLL_CTL_ADD, deadline_fd, &ev));
+    if (!ok)
+    {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+#endif
+}
+
+rtEventWait::~rtEventWait()
+{
+    if (epoll_fd >= 0)
+    {
+        close(epoll_fd);
+    }
+    if (deadline_fd >= 0)
+    {
+        close(deadline_fd);
+    }
+}
+
+bool rtEventWait::ready() const
+{
+    return (epoll_fd >= 0) && (deadline_fd >= 0);
+}
+
+/*
+ *  rtEventWait::waitUntil
+ * 
+ * Theory of operation:
+ * 
+ * 1) Arm the deadline timerfd. A deadline already in the past fires at once.
+ * 2) epoll_wait with no timeout, retrying on EINTR
+ * 3) If the event fd is readable, read it to reset it and report the event.
+ *      It wins over the deadline if both are ready.
+ * 4) Otherwise drain the timerfd and report the deadline.
+ */
+bool rtEventWait::waitUntil(int64_t deadline)
+{
+#ifdef __linux__
+    if (!ready())
+    {
+        return false;
+    }
+
+    // 1) Deadline. A zero it_value would disarm the timer, so clamp to 1 ns.
+    struct itimerspec spec;
+    spec.it_interval.tv_sec  = 0;
+    spec.it_interval.tv_nsec = 0;
+    if (deadline < 1)
+    {
+        deadline = 1;
+    }
+    spec.it_value = nsTimespec(deadline);
+    timerfd_settime(deadline_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+
+    // 2) Wait
+    struct epoll_event events[2];
+    int count;
+    do
+    {
+        count = epoll_wait(epoll_fd, events, 2, -1);
+    } while ((count < 0) && (EINTR == errno));
+
+    bool gotEvent = false;
+    for (int i = 0; i < count; i++)
+    {
+        if (events[i].data.fd == event_fd)
+        {
+            gotEvent = true;
+        }
+    }
+
+    // 3) Event
+    uint64_t value;
+    if (gotEvent)
+    {
+        ssize_t bytes = read(event_fd, &value, sizeof(value));
+        (void)bytes;
+    }
+
+    // 4) Disarm and drain the deadline either way, so it can't fire into
+    //    the next wait
+    spec.it_value.tv_sec  = 0;
+    spec.it_value.tv_nsec = 0;
+    timerfd_settime(deadline_fd, 0, &spec, nullptr);
+    ssize_t bytes = read(deadline_fd, &value, sizeof(value));
+    (void)bytes;
+
+    return gotEvent;
+#else
+    (void)deadline;
+    return false;
+#endif
+}
+
+/*
+ *  sleepUntilNs
+ */
+void sleepUntilNs(int64_t deadline)
+{
+    struct timespec ts = nsTimespec(deadline);
+    while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr))
+    {
+        //Interrupted by a signal, the deadline is absolute so just go again
+    }
+}
+
+/*
+ *  rtClockName
+ */
+const char *rtClockName(rt_clock_backend clock)
+{
+    switch (clock)
+    {
+        case RT_CLOCK_SLEEP_UNTIL:
+            return "sleep_until";
+        case RT_CLOCK_NANOSLEEP:
+            return "clock_nanosleep";
+        case RT_CLOCK_TIMERFD:
+            return "timerfd";
+    }
+    return "unknown";
+}
+
+/*
+ *  rtClockFromName
+ */
+bool rtClockFromName(const std::string& name, rt_clock_backend& clock)
+{
+    if (name == "sleep_until")
+    {
+        clock = RT_CLOCK_SLEEP_UNTIL;
+    }
+    else if (name == "clock_nanosleep")
+    {
+        clock = RT_CLOCK_NANOSLEEP;
+    }
+    else if (name == "timerfd")
+    {
+        clock = RT_CLOCK_TIMERFD;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/*
+ *  tickModeName
+ */
+const char *tickModeName(tick_mode mode)
+{
+    switch (mode)
+    {
+        case TICK_FIXED:
+            return "fixed";
+        case TICK_EVENT:
+            return "event";
+        case TICK_JIT:
+            return "jit";
+        case TICK_PLL:
+            return "pll";
+    }
+    return "unknown";
+}
+
+/*
+ *  tickModeFromName
+ */
+bool tickModeFromName(const std::string& name, tick_mode& mode)
+{
+    if (name == "fixed")
+    {
+        mode = TICK_FIXED;
+    }
+    else if (name == "event")
+    {
+        mode = TICK_EVENT;
+    }
+    else if (name == "jit")
+    {
+        mode = TICK_JIT;
+    }
+    else if (name == "pll")
+    {
+        mode = TICK_PLL;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/*
+ *  rtOverrunName
+ */
+const char *rtOverrunName(rt_overrun_policy policy)
+{
+    switch (policy)
+    {
+        case RT_OVERRUN_CATCH_UP:
+            return "catch_up";
+        case RT_OVERRUN_DROP:
+            return "drop";
+    }
+    return "unknown";
+}
+
+/*
+ *  rtOverrunFromName
+ */
+bool rtOverrunFromName(const std::string& name, rt_overrun_policy& policy)
+{
+    if (name == "catch_up")
+    {
+        policy = RT_OVERRUN_CATCH_UP;
+    }
+    else if (name == "drop")
+    {
+        policy = RT_OVERRUN_DROP;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/*
+ *  netBackendName
+ */
+const char *netBackendName(net_backend backend)
+{
+    switch (backend)
+    {
+        case NET_EPOLL:
+            return "epoll";
+        case NET_URING:
+            return "io_uring";
+    }
+    return "unknown";
+}
+
+/*
+ *  netBackendFromName
+ */
+bool netBackendFromName(const std::string& name, net_backend& backend)
+{
+    if (name == "epoll")
+    {
+        backend = NET_EPOLL;
+    }
+    else if (name == "io_uring")
+    {
+        backend = NET_URING;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
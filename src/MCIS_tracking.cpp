@@ -0,0 +1,217 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+
+#include <cmath>
+#include <cstring>
+#include "include/MCIS_tracking.h"
+
+//Values are clamped to this many units (100 m or rad), so that a garbled 
+//reply can't overflow the running sums
+#define TRACKING_MAX_UNITS      100000000
+
+/*
+ *  Scale to units and clamp. NaN, which a garbled reply may well hold, 
+ * counts as zero.
+ */
+static int64_t toUnits(double value)
+{
+    double units = std::round(value * TRACKING_SCALE);
+    if (!(units > -TRACKING_MAX_UNITS))
+    {
+        return std::isnan(units) ? 0 : -TRACKING_MAX_UNITS;
+    }
+    if (units > TRACKING_MAX_UNITS)
+    {
+        return TRACKING_MAX_UNITS;
+    }
+    return (int64_t)units;
+}
+
+/*
+ *  trackingMonitor constructor
+ */
+trackingMonitor::trackingMonitor()
+{
+    reset();
+}
+
+/*
+ *  trackingMonitor::reset
+ * 
+ * Back to an empty history, all zeros, which is what the running sums 
+ * assume before the first pair
+ */
+void trackingMonitor::reset()
+{
+    memset(commands, 0, sizeof(commands));
+    memset(feedbacks, 0, sizeof(feedbacks));
+    memset(sendTimes, 0, sizeof(sendTimes));
+    memset(sumF, 0, sizeof(sumF));
+    memset(sumFF, 0, sizeof(sumFF));
+    memset(sumC, 0, sizeof(sumC));
+    memset(sumCC, 0, sizeof(sumCC));
+    memset(sumFC, 0, sizeof(sumFC));
+    newestSlot = depth - 1;
+    status = trackingStatus();
+}
+
+unsigned int trackingMonitor::slot(unsigned int age) const
+{
+    return (newestSlot + depth - age) % depth;
+}
+
+/*
+ *  trackingMonitor::addSample
+ * 
+ * Steps 1 and 2, then 3 and 4 for every axis once the window is full. 
+ * O(TRACKING_MAX_LAG) per axis.
+ */
+void trackingMonitor::addSample(const double (&command)[TRACKING_AXES], int64_t sent,
+                                const double (&feedback)[TRACKING_AXES])
+{
+    // 1) History. The slot taken is that of the oldest pair, which is no 
+    //    longer in any sum.
+    status.samples++;
+    newestSlot = (newestSlot + 1) % depth;
+    unsigned int newest = newestSlot;
+    sendTimes[newest] = sent;
+    for (unsigned int axis = 0; axis < TRACKING_AXES; axis++)
+    {
+        commands[newest][axis]  = toUnits(command[axis]);
+        feedbacks[newest][axis] = toUnits(feedback[axis]);
+        status.command[axis]  = command[axis];
+        status.feedback[axis] = feedback[axis];
+    }
+
+    // 2) Running sums, the pair TRACKING_WINDOW old leaves the window
+    unsigned int leaving = slot(TRACKING_WINDOW);
+    for (unsigned int axis = 0; axis < TRACKING_AXES; axis++)
+    {
+        int64_t fIn  = feedbacks[newest][axis];
+        int64_t fOut = feedbacks[leaving][axis];
+        sumF[axis]  += fIn - fOut;
+        sumFF[axis] += fIn * fIn - fOut * fOut;
+        for (unsigned int lag = 0; lag <= TRACKING_MAX_LAG; lag++)
+        {
+            int64_t cIn  = commands[slot(lag)][axis];
+            int64_t cOut = commands[slot(TRACKING_WINDOW + lag)][axis];
+            sumC[axis][lag]  += cIn - cOut;
+            sumCC[axis][lag] += cIn * cIn - cOut * cOut;
+            sumFC[axis][lag] += fIn * cIn - fOut * cOut;
+        }
+    }
+
+    status.ready = isReady();
+    if (!status.ready)
+    {
+        return;
+    }
+    status.command_period = (sendTimes[newest] - sendTimes[leaving]) / TRACKING_WINDOW;
+    for (unsigned int axis = 0; axis < TRACKING_AXES; axis++)
+    {
+        estimate(axis);
+    }
+}
+
+/*
+ *  trackingMonitor::estimate
+ * 
+ * Steps 3 and 4 for one axis. Variances and covariances are kept scaled by
+ * the window length squared, which cancels out of the correlation.
+ */
+void trackingMonitor::estimate(unsigned int axis)
+{
+    const double n = TRACKING_WINDOW;
+    const double minVariance = (TRACKING_MIN_STDDEV * TRACKING_SCALE * n) * 
+                               (TRACKING_MIN_STDDEV * TRACKING_SCALE * n);
+    double varF = n * (double)sumFF[axis] - (double)sumF[axis] * (double)sumF[axis];
+
+    // 3) Correlation at every lag, and the best one
+    double correlation[TRACKING_MAX_LAG + 1];
+    unsigned int best = 0;
+    double bestVarC = 0;
+    for (unsigned int lag = 0; lag <= TRACKING_MAX_LAG; lag++)
+    {
+        double varC = n * (double)sumCC[axis][lag] - (double)sumC[axis][lag] * (double)sumC[axis][lag];
+        double cov  = n * (double)sumFC[axis][lag] - (double)sumF[axis] * (double)sumC[axis][lag];
+        correlation[lag] = ((varF > 0) && (varC > 0)) ? cov / std::sqrt(varF * varC) : 0;
+        if ((0 == lag) || (correlation[lag] > correlation[best]))
+        {
+            best = lag;
+            bestVarC = varC;
+        }
+    }
+
+    trackingAxisStatus& result = status.axes[axis];
+    result.delay_valid = (bestVarC >= minVariance) && (varF > 0) && (correlation[best] > 0);
+    result.correlation = correlation[best];
+    if (result.delay_valid)
+    {
+        //Vertex of the parabola through the peak and its neighbours
+        double offset = 0;
+        if ((best > 0) && (best < TRACKING_MAX_LAG))
+        {
+            double curvature = correlation[best - 1] - 2 * correlation[best] + correlation[best + 1];
+            if (curvature < 0)
+            {
+                offset = 0.5 * (correlation[best - 1] - correlation[best + 1]) / curvature;
+                offset = std::fmax(-0.5, std::fmin(0.5, offset));
+            }
+        }
+        result.delay = (int64_t)((best + offset) * status.command_period);
+    }
+    else
+    {
+        best = 0;
+        result.delay = 0;
+    }
+
+    // 4) Tracking error
+    const double scale = n * TRACKING_SCALE * TRACKING_SCALE;
+    double raw = (double)(sumFF[axis] - 2 * sumFC[axis][0] + sumCC[axis][0]) / scale;
+    double aligned = (double)(sumFF[axis] - 2 * sumFC[axis][best] + sumCC[axis][best]) / scale;
+    result.error_rms = std::sqrt(std::fmax(raw, 0.0));
+    result.aligned_error_rms = std::sqrt(std::fmax(aligned, 0.0));
+}
+
+bool trackingMonitor::isReady() const
+{
+    return status.samples >= TRACKING_WINDOW + TRACKING_MAX_LAG;
+}
+
+const trackingStatus& trackingMonitor::getStatus() const
+{
+    return status;
+}
+
+const char *trackingMonitor::axisName(unsigned int axis)
+{
+    static const char *names[TRACKING_AXES] = {"Surge", "Lateral", "Heave", "Roll", "Pitch", "Yaw"};
+    return (axis < TRACKING_AXES) ? names[axis] : "Unknown";
+}
@@ -0,0 +1,380 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include "include/MCIS_uring.h"
+
+#ifdef MCIS_HAVE_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/*
+ *  The syscalls. glibc has no wrappers for them.
+ */
+static int uringSetup(unsigned entries, io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int uringRegister(int fd, unsigned opcode, const void *arg, unsigned count)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+uringQueue::~uringQueue()
+{
+    release();
+}
+
+/*
+ *  release
+ * 
+ * Unmaps and closes whatever init() and provideBuffers() got. Closing the
+ * ring also drops everything registered with it.
+ */
+void uringQueue::release()
+{
+    if (sqes)
+    {
+        munmap(sqes, sqesBytes);
+        sqes = nullptr;
+    }
+    if (cqRing && (cqRing != sqRing))
+    {
+        munmap(cqRing, cqRingBytes);
+    }
+    cqRing = nullptr;
+    if (sqRing)
+    {
+        munmap(sqRing, sqRingBytes);
+        sqRing = nullptr;
+    }
+    if (ring_fd >= 0)
+    {
+        close(ring_fd);
+        ring_fd = -1;
+    }
+    if (bufRing)
+    {
+        munmap(bufRing, bufRingBytes);
+        bufRing = nullptr;
+    }
+    if (bufMemory)
+    {
+        munmap(bufMemory, bufMemoryBytes);
+        bufMemory = nullptr;
+    }
+}
+
+/*
+ *  init
+ * 
+ * Theory of operation:
+ * 
+ * 1) io_uring_setup, with SQPOLL if asked for
+ * 2) Map the submission ring, the completion ring (the same mapping, on 
+ *      any kernel with IORING_FEAT_SINGLE_MMAP) and the SQE array
+ * 3) Find the heads, tails and masks inside the rings
+ * 4) Point each submission ring slot at the SQE of the same index, once and
+ *      for all, so that getSqe() only has to hand out SQEs in order
+ */
+bool uringQueue::init(unsigned entries, bool sq_poll)
+{
+    if (ring_fd >= 0)
+    {
+        return false;
+    }
+
+    // 1) Setup
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+    if (sq_poll)
+    {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = URING_SQPOLL_IDLE_MS;
+    }
+    ring_fd = uringSetup(entries, &params);
+    if (ring_fd < 0)
+    {
+        ring_fd = -1;
+        return false;
+    }
+
+    // 2) Map
+    sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap)
+    {
+        sqRingBytes = (cqRingBytes > sqRingBytes) ? cqRingBytes : sqRingBytes;
+        cqRingBytes = sqRingBytes;
+    }
+    void *map = mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ring_fd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == map)
+    {
+        release();
+        return false;
+    }
+    sqRing = map;
+    if (singleMap)
+    {
+        cqRing = sqRing;
+    }
+    else
+    {
+        map = mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ring_fd, IORING_OFF_CQ_RING);
+        if (MAP_FAILED == map)
+        {
+            release();
+            return false;
+        }
+        cqRing = map;
+    }
+    sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+    map = mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+               ring_fd, IORING_OFF_SQES);
+    if (MAP_FAILED == map)
+    {
+        release();
+        return false;
+    }
+    sqes = (io_uring_sqe *)map;
+
+    // 3) Ring fields
+    unsigned char *sq = (unsigned char *)sqRing;
+    unsigned char *cq = (unsigned char *)cqRing;
+    sqHead  = (unsigned *)(sq + params.sq_off.head);
+    sqTail  = (unsigned *)(sq + params.sq_off.tail);
+    sqFlags = (unsigned *)(sq + params.sq_off.flags);
+    sqMask  = *(unsigned *)(sq + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    cqHead  = (unsigned *)(cq + params.cq_off.head);
+    cqTail  = (unsigned *)(cq + params.cq_off.tail);
+    cqMask  = *(unsigned *)(cq + params.cq_off.ring_mask);
+    cqes    = (io_uring_cqe *)(cq + params.cq_off.cqes);
+    sqLocalTail = *sqTail;
+
+    // 4) Identity SQ array
+    unsigned *sqArray = (unsigned *)(sq + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries; i++)
+    {
+        sqArray[i] = i;
+    }
+
+    sqPolled = sq_poll;
+    return true;
+}
+
+bool uringQueue::isReady() const
+{
+    return ring_fd >= 0;
+}
+
+bool uringQueue::isSqPolled() const
+{
+    return sqPolled;
+}
+
+/*
+ *  getSqe
+ * 
+ * The kernel moves the head as it consumes SQEs, the tail is ours.
+ */
+io_uring_sqe *uringQueue::getSqe()
+{
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (sqLocalTail - head >= sqEntries)
+    {
+        return nullptr;
+    }
+    io_uring_sqe *sqe = &sqes[sqLocalTail & sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqLocalTail++;
+    return sqe;
+}
+
+/*
+ *  submit
+ * 
+ * Publishes the new tail, then enters the kernel only if it has to: to 
+ * submit (unless SQPOLL picks them up), to wake an idle SQPOLL thread, or 
+ * to wait. Whatever the kernel has not consumed yet, including anything 
+ * left over from an interrupted call, is submitted again.
+ */
+int uringQueue::submit(unsigned wait_for)
+{
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+
+    unsigned flags = 0;
+    unsigned toSubmit = sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (sqPolled)
+    {
+        //The kernel thread has to see the tail before we look at its flags
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(sqFlags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)
+        {
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        }
+        else if (!wait_for)
+        {
+            return (int)toSubmit;
+        }
+    }
+    else if (!toSubmit && !wait_for)
+    {
+        return 0;
+    }
+    if (wait_for)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+
+    int ret = uringEnter(ring_fd, toSubmit, wait_for, flags);
+    return (ret < 0) ? -errno : ret;
+}
+
+io_uring_cqe *uringQueue::peekCqe()
+{
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+    {
+        return nullptr;
+    }
+    return &cqes[head & cqMask];
+}
+
+void uringQueue::seenCqe()
+{
+    __atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+}
+
+bool uringQueue::registerBuffers(const struct iovec *buffers, unsigned count)
+{
+    return 0 == uringRegister(ring_fd, IORING_REGISTER_BUFFERS, buffers, count);
+}
+
+bool uringQueue::registerFiles(const int *fds, unsigned count)
+{
+    return 0 == uringRegister(ring_fd, IORING_REGISTER_FILES, fds, count);
+}
+
+/*
+ *  provideBuffers
+ * 
+ * Both the buffer ring and the buffers themselves are mapped and touched
+ * here, so that receiving never page faults. The ring has to be page 
+ * aligned, which mmap takes care of.
+ */
+bool uringQueue::provideBuffers(uint16_t group, unsigned count, unsigned size)
+{
+    if ((ring_fd < 0) || bufRing || !count || (count & (count - 1)) || (count > 32768))
+    {
+        return false;
+    }
+
+    size_t ringBytes = count * sizeof(io_uring_buf);
+    size_t memoryBytes = (size_t)count * size;
+    void *ring = mmap(nullptr, ringBytes, PROT_READ | PROT_WRITE, 
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (MAP_FAILED == ring)
+    {
+        return false;
+    }
+    void *memory = mmap(nullptr, memoryBytes, PROT_READ | PROT_WRITE, 
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (MAP_FAILED == memory)
+    {
+        munmap(ring, ringBytes);
+        return false;
+    }
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring;
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (0 != uringRegister(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1))
+    {
+        munmap(memory, memoryBytes);
+        munmap(ring, ringBytes);
+        return false;
+    }
+
+    bufRing = (io_uring_buf *)ring;
+    bufMemory = (unsigned char *)memory;
+    bufRingBytes = ringBytes;
+    bufMemoryBytes = memoryBytes;
+    bufCount = count;
+    bufSize = size;
+    bufTail = 0;
+    for (unsigned id = 0; id < count; id++)
+    {
+        addBuffer(id);
+    }
+    return true;
+}
+
+const unsigned char *uringQueue::getBuffer(unsigned id) const
+{
+    return bufMemory + (size_t)(id % bufCount) * bufSize;
+}
+
+void uringQueue::recycleBuffer(unsigned id)
+{
+    addBuffer(id % bufCount);
+}
+
+/*
+ *  addBuffer
+ * 
+ * The ring's tail shares its slot with the first buffer's reserved field.
+ * It is reached through that field, not through io_uring_buf_ring: in C++,
+ * the flexible array in that struct (__DECLARE_FLEX_ARRAY) starts 8 bytes
+ * in, not at 0 where the kernel has it.
+ */
+void uringQueue::addBuffer(unsigned id)
+{
+    io_uring_buf *buf = &bufRing[bufTail & (bufCount - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(bufMemory + (size_t)id * bufSize);
+    buf->len  = bufSize;
+    buf->bid  = (uint16_t)id;
+    bufTail++;
+    __atomic_store_n(&bufRing[0].resv, bufTail, __ATOMIC_RELEASE);
+}
+
+#endif
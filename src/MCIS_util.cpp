@@ -30,7 +30,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
 #include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <new>
 #include <arpa/inet.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
 #include "include/MCIS_util.h"
 
 /*
@@ -49,8 +57,10 @@ float floatNetToHost(uint32_t bigEndianFloat)
                     |  ((uint32_t) value[1] << 16)
                     |  ((uint32_t) value[0] << 24);*/
     uint32_t hostVal = ntohl(bigEndianFloat);
-    float *convFloat = reinterpret_cast<float *>(hostVal);
-    return *convFloat;
+    //Reinterpreting the bits as a float, not converting the integer value
+    float hostFloat;
+    memcpy(&hostFloat, &hostVal, sizeof(hostFloat));
+    return hostFloat;
 }
 
 /*
@@ -67,13 +77,16 @@ float floatLEToHost(uint32_t LEFloat)
      *  Seems messy and inefficient, but most compilers will boil it down to no-op
      *  for big-endian systems and bswap32 for little-endian systems
      */
-    uint64_t hostFloat;
-    hostFloat = ((uint64_t)inBuf[0] << 0)  | 
-                ((uint64_t)inBuf[1] << 8)  | 
-                ((uint64_t)inBuf[2] << 16) | 
-                ((uint64_t)inBuf[3] << 24);
+    uint32_t hostBits;
+    hostBits = ((uint32_t)inBuf[0] << 0)  | 
+               ((uint32_t)inBuf[1] << 8)  | 
+               ((uint32_t)inBuf[2] << 16) | 
+               ((uint32_t)inBuf[3] << 24);
 
-    return *reinterpret_cast<double *>(&hostFloat);
+    //Reinterpreting the bits as a float, not converting the integer value
+    float hostFloat;
+    memcpy(&hostFloat, &hostBits, sizeof(hostFloat));
+    return hostFloat;
 }
 
 /*
@@ -140,4 +153,245 @@ double doubleNetToHost(uint64_t netDouble)
                     ((uint64_t)inBuf[0] << 56);
 
     return *reinterpret_cast<double *>(&hostDouble);
-}
\ No newline at end of file
+}
+
+/*
+ *  monotonicNs
+ * 
+ * Current CLOCK_MONOTONIC time in nanoseconds
+ */
+int64_t monotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*
+ *  realtimeNs
+ */
+int64_t realtimeNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/*
+ *  nextFreeFilename
+ */
+std::string nextFreeFilename(const std::string& stem, const std::string& ext)
+{
+    for (unsigned int i = 0; ; i++)
+    {
+        std::string path = stem + std::to_string(i) + ext;
+        std::ifstream existing(path);
+        if (!existing)
+        {
+            return path;
+        }
+    }
+}
+
+/*
+ *  enableRxTimestamps
+ */
+bool enableRxTimestamps(int fd)
+{
+#ifdef SO_TIMESTAMPNS
+    int on = 1;
+    return 0 == setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+#else
+    (void)fd;
+    return false;
+#endif
+}
+
+/*
+ *  rxTimestampNs
+ * 
+ * The kernel stamps datagrams with CLOCK_REALTIME. It is brought over to 
+ * CLOCK_MONOTONIC with the offset between the two clocks right now, which
+ * is two vDSO reads and no syscall. A step of the wall clock between the 
+ * arrival and this call (NTP slewing is far too slow to matter) would throw
+ * it off, so anything that would put the arrival in the future is clamped
+ * to now.
+ */
+int64_t rxTimestampNs(const struct msghdr *msg)
+{
+#ifdef SO_TIMESTAMPNS
+    for (const struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; 
+         cmsg = CMSG_NXTHDR((struct msghdr *)msg, (struct cmsghdr *)cmsg))
+    {
+        if ((SOL_SOCKET == cmsg->cmsg_level) && (SCM_TIMESTAMPNS == cmsg->cmsg_type))
+        {
+            struct timespec stamp, real;
+            memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+            clock_gettime(CLOCK_REALTIME, &real);
+            int64_t now = monotonicNs();
+            int64_t age = ((int64_t)real.tv_sec - stamp.tv_sec) * 1000000000 + 
+                          (real.tv_nsec - stamp.tv_nsec);
+            return now - ((age > 0) ? age : 0);
+        }
+    }
+#else
+    (void)msg;
+#endif
+    return 0;
+}
+
+/*
+ *  pageFaultCounts::operator-
+ */
+pageFaultCounts pageFaultCounts::operator-(const pageFaultCounts& rhs) const
+{
+    pageFaultCounts difference;
+    difference.minor = minor - rhs.minor;
+    difference.major = major - rhs.major;
+    return difference;
+}
+
+static pageFaultCounts usagePageFaults(int who)
+{
+    pageFaultCounts faults;
+    struct rusage usage;
+    if (0 == getrusage(who, &usage))
+    {
+        faults.minor = usage.ru_minflt;
+        faults.major = usage.ru_majflt;
+    }
+    return faults;
+}
+
+/*
+ *  threadPageFaults
+ */
+pageFaultCounts threadPageFaults()
+{
+#ifdef RUSAGE_THREAD
+    return usagePageFaults(RUSAGE_THREAD);
+#else
+    return usagePageFaults(RUSAGE_SELF);
+#endif
+}
+
+/*
+ *  processPageFaults
+ */
+pageFaultCounts processPageFaults()
+{
+    return usagePageFaults(RUSAGE_SELF);
+}
+
+
+
+/*
+ *
+ *      ---=== class rtArena ===---
+ * 
+ */
+
+//Size of a huge page on x86 and most ARM configurations. Only used to round
+//up the size of a MAP_HUGETLB mapping, which must be a multiple of it.
+#define RT_ARENA_HUGE_PAGE_BYTES (2 * 1024 * 1024)
+
+/*
+ *  rtArena constructor
+ * 
+ * See the class description for the steps. Only failing to map anything at
+ * all throws.
+ */
+rtArena::rtArena(std::size_t bytes, bool huge_pages)
+{
+    std::size_t pageSize = (std::size_t)sysconf(_SC_PAGESIZE);
+    void *mapping = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    if (huge_pages)
+    {
+        size = (bytes + RT_ARENA_HUGE_PAGE_BYTES - 1) & ~(std::size_t)(RT_ARENA_HUGE_PAGE_BYTES - 1);
+        mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, 
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        hugePages = (MAP_FAILED != mapping);
+    }
+#endif
+    if (MAP_FAILED == mapping)
+    {
+        size = (bytes + pageSize - 1) & ~(pageSize - 1);
+        mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, 
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == mapping)
+        {
+            std::bad_alloc mapFailed;
+            throw mapFailed;
+        }
+#ifdef MADV_HUGEPAGE
+        if (huge_pages)
+        {
+            madvise(mapping, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    base = static_cast<char *>(mapping);
+
+    locked = (0 == mlock(base, size));
+
+    //Touch every page. mlock already faults them in, but it may have failed.
+    for (std::size_t offset = 0; offset < size; offset += pageSize)
+    {
+        *(volatile char *)(base + offset) = 0;
+    }
+}
+
+/*
+ *  rtArena destructor
+ * 
+ * Destroys the objects in reverse order of creation, then unmaps
+ */
+rtArena::~rtArena()
+{
+    while (objectCount > 0)
+    {
+        objectCount--;
+        destructors[objectCount](objects[objectCount]);
+    }
+    if (locked)
+    {
+        munlock(base, size);
+    }
+    munmap(base, size);
+}
+
+/*
+ *  rtArena::allocate
+ * 
+ * Bump allocation. alignment must be a power of two.
+ */
+void *rtArena::allocate(std::size_t bytes, std::size_t alignment)
+{
+    std::size_t start = (used + alignment - 1) & ~(alignment - 1);
+    if ((start > size) || (bytes > size - start))
+    {
+        std::bad_alloc arenaFull;
+        throw arenaFull;
+    }
+    used = start + bytes;
+    return base + start;
+}
+
+/*
+ *  rtArena::addObject
+ */
+void rtArena::addObject(void (*destructor)(void *), void *object)
+{
+    if (objectCount >= RT_ARENA_MAX_OBJECTS)
+    {
+        //Too late to refuse the object, so destroy it before throwing
+        destructor(object);
+        std::bad_alloc tooManyObjects;
+        throw tooManyObjects;
+    }
+    destructors[objectCount] = destructor;
+    objects[objectCount] = object;
+    objectCount++;
+}
@@ -27,9 +27,15 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <iostream>
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 #include <unistd.h>
 #include <math.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 #include "include/MCIS_xplane_sock.h"
+#include "include/MCIS_diag.h"
 #include "include/MCIS_util.h"
 
 
@@ -39,9 +45,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * It is responsible for opening the socket and setting up the correct type
  * of message to be received.
  * 
- * It also spawns the thread that will actually receive stuff
+ * It also spawns the thread that will actually receive stuff, unless an
+ * ioReactor is going to take care of that.
  */
-xplaneSocket::xplaneSocket(uint16_t localPort, xplaneMsgType msgType)
+xplaneSocket::xplaneSocket(uint16_t localPort, xplaneMsgType msgType, bool own_thread,
+                           int busy_poll_us) :
+    messageVersion{msgType}, ownThread{own_thread}
 {
     //Boilerplate socket setup
     sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
@@ -51,6 +60,41 @@ xplaneSocket::xplaneSocket(uint16_t localPort, xplaneMsgType msgType)
         throw invalid_sock_fd_exception;
     }
 
+    //The send thread may ask for data before anything arrives
+    latestSample.store(xplaneSample());
+
+#ifdef __linux__
+    //Not having it only rules out waiting for data, so failure is not fatal
+    event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#endif
+
+#ifdef SO_BUSY_POLL
+    //Unprivileged, this fails with EPERM and the socket just sleeps as usual
+    if ((busy_poll_us > 0) && 
+        (0 == setsockopt(sock_fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us))))
+    {
+        busyPollUs = busy_poll_us;
+    }
+#else
+    (void)busy_poll_us;
+#endif
+
+    //Without it, messages are stamped when they are read instead
+    kernelTimestamps = enableRxTimestamps(sock_fd);
+
+#ifdef __linux__
+    //Each batch entry receives straight into its own buffers
+    memset(batchHdrs, 0, sizeof(batchHdrs));
+    for (int i = 0; i < XP_RECV_BATCH; i++)
+    {
+        batchIov[i].iov_base = batchMsgs[i];
+        batchIov[i].iov_len  = XP9_MSG_SIZE;
+        batchHdrs[i].msg_hdr.msg_iov    = &batchIov[i];
+        batchHdrs[i].msg_hdr.msg_iovlen = 1;
+        batchHdrs[i].msg_hdr.msg_control = batchControl[i];
+    }
+#endif
+
     //Bind the socket 
     struct sockaddr_in localAddr;
     localAddr.sin_family = AF_INET;
@@ -71,7 +115,10 @@ xplaneSocket::xplaneSocket(uint16_t localPort, xplaneMsgType msgType)
      * argument. recvThreadFunc nominally takes no arguments, so we just need'
      * to include the normally-implicit this pointer.
      */
-    recvThread = std::thread(&xplaneSocket::recvThreadFunc, this);
+    if (ownThread)
+    {
+        recvThread = std::thread(&xplaneSocket::recvThreadFunc, this);
+    }
 }
 
 /*
@@ -106,7 +153,17 @@ void xplaneSocket::stop()
         throw except;
     }
 
-    recvThread.join();
+    if (ownThread)
+    {
+        recvThread.join();
+    }
+
+    //Nobody is waiting on it by now, the send thread stops first
+    if (event_fd >= 0)
+    {
+        close(event_fd);
+        event_fd = -1;
+    }
 }
 
 
@@ -119,18 +176,14 @@ void xplaneSocket::stop()
  */
 void xplaneSocket::recvThreadFunc()
 {
-    struct sockaddr_in  recvAddr;
-    unsigned int recvAddrSize;
     int receivedBytes;
+    int64_t recvTime;
     
     //std::cout << "recvThread started..." << std::endl;
 
     while (continueRecv)
     {
-        //The cast is to silence -Wconversion. We are NEVER going to receive
-        //more than 2^32 bytes at once.
-        receivedBytes = (int)recvfrom(sock_fd, (void *)&rawMsg, XP9_MSG_SIZE,
-                                   0, (sockaddr*)&recvAddr, &recvAddrSize);
+        receivedBytes = recvOne(0, recvTime);
         
         if (!continueRecv)
         {
@@ -139,32 +192,235 @@ void xplaneSocket::recvThreadFunc()
         if (receivedBytes == -1)
         {
             //Todo - make this an exception and catch upstack
-            std::cerr << "X-Plane receive socket returned -1" << std::endl;
+            diagReport(DIAG_XP_RECV_FAILED, errno);
             return;
         }
         
-        if (messageVersion == XP9)
+        handleMessage(receivedBytes, recvTime);
+    }
+
+
+}
+
+/*
+ *  recvOne
+ * 
+ * recvmsg into rawMsg, so that the kernel's timestamp comes along. Returns
+ * what recvmsg did.
+ */
+int xplaneSocket::recvOne(int flags, int64_t& recvTime)
+{
+    struct iovec iov;
+    iov.iov_base = rawMsg;
+    iov.iov_len  = XP9_MSG_SIZE;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = msgControl;
+    msg.msg_controllen = sizeof(msgControl);
+
+    //The cast is to silence -Wconversion. We are NEVER going to receive
+    //more than 2^32 bytes at once.
+    int receivedBytes = (int)recvmsg(sock_fd, &msg, flags);
+    recvTime = (receivedBytes >= 0) ? rxTimestampNs(&msg) : 0;
+    return receivedBytes;
+}
+
+/*
+ *  onReadable
+ * 
+ * The ioReactor's version of recvThreadFunc, which returns once the socket
+ * is empty instead of blocking.
+ * 
+ * Theory of operation (Linux):
+ * 
+ * 1) recvmmsg up to XP_RECV_BATCH datagrams, without blocking
+ * 2) Check each one, keep a copy of the newest valid one in rawMsg, and
+ *      its timestamp
+ * 3) If the batch was full, there may be more, go again
+ * 4) Decode rawMsg once. The other valid messages skip their sequence 
+ *      numbers and count as dropped.
+ * 
+ * Elsewhere, one recvmsg at a time, decoding each.
+ */
+void xplaneSocket::onReadable(int fd)
+{
+    (void)fd;
+#ifdef __linux__
+    uint64_t valid = 0;
+    int64_t recvTime = 0;
+    while (continueRecv)
+    {
+        // 1) Batch
+        for (int i = 0; i < XP_RECV_BATCH; i++)
+        {
+            batchHdrs[i].msg_hdr.msg_controllen = RX_TIMESTAMP_CONTROL_SIZE;
+        }
+        int count = recvmmsg(sock_fd, batchHdrs, XP_RECV_BATCH, MSG_DONTWAIT, nullptr);
+        if (count < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+            {
+                diagReport(DIAG_XP_RECV_FAILED, errno);
+            }
+            break;
+        }
+
+        // 2) Newest valid
+        int newest = -1;
+        for (int i = 0; i < count; i++)
         {
-            //Check the message length
-            if (receivedBytes != XP9_MSG_SIZE)
+            if (checkMessage((int)batchHdrs[i].msg_len))
+            {
+                valid++;
+                newest = i;
+            }
+        }
+        if (newest >= 0)
+        {
+            memcpy(rawMsg, batchMsgs[newest], XP9_MSG_SIZE);
+            recvTime = rxTimestampNs(&batchHdrs[newest].msg_hdr);
+        }
+
+        // 3) More?
+        if (count < XP_RECV_BATCH)
+        {
+            break;
+        }
+    }
+
+    // 4) Decode
+    decodeNewest(valid, recvTime);
+#else
+    while (continueRecv)
+    {
+        int64_t recvTime;
+        int receivedBytes = recvOne(MSG_DONTWAIT, recvTime);
+        if (receivedBytes == -1)
+        {
+            if (EINTR == errno)
             {
-                std::cerr << "Message received has wrong length for X-Plane 9 message." << std::endl;
-                std::cerr << "Should be: " << sizeof(xplane9msg) << "  Is: " << receivedBytes << std::endl;
                 continue;
             }
-            //std::cout << "Message received\n";
-            interpretXP9msg();
+            if ((EAGAIN != errno) && (EWOULDBLOCK != errno))
+            {
+                diagReport(DIAG_XP_RECV_FAILED, errno);
+            }
+            return;
         }
 
-        else if (messageVersion == XP11)
+        handleMessage(receivedBytes, recvTime);
+    }
+#endif
+}
+
+/*
+ *  onDatagram
+ * 
+ * Like onReadable, the newest valid message of the burst is kept, and 
+ * decoded once the reactor has no more.
+ */
+void xplaneSocket::onDatagram(int fd, const unsigned char *data, int length, int64_t rx_time)
+{
+    (void)fd;
+    if (checkMessage(length))
+    {
+        memcpy(rawMsg, data, XP9_MSG_SIZE);
+        burstRecvTime = rx_time;
+        burstValid++;
+    }
+}
+
+void xplaneSocket::onDatagramsDone(int fd)
+{
+    (void)fd;
+    decodeNewest(burstValid, burstRecvTime);
+    burstValid = 0;
+}
+
+/*
+ *  decodeNewest
+ * 
+ * The older messages are never decoded, but take their sequence numbers.
+ */
+void xplaneSocket::decodeNewest(uint64_t valid, int64_t recvTime)
+{
+    if (valid > 0)
+    {
+        samplesReceived += valid - 1;
+        messagesDropped += valid - 1;
+        interpretXP9msg(recvTime);
+    }
+}
+
+int xplaneSocket::getSocketFd() const
+{
+    return sock_fd;
+}
+
+uint64_t xplaneSocket::getMessagesDropped() const
+{
+    return messagesDropped;
+}
+
+int xplaneSocket::getBusyPollUs() const
+{
+    return busyPollUs;
+}
+
+bool xplaneSocket::hasKernelTimestamps() const
+{
+    return kernelTimestamps;
+}
+
+/*
+ *  handleMessage
+ */
+void xplaneSocket::handleMessage(int receivedBytes, int64_t recvTime)
+{
+    if (checkMessage(receivedBytes))
+    {
+        //std::cout << "Message received\n";
+        interpretXP9msg(recvTime);
+    }
+}
+
+/*
+ *  checkMessage
+ */
+bool xplaneSocket::checkMessage(int receivedBytes)
+{
+    if (messageVersion == XP9)
+    {
+        //Check the message length
+        if (receivedBytes != XP9_MSG_SIZE)
         {
-            //Ooops
-            std::logic_error except("You're trying to use XP11 without coding for it, dumbass!\n");
-            throw except;
+            diagReport(DIAG_XP_WRONG_LENGTH, receivedBytes);
+            return false;
         }
+        return true;
     }
 
+    //Ooops
+    std::logic_error except("You're trying to use XP11 without coding for it, dumbass!\n");
+    throw except;
+}
 
+/*
+ *  Grab the raw bits of a float out of the message. The fields are not 
+ * aligned, so they're copied out instead of dereferenced in place.
+ */
+static uint32_t rawFloatBits(const unsigned char *field)
+{
+    uint32_t bits;
+    memcpy(&bits, field, sizeof(bits));
+    return bits;
 }
 
 /*
@@ -172,30 +428,35 @@ void xplaneSocket::recvThreadFunc()
  * 
  * Interpret a message sent by X-Plane 9's data output as used by the SVI.
  * 
- * This function acquires the lock that prevents reading of incomplete
- * output buffers
+ * The decoded sample is published with a new sequence number and the 
+ * receive time, for getData to pick up. Without a kernel timestamp, the
+ * message counts as received now.
  */
-void xplaneSocket::interpretXP9msg()
+void xplaneSocket::interpretXP9msg(int64_t recvTime)
 {
     //We're not touching angular accelerations yet
     //They're weird in X-Plane 11 and we don't have an offset position anyway
     //so we just ignore them for now.
     double xSf, ySf, zSf, p, q, r, phi, theta, psi;
+    if (0 == recvTime)
+    {
+        recvTime = monotonicNs();
+    }
 
     //X-Plane annoyingly sends little-endian data, so we ironically have more trouble
     //than if they just used big-endian in the first place, even though we mostly
     //run on little-endian systems
-    xSf = floatLEToHost(*(float *) (msgPointer + xplane9msg::offset_sfX));
-    ySf = floatLEToHost(*(float *) (msgPointer + xplane9msg::offset_sfY));
-    zSf = floatLEToHost(*(float *) (msgPointer + xplane9msg::offset_sfZ));
+    xSf = floatLEToHost(rawFloatBits(msgPointer + xplane9msg::offset_sfX));
+    ySf = floatLEToHost(rawFloatBits(msgPointer + xplane9msg::offset_sfY));
+    zSf = floatLEToHost(rawFloatBits(msgPointer + xplane9msg::offset_sfZ));
 
-    p   = floatLEToHost(*(float *) (msgPointer + xplane9msg::offset_p));
-    q   = floatLEToHost(*(float *) (msgPointer + xplane9msg::offset_q));
-    r   = floatLEToHost(*(float *) (msgPointer + xplane9msg::offset_r));
+    p   = floatLEToHost(rawFloatBits(msgPointer + xplane9msg::offset_p));
+    q   = floatLEToHost(rawFloatBits(msgPointer + xplane9msg::offset_q));
+    r   = floatLEToHost(rawFloatBits(msgPointer + xplane9msg::offset_r));
 
-    phi   = floatLEToHost(*(float *) (msgPointer + xplane9msg::offset_phi));
-    theta = floatLEToHost(*(float *) (msgPointer + xplane9msg::offset_theta));
-    psi   = floatLEToHost(*(float *) (msgPointer + xplane9msg::offset_psi));
+    phi   = floatLEToHost(rawFloatBits(msgPointer + xplane9msg::offset_phi));
+    theta = floatLEToHost(rawFloatBits(msgPointer + xplane9msg::offset_theta));
+    psi   = floatLEToHost(rawFloatBits(msgPointer + xplane9msg::offset_psi));
 
     //Angular accelerations would go here.
 
@@ -218,24 +479,60 @@ void xplaneSocket::interpretXP9msg()
     theta *= M_PI/180;
     psi   *= M_PI/180;
 
-    //This lock guard locks the mutex until it is destructed, when this function returns.
-    std::lock_guard<std::mutex> lock(stateMutex);
+    xplaneSample sample;
+    sample.sf.assign(xSf, ySf, zSf);
+    sample.angv.assign(p, q, r);
+    sample.att.assign(phi, theta, psi);
+    sample.sequence = ++samplesReceived;
+    sample.recvTimeNs = recvTime;
+    latestSample.store(sample);
+
+    if (event_fd >= 0)
+    {
+        uint64_t one = 1;
+        ssize_t bytes = write(event_fd, &one, sizeof(one));
+        (void)bytes;
+    }
+}
 
-    sfBuffer.assign(xSf, ySf, zSf);
-    angvBuffer.assign(p, q, r);
-    attBuffer.assign(phi, theta, psi);
+int xplaneSocket::getEventFd() const
+{
+    return event_fd;
 }
 
 /*
  *  Getter for the buffered received output
  * 
- * Of note is the fact that it locks a mutex to prevent the data from being
- * clobbered by the recv thread while it is being copied off
+ * A read that overlaps a new message is retried a few times at most, so this
+ * never waits on the recv thread for long. X-Plane sends at a few hundred Hz
+ * at most, so in practice the first try nearly always succeeds, and if they
+ * all fail the previous sample is only one message old anyway.
  */
-void xplaneSocket::getData(MCISvector& spForces, MCISvector& angVelocities, MCISvector& attitude)
+bool xplaneSocket::getData(MCISvector& spForces, MCISvector& angVelocities, MCISvector& attitude)
 {
-    std::lock_guard<std::mutex> lock(stateMutex);
-    spForces        = sfBuffer;
-    angVelocities   = angvBuffer;
-    attitude        = attBuffer;
+    uint64_t sequence;
+    int64_t recvTimeNs;
+    return getData(spForces, angVelocities, attitude, sequence, recvTimeNs);
+}
+
+bool xplaneSocket::getData(MCISvector& spForces, MCISvector& angVelocities, MCISvector& attitude,
+                           uint64_t& sequence, int64_t& recvTimeNs)
+{
+    xplaneSample sample;
+    for (int i = 0; i < XP_GETDATA_MAX_TRIES; i++)
+    {
+        if (latestSample.tryLoad(sample))
+        {
+            spForces        = sample.sf;
+            angVelocities   = sample.angv;
+            attitude        = sample.att;
+            sequence        = sample.sequence;
+            recvTimeNs      = sample.recvTimeNs;
+
+            bool isNew = (sample.sequence != lastSequence);
+            lastSequence = sample.sequence;
+            return isNew;
+        }
+    }
+    return false;
 }
\ No newline at end of file
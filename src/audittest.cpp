@@ -0,0 +1,154 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+
+//Checks that the ENGAGED hot path of the send thread neither allocates nor
+//makes more syscalls than it should, for every cueing engine.
+//The interface is engaged through the override (no MB needed) and fed 
+//X-Plane messages at 60 Hz, then the audit reports for whole ticks and for
+//the cueing engine step are checked. Any allocation fails the test.
+//
+//Needs the instrumentation build of the libraries (cmake -DMCIS_AUDIT=ON).
+//Build: g++ -std=c++11 -O2 -pthread -DMCIS_AUDIT audittest.cpp -o audittest 
+//          -lMCIS_MB_interface -lMCIS_xplane_sock -lMCIS_MDA -lMCIS_MPC 
+//          -lMCIS_MDA_adaptive -lMCIS_logger -lMCIS_fileio -lMCIS_rt -lMCIS_pll -lMCIS_tracking
+//          -lMCIS_recorder -lMCIS_journal -lMCIS_histogram -lMCIS_audit -lMCIS_reactor -lMCIS_uring 
+//          -lMCIS_discreteMath -lMCIS_diag -lMCIS_util -lMCIS_config -lMCIS_crc -ldl
+
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include "include/MCIS_MB_interface.h"
+#include "include/MCIS_audit.h"
+#include "include/MCIS_util.h"
+#include "include/MCIS_testharness.h"
+
+#define TEST_XPLANE_PORT    49720
+
+#define XPLANE_RATE_HZ      60
+#define ENGAGED_SECONDS     3
+
+//Syscalls a tick may make: waiting for it and, on a tock, sending the 
+//command. The event and PLL tick modes add one or two more.
+#define MAX_TICK_SYSCALLS   4
+
+class auditCase
+{
+    public:
+
+    const char *name;
+    cueing_engine engine;
+    bool single_precision;
+};
+
+static bool runCase(const auditCase& test, uint16_t xplanePort)
+{
+    //The MB must exist for sendto to succeed quietly, it never answers
+    testMB fakeMB;
+    testInterface iface("audittest", xplanePort, rtTimingConfig(), test.single_precision, test.engine);
+    mbinterface& mb = iface.mb;
+    bool engaged = iface.engage();
+
+    feedXplane(xplanePort, XPLANE_RATE_HZ, ENGAGED_SECONDS);
+
+    engaged = engaged && (ENGAGED == mb.get_iface_status());
+    auditReport tick = mb.get_audit_report(AUDIT_TICK);
+    auditReport step = mb.get_audit_report(AUDIT_MDA_STEP);
+    mb.stop();
+    fakeMB.stop();
+
+    std::cout << test.name << ":" << std::endl;
+    std::cout << "  " << mbinterface::audit_region_name(AUDIT_TICK) << ": ";
+    tick.print(std::cout);
+    std::cout << std::endl;
+    std::cout << "  " << mbinterface::audit_region_name(AUDIT_MDA_STEP) << ": ";
+    step.print(std::cout);
+    std::cout << std::endl;
+
+    bool ok = true;
+    if (!engaged || !tick.runs || !step.runs)
+    {
+        std::cout << "  never engaged, nothing audited" << std::endl;
+        ok = false;
+    }
+    if (tick.total.allocations || step.total.allocations)
+    {
+        std::cout << "  the hot path allocates" << std::endl;
+        ok = false;
+    }
+    if (step.total.syscalls)
+    {
+        std::cout << "  the cueing engine makes syscalls" << std::endl;
+        ok = false;
+    }
+    if (tick.worst.syscalls > MAX_TICK_SYSCALLS)
+    {
+        std::cout << "  too many syscalls in one tick" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    //Without the hooks every check would pass, so make sure they are there
+    //(through a volatile pointer, or the compiler may drop the pair)
+    auditCounts before = auditThreadCounts();
+    int *volatile probe = new int(0);
+    delete probe;
+    auditCounts hooked = auditThreadCounts() - before;
+    if (!auditEnabled() || (1 != hooked.allocations) || (1 != hooked.frees))
+    {
+        std::cout << "Not an MCIS_AUDIT build, nothing can be checked" << std::endl;
+        std::cout << "FAILED" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const auditCase cases[] =
+    {
+        {"Classical",                   CUEING_CLASSICAL,   false},
+        {"Classical, single precision", CUEING_CLASSICAL,   true},
+        {"MPC",                         CUEING_MPC,         false},
+        {"Adaptive",                    CUEING_ADAPTIVE,    false},
+    };
+
+    bool passed = true;
+    uint16_t xplanePort = TEST_XPLANE_PORT;
+    for (const auditCase& test : cases)
+    {
+        passed &= runCase(test, xplanePort++);
+    }
+
+    if (!passed)
+    {
+        std::cout << "FAILED" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+//Test for the real-time diagnostics:
+//  - Reports from several threads at once are all counted
+//  - A diagnostic reported over and over gets one line per 
+//      DIAG_REPORT_INTERVAL_NS, with how many times it happened since
+//  - Reports from before a drain started are printed by it
+//  - stop() prints whatever is still pending
+//  - diagLatest finds the most recent diagnostic
+//
+//Build: g++ -std=c++11 -O2 -pthread diagtest.cpp -o diagtest -lMCIS_diag -lMCIS_util
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "include/MCIS_diag.h"
+#include "include/MCIS_testutil.h"
+
+#define TEST_THREADS 4
+#define TEST_REPORTS 10000
+
+static size_t countLines(const std::string& text)
+{
+    size_t lines = 0;
+    for (char c : text)
+    {
+        if ('\n' == c)
+        {
+            lines++;
+        }
+    }
+    return lines;
+}
+
+int main()
+{
+    //Reported before any drain runs
+    diagReport(DIAG_XP_WRONG_LENGTH, 42);
+
+    //Several threads hammering the same diagnostic
+    std::vector<std::thread> threads;
+    for (int t = 0; t < TEST_THREADS; t++)
+    {
+        threads.push_back(std::thread([]()
+        {
+            for (int i = 0; i < TEST_REPORTS; i++)
+            {
+                diagReport(DIAG_MB_SEND_FAILED, i);
+            }
+        }));
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    check(TEST_THREADS * TEST_REPORTS == diagGetStatus(DIAG_MB_SEND_FAILED).count, 
+          "every report from every thread counted");
+    check(TEST_REPORTS - 1 == diagGetStatus(DIAG_MB_SEND_FAILED).last_value, "latest value kept");
+    check(TEST_THREADS * TEST_REPORTS + 1 == diagTotal(), "total");
+
+    diag_id id;
+    diagStatus status;
+    check(diagLatest(id, status) && (DIAG_MB_SEND_FAILED == id), "latest diagnostic");
+
+    std::ostringstream out;
+    {
+        diagDrain drain(out);
+        std::this_thread::sleep_for(std::chrono::milliseconds(3 * DIAG_DRAIN_SLEEP_MS));
+        std::string first = out.str();
+        check(2 == countLines(first), "one line each for the pending diagnostics");
+        check(std::string::npos != first.find("(40000 times)"), "repeats summed up");
+        check(std::string::npos != first.find("42"), "report from before the drain printed");
+
+        //Reported every 5 ms for a bit over two intervals: a line for the
+        //first, then one per interval
+        auto start = std::chrono::steady_clock::now();
+        auto length = std::chrono::nanoseconds((int64_t)DIAG_REPORT_INTERVAL_NS * 9 / 4);
+        int reported = 0;
+        while (std::chrono::steady_clock::now() - start < length)
+        {
+            diagReport(DIAG_XP_RECV_FAILED, 11);
+            reported++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        size_t during = countLines(out.str()) - 2;
+        check((during >= 2) && (during <= 3), "at most one line per interval");
+
+        //The last few wait for the interval, stop() shouldn't
+        diagReport(DIAG_XP_RECV_FAILED, 12);
+        drain.stop();
+        check(diagGetStatus(DIAG_XP_RECV_FAILED).count == (uint64_t)reported + 1, "recv failures counted");
+        check(countLines(out.str()) == drain.get_lines(), "lines counted");
+        check(countLines(out.str()) == 2 + during + 1, "pending line printed on stop");
+    }
+
+    if (failures)
+    {
+        std::cout << out.str();
+    }
+    return testSummary("Diagnostics");
+}
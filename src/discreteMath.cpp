@@ -25,6 +25,7 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
 */
 
+
 #include <iostream>
 #include <cmath>
 #include <vector>
@@ -46,7 +47,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * For safety, the delays are also explicitly reset to zero (these can be
  * overriden later using setState) 
  */
-discreteFilt2ndOrder::discreteFilt2ndOrder(const std::vector<double>& aGainIn, const std::vector<double>& bGainIn)
+template <typename T>
+basicDiscreteFilt2ndOrder<T>::basicDiscreteFilt2ndOrder(const std::vector<double>& aGainIn, const std::vector<double>& bGainIn)
 {
     this -> setParams(aGainIn, bGainIn);
     this -> resetState();      
@@ -60,7 +62,8 @@ discreteFilt2ndOrder::discreteFilt2ndOrder(const std::vector<double>& aGainIn, c
  * For safety, the delays are also explicitly reset to zero (these can be
  * overriden later using setState) 
  */
-discreteFilt2ndOrder::discreteFilt2ndOrder(const discreteBiquadSectionParams& config)
+template <typename T>
+basicDiscreteFilt2ndOrder<T>::basicDiscreteFilt2ndOrder(const discreteBiquadSectionParams& config)
 {
     this -> setParams(config);
     this -> resetState();
@@ -71,7 +74,8 @@ discreteFilt2ndOrder::discreteFilt2ndOrder(const discreteBiquadSectionParams& co
  * 
  * Sets the gains to new values, if the vector lengths match the existing
  */
-void discreteFilt2ndOrder::setParams(const std::vector<double>& aGainIn, const std::vector<double>& bGainIn)
+template <typename T>
+void basicDiscreteFilt2ndOrder<T>::setParams(const std::vector<double>& aGainIn, const std::vector<double>& bGainIn)
 {
     //Start by checking the order
     /*
@@ -90,8 +94,8 @@ void discreteFilt2ndOrder::setParams(const std::vector<double>& aGainIn, const s
     //On to the useful stuff
     for (int i = 0; i <  3; i++)
     {
-        aGains[i] = aGainIn[i];
-        bGains[i] = bGainIn[i];
+        aGains[i] = (T)aGainIn[i];
+        bGains[i] = (T)bGainIn[i];
     }
 }
 
@@ -100,20 +104,22 @@ void discreteFilt2ndOrder::setParams(const std::vector<double>& aGainIn, const s
  * 
  * Sets the gains according to a discreteBiquadSectionParams object
  */
-void discreteFilt2ndOrder::setParams(const discreteBiquadSectionParams& config)
+template <typename T>
+void basicDiscreteFilt2ndOrder<T>::setParams(const discreteBiquadSectionParams& config)
 {
     aGains[0] = 1;
-    aGains[1] = config.a1;
-    aGains[2] = config.a2;
-    bGains[0] = config.b0;
-    bGains[1] = config.b1;
-    bGains[2] = config.b2;
+    aGains[1] = (T)config.a1;
+    aGains[2] = (T)config.a2;
+    bGains[0] = (T)config.b0;
+    bGains[1] = (T)config.b1;
+    bGains[2] = (T)config.b2;
 }
 
 /*
  *  resetState resets the delays vector to zero
  */
-void discreteFilt2ndOrder::resetState()
+template <typename T>
+void basicDiscreteFilt2ndOrder<T>::resetState()
 {
     for (int i = 0; i <  3; i++)
     {
@@ -132,7 +138,8 @@ void discreteFilt2ndOrder::resetState()
  * newState[2] - output of second delay
  * 
  */
-void discreteFilt2ndOrder::setState(const std::vector<double>& newState)
+template <typename T>
+void basicDiscreteFilt2ndOrder<T>::setState(const std::vector<double>& newState)
 {
     //Start by checking the order
     /*
@@ -150,10 +157,41 @@ void discreteFilt2ndOrder::setState(const std::vector<double>& newState)
 
     for (int i = 1; i < 3; i++)
     {
-        delays[i] = newState[i];
+        delays[i] = (T)newState[i];
     } 
 }
 
+/*
+ *  initSteadyState sets the delays to the equilibrium for a constant input
+ * 
+ * With a constant input u, every delay of the direct form II structure settles
+ * on the same value, w = u / (1 + a1 + a2), and the output settles on 
+ * (b0 + b1 + b2) * w. Starting from this state, the filter produces no 
+ * transient as long as the input stays put.
+ * 
+ * Filters with a pole at z = 1 (integrators) have no equilibrium for a non-zero
+ * input. Those are reset to zero, which is as good a guess as any.
+ * 
+ * The state is applied through setState and the steady-state output is returned.
+ */
+template <typename T>
+T basicDiscreteFilt2ndOrder<T>::initSteadyState(T input)
+{
+    T denominator = 1 + aGains[1] + aGains[2];
+
+    if (std::fabs(denominator) < 1e-12)
+    {
+        this -> resetState();
+        return currOutput;
+    }
+
+    T w = input / denominator;
+    this -> setState(std::vector<double>{0, w, w});
+
+    currOutput = (bGains[0] + bGains[1] + bGains[2]) * w;
+    return currOutput;
+}
+
 /*
  *  nextSample runs the filter through one sample time, effectively moving
  * forward in time by one quantum
@@ -162,7 +200,8 @@ void discreteFilt2ndOrder::setState(const std::vector<double>& newState)
  * 
  * Thread safety is left up to higher layers, for efficiency reasons.
  */
-double discreteFilt2ndOrder::nextSample(double newInput)
+template <typename T>
+T basicDiscreteFilt2ndOrder<T>::nextSample(T newInput)
 {
     //This is the direct form II difference equation
     delays[0] = newInput - aGains[1]*delays[1] - aGains[2]*delays[2];
@@ -177,115 +216,134 @@ double discreteFilt2ndOrder::nextSample(double newInput)
 
 
 /*
- *       ---=== Generic vector function definitions ===---
  *
- *                  ***** Constructors *****
- * 
- */ 
-
-/*
- *  Initial length constructor
+ *      ---=== class biquadCoeffs ===---
  * 
- *  Constructs the elements vector with initial size vectorLen
  */
-genericVector::genericVector(const unsigned int vectorLen) : elements(vectorLen, 0)
-{}
 
 /*
- *  Move constructor
- * 
- *  Move an existing genericVector and use it as the elements vector
+ *  Default constructor, a filter that outputs zero
  */
-genericVector::genericVector(genericVector&& toBeMoved)
-{
-    elements.swap(toBeMoved.elements);
-}
+template <typename T>
+basicBiquadCoeffs<T>::basicBiquadCoeffs() : a1{0}, a2{0}, b0{0}, b1{0}, b2{0} {}
 
-/* 
- *  Copy constructor
- *  
- *  Copy an existing genericVector by copying its elements into our own
+/*
+ *  Coefficients setter, same conversions as discreteFilt2ndOrder::setParams
  */
-genericVector::genericVector(const genericVector& toBeCopied)
+template <typename T>
+void basicBiquadCoeffs<T>::setParams(const discreteBiquadSectionParams& config)
 {
-    elements = toBeCopied.elements;
+    a1 = (T)config.a1;
+    a2 = (T)config.a2;
+    b0 = (T)config.b0;
+    b1 = (T)config.b1;
+    b2 = (T)config.b2;
 }
 
 /*
- *  Pseudo-copy constructor
- * 
- *  Copy an existing std::vector and use that as the elements vector
+ *  initSteadyState, see discreteFilt2ndOrder::initSteadyState
  */
-genericVector::genericVector(const std::vector<double>& scalars)
+template <typename T>
+T basicBiquadCoeffs<T>::initSteadyState(T (&state)[2], T input) const
 {
-    elements = scalars; 
+    T denominator = 1 + a1 + a2;
+
+    if (std::fabs(denominator) < 1e-12)
+    {
+        state[0] = 0;
+        state[1] = 0;
+        return 0;
+    }
+
+    T w = input / denominator;
+    state[0] = w;
+    state[1] = w;
+
+    return (b0 + b1 + b2) * w;
 }
 
 /*
- *  Pseudo-move constructor
- * 
- *  Move an existing std::vector and use that as the elements vector
+ *  nextSample, see discreteFilt2ndOrder::nextSample
  */
-genericVector::genericVector(std::vector<double>&& scalars)
+template <typename T>
+T basicBiquadCoeffs<T>::nextSample(T (&state)[2], T newInput) const
 {
-    elements.swap(scalars); 
-}
-
-
+    T w0  = newInput - a1*state[0] - a2*state[1];
+    T out = b0*w0 + b1*state[0] + b2*state[1];
 
+    state[1] = state[0];
+    state[0] = w0;
 
+    return out;
+}
 
 
 /*
+ *       ---=== Generic vector function definitions ===---
  *
- *          ***** Operator overloads *****
+ *                  ***** Constructors *****
  * 
- */
+ */ 
 
 /*
- *  Copy assignment
+ *  Default constructor
+ * 
+ *  Zeroes the storage. Used by the subclasses, which know their own size.
  */
-genericVector&  genericVector::operator=(const genericVector& rhs)
+template <typename T, unsigned int N>
+basicGenericVector<T, N>::basicGenericVector()
 {
-    if (this != &rhs)
+    for (unsigned int i = 0; i < N; i++)
     {
-        elements = rhs.elements;
+        elements[i] = 0;
     }
-    return *this;
 }
 
 /*
- *  Move assignment
+ *  Pseudo-copy constructor
+ * 
+ *  Copy an existing std::vector into the elements array. Sizes must match.
  */
-genericVector& genericVector::operator=(genericVector&& rhs)
+template <typename T, unsigned int N>
+basicGenericVector<T, N>::basicGenericVector(const std::vector<T>& scalars)
 {
-    if (this != &rhs)
+    if (scalars.size() != N)
     {
-        elements.swap(rhs.elements);
+        //Throw an exception since we have the wrong size
+        std::length_error mismatchedLengthException("Vector initializer has the wrong number of elements!\n");
+        throw mismatchedLengthException;
+    }
+    for (unsigned int i = 0; i < N; i++)
+    {
+        elements[i] = scalars[i];
     }
-    return *this;
 }
 
+
+
+/*
+ *
+ *          ***** Operator overloads *****
+ * 
+ */
+
 /*
  *  Equality test
  * 
- *  Returns false if the sizes don't match or if a non-matching element is found.
+ *  Returns false if a non-matching element is found.
  *  Returns true otherwise
  */
-bool genericVector::operator==(const genericVector& rhs)
+template <typename T, unsigned int N>
+bool basicGenericVector<T, N>::operator==(const basicGenericVector& rhs) const
 {
-    if (this -> elements.size() == rhs.elements.size())
+    for (unsigned int i = 0; i < N; i++)
     {
-        for (unsigned int i = 0; i < this -> elements.size(); i++)
+        if (this -> elements[i] != rhs.elements[i])
         {
-            if (this -> elements[i] != rhs.elements[i])
-            {
-                return false;
-            }            
-        }
-        return true;
+            return false;
+        }            
     }
-    return false;
+    return true;
 }
 
 /*
@@ -295,7 +353,8 @@ bool genericVector::operator==(const genericVector& rhs)
  * 
  * Could potentially be optimized, but who cares...
  */
-bool genericVector::operator!=(const genericVector& rhs)
+template <typename T, unsigned int N>
+bool basicGenericVector<T, N>::operator!=(const basicGenericVector& rhs) const
 {
     return !(*this==rhs);
 }
@@ -305,18 +364,12 @@ bool genericVector::operator!=(const genericVector& rhs)
  * 
  * Sums each element of the vectors and stores in the lhs.
  * 
- * Throws std::length_error if the sizes don't match.
+ * Sizes are part of the type, so there is nothing to check.
  */
-genericVector& genericVector::operator+=(const genericVector& rhs)
+template <typename T, unsigned int N>
+basicGenericVector<T, N>& basicGenericVector<T, N>::operator+=(const basicGenericVector& rhs)
 {
-    if (this->elements.size() != rhs.elements.size())
-    {
-        //Vector sizes don't match, throw exception
-        std::length_error mismatchedLengthException("Vectors to sum must be of same size!\n");
-        throw mismatchedLengthException;
-    }
-
-    for (unsigned int i = 0; i < this->elements.size(); i++)
+    for (unsigned int i = 0; i < N; i++)
     {
         this->elements[i] += rhs.elements[i];
     }
@@ -329,18 +382,12 @@ genericVector& genericVector::operator+=(const genericVector& rhs)
  * 
  * Subtracts each element of the vectors and stores in the lhs.
  * 
- * Throws std::length_error if the sizes don't match.
+ * Sizes are part of the type, so there is nothing to check.
  */
-genericVector& genericVector::operator-=(const genericVector& rhs)
+template <typename T, unsigned int N>
+basicGenericVector<T, N>& basicGenericVector<T, N>::operator-=(const basicGenericVector& rhs)
 {
-    if (this->elements.size() != rhs.elements.size())
-    {
-        //Vector sizes don't match, throw exception
-        std::length_error mismatchedLengthException("Vectors to subtract must be of same size!\n");
-        throw mismatchedLengthException;
-    }
-
-    for (unsigned int i = 0; i < this->elements.size(); i++)
+    for (unsigned int i = 0; i < N; i++)
     {
         this->elements[i] -= rhs.elements[i];
     }
@@ -356,9 +403,10 @@ genericVector& genericVector::operator-=(const genericVector& rhs)
  * Note that dot product and cross product are defined separately and only 
  * for the cases of interest. Again, this is vector *= scalar.
  */
-genericVector& genericVector::operator*=(const double rhs)
+template <typename T, unsigned int N>
+basicGenericVector<T, N>& basicGenericVector<T, N>::operator*=(const T rhs)
 {
-    for (unsigned int i = 0; i < this -> elements.size(); i++)
+    for (unsigned int i = 0; i < N; i++)
     {
         this->elements[i] *= rhs;
     }
@@ -372,72 +420,16 @@ genericVector& genericVector::operator*=(const double rhs)
  * but this is so trivial we might as well implement it for the sake
  * of completeness 
  */
-genericVector& genericVector::operator/=(const double rhs)
+template <typename T, unsigned int N>
+basicGenericVector<T, N>& basicGenericVector<T, N>::operator/=(const T rhs)
 {
-    for (unsigned int i = 0; i < this -> elements.size(); i++)
+    for (unsigned int i = 0; i < N; i++)
     {
         this->elements[i] /= rhs;
     }
     return *this;
 }
 
-/*
- *  genericVector sum
- * 
- * As is usual, uses compound operator for heavy lifting
- * 
- * Declared   because it really should be
- */
-  genericVector operator+(genericVector lhs, const genericVector& rhs)
-{
-    lhs += rhs;
-    return lhs;
-}
-
-/*
- *  genericVector subtraction
- * 
- * As is usual, uses compound operator for heavy lifting
- * 
- * Declared   because it really should be
- */
-  genericVector operator-(genericVector lhs, const genericVector& rhs)
-{
-    lhs -= rhs;
-    return lhs;
-}
-
-/*
- *  genericVector multiplication with scalar
- * 
- * As is usual, uses compound operator for heavy lifting. Two versions
- * exist, because this operation is commutative.
- * 
- * Declared   because it really should be
- */
-  genericVector operator*(genericVector lhs, double rhs)
-{
-    return lhs *= rhs;
-}
-// Reverse order of parameters to satisfy commutativity
-  genericVector operator*(double lhs, genericVector rhs)
-{
-    return rhs *= lhs;
-}
-
-/*
- *  genericVector division with scalar
- * 
- * As is usual, uses compound operator for heavy lifting. Only one
- * version exists because division by vector is not defined.
- * 
- * Declared   because it really should be
- */
-  genericVector operator/(genericVector lhs, const double rhs)
-{
-    return lhs /= rhs;
-}
-
 
 
 
@@ -449,12 +441,11 @@ genericVector& genericVector::operator/=(const double rhs)
 
 /*
  *  Simple, safe function to get an element from the vector
- * 
- * Declared  
  */
-  double genericVector::getVal(unsigned int position) const
+template <typename T, unsigned int N>
+T basicGenericVector<T, N>::getVal(unsigned int position) const
 {
-    if (position >= this->elements.size())
+    if (position >= N)
     {
         //Requested element does not exist, throw exception
         std::out_of_range invalidSubscriptException("Requested vector element is out of bounds!\n");
@@ -465,12 +456,11 @@ genericVector& genericVector::operator/=(const double rhs)
 
 /*
  *  Simple, safe function to set an element from the vector
- * 
- * Declared  
  */
-  void genericVector::setVal(unsigned int position, double value)
+template <typename T, unsigned int N>
+void basicGenericVector<T, N>::setVal(unsigned int position, T value)
 {
-    if (position >= this->elements.size())
+    if (position >= N)
     {
         //Requested element does not exist, throw exception
         std::out_of_range invalidSubscriptException("Requested vector element is out of bounds!\n");
@@ -482,7 +472,8 @@ genericVector& genericVector::operator/=(const double rhs)
 /*
  *  Pretty-print a linear vector
  */
-void genericVector::print(std::ostream& dest)
+template <typename T, unsigned int N>
+void basicGenericVector<T, N>::print(std::ostream& dest)
 {
     //dest.width(8);
     //dest.precision(9);
@@ -509,76 +500,42 @@ void genericVector::print(std::ostream& dest)
 /*
  *  Default constructor
  * 
- * This one just creates an appropriately-sized vector by calling the parent's
+ * This one just creates a zeroed vector by calling the parent's
  * constructor.
  */
-MCISvector::MCISvector() : genericVector(3)
+template <typename T>
+basicMCISvector<T>::basicMCISvector() : basicGenericVector<T, 3>()
 {}
 
 /*
- *  Initial length constructor
- * 
- *  Constructs the elements vector with initial size vectorLen
+ *  Convenient constructor
  */
-MCISvector::MCISvector(double a, double b, double c) : genericVector(3)
+template <typename T>
+basicMCISvector<T>::basicMCISvector(T a, T b, T c)
 {
-    elements[0] = a;
-    elements[1] = b;
-    elements[2] = c;
+    this -> elements[0] = a;
+    this -> elements[1] = b;
+    this -> elements[2] = c;
 }
 
 /*
  *  Vector initializer constructor
+ * 
+ * The parent throws std::length_error if the size isn't 3
  */
-MCISvector::MCISvector(const std::vector<double>& scalars) : genericVector(3)
-{
-    if (scalars.size() != 3)
-    {
-        //Throw an exception since we have the wrong size
-        std::length_error mismatchedLengthException("MCISvectors must be of size 3!\n");
-        throw mismatchedLengthException;
-    }
-    this->elements = scalars;
-}
-
-/*
- *  Vector initializer constructor, move version
- */
-MCISvector::MCISvector(std::vector<double>&& scalars) : genericVector(3)
-{
-    if (scalars.size() != 3)
-    {
-        //Throw an exception since we have the wrong size
-        std::length_error mismatchedLengthException("MCISvectors must be of size 3!\n");
-        throw mismatchedLengthException;
-    }
-    this->elements.swap(scalars);
-}
-
-/* 
- *  Copy constructor
- */
-MCISvector::MCISvector(const MCISvector& toBeCopied) : genericVector(3)
-{
-    this->elements = toBeCopied.elements;
-}
-
-/* 
- *  Move constructor
- */
-MCISvector::MCISvector(MCISvector&& toBeCopied) : genericVector(3)
-{
-    this->elements.swap(toBeCopied.elements);
-}
+template <typename T>
+basicMCISvector<T>::basicMCISvector(const std::vector<T>& scalars) : basicGenericVector<T, 3>(scalars)
+{}
 
 /*
  *  Convenient all-at-once assignment
  */
-void MCISvector::assign(double a, double b, double c)
+template <typename T>
+void basicMCISvector<T>::assign(T a, T b, T c)
 {
-    elements[0] = a;
-    elements[1] = b;
-    elements[2] = c;
+    this -> elements[0] = a;
+    this -> elements[1] = b;
+    this -> elements[2] = c;
 }
 
 /*
@@ -594,9 +551,10 @@ void MCISvector::assign(double a, double b, double c)
  * 
  * Doubly so for modern CPUs.
  */
-double MCISvector::dotProduct(const MCISvector& aVector, const MCISvector& bVector)
+template <typename T>
+T basicMCISvector<T>::dotProduct(const basicMCISvector& aVector, const basicMCISvector& bVector)
 {
-    double output;
+    T output;
 
     output =    aVector.elements[0]*bVector.elements[0] + 
                 aVector.elements[1]*bVector.elements[1] +
@@ -609,108 +567,72 @@ double MCISvector::dotProduct(const MCISvector& aVector, const MCISvector& bVect
 /*
  *  Calculate the cross product of two vectors of length 3
  */
-MCISvector MCISvector::crossProduct(const MCISvector& aVector, const MCISvector& bVector)
+template <typename T>
+basicMCISvector<T> basicMCISvector<T>::crossProduct(const basicMCISvector& aVector, const basicMCISvector& bVector)
 {
-    std::vector<double> result (3);
-    result[0] = aVector.elements[1]*bVector.elements[2] - aVector.elements[2]*bVector.elements[1];
-    result[1] = aVector.elements[2]*bVector.elements[0] - aVector.elements[0]*bVector.elements[2];
-    result[2] = aVector.elements[0]*bVector.elements[1] - aVector.elements[1]*bVector.elements[0];
+    basicMCISvector resOut;
+    resOut.elements[0] = aVector.elements[1]*bVector.elements[2] - aVector.elements[2]*bVector.elements[1];
+    resOut.elements[1] = aVector.elements[2]*bVector.elements[0] - aVector.elements[0]*bVector.elements[2];
+    resOut.elements[2] = aVector.elements[0]*bVector.elements[1] - aVector.elements[1]*bVector.elements[0];
 
-    MCISvector resOut(result);
-
-    //return std::move(resOut);
     return resOut;
 }
 
 /*
  *  Apply a set of three scalar gains to the vector
  */
-void MCISvector::applyScalarGains(double a, double b, double c)
+template <typename T>
+void basicMCISvector<T>::applyScalarGains(T a, T b, T c)
 {
-    elements[0] *= a;
-    elements[1] *= b;
-    elements[2] *= c;
+    this -> elements[0] *= a;
+    this -> elements[1] *= b;
+    this -> elements[2] *= c;
 
 }
 
 /*
  *          ***** Operator Overloads *****
  */
-MCISvector& MCISvector::operator=(const MCISvector& rhs)
-{
-     if (this != &rhs)
-    {
-        elements = rhs.elements;
-    }
-    return *this;
-}
-MCISvector& MCISvector::operator=(MCISvector&& rhs)
-{
-    if (this != &rhs)
-    {
-        elements.swap(rhs.elements);
-    }
-    return *this;
-}
 /* 
  * These all call their parent operator functions. Behavior is identical,
  * but this is a required formality.
  */
-  bool MCISvector::operator==(const MCISvector& rhs)
+template <typename T>
+bool basicMCISvector<T>::operator==(const basicMCISvector& rhs) const
 {
-    return genericVector::operator==(rhs);
+    return basicGenericVector<T, 3>::operator==(rhs);
 }
-  bool MCISvector::operator!=(const MCISvector& rhs)
+template <typename T>
+bool basicMCISvector<T>::operator!=(const basicMCISvector& rhs) const
 {
-    return genericVector::operator!=(rhs);
+    return basicGenericVector<T, 3>::operator!=(rhs);
 }
 
-  MCISvector& MCISvector::operator+=(const MCISvector& rhs)
+template <typename T>
+basicMCISvector<T>& basicMCISvector<T>::operator+=(const basicMCISvector& rhs)
 {
-    genericVector::operator+=(rhs);
+    basicGenericVector<T, 3>::operator+=(rhs);
     return *this;
 }
-  MCISvector& MCISvector::operator-=(const MCISvector& rhs)
+template <typename T>
+basicMCISvector<T>& basicMCISvector<T>::operator-=(const basicMCISvector& rhs)
 {
-    genericVector::operator-=(rhs);
+    basicGenericVector<T, 3>::operator-=(rhs);
     return *this;
 }
-  MCISvector& MCISvector::operator*=(double rhs)
+template <typename T>
+basicMCISvector<T>& basicMCISvector<T>::operator*=(T rhs)
 {
-    genericVector::operator*=(rhs);
+    basicGenericVector<T, 3>::operator*=(rhs);
     return *this;
 }
-  MCISvector& MCISvector::operator/=(double rhs)
+template <typename T>
+basicMCISvector<T>& basicMCISvector<T>::operator/=(T rhs)
 {
-    genericVector::operator/=(rhs);
+    basicGenericVector<T, 3>::operator/=(rhs);
     return *this;
 }
 
-/*
- *  For binary operators, we call the compound operators
- * for MCISvector
- */
-MCISvector operator+(MCISvector lhs, const MCISvector& rhs)
-{
-    return lhs += rhs;
-}
-MCISvector operator-(MCISvector lhs, const MCISvector& rhs)
-{
-    return lhs -= rhs;
-}
-MCISvector operator*(MCISvector lhs, double rhs)
-{
-    return lhs *= rhs;
-}
-MCISvector operator*(double lhs, MCISvector rhs)
-{
-    return rhs *= lhs;
-}
-MCISvector operator/(MCISvector lhs, double rhs)
-{
-    return lhs /= rhs;
-}
-
 
 /*
  *  ---=== MCISmatrix function definitions ===---
@@ -721,165 +643,79 @@ MCISvector operator/(MCISvector lhs, double rhs)
 /*
  *  Default constructor
  * 
- * Constructs the elements vector with size 9
+ * Zeroes all 9 elements
  */
-MCISmatrix::MCISmatrix() : genericVector(9)
+template <typename T>
+basicMCISmatrix<T>::basicMCISmatrix() : basicGenericVector<T, 9>()
 {}
 
 /*
  *  Convenient constructor
  * 
- *  Constructs the elements vector with initial size 9 and assigns
- * nine doubles
+ *  Assigns all nine elements
  */
-MCISmatrix::MCISmatrix( double a, double b, double c,
-                        double d, double e, double f,
-                        double g, double h, double i) : genericVector(9)
+template <typename T>
+basicMCISmatrix<T>::basicMCISmatrix(T a, T b, T c,
+                                    T d, T e, T f,
+                                    T g, T h, T i)
 {
-    this -> elements[0] = a;
-    this -> elements[1] = b;
-    this -> elements[2] = c;
-
-    this -> elements[3] = d;
-    this -> elements[4] = e;
-    this -> elements[5] = f;
-
-    this -> elements[6] = g;
-    this -> elements[7] = h;
-    this -> elements[8] = i;
+    this -> assign(a, b, c, d, e, f, g, h, i);
 }
 
 /*
  *  std::vector copy constructor
+ * 
+ * The parent throws std::length_error if the size isn't 9
  */
-MCISmatrix::MCISmatrix(const std::vector<double>& scalars) : genericVector(9)
-{
-    if (scalars.size() != 9)
-    {
-        //Throw an exception since we have the wrong size
-        std::length_error mismatchedLengthException("MCISmatrix must have 9 elements!\n");
-        throw mismatchedLengthException;
-    }
-    this -> elements = scalars;
-}
-
-/*
- *  std::vector move constructor
- */
-MCISmatrix::MCISmatrix(std::vector<double>&& scalars) : genericVector(9)
-{
-    if (scalars.size() != 9)
-    {
-        //Throw an exception since we have the wrong size
-        std::length_error mismatchedLengthException("MCISmatrix must have 9 elements!\n");
-        throw mismatchedLengthException;
-    }
-    this -> elements.swap(scalars);
-}
-
-/*
- *  Copy constructor
- */
-MCISmatrix::MCISmatrix(const MCISmatrix& toBeCopied) : genericVector(toBeCopied.elements)
+template <typename T>
+basicMCISmatrix<T>::basicMCISmatrix(const std::vector<T>& scalars) : basicGenericVector<T, 9>(scalars)
 {}
 
-/*
- *  Move constructor
- */
-MCISmatrix::MCISmatrix(MCISmatrix&& toBeMoved) : genericVector(9)
-{
-    this -> elements.swap(toBeMoved.elements);
-}
-
 
 
 /*
  *          ***** Operator OVerloads *****
  */
-  MCISmatrix& MCISmatrix::operator=(const MCISmatrix& rhs)
-{
-     if (this != &rhs)
-    {
-        elements = rhs.elements;
-    }
-    return *this;
-}
-  MCISmatrix& MCISmatrix::operator=(MCISmatrix&& rhs)
-{
-    if (this != &rhs)
-    {
-        elements.swap(rhs.elements);
-    }
-    return *this;
-}
 /* 
  * These all call their parent operator functions. Behavior is identical,
  * but this is a required formality.
  */
-  bool MCISmatrix::operator==(const MCISmatrix& rhs)
+template <typename T>
+bool basicMCISmatrix<T>::operator==(const basicMCISmatrix& rhs) const
 {
-    return genericVector::operator==(rhs);
+    return basicGenericVector<T, 9>::operator==(rhs);
 }
-  bool MCISmatrix::operator!=(const MCISmatrix& rhs)
+template <typename T>
+bool basicMCISmatrix<T>::operator!=(const basicMCISmatrix& rhs) const
 {
-    return genericVector::operator!=(rhs);
+    return basicGenericVector<T, 9>::operator!=(rhs);
 }
 
-  MCISmatrix& MCISmatrix::operator+=(const MCISmatrix& rhs)
+template <typename T>
+basicMCISmatrix<T>& basicMCISmatrix<T>::operator+=(const basicMCISmatrix& rhs)
 {
-    genericVector::operator+=(rhs);
+    basicGenericVector<T, 9>::operator+=(rhs);
     return *this;
 }
-  MCISmatrix& MCISmatrix::operator-=(const MCISmatrix& rhs)
+template <typename T>
+basicMCISmatrix<T>& basicMCISmatrix<T>::operator-=(const basicMCISmatrix& rhs)
 {
-    genericVector::operator-=(rhs);
+    basicGenericVector<T, 9>::operator-=(rhs);
     return *this;
 }
-  MCISmatrix& MCISmatrix::operator*=(double rhs)
+template <typename T>
+basicMCISmatrix<T>& basicMCISmatrix<T>::operator*=(T rhs)
 {
-    genericVector::operator*=(rhs);
+    basicGenericVector<T, 9>::operator*=(rhs);
     return *this;
 }
-  MCISmatrix& MCISmatrix::operator/=(double rhs)
+template <typename T>
+basicMCISmatrix<T>& basicMCISmatrix<T>::operator/=(T rhs)
 {
-    genericVector::operator/=(rhs);
+    basicGenericVector<T, 9>::operator/=(rhs);
     return *this;
 }
 
-/*
- *  For binary operators, we call the compound operators
- * for MCISmatrix
- */
-  MCISmatrix operator+(MCISmatrix lhs, const MCISmatrix& rhs)
-{
-    return lhs += rhs;
-}
-  MCISmatrix operator-(MCISmatrix lhs, const MCISmatrix& rhs)
-{
-    return lhs -= rhs;
-}
-  MCISmatrix operator*(MCISmatrix lhs, double rhs)
-{
-    return lhs *= rhs;
-}
-  MCISmatrix operator*(double lhs, MCISmatrix rhs)
-{
-    return rhs *= lhs;
-}
-  MCISmatrix operator/(MCISmatrix lhs, double rhs)
-{
-    return lhs /= rhs;
-}
-
-/*
- *  Multiplying a  3x3 matrix with a 3x1 column vector is done by calling
- * MCISmatrix::rightMultiplyVector()
- */
-MCISvector operator*(const MCISmatrix& lhs, const MCISvector& rhs)
-{
-    return lhs.rightMultiplyVector(rhs);
-}
-
 
 /*
  *          ***** Assignment and retrieval *****
@@ -895,9 +731,10 @@ MCISvector operator*(const MCISmatrix& lhs, const MCISvector& rhs)
  * | 3 4 5 |
  * | 6 7 8 |
  */
-  void MCISmatrix::assign(double a, double b, double c,
-                               double d, double e, double f,
-                               double g, double h, double i)
+template <typename T>
+void basicMCISmatrix<T>::assign(T a, T b, T c,
+                                T d, T e, T f,
+                                T g, T h, T i)
 {
     this -> elements[0] = a;
     this -> elements[1] = b;
@@ -918,7 +755,8 @@ MCISvector operator*(const MCISmatrix& lhs, const MCISvector& rhs)
  * 
  * Make sure it's not out-of-bounds
  */
-double MCISmatrix::getMatrixElement(unsigned int row, unsigned int column) const
+template <typename T>
+T basicMCISmatrix<T>::getMatrixElement(unsigned int row, unsigned int column) const
 {
     if (row >= 3 || column >= 3)
     {
@@ -935,7 +773,8 @@ double MCISmatrix::getMatrixElement(unsigned int row, unsigned int column) const
  * 
  * Make sure it's not out-of-bounds
  */
-void MCISmatrix::setMatrixElement(unsigned int row, unsigned int column, double value)
+template <typename T>
+void basicMCISmatrix<T>::setMatrixElement(unsigned int row, unsigned int column, T value)
 {
     if (row >= 3 || column >= 3)
     {
@@ -951,7 +790,8 @@ void MCISmatrix::setMatrixElement(unsigned int row, unsigned int column, double
  * 
  * This function overrides genericVector::print
  */
-void MCISmatrix::print(std::ostream& dest)
+template <typename T>
+void basicMCISmatrix<T>::print(std::ostream& dest)
 {
     //dest.width(8);
     //dest.precision(9);
@@ -981,19 +821,20 @@ void MCISmatrix::print(std::ostream& dest)
  *  | d e f || k | = | n |
  *  | g h i || l |   | o |
  */
-MCISvector MCISmatrix::rightMultiplyVector(const MCISvector& vec) const
+template <typename T>
+basicMCISvector<T> basicMCISmatrix<T>::rightMultiplyVector(const basicMCISvector<T>& vec) const
 {
-    MCISvector result;
-    double res;
+    basicMCISvector<T> result;
+    T res;
 
     for(int rowIt = 0; rowIt < 3; rowIt++)
     {
         res = 0;
         for (int colIt = 0; colIt < 3; colIt++)
         {
-            res += (this->elements[rowIt*3 + colIt])*vec.getVal(colIt);
+            res += (this->elements[rowIt*3 + colIt])*vec[colIt];
         }
-        result.setVal(rowIt, res);
+        result[rowIt] = res;
     }
     return result;
 }
@@ -1004,14 +845,15 @@ MCISvector MCISmatrix::rightMultiplyVector(const MCISvector& vec) const
  * The object pointed to by this is *OVERWRITTEN*
  * 
  * This is fine for MCIS because we never really need to reuse the matrix later,
- * so we can save on some allocations. Allocations are evil.
+ * so we can save on some copies.
  * 
  * If needed in the future, a second function can backup the original
  * matrix before transposing, then swap them, then return the original one
  */
-void MCISmatrix::transpose()
+template <typename T>
+void basicMCISmatrix<T>::transpose()
 {
-    double temp;
+    T temp;
 
     temp = this -> elements[1];                 // temp holds b
     this  -> elements[1] = this -> elements[3]; // b now holds d
@@ -1043,23 +885,26 @@ void MCISmatrix::transpose()
 * - Roll, Pitch and Yaw are defined as a ZYX rotation, as this makes
 *   a zero rotation correspond to "level" attitude.
 */
-void MCISmatrix::euler2DCM_ZYX(const MCISvector& eulerAngles)
+template <typename T>
+void basicMCISmatrix<T>::euler2DCM_ZYX(const basicMCISvector<T>& eulerAngles)
 {
     /*
      *  We need the sine and cosine of every element of eulerAngles,
      *  and we need them repeatedly. We'll pre-calculate these first,
      *  then do the rest of the work in a vectorization-friendly manner. 
+     * 
+     *  std::sin and friends pick the float overloads for float.
      */
 
-    double sPhi, sTheta, sPsi, cPhi, cTheta, cPsi;
+    T sPhi, sTheta, sPsi, cPhi, cTheta, cPsi;
 
-    sPhi    = sin(eulerAngles.getVal(0));
-    sTheta  = sin(eulerAngles.getVal(1));
-    sPsi    = sin(eulerAngles.getVal(2));
+    sPhi    = std::sin(eulerAngles[0]);
+    sTheta  = std::sin(eulerAngles[1]);
+    sPsi    = std::sin(eulerAngles[2]);
 
-    cPhi    = cos(eulerAngles.getVal(0));
-    cTheta  = cos(eulerAngles.getVal(1));
-    cPsi    = cos(eulerAngles.getVal(2));
+    cPhi    = std::cos(eulerAngles[0]);
+    cTheta  = std::cos(eulerAngles[1]);
+    cPsi    = std::cos(eulerAngles[2]);
 
     /*
     *  Now we can assign the matrix elements
@@ -1108,7 +953,8 @@ void MCISmatrix::euler2DCM_ZYX(const MCISvector& eulerAngles)
 * - Roll, Pitch and Yaw are defined as a ZYX rotation, as this makes
 *   a zero rotation correspond to "level" attitude.
 */
-void MCISmatrix::euler2DCM_ZYX_inv(const MCISvector& eulerAngles)
+template <typename T>
+void basicMCISmatrix<T>::euler2DCM_ZYX_inv(const basicMCISvector<T>& eulerAngles)
 {
     /*
         *  We need the sine and cosine of every element of eulerAngles,
@@ -1116,15 +962,15 @@ void MCISmatrix::euler2DCM_ZYX_inv(const MCISvector& eulerAngles)
         *  then do the rest of the work in a vectorization-friendly manner. 
         */
 
-    double sPhi, sTheta, sPsi, cPhi, cTheta, cPsi;
+    T sPhi, sTheta, sPsi, cPhi, cTheta, cPsi;
 
-    sPhi    = sin(eulerAngles.getVal(0));
-    sTheta  = sin(eulerAngles.getVal(1));
-    sPsi    = sin(eulerAngles.getVal(2));
+    sPhi    = std::sin(eulerAngles[0]);
+    sTheta  = std::sin(eulerAngles[1]);
+    sPsi    = std::sin(eulerAngles[2]);
 
-    cPhi    = cos(eulerAngles.getVal(0));
-    cTheta  = cos(eulerAngles.getVal(1));
-    cPsi    = cos(eulerAngles.getVal(2));
+    cPhi    = std::cos(eulerAngles[0]);
+    cTheta  = std::cos(eulerAngles[1]);
+    cPsi    = std::cos(eulerAngles[2]);
 
     /*
         *  Now we can assign the matrix elements
@@ -1156,18 +1002,19 @@ void MCISmatrix::euler2DCM_ZYX_inv(const MCISvector& eulerAngles)
      * Euler angle rates. 
      * 
      */
-    void MCISmatrix::pqr2eulerRates(const MCISvector& eulerAngles)
+    template <typename T>
+    void basicMCISmatrix<T>::pqr2eulerRates(const basicMCISvector<T>& eulerAngles)
     {
         /*
          *  We'll need these values repeatedly, so we'll precalculate them
          */
-        double sPhi, cPhi, tanTheta, secTheta;
+        T sPhi, cPhi, tanTheta, secTheta;
 
-        sPhi    = sin(eulerAngles.getVal(0));
-        cPhi    = cos(eulerAngles.getVal(0));
+        sPhi    = std::sin(eulerAngles[0]);
+        cPhi    = std::cos(eulerAngles[0]);
 
-        tanTheta = tan(eulerAngles.getVal(1));
-        secTheta = 1 / cos(eulerAngles.getVal(1));
+        tanTheta = std::tan(eulerAngles[1]);
+        secTheta = 1 / std::cos(eulerAngles[1]);
 
         /*
         *  Now we can assign the matrix elements
@@ -1209,10 +1056,11 @@ void MCISmatrix::euler2DCM_ZYX_inv(const MCISvector& eulerAngles)
  * make any sense. This forces users to think before using a limit.
  * It's a start, at least.
  */
-saturation::saturation(double limSetting, double initOutput)
+template <typename T>
+basicSaturation<T>::basicSaturation(double limSetting, double initOutput)
 {
-    limit   = limSetting;
-    output  = initOutput;
+    limit   = (T)limSetting;
+    output  = (T)initOutput;
 }
 
 /*
@@ -1222,7 +1070,8 @@ saturation::saturation(double limSetting, double initOutput)
  * If it isn't, it gets clamped down to the corresponding positive or 
  * negative limit, depending on sign.
  */
-double saturation::nextSample(double input)
+template <typename T>
+T basicSaturation<T>::nextSample(T input)
 {   
     if (input > limit)
     {
@@ -1246,9 +1095,10 @@ double saturation::nextSample(double input)
  * 
  * Thread safety must be ensured at a higher level!!!
  */
-void saturation::setLimit(double newLim)
+template <typename T>
+void basicSaturation<T>::setLimit(double newLim)
 {
-    limit = newLim;
+    limit = (T)newLim;
 }
 
 
@@ -1265,7 +1115,8 @@ void saturation::setLimit(double newLim)
  * 
  * It calls the parent constructor for heavy lifting.
  */
-rateLimit::rateLimit(double limSetting, double initOutput) : saturation(limSetting, initOutput) {}
+template <typename T>
+basicRateLimit<T>::basicRateLimit(double limSetting, double initOutput) : basicSaturation<T>(limSetting, initOutput) {}
 
 /*
  *  nextSample calculates the next iteration.
@@ -1276,25 +1127,26 @@ rateLimit::rateLimit(double limSetting, double initOutput) : saturation(limSetti
  * 
  * If the limit is not reached, the output is passed through.
  */
-double rateLimit::nextSample(double input)
+template <typename T>
+T basicRateLimit<T>::nextSample(T input)
 {
-    double inputRate = input - output; //x(n) - x(n-1)
-    double absRate = fabs(inputRate);
+    T inputRate = input - this -> output; //x(n) - x(n-1)
+    T absRate = std::fabs(inputRate);
 
-    if (absRate > limit)
+    if (absRate > this -> limit)
     {
         if (inputRate < 0)
         {
-            output -= limit;
+            this -> output -= this -> limit;
         }
         else
         {
-            output += limit;
+            this -> output += this -> limit;
         }
     }
     else
     {
-        output = input;
+        this -> output = input;
     }
     
     /*if (abs(inputRate) > limit && inputRate < 0)
@@ -1310,16 +1162,17 @@ double rateLimit::nextSample(double input)
         output = input;
     }*/
     
-    return output;
+    return this -> output;
 }
 
 /*
  *  This new output is never actually output, it's only used as the reference 
  *  when calculating the rate for the next iteration
  */
-void rateLimit::overrideOutput(double newOutput)
+template <typename T>
+void basicRateLimit<T>::overrideOutput(T newOutput)
 {
-    output = newOutput;
+    this -> output = newOutput;
 }
 
 /*
@@ -1334,7 +1187,8 @@ void rateLimit::overrideOutput(double newOutput)
  * Constructs the indididual scalar rateLimits using the given limit
  * and starting value
  */
-vectorRateLimit::vectorRateLimit(double rateLimit, const MCISvector& initOutput) : 
+template <typename T>
+basicVectorRateLimit<T>::basicVectorRateLimit(double rateLimit, const basicMCISvector<T>& initOutput) : 
     lim0{rateLimit, initOutput.getVal(0)},
     lim1{rateLimit, initOutput.getVal(1)},
     lim2{rateLimit, initOutput.getVal(2)}
@@ -1345,11 +1199,12 @@ vectorRateLimit::vectorRateLimit(double rateLimit, const MCISvector& initOutput)
  * 
  * Apply the rate limit to the given input vector, based on internal state
  */
-void vectorRateLimit::nextSample(MCISvector& input)
+template <typename T>
+void basicVectorRateLimit<T>::nextSample(basicMCISvector<T>& input)
 {
-    input.setVal(0, lim0.nextSample(input.getVal(0)));
-    input.setVal(1, lim1.nextSample(input.getVal(1)));
-    input.setVal(2, lim2.nextSample(input.getVal(2)));
+    input[0] = lim0.nextSample(input[0]);
+    input[1] = lim1.nextSample(input[1]);
+    input[2] = lim2.nextSample(input[2]);
 }
 
 /*
@@ -1357,9 +1212,44 @@ void vectorRateLimit::nextSample(MCISvector& input)
  * 
  * Set a new output value, bypassing the rate limits
  */ 
-void vectorRateLimit::overrideOutput(const MCISvector& newOutput)
+template <typename T>
+void basicVectorRateLimit<T>::overrideOutput(const basicMCISvector<T>& newOutput)
 {
-    lim0.overrideOutput(newOutput.getVal(0));
-    lim1.overrideOutput(newOutput.getVal(1));
-    lim2.overrideOutput(newOutput.getVal(2));
+    lim0.overrideOutput(newOutput[0]);
+    lim1.overrideOutput(newOutput[1]);
+    lim2.overrideOutput(newOutput[2]);
 }
+
+
+
+/*
+ *  Explicit instantiations
+ * 
+ * Only double and single precision are ever used, so everything above is
+ * compiled for those two here, and the header only needs the declarations.
+ */
+template class basicDiscreteFilt2ndOrder<double>;
+template class basicDiscreteFilt2ndOrder<float>;
+
+template class basicBiquadCoeffs<double>;
+template class basicBiquadCoeffs<float>;
+
+template class basicGenericVector<double, 3>;
+template class basicGenericVector<float, 3>;
+template class basicGenericVector<double, 9>;
+template class basicGenericVector<float, 9>;
+
+template class basicMCISvector<double>;
+template class basicMCISvector<float>;
+
+template class basicMCISmatrix<double>;
+template class basicMCISmatrix<float>;
+
+template class basicSaturation<double>;
+template class basicSaturation<float>;
+
+template class basicRateLimit<double>;
+template class basicRateLimit<float>;
+
+template class basicVectorRateLimit<double>;
+template class basicVectorRateLimit<float>;
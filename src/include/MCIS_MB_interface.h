@@ -28,6 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
 #include <fstream>
+#include <atomic>
 #include <thread>
 #include <chrono>
 #include <stdexcept>
@@ -37,6 +38,20 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <arpa/inet.h>
 
 #include "MCIS_MDA.h"
+#include "MCIS_MPC.h"
+#include "MCIS_MDA_adaptive.h"
+#include "MCIS_rt.h"
+#include "MCIS_pll.h"
+#include "MCIS_tracking.h"
+#include "MCIS_recorder.h"
+#include "MCIS_journal.h"
+#include "MCIS_reactor.h"
+#include "MCIS_audit.h"
+#include "MCIS_util.h"
+#include "MCIS_histogram.h"
+#include "MCIS_logger.h"
+#include "MCIS_seqlock.h"
+#include "MCIS_spsc.h"
 #include "MCIS_xplane_sock.h"
 #include "discreteMath.h"
 #include "MOOG6DOF2000E.h"
@@ -50,16 +65,174 @@ enum iface_error    {NONE, MB_FAULT_1, MB_FAULT_2, MB_FAULT_3,
                      MB_RESPONSE_TIMED_OUT, MB_ENGAGE_FAILED, 
                      MB_ESTOP};
 
-class mbinterface
+//Timing histograms kept by mbinterface. HIST_COMMAND is the time from a 
+//user command being issued to the tock that acts on it, the rest are per tick.
+//HIST_INPUT_AGE is the age of the X-Plane message behind each position 
+//command, when the command is sent. HIST_INPUT_TO_OUTPUT is the same, only 
+//for the first command computed from each message, i.e. the latency of the
+//cueing chain from the X-Plane message's arrival to the command leaving. 
+//HIST_MB_RTT is from a command being sent to the MB's reply arriving. 
+//Arrivals are stamped by the kernel where possible, see xplaneSocket.
+enum timing_histogram {HIST_WAKE_LATENESS, HIST_MDA_COMPUTE, HIST_LOGGING, HIST_SEND, 
+                       HIST_COMMAND, HIST_INPUT_AGE, HIST_INPUT_TO_OUTPUT, HIST_MB_RTT,
+                       HIST_COUNT};
+
+//Regions audited for heap allocations and syscalls in an MCIS_AUDIT build,
+//see MCIS_audit.h. A whole tick of the send thread, wait included, and each
+//call into the cueing engine only count while ENGAGED, each wakeup of the 
+//reactor thread from the first time ENGAGED on. The send thread's own come
+//before AUDIT_REACTOR.
+enum audit_region_id {AUDIT_TICK, AUDIT_MDA_STEP, AUDIT_REACTOR, AUDIT_REGION_COUNT};
+
+//In TICK_EVENT mode, the MDA runs no later than this long before the next 
+//tick even if no new X-Plane message came in, in ns
+#define EVENT_TICK_MARGIN_NS 1000000
+
+/*
+ *  TICK_JIT margins, in ns. The send thread wakes up this long before each 
+ * tick to read the input and run the MDA. The margin is the p99 of how long
+ * that took over the last JIT_RELEARN_TICKS ticks, counted from the 
+ * intended wake-up so that late wake-ups are included, plus JIT_GUARD_NS.
+ * It grows at once and shrinks by at most JIT_SHRINK_PERCENT per relearn.
+ */
+#define JIT_INITIAL_MARGIN_NS   2000000
+#define JIT_MIN_MARGIN_NS       200000
+#define JIT_MAX_MARGIN_NS       4000000
+#define JIT_GUARD_NS            100000
+#define JIT_RELEARN_TICKS       120
+#define JIT_SHRINK_PERCENT      10
+
+//The MB answers every command. Once it has answered at all, going this long
+//without an answer counts as a reply timeout.
+#define MB_REPLY_TIMEOUT_NS         500000000
+
+//Once ENGAGED, the send thread's page fault count is refreshed every this
+//many ticks (getrusage is a syscall)
+#define PAGE_FAULT_SAMPLE_TICKS 120
+
+//With NET_URING, commands are sent from this many registered buffers in 
+//turn. A buffer is busy until the kernel is done with it, which on a 
+//zero-copy send is a while after the send itself completes.
+#define MB_SEND_SLOTS 4
+
+//Commands sent but not yet paired with a reply, see track_feedback. Deep 
+//enough for every command sent during MB_REPLY_TIMEOUT_NS at 60 Hz, after
+//which onTimer empties it, so this only fills up if the reactor thread is
+//stuck. A command that doesn't fit is counted and left out of tracking.
+#define MB_TRACKING_QUEUE_LEN 64
+
+//A command as sent to the MB, handed from the send thread to the reactor
+//thread for tracking
+class trackingCommandMsg
+{
+    public:
+
+    DOFpacket packet;
+    //monotonicNs() when it was sent
+    int64_t sent;
+    //Counts every command sent, queued or not
+    uint64_t seq;
+};
+
+//Flight recorder dumps go to this, plus a sequential number and .bin, 
+//unless told otherwise. See MCIS_recorder.h.
+#define FLIGHT_RECORDER_FILENAME "flightrec"
+//Same for the event journal, with .jnl. See MCIS_journal.h.
+#define JOURNAL_FILENAME "journal"
+
+//Commands from the UI to the interface state machine
+enum user_command   {CMD_ENGAGE, CMD_READY, CMD_PARK, CMD_OVERRIDE, CMD_RESET};
+
+//How many commands can be waiting for the next tock. The UI issues at most
+//a couple per keypress, so this only fills up if the send thread is stuck.
+#define USER_COMMAND_QUEUE_LEN 16
+
+class userCommandMsg
+{
+    public:
+
+    user_command command;
+    //monotonicNs() when it was issued
+    int64_t issued;
+};
+
+//Cueing engines that can drive the MB
+enum cueing_engine  {CUEING_CLASSICAL, CUEING_MPC, CUEING_ADAPTIVE};
+
+/*
+ *  Everything the UI shows about the send thread, published once per tick
+ * through a seqlock, so that reading it never holds up the send thread.
+ */
+class mbStatusSnapshot
+{
+    public:
+
+    MCISvector sf_in, angv_in, ang_in;
+    MCISvector pos_out, rot_out;
+    //X-Plane messages received so far, and how old the one in use was when
+    //it was published. The age is meaningless while input_sequence is zero.
+    uint64_t input_sequence = 0;
+    int64_t  input_age = 0;
+    //Zero unless the MPC engine is in use
+    int64_t mpc_worst_solve_time = 0;
+    //Only meaningful if the adaptive engine is in use
+    MCISvector adaptive_scaling, adaptive_tilt_gains, adaptive_break_freqs;
+    rtStatus rt;
+    tick_mode ticks = TICK_FIXED;
+    //Current TICK_JIT wake-up margin, ns
+    int64_t jit_margin = 0;
+    //Ticks that got no new X-Plane message, and messages no tick ever saw
+    uint64_t samples_duplicated = 0;
+    uint64_t samples_skipped = 0;
+    //Load shed on ticks that started late
+    uint64_t log_lines_shed = 0;
+    uint64_t mda_steps_shed = 0;
+    //TICK_PLL state
+    bool pll_locked = false;
+    int64_t pll_message_period = 0;
+    int64_t pll_phase_error = 0;
+    //Send thread page faults up to the first ENGAGED tick, and since
+    bool engaged_once = false;
+    pageFaultCounts faults_before_engage;
+    pageFaultCounts faults_since_engage;
+};
+
+/*
+ *  mbinterface runs the MB: a send thread ticks the state machine and the 
+ * cueing engine, and an I/O reactor thread receives both the X-Plane 
+ * messages and the MB's replies (see MCIS_reactor.h).
+ */
+class mbinterface : private reactorHandler
 {
     private:
     
-    bool continue_operation = true;
+    std::atomic<bool> continue_operation{true};
 
     bool subgrav;
+
+    //Run the single precision MDA (mdaf) instead of the double precision one
+    bool single_precision;
+
+    //Which cueing engine computes the outputs. single_precision only 
+    //applies to CUEING_CLASSICAL.
+    cueing_engine engine;
     
     MCISvector curr_pos_out, curr_rot_out;
     MCISvector curr_acceleration_in, curr_ang_velocity_in, curr_attitude_in;
+    //Which X-Plane message the inputs came from, and when it arrived
+    uint64_t curr_input_sequence = 0;
+    int64_t  curr_input_recv_time = 0;
+    //Same, for the message the outputs were computed from, as mda_next_sample
+    //passes them along. The outputs outlive the inputs on a shed tick.
+    uint64_t curr_output_sequence = 0;
+    int64_t  curr_output_input_time = 0;
+    //Newest message that went out to the MB, for HIST_INPUT_TO_OUTPUT, and
+    //that latency, for the log. Send thread only.
+    uint64_t last_sent_sequence = 0;
+    int64_t  last_input_to_output = 0;
+    //The cueing engine's angles without tilt coordination, for the flight 
+    //recorder
+    MCISvector curr_rot_no_tc;
     const MCISvector init_pos_out{MB_OFFSET_x, MB_OFFSET_y, MB_OFFSET_z};
     const MCISvector init_rot_out{MB_OFFSET_roll, MB_OFFSET_pitch, MB_OFFSET_yaw};
     //The rate limits are defined per sample
@@ -71,16 +244,69 @@ class mbinterface
     vectorRateLimit pos_rate_limiter{pos_rate_lim, init_pos_out};
     vectorRateLimit rot_rate_limiter{rot_rate_lim, init_rot_out};
 
-    std::mutex output_mutex;
-
-    iface_status current_status = ESTABLISH_COMMS;
+    //RATE_LIMITED ends early once the rate-limited output has caught up
+    //with the MDA output, within these tolerances
+    //0.1 mm
+    double pos_converged_tol = 1e-4;
+    //~0.06 degree
+    double rot_converged_tol = 1e-3;
+    //The outputs must stay converged for this many tocks (50 ms)
+    const unsigned int rate_limit_settle_tocks = 3;
+    unsigned int rate_limit_converged_tocks = 0;
+
+    //Written by the send thread every tick, read by the UI
+    seqlock<mbStatusSnapshot> status_snapshot;
+    void publish_status();
+
+    //Only the send thread changes the state (change_status), anyone may read it
+    std::atomic<iface_status> current_status{ESTABLISH_COMMS};
     iface_error  current_error = NONE;
 
-    std::thread MB_recv_thread;
     std::thread MB_send_thread;
 
-    unsigned long int send_ticks = 1;
+    std::atomic<unsigned long int> send_ticks{1};
     const unsigned long int ticks_per_tock = 2;
+    //Paces mb_send_func, one tick per period
+    rtTicker send_ticker;
+    //Requested tick mode, and the one in effect once the send thread is up
+    tick_mode requested_ticks;
+    tick_mode active_ticks = TICK_FIXED;
+    //TICK_JIT: how long before the tick to wake up, and how long the 
+    //wake-up to MDA output took over the current relearn window
+    int64_t jit_margin = JIT_INITIAL_MARGIN_NS;
+    latencyHistogram jit_window;
+    void update_jit_margin();
+    //TICK_PLL: slews send_ticker to the X-Plane message cadence
+    framePLL tick_pll;
+    //Input continuity, counted in every tick mode
+    uint64_t samples_duplicated = 0;
+    uint64_t samples_skipped = 0;
+
+    //Load shedding, on a tick that starts late because the one before it 
+    //overran: skip its MDA log line, and/or skip the MDA altogether so the
+    //last command goes out again. Counted in log_lines_shed and 
+    //mda_steps_shed.
+    bool overrun_skip_logging;
+    bool overrun_resend;
+    bool late_tick = false;
+    uint64_t log_lines_shed = 0;
+    uint64_t mda_steps_shed = 0;
+    //Page faults taken by the send thread, see PAGE_FAULT_SAMPLE_TICKS
+    bool engaged_once = false;
+    pageFaultCounts faults_at_engage;
+    pageFaultCounts faults_since_engage;
+#ifdef MCIS_AUDIT
+    //See inject_delay
+    std::atomic<int64_t> injected_delay{0};
+#endif
+
+    //Per-tick timing, indexed by timing_histogram:
+    //how late each wake-up was, how long mda_next_sample, queueing the MDA log line
+    //and each sendto to the MB took. HIST_MB_RTT is the reactor thread's, 
+    //the rest the send thread's.
+    latencyHistogram timing_hists[HIST_COUNT];
+    //Allocations and syscalls, indexed by audit_region_id
+    auditRegion audit_regions[AUDIT_REACTOR];
     const unsigned long int engage_timeout_period     = 
         MB_ENGAGE_TIMEOUT_SECONDS * ticks_per_tock * MB_SAMPLE_RATE;
     const unsigned long int rate_limit_timeout_period = 
@@ -92,23 +318,98 @@ class mbinterface
     //int recv_sock_fd;
     int send_sock_fd;
 
-    bool sock_bound = false;
-
     //uint16_t recv_port;
     uint16_t send_port;
 
     //struct sockaddr_in recvAddr;
     struct sockaddr_in sendAddr;
 
+    //NET_URING sends: the send thread's own ring, with send_slots and 
+    //send_sock_fd registered, see send_packet_uring
+#ifdef MCIS_HAVE_URING
+    uringQueue send_ring;
+    DOFpacket send_slots[MB_SEND_SLOTS];
+    bool send_slot_busy[MB_SEND_SLOTS] = {};
+    unsigned int next_send_slot = 0;
+#endif
+    std::atomic<bool> uring_send{false};
+    bool uring_send_sq_polled = false;
+
+    //User commands are queued by the UI thread and picked up by the send 
+    //thread at the start of each tock, see take_user_commands
+    spscRing<userCommandMsg, USER_COMMAND_QUEUE_LEN> user_commands;
+    std::atomic<uint64_t> user_commands_dropped{0};
+    void queue_user_command(user_command command);
+    void take_user_commands();
+
+    //Commands in effect for the current tock. Send thread only.
     bool userEngage = false;
     bool userReady  = false;
     bool userPark   = false;
     bool userOverride = false;
     bool userReset = false;
 
-    bool MB_error_asserted = false;
-    uint32_t MB_state_reply = 0xFFFFFFFF;
-    uint32_t MB_state_info_raw = 0xFFFFFFFF;
+    //Written by the reactor thread, read by the send thread and the UI
+    std::atomic<bool> MB_error_asserted{false};
+    std::atomic<uint32_t> MB_state_reply{0xFFFFFFFF};
+    std::atomic<uint32_t> MB_state_info_raw{0xFFFFFFFF};
+    std::atomic<uint32_t> MB_latched_fault_raw{0};
+    std::atomic<uint32_t> MB_discrete_io_raw{0};
+    //MB replies received, when the last one came in (monotonicNs), and
+    //reply timeouts, see MB_REPLY_TIMEOUT_NS. Reactor thread only writes.
+    std::atomic<uint64_t> MB_replies{0};
+    std::atomic<int64_t>  MB_last_reply{0};
+    std::atomic<bool>     MB_reply_timed_out{false};
+    std::atomic<uint64_t> MB_reply_timeouts{0};
+    //When the last command went out, 0 once a reply was matched to it, and 
+    //the last round trip (ns). Written by the send thread and the reactor 
+    //thread respectively, see handle_MB_response.
+    std::atomic<int64_t>  MB_command_sent{0};
+    std::atomic<int64_t>  MB_last_rtt{0};
+    //SO_TIMESTAMPNS in effect on send_sock_fd
+    bool mb_kernel_timestamps = false;
+    //Control buffer for onReadable's recvmsg. Reactor thread only.
+    alignas(struct cmsghdr) unsigned char MB_recv_control[RX_TIMESTAMP_CONTROL_SIZE];
+
+    //MB feedback against the commands, see MCIS_tracking.h. Every command 
+    //sent is queued on tracking_commands, and the reactor thread pairs it 
+    //with the feedback in the reply (track_feedback). The results go to the
+    //UI and the send thread's log through tracking_status.
+    //tracking_sent_seq is the seq of the last command sent, and 
+    //tracking_dropped counts those that didn't fit in tracking_commands.
+    //Both are written by the send thread only.
+    spscRing<trackingCommandMsg, MB_TRACKING_QUEUE_LEN> tracking_commands;
+    std::atomic<uint64_t> tracking_sent_seq{0};
+    std::atomic<uint64_t> tracking_dropped{0};
+    trackingMonitor tracking;
+    trackingCommandMsg tracking_pending;
+    bool tracking_has_pending = false;
+    double tracking_held_feedback[TRACKING_AXES] = {};
+    seqlock<trackingStatus> tracking_status;
+    //Latest tracking_status, as the send thread's log uses it
+    trackingStatus curr_tracking;
+
+    //The last few seconds of ticks, dumped on a fault, see MCIS_recorder.h.
+    //The send thread fills in flight_record as the tick goes and records it
+    //at the end. last_sent_packet and last_send_time are the last command 
+    //and how long sending it took. Send thread only.
+    flightRecorder flight_recorder;
+    flightRecord flight_record{};
+    DOFpacket last_sent_packet{};
+    int64_t last_send_time = 0;
+    void record_flight(uint32_t flags);
+
+    //State transitions, user commands and what the MB reports about 
+    //itself, see MCIS_journal.h. Send thread only, like the journaled_ 
+    //values, the last the MB reported as far as the journal knows.
+    eventJournal journal;
+    uint32_t journaled_mb_state = 0xFFFFFFFF;
+    uint32_t journaled_latched_fault = 0;
+    uint32_t journaled_discrete_io = 0;
+    bool journaled_reply_timed_out = false;
+    void journal_mb_changes();
+    //Every state change goes through this, send thread only
+    void change_status(iface_status next);
 
     //std::chrono::time_point<std::chrono::high_resolution_clock> state_start;
     //std::chrono::time_point<std::chrono::high_resolution_clock> state_current;
@@ -122,11 +423,29 @@ class mbinterface
 
 
     xplaneSocket simSocket;
+    //Receives on simSocket and send_sock_fd. Stops before simSocket goes.
+    ioReactor io_reactor;
     MCIS_MDA mda;
-
-    std::fstream *MDA_logfile;
-
-    void mb_recv_func();
+    MCIS_MDAf mdaf;
+    MCIS_MPC mpc;
+    MCIS_MDA_adaptive adaptive;
+
+    //The MDA log is written from its own thread, see MCIS_logger.h
+    asyncMDAlog mda_log;
+
+    //reactorHandler: MB replies waiting on send_sock_fd (or each one, under
+    //io_uring), and the reply timeout check
+    void onReadable(int fd) override;
+    void onDatagram(int fd, const unsigned char *data, int length, int64_t rx_time) override;
+    void onTimer(int64_t now) override;
+    //rx_time is when it arrived, monotonicNs()
+    void handle_MB_response(const DOFresponse& mb_response, int64_t rx_time);
+    void track_feedback(const DOFresponse& mb_response);
+    void pop_tracking_commands();
+    void track_unanswered();
+    //Command and feedback in host order floats, as trackingMonitor's axes
+    static void command_axes(const DOFpacket& packet, double (&axes)[TRACKING_AXES]);
+    static void feedback_axes(const DOFresponse& response, double (&axes)[TRACKING_AXES]);
     void mb_send_func();
 
     void mb_send_func_ESTABLISH_COMMS();
@@ -141,11 +460,22 @@ class mbinterface
 
     void send_mb_command(int MCW, MCISvector& pos, MCISvector& rot);
     void send_mb_neutral_command(int MCW);
+    //sendto the MB, timed into HIST_SEND
+    void send_packet(const DOFpacket& packet);
+    //Queue it on send_ring instead. False if it can't, and sendto it is.
+    bool send_packet_uring(const DOFpacket& packet);
     void testsend_mb_command();
 
     void reset_user_commands();
 
+    //Run whichever MDA was selected at construction on the current inputs,
+    //tagging the outputs with the inputs' message and arrival time
+    void mda_next_sample();
+    void mda_init_steady_state();
+
     static void output_limiter(MCISvector& pos, MCISvector& rot);
+    static bool outputs_converged(const MCISvector& target, const MCISvector& output, 
+                                  double tolerance);
 
 
     public:
@@ -154,20 +484,105 @@ class mbinterface
     
     mbinterface(uint16_t mb_send_port, uint16_t mb_recv_port, uint32_t mb_IP,
                 uint16_t xp_recv_port, MCISconfig mdaconfig, 
-                std::fstream& MDA_log, bool subtract_gravity);
+                std::fstream& MDA_log, bool subtract_gravity,
+                bool single_precision = false, 
+                cueing_engine engine = CUEING_CLASSICAL,
+                const rtTimingConfig& rt_config = rtTimingConfig(),
+                const std::string& flight_recorder_prefix = FLIGHT_RECORDER_FILENAME,
+                const std::string& journal_prefix = JOURNAL_FILENAME);
     //~mbinterface();
 
+    //User commands. Only ever call these from one thread (the UI). They
+    //never block, and take effect at the send thread's next tock.
     void setEngage();
     void setReady();
     void setPark();
     void setOverride();
     void setReset();
+    //Commands lost because the queue was full
+    uint64_t get_commands_dropped();
 
     int get_ticks();
 
     unsigned int get_MB_status();
+    //MB replies received so far, how long ago the last one came in (ns), 
+    //whether the MB has stopped replying, and how many times it has
+    void get_MB_reply_status(uint64_t& replies, int64_t& last_reply_age, 
+                             bool& timed_out, uint64_t& timeouts);
     iface_status get_iface_status();
     void get_MDA_status(MCISvector& sf_in, MCISvector& angv_in, MCISvector& ang_in,
                         MCISvector& MB_pos_out, MCISvector& MB_rot_out);
+    //X-Plane messages received so far and age of the one in use, in ns
+    void get_input_status(uint64_t& sequence, int64_t& age);
+    cueing_engine get_cueing_engine();
+    //Worst MPC solve time so far, in ns. Zero unless the MPC engine is in use.
+    int64_t get_MPC_worst_solve_time();
+    //Current adaptive washout parameters: K_SF, K_TC and break frequencies.
+    //Left untouched unless the adaptive engine is in use.
+    void get_adaptive_params(MCISvector& scaling, MCISvector& tilt_gains, MCISvector& break_freqs);
+    //Real-time settings in effect for the send thread, and missed ticks
+    rtStatus get_rt_status();
+    //Tick mode in effect. TICK_EVENT falls back to TICK_FIXED if it can't 
+    //be set up.
+    tick_mode get_tick_mode();
+    //TICK_JIT wake-up margin in effect, ns
+    int64_t get_jit_margin();
+    //Ticks that ran on the same X-Plane message as the tick before, and
+    //messages that were replaced before any tick used them
+    void get_sample_continuity(uint64_t& duplicated, uint64_t& skipped);
+    //X-Plane messages received but never decoded, because a newer one came
+    //in the same burst (they count as skipped too), and SO_BUSY_POLL in 
+    //effect on the X-Plane socket, us
+    void get_receive_status(uint64_t& dropped, int& busy_poll_us);
+    //Whether io_uring is in use for receiving and for sending, and whether
+    //a kernel thread polls the send ring (see rtTimingConfig::uring_sqpoll)
+    void get_net_status(bool& uring_receive, bool& uring_send, bool& sq_polled);
+    //Whether the kernel timestamps arrivals (SO_TIMESTAMPNS) on the X-Plane
+    //and on the MB socket. If not, they are stamped when read.
+    void get_timestamp_status(bool& xplane_kernel, bool& mb_kernel);
+    //TICK_PLL state: locked, X-Plane message period and phase error in ns
+    void get_pll_status(bool& locked, int64_t& message_period, int64_t& phase_error);
+    //Ticks that skipped their log line, and ticks that skipped the MDA, 
+    //because they started late
+    void get_shed_counts(uint64_t& log_lines, uint64_t& mda_steps);
+    //Page faults taken by the send thread before it first reached ENGAGED, 
+    //and since. False until then.
+    bool get_page_faults(pageFaultCounts& before_engage, pageFaultCounts& since_engage);
+#ifdef MCIS_AUDIT
+    //For testing: stall the send thread for this long, in ns, in the middle 
+    //of its next tick (where logging happens), as a log write or a page 
+    //fault would. Only in the instrumentation build, see MCIS_audit.h.
+    void inject_delay(int64_t ns);
+#endif
+    //MDA log lines written to file and lines dropped because the writer
+    //fell behind
+    uint64_t get_log_written();
+    uint64_t get_log_dropped();
+    //MB feedback, transport delay and tracking error per axis, see 
+    //MCIS_tracking.h
+    trackingStatus get_tracking_status();
+    //Commands left out of tracking because the reactor thread fell behind
+    uint64_t get_tracking_dropped();
+    //Flight recorder dumps written so far, see MCIS_recorder.h
+    flightRecorderStatus get_flight_recorder_status();
+    //Dump the flight recorder now, e.g. on SIGINT. Only after stop().
+    //Returns the file written, empty if it couldn't be.
+    std::string dump_flight_recorder();
+    //The event journal's file, events written to it and events dropped
+    void get_journal_status(std::string& path, uint64_t& written, uint64_t& dropped);
+    //Snapshot of one of the per-tick timing histograms
+    histogramSummary get_timing_summary(timing_histogram which);
+    //Names of states, errors, user commands and MB states (as in 
+    //get_MB_status), for display
+    static const char *status_name(iface_status status);
+    static const char *error_name(iface_error error);
+    static const char *command_name(user_command command);
+    static const char *mb_state_name(unsigned int mb_state);
+    //Name of a timing histogram, for display
+    static const char *timing_histogram_name(timing_histogram which);
+    //Allocations and syscalls seen in one of the audited regions so far. 
+    //Always empty unless auditEnabled().
+    auditReport get_audit_report(audit_region_id which);
+    static const char *audit_region_name(audit_region_id which);
 
 };
@@ -35,18 +35,44 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 /*
  * Forward declarations
+ * 
+ * Like the building blocks in discreteMath.h, the MDA is templated on the 
+ * scalar type. The double precision classes keep the original names and the
+ * single precision ones get an f suffix (MCIS_MDA and MCIS_MDAf).
  */
 
 //General Motion Drive Algorithm class
-class MCIS_MDA;
+template <typename T> class basicMCIS_MDA;
 // Offset linear accelerations calculator class
 class CGoffset;
 //MB orientation high-pass filtering class
-class angHPchannel;
+template <typename T> class basicAngHPchannel;
 //Tilt coordination channel class
-class tiltCoordination;
+template <typename T> class basicTiltCoordination;
 //MB position high-pass filtering class
-class posHPchannel;
+template <typename T> class basicPosHPchannel;
+//Parameters and state of each block, and of the whole MDA
+template <typename T> class basicAngHPparams;
+template <typename T> class basicAngHPstate;
+template <typename T> class basicTiltParams;
+template <typename T> class basicTiltState;
+template <typename T> class basicPosHPparams;
+template <typename T> class basicPosHPstate;
+template <typename T> class basicMDAparams;
+template <typename T> class basicMDAstate;
+
+typedef basicMCIS_MDA<double>           MCIS_MDA;
+typedef basicMCIS_MDA<float>            MCIS_MDAf;
+typedef basicAngHPchannel<double>       angHPchannel;
+typedef basicAngHPchannel<float>        angHPchannelf;
+typedef basicTiltCoordination<double>   tiltCoordination;
+typedef basicTiltCoordination<float>    tiltCoordinationf;
+typedef basicPosHPchannel<double>       posHPchannel;
+typedef basicPosHPchannel<float>        posHPchannelf;
+typedef basicMDAparams<double>          MDAparams;
+typedef basicMDAparams<float>           MDAparamsf;
+typedef basicMDAstate<double>           MDAstate;
+typedef basicMDAstate<float>            MDAstatef;
 
 /*
 //2nd order filter bank parameters class
@@ -63,9 +89,143 @@ class params2ndOrderFilt
 };*/
 
 //Rotate frame of reference from body to inertial axes
-void body2inert(MCISvector& vec, const MCISvector& eulerAngles);
+template <typename T>
+void body2inert(basicMCISvector<T>& vec, const basicMCISvector<T>& eulerAngles);
 //Convert body angular velocities into Euler angle rates
-void pqr2eulerRates(MCISvector& vec, const MCISvector& eulerAngles);
+template <typename T>
+void pqr2eulerRates(basicMCISvector<T>& vec, const basicMCISvector<T>& eulerAngles);
+
+
+
+/*
+ *  Parameters and state
+ * 
+ * Each block of the MDA is split into what never changes and what does:
+ * 
+ *  - The parameters hold every coefficient, gain and limit, derived once 
+ *      from an MCISconfig. The signal path of the block lives here, as const
+ *      member functions that run one sample on a state owned by the caller.
+ *  - The state holds the filter delays and rate limit outputs, and nothing
+ *      else. It is plain data with no pointers.
+ * 
+ * The block classes (angHPchannel, tiltCoordination, posHPchannel) own one 
+ * of each, and so does MCIS_MDA, through MDAparams and MDAstate. There is 
+ * only one copy of the signal path, whichever way the MDA is driven.
+ */
+
+/*
+ *  Angular High-Pass channel parameters (roll, pitch, yaw)
+ */
+template <typename T>
+class basicAngHPparams
+{
+    public:
+
+    basicBiquadCoeffs<T> filt[3];
+    T filtK[3];                 //Gains applied after the biquad sections
+    T lim[3];
+
+    basicAngHPparams(const MCISconfig& config);
+
+    basicMCISvector<T> nextSample(basicAngHPstate<T>& state, const basicMCISvector<T>& input, 
+                                  const basicMCISvector<T>& eulerAngles) const;
+    basicMCISvector<T> nextSample_MCISv2(basicAngHPstate<T>& state, const basicMCISvector<T>& input, 
+                                         const basicMCISvector<T>& lastOutput) const; //Obsolete
+    //Jump to the steady state for a constant input
+    basicMCISvector<T> initSteadyState(basicAngHPstate<T>& state, const basicMCISvector<T>& input, 
+                                       const basicMCISvector<T>& eulerAngles) const;
+};
+
+template <typename T>
+class basicAngHPstate
+{
+    public:
+
+    T filt[3][2];
+
+    basicAngHPstate();
+    //Back to rest
+    void reset();
+};
+
+/*
+ *  Tilt Coordination parameters (x, y)
+ */
+template <typename T>
+class basicTiltParams
+{
+    public:
+
+    basicBiquadCoeffs<T> filt[2];
+    T filtK[2];                 //Gains applied after the biquad sections
+    T lim[2];
+    T gain[2];                  //K_TC_x, K_TC_y
+    T rateLim[2];               //Per sample
+
+    basicTiltParams(const MCISconfig& config);
+
+    basicMCISvector<T> nextSample(basicTiltState<T>& state, const basicMCISvector<T>& input, 
+                                  const basicMCISvector<T>& MBangles, const basicMCISvector<T>& hpAngles) const;
+    basicMCISvector<T> nextSample_MCISv2(basicTiltState<T>& state, const basicMCISvector<T>& input, 
+                                         const basicMCISvector<T>& MBangles) const; //Obsolete
+    //Jump to the steady state for a constant input
+    basicMCISvector<T> initSteadyState(basicTiltState<T>& state, const basicMCISvector<T>& input, 
+                                       const basicMCISvector<T>& MBangles, const basicMCISvector<T>& hpAngles) const;
+};
+
+template <typename T>
+class basicTiltState
+{
+    public:
+
+    T filt[2][2];
+    T rateLim[2];               //Last rate limit outputs
+
+    basicTiltState();
+    //Back to rest
+    void reset();
+};
+
+/*
+ *  Specific Force High-Pass channel parameters (x, y, z)
+ */
+template <typename T>
+class basicPosHPparams
+{
+    public:
+
+    basicBiquadCoeffs<T> filt1[3];  //We need two biquad sections
+    basicBiquadCoeffs<T> filt2[3];  //per filter for Specific Force
+    T filtK[3];                 //Gains applied after the biquad sections
+    T lim[3];
+
+    bool subgrav;
+
+    T zGravSub;         //Value to subtract from the z-axis, corresponds to
+                        //g*K_SF_z and is set in constructor
+                        //Only if subgrav is false
+
+    basicPosHPparams(const MCISconfig& config, bool subtract_gravity);
+
+    basicMCISvector<T> nextSample(basicPosHPstate<T>& state, const basicMCISvector<T>& input, 
+                                  const basicMCISvector<T>& MBangles) const;
+    //Jump to the steady state for a constant input
+    basicMCISvector<T> initSteadyState(basicPosHPstate<T>& state, const basicMCISvector<T>& input, 
+                                       const basicMCISvector<T>& MBangles) const;
+};
+
+template <typename T>
+class basicPosHPstate
+{
+    public:
+
+    T filt1[3][2];
+    T filt2[3][2];
+
+    basicPosHPstate();
+    //Back to rest
+    void reset();
+};
 
 
 
@@ -74,24 +234,24 @@ void pqr2eulerRates(MCISvector& vec, const MCISvector& eulerAngles);
  * 
  * This class implements a self-contained Angular High-Pass channel
  */
-class angHPchannel
+template <typename T>
+class basicAngHPchannel
 {
     private:
-    discreteFilt2ndOrder rollFilt, pitchFilt, yawFilt;
-    saturation rollSat, pitchSat, yawSat;
-    double rollFiltK, pitchFiltK, yawFiltK; //Gains applied after the biquad sections
-
-    MCISvector lastOutput;
+    basicAngHPparams<T> params;
+    basicAngHPstate<T>  state;
 
-    bool subgrav;
+    basicMCISvector<T> lastOutput;
 
     public:
     //Constructor
-    angHPchannel(const MCISconfig& config);
+    basicAngHPchannel(const MCISconfig& config);
 
 
-    MCISvector nextSample(const MCISvector& input, const MCISvector& eulerAngles);
-    MCISvector nextSample_MCISv2(const MCISvector& input); //Obsolete
+    basicMCISvector<T> nextSample(const basicMCISvector<T>& input, const basicMCISvector<T>& eulerAngles);
+    basicMCISvector<T> nextSample_MCISv2(const basicMCISvector<T>& input); //Obsolete
+    //Jump to the steady state for a constant input
+    basicMCISvector<T> initSteadyState(const basicMCISvector<T>& input, const basicMCISvector<T>& eulerAngles);
 
     //Not implemented, reserved for future use
     void setFilterParameters(const MCISconfig& config);
@@ -102,26 +262,21 @@ class angHPchannel
  * 
  * This class implements a self-contained Specific Force High-Pass channel
  */
-class posHPchannel
+template <typename T>
+class basicPosHPchannel
 {
     private:
-    discreteFilt2ndOrder xFilt1, yFilt1, zFilt1; //We need two biquad sections
-    discreteFilt2ndOrder xFilt2, yFilt2, zFilt2; //per filter for Specific Force
-    double xFiltK, yFiltK, zFiltK;  //Gains applied after the biquad sections
-    saturation xSat, ySat, zSat;
-
-    bool subgrav;
-
-    double zGravSub;    //Value to subtract from the z-axis, corresponds to
-                        //g*K_SF_z and is set in constructor
-                        //Only if subgrav is false
+    basicPosHPparams<T> params;
+    basicPosHPstate<T>  state;
 
     public:
     //Constructor
-    posHPchannel(const MCISconfig& config, bool subtract_gravity);
+    basicPosHPchannel(const MCISconfig& config, bool subtract_gravity);
 
 
-    MCISvector nextSample(const MCISvector& input, const MCISvector& MBangles);
+    basicMCISvector<T> nextSample(const basicMCISvector<T>& input, const basicMCISvector<T>& MBangles);
+    //Jump to the steady state for a constant input
+    basicMCISvector<T> initSteadyState(const basicMCISvector<T>& input, const basicMCISvector<T>& MBangles);
 
     //Not implemented, reserved for future use
     void setFilterParameters(const MCISconfig& config);
@@ -132,57 +287,128 @@ class posHPchannel
  * 
  * This class implements a self-contained Tilt Coordination channel
  */
-class tiltCoordination
+template <typename T>
+class basicTiltCoordination
 {
     private:
-    discreteFilt2ndOrder xFilt, yFilt;
-    double xFiltK, yFiltK; //Gains applied after the biquad sections
-    saturation xSat, ySat;
-    rateLimit xRatelim, yRatelim;
-    double xGain, yGain;
+    basicTiltParams<T> params;
+    basicTiltState<T>  state;
 
     public:
     //Constructor
-    tiltCoordination(const MCISconfig& config);
+    basicTiltCoordination(const MCISconfig& config);
 
 
-    MCISvector nextSample(const MCISvector& input, const MCISvector& MBangles, const MCISvector& hpAngles);
-    MCISvector nextSample_MCISv2(const MCISvector& input, const MCISvector& MBangles);
+    basicMCISvector<T> nextSample(const basicMCISvector<T>& input, const basicMCISvector<T>& MBangles, const basicMCISvector<T>& hpAngles);
+    basicMCISvector<T> nextSample_MCISv2(const basicMCISvector<T>& input, const basicMCISvector<T>& MBangles);
+    //Jump to the steady state for a constant input
+    basicMCISvector<T> initSteadyState(const basicMCISvector<T>& input, const basicMCISvector<T>& MBangles, const basicMCISvector<T>& hpAngles);
+    //Change the Tilt Coordination gains (K_TC_x, K_TC_y) on the fly
+    void setGains(T xGainIn, T yGainIn);
 
     //Not implemented, reserved for future use
     void setFilterParameters(const MCISconfig& config);
 };
 
+
+
+//Cache line size, for aligning the shared parameters
+#define MDA_CACHE_LINE  64
+
 /*
- *  MCIS MDA class
+ *  MDA parameters
  * 
- * This class implements a single object that provides the full MCIS algorithm.
+ * The input scaling and the parameters of every block, in the order the 
+ * signal path reads them. Never written after construction, so a single 
+ * instance can be shared by any number of MDAs (and threads), e.g. a whole
+ * population of MDAstates for Monte Carlo runs or parameter sweeps.
  * 
- * MDA stands for Motion Drive Algorithm
+ * Aligned to a cache line so that it never shares one with anybody's 
+ * mutable data. Note that before C++17, new does not honour alignments 
+ * beyond that of std::max_align_t. Declare it static or on the stack if the
+ * alignment matters.
  */
-class MCIS_MDA
+template <typename T>
+class alignas(MDA_CACHE_LINE) basicMDAparams
 {
-    private:
+    public:
 
+    //Input scaling
+    T kSF[3];                   //x, y, z
+    T kAngv[3];                 //p, q, r
     bool subgrav;
 
-    angHPchannel        angleBlock;
-    tiltCoordination    tiltBlock;
-    posHPchannel        posBlock;
-
-    MCISvector posOut, angleOut, angleNoTCout;
-    MCISvector accInput, angvInput, attInput;
+    basicAngHPparams<T> ang;
+    basicTiltParams<T>  tilt;
+    basicPosHPparams<T> pos;
 
-    double kX, kY, kZ, kp, kq, kr;
+    basicMDAparams(const MCISconfig& config, bool subtract_gravity);
+};
 
+/*
+ *  MDA state
+ * 
+ * Everything that changes from sample to sample. A new state is at rest,
+ * like a newly constructed MCIS_MDA.
+ */
+template <typename T>
+class basicMDAstate
+{
     public:
 
-    MCIS_MDA(const MCISconfig& config, bool subtract_gravity);
+    basicAngHPstate<T> ang;
+    basicTiltState<T>  tilt;
+    basicPosHPstate<T> pos;
+
+    basicMCISvector<T> posOut, angleOut, angleNoTCout;
+
+    basicMDAstate();
+
+    //Back to rest
+    void reset();
+};
+
+//Run one iteration of the MDA, see MCIS_MDA::nextSample
+template <typename T>
+void MDAnextSample(const basicMDAparams<T>& params, basicMDAstate<T>& state,
+                   const basicMCISvector<T>& accelerations, const basicMCISvector<T>& angularVelocities, 
+                   const basicMCISvector<T>& attitude);
+//Jump to the steady state for the given input, see MCIS_MDA::initSteadyState
+template <typename T>
+void MDAinitSteadyState(const basicMDAparams<T>& params, basicMDAstate<T>& state,
+                        const basicMCISvector<T>& accelerations, const basicMCISvector<T>& angularVelocities, 
+                        const basicMCISvector<T>& attitude);
+
+
+
+/*
+ *  MCIS MDA class
+ * 
+ * This class implements a single object that provides the full MCIS algorithm.
+ * It is an MDAparams and MDAstate pair, run by MDAnextSample and 
+ * MDAinitSteadyState.
+ * 
+ * MDA stands for Motion Drive Algorithm
+ */
+template <typename T>
+class basicMCIS_MDA
+{
+    private:
+
+    basicMDAparams<T> params;
+    basicMDAstate<T>  state;
+
+    public:
 
-    void nextSample(const MCISvector& accelerations, const MCISvector& angularVelocities, 
-                    const MCISvector& attitude);
-    void nextSample_MCISv2(const MCISvector& accelerations, const MCISvector& angularVelocities);
-    MCISvector& getPos();
-    MCISvector& getangle();
-    MCISvector& getAngleNoTC();
+    basicMCIS_MDA(const MCISconfig& config, bool subtract_gravity);
+
+    void nextSample(const basicMCISvector<T>& accelerations, const basicMCISvector<T>& angularVelocities, 
+                    const basicMCISvector<T>& attitude);
+    void nextSample_MCISv2(const basicMCISvector<T>& accelerations, const basicMCISvector<T>& angularVelocities);
+    //Initialize every filter and rate limit to the steady state for the given input
+    void initSteadyState(const basicMCISvector<T>& accelerations, const basicMCISvector<T>& angularVelocities, 
+                         const basicMCISvector<T>& attitude);
+    basicMCISvector<T>& getPos();
+    basicMCISvector<T>& getangle();
+    basicMCISvector<T>& getAngleNoTC();
 };
@@ -0,0 +1,202 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include "discreteMath.h"
+#include "MCIS_config.h"
+#include "MCIS_MDA.h"
+
+/*
+ *  MCIS adaptive washout
+ * 
+ * A variant of the classical washout in MCIS_MDA, built from the same 
+ * angHPchannel, posHPchannel and tiltCoordination blocks, with the same 
+ * inputs and outputs. Instead of fixed gains, a handful of parameters are 
+ * adjusted every sample by steepest descent on a cue error cost:
+ * 
+ *  - the specific force scaling, K_SF (x, y and z),
+ *  - the tilt coordination gains, K_TC (x and y),
+ *  - the break frequency of a first order high-pass stage placed in front of
+ *    posHPchannel (x, y and z). It starts at zero, i.e. as a plain wire, and 
+ *    only rises when the MB is running out of travel.
+ * 
+ * The cost, per translational axis, is
+ * 
+ *  J = 1/2 (W_ERR e^2 + W_POS p^2 + W_VEL v^2) 
+ *    + 1/2 (W_K (K_SF - K_SF0)^2 + W_TC (K_TC - K_TC0)^2 + W_OMEGA omega^2)
+ * 
+ * where e is the specific force error (configured cue minus what the MB 
+ * delivers through translation and tilt), p and v the MB position and 
+ * velocity. The last three terms pull the parameters back to the configured
+ * values when there is nothing to gain from moving them.
+ * 
+ * Nothing is allocated and there are no data-dependent loops: every sample 
+ * costs the same, so the compute budget is fixed. The compute time of every
+ * sample is measured anyway, for comparison with ADAPTIVE_COMPUTE_BUDGET_NS.
+ */
+
+//Time budget for one sample, in ns. Fixed-cost, but kept well below the
+//60 Hz MB period so that the rest of the tick is unaffected.
+#define ADAPTIVE_COMPUTE_BUDGET_NS  200000
+
+//Cost function weights
+#define ADAPTIVE_W_ERR      1.0
+#define ADAPTIVE_W_POS      20.0
+#define ADAPTIVE_W_VEL      2.0
+#define ADAPTIVE_W_K        0.5
+#define ADAPTIVE_W_TC       0.5
+#define ADAPTIVE_W_OMEGA    0.05
+//Steepest descent step sizes, per sample
+#define ADAPTIVE_MU_K       0.002
+#define ADAPTIVE_MU_TC      0.002
+#define ADAPTIVE_MU_OMEGA   0.02
+//Parameter bounds. Gains are bounded relative to their configured values,
+//the break frequency is in rad/s.
+#define ADAPTIVE_K_MIN      0.25
+#define ADAPTIVE_K_MAX      2.0
+#define ADAPTIVE_OMEGA_MAX  5.0
+//Leak on the position/velocity sensitivities to the break frequency, rad/s.
+//They are integrals of a high-passed signal and would otherwise drift.
+#define ADAPTIVE_SENS_LEAK  0.5
+
+
+/*
+ *  cueErrorEstimator
+ * 
+ * Works out the specific force the MB actually delivers, from the MDA 
+ * outputs alone, and compares it with the configured cue:
+ * 
+ *  - translation, from the second difference of the position output,
+ *  - tilt coordination, from the part of the orientation output that is not 
+ *    in angleNoTC. Small angles, and the x/y signs follow tiltCoordination.
+ * 
+ * Not tied to the adaptive washout, so that any cueing engine can be scored
+ * the same way.
+ */
+class cueErrorEstimator
+{
+    private:
+
+    double dt;
+    double kX, kY, kZ;
+
+    MCISvector lastPos, lastPos2;
+    MCISvector platformAcc, platformVel, tiltSF, error;
+
+    public:
+
+    cueErrorEstimator(const MCISconfig& config);
+
+    //Configured cue for the given aircraft inputs: gravity is subtracted in 
+    //body axes and the result is scaled by K_SF
+    MCISvector reference(const MCISvector& accelerations, const MCISvector& attitude) const;
+    //Update with the latest MDA outputs, returns reference minus delivered
+    const MCISvector& nextSample(const MCISvector& reference, const MCISvector& pos, 
+                                 const MCISvector& angle, const MCISvector& angleNoTC);
+    //Assume the MB has been sitting at pos forever
+    void reset(const MCISvector& pos);
+
+    const MCISvector& getPlatformAcc() const;
+    const MCISvector& getPlatformVel() const;
+    const MCISvector& getTiltSF() const;
+    const MCISvector& getError() const;
+};
+
+
+/*
+ *  MCIS adaptive washout class
+ * 
+ * Drop-in alternative to MCIS_MDA. Inputs, outputs and getters are the same,
+ * plus getters for the adapted parameters and the compute time.
+ * 
+ * Gravity is always subtracted in body axes: the adaptive high-pass stage 
+ * would wash out a gravity offset on z before posHPchannel could subtract it.
+ */
+class MCIS_MDA_adaptive
+{
+    private:
+
+    double dt;
+
+    angHPchannel        angleBlock;
+    tiltCoordination    tiltBlock;
+    posHPchannel        posBlock;
+
+    cueErrorEstimator   cueError;
+
+    MCISvector posOut, angleOut, angleNoTCout;
+    MCISvector angvInput, posInput;
+    MCISvector refInput;    //Configured cue, see cueErrorEstimator::reference
+
+    //Configured values
+    double kSF0[3], kTC0[2];
+    double kp, kq, kr;
+
+    //Adapted parameters. The gains are relative to the configured ones.
+    double gainSF[3], gainTC[2], omega[3];
+
+    //Adaptive high-pass stage, its input one sample ago and the sensitivity
+    //of its output to omega. The position and velocity sensitivities are
+    //leaky integrals of the acceleration one.
+    double hpOut[3], hpLastIn[3], hpSens[3];
+    double velSens[3], posSens[3];
+
+    //Compute time statistics, in nanoseconds
+    int64_t lastComputeTime, worstComputeTime;
+
+    //Gravity subtraction and input scaling, at the configured gains
+    void prepareInputs(const MCISvector& accelerations, const MCISvector& angularVelocities, 
+                       const MCISvector& attitude);
+    //One steepest descent step on every parameter
+    void adapt();
+
+    public:
+
+    MCIS_MDA_adaptive(const MCISconfig& config);
+
+    void nextSample(const MCISvector& accelerations, const MCISvector& angularVelocities, 
+                    const MCISvector& attitude);
+    //Back to the configured parameters, every filter at its steady state
+    void initSteadyState(const MCISvector& accelerations, const MCISvector& angularVelocities, 
+                         const MCISvector& attitude);
+    MCISvector& getPos();
+    MCISvector& getangle();
+    MCISvector& getAngleNoTC();
+
+    //Current parameters: K_SF, K_TC (z is always zero) and break frequencies
+    MCISvector getScaling() const;
+    MCISvector getTiltGains() const;
+    MCISvector getBreakFrequencies() const;
+    const MCISvector& getCueError() const;
+
+    int64_t getLastComputeTime() const;
+    int64_t getWorstComputeTime() const;
+    void resetComputeStats();
+};
@@ -0,0 +1,277 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include "discreteMath.h"
+#include "MCIS_config.h"
+#include "MCIS_MDA.h"
+
+/*
+ *  MCIS MPC cueing engine
+ * 
+ * An alternative to the classical washout in MCIS_MDA, with the same inputs 
+ * and outputs. Instead of high-pass filtering the cues and clamping whatever 
+ * comes out in mbinterface::output_limiter, every sample a small optimization 
+ * problem is solved per degree of freedom:
+ * 
+ *  - Reproduce the (scaled) specific force or angular velocity as closely as
+ *    possible over the next MPC_HORIZON steps,
+ *  - while washing the MB back towards neutral,
+ *  - without ever leaving the MB_LIM_* workspace.
+ * 
+ * The six degrees of freedom are decoupled in the model (the MB is modelled 
+ * as a double integrator in x, y and z and as a single integrator in roll, 
+ * pitch and yaw), so the 6-DOF problem is six independent dense QPs of
+ * MPC_HORIZON variables each. Tilt coordination is not part of the QP, the
+ * classical tiltCoordination block is reused and the angular workspace 
+ * given to the QP is reduced by what tilt coordination can use.
+ * 
+ * Everything is sized at compile time. Nothing is allocated after 
+ * construction and the iteration count is bounded, so the worst-case solve
+ * time is bounded too.
+ */
+
+//Number of steps in the prediction horizon
+#define MPC_HORIZON         20
+//Length of every step but the first, in MDA samples. The first step is always
+//one sample long, since that's what gets applied.
+#define MPC_STEP_SAMPLES    6
+//Iteration cap for the QP solver. Bounds the worst-case solve time.
+#define MPC_MAX_ITERATIONS  50
+//Time budget for one sample, all six axes, in ns. The MB runs at 60 Hz,
+//this leaves most of the tick for everything else.
+#define MPC_SOLVE_BUDGET_NS 2000000
+
+//Fraction of the MB workspace made available to the MPC. The rest is left
+//as a safety margin for model mismatch before output_limiter clamps.
+#define MPC_WORKSPACE_MARGIN    0.9
+//Bounds on the MPC inputs, i.e. the platform acceleration (m/s^2) and 
+//angular velocity (rad/s)
+#define MPC_LIM_ACC             5.0
+#define MPC_LIM_ANGV            0.5
+
+
+/*
+ *  mpcAxisWeights
+ * 
+ * Transparent struct holding the cost function weights for one axis:
+ * 
+ * input    - tracking error between the MB input and the cue reference
+ * pos      - distance from neutral (washout)
+ * vel      - velocity (washout, translational axes only)
+ * smooth   - change in input between steps
+ */
+class mpcAxisWeights
+{
+    public:
+
+    double input, pos, vel, smooth;
+};
+
+
+/*
+ *  mpcQPsolver
+ * 
+ * Dense QP solver for problems of the form
+ * 
+ *      minimize    1/2 x'Px + q'x
+ *      subject to  l <= Ax <= u
+ * 
+ * with MPC_HORIZON variables and 2*MPC_HORIZON constraints.
+ * 
+ * ADMM is used (as in OSQP), with fixed step parameters. P and A never change
+ * for a given axis, so the only matrix that ever needs factorizing is factorized
+ * once, in setup(). Each iteration is then a pair of triangular solves and a
+ * couple of matrix-vector products.
+ * 
+ * The previous solution and dual variables are kept, so every solve is warm-
+ * started from the last one. Consecutive problems differ only a little, so this
+ * usually converges in a handful of iterations. Sudden changes in the cue can
+ * still take it to MPC_MAX_ITERATIONS without converging (a few samples in 
+ * ten thousand), which getLastConverged reports.
+ */
+class mpcQPsolver
+{
+    public:
+
+    static const unsigned int N = MPC_HORIZON;
+    static const unsigned int M = 2 * MPC_HORIZON;
+
+    private:
+
+    double P[N][N];
+    double A[M][N];     //Stored with every row scaled by rowScale
+    double rowScale[M];
+    double L[N][N];     //Cholesky factor of P + sigma*I + rho*A'A
+
+    double x[N], z[M], y[M];
+    double rhs[N], xt[N], zt[M];
+
+    double rho, sigma, alpha;
+    double epsAbs, epsRel;
+
+    unsigned int lastIterations;
+    bool lastConverged;
+
+    //Solve (L L') out = in
+    void cholSolve(const double *in, double *out);
+
+    public:
+
+    mpcQPsolver();
+
+    //Set the problem matrices and factorize. Throws std::runtime_error if
+    //P is not positive semi-definite.
+    void setup(const double (&Pin)[N][N], const double (&Ain)[M][N]);
+    //Forget the warm start
+    void reset();
+    //Solve for new q, l and u. Returns the number of iterations used.
+    unsigned int solve(const double (&q)[N], const double (&l)[M], const double (&u)[M]);
+
+    double getSolution(unsigned int index) const;
+    unsigned int getLastIterations() const;
+    //False if the last solve stopped at MPC_MAX_ITERATIONS
+    bool getLastConverged() const;
+};
+
+
+/*
+ *  mpcAxis
+ * 
+ * One degree of freedom of the MPC cueing engine: the MB model, the condensed
+ * QP matrices built from it and the current MB state.
+ * 
+ * modelOrder 2 is a double integrator (position, velocity, input is 
+ * acceleration), modelOrder 1 a single integrator (angle, input is angular 
+ * velocity).
+ */
+class mpcAxis
+{
+    private:
+
+    static const unsigned int N = mpcQPsolver::N;
+    static const unsigned int M = mpcQPsolver::M;
+
+    unsigned int order;
+    double dt;
+    mpcAxisWeights weights;
+    double posMin, posMax, inputLim;
+
+    //Predicted position/velocity at the end of step k due to input j
+    double Gp[N][N], Gv[N][N];
+    //Time elapsed at the end of step k
+    double T[N];
+    //Stage weights, proportional to step length
+    double c[N];
+    //Precomputed products for the linear term of the cost
+    double gp1[N], gpT[N], gv1[N];
+
+    mpcQPsolver solver;
+    double q[N], l[M], u[M];
+
+    //MB state
+    double pos, vel, lastInput;
+
+    public:
+
+    mpcAxis(unsigned int modelOrder, double samplePeriod, const mpcAxisWeights& axisWeights,
+            double lowerLim, double upperLim, double inputLimit);
+
+    //Solve for the reference, apply the first input and return the new position
+    double nextSample(double reference);
+    //Back to neutral and at rest
+    void reset();
+
+    unsigned int getLastIterations() const;
+    //False if the last solve stopped at MPC_MAX_ITERATIONS
+    bool getLastConverged() const;
+};
+
+
+/*
+ *  MCIS MPC class
+ * 
+ * Drop-in alternative to MCIS_MDA. Inputs, outputs and getters are the same.
+ * 
+ * The solve time of every sample is measured, so that the worst case can be
+ * shown to the user and checked against the 60 Hz MB period.
+ */
+class MCIS_MPC
+{
+    private:
+
+    bool subgrav;
+
+    tiltCoordination    tiltBlock;
+
+    saturation xSat, ySat, zSat;
+    saturation rollSat, pitchSat, yawSat;
+
+    mpcAxis xAxis, yAxis, zAxis;
+    mpcAxis rollAxis, pitchAxis, yawAxis;
+
+    MCISvector posOut, angleOut, angleNoTCout;
+    MCISvector accInput, angvInput, attInput;
+
+    double kX, kY, kZ, kp, kq, kr;
+    double zGravSub;
+
+    //Solve time statistics, in nanoseconds
+    int64_t lastSolveTime, worstSolveTime;
+    unsigned int worstIterations;
+    //Samples where some axis stopped at MPC_MAX_ITERATIONS without converging
+    unsigned long capHits;
+
+    //Gravity subtraction and input scaling, same as MCIS_MDA
+    void prepareInputs(const MCISvector& accelerations, const MCISvector& angularVelocities, 
+                       const MCISvector& attitude);
+    //Angular workspace left over after tilt coordination
+    static double tiltAllowance(double K_TC, double lim_TC, const discreteBiquadSectionParams& lp,
+                                double limit);
+
+    public:
+
+    MCIS_MPC(const MCISconfig& config, bool subtract_gravity);
+
+    void nextSample(const MCISvector& accelerations, const MCISvector& angularVelocities, 
+                    const MCISvector& attitude);
+    //Start from neutral, with tilt coordination at its steady state
+    void initSteadyState(const MCISvector& accelerations, const MCISvector& angularVelocities, 
+                         const MCISvector& attitude);
+    MCISvector& getPos();
+    MCISvector& getangle();
+    MCISvector& getAngleNoTC();
+
+    int64_t getLastSolveTime() const;
+    int64_t getWorstSolveTime() const;
+    unsigned int getWorstIterations() const;
+    unsigned long getCapHits() const;
+    void resetSolveStats();
+};
@@ -0,0 +1,125 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <ostream>
+
+/*
+ *  Heap and syscall auditing for the real-time path
+ * 
+ * Built with MCIS_AUDIT defined (cmake -DMCIS_AUDIT=ON), MCIS_audit.cpp 
+ * replaces the global operator new and delete and interposes the libc 
+ * entry points of the syscalls the send and reactor threads could make 
+ * (syscall() itself included, for io_uring), so that every call is counted
+ * against the calling thread. Without MCIS_AUDIT, nothing is hooked, the 
+ * counts are always zero and auditRegion does nothing.
+ * 
+ * Only calls that go through the dynamic libc symbols are seen, which covers
+ * MCIS and libstdc++ but not glibc calling itself (e.g. fwrite calling write).
+ * clock_gettime normally never enters the kernel (vDSO) and is not counted.
+ */
+
+/*
+ *  auditCounts
+ * 
+ * Heap allocations, frees, bytes allocated and syscalls. Either running
+ * totals for a thread, or the difference between two of those.
+ */
+class auditCounts
+{
+    public:
+
+    uint64_t allocations    = 0;
+    uint64_t frees          = 0;
+    uint64_t bytes          = 0;
+    uint64_t syscalls       = 0;
+
+    auditCounts operator-(const auditCounts& rhs) const;
+};
+
+//Running totals for the calling thread
+auditCounts auditThreadCounts();
+//True if this is an MCIS_AUDIT build, with the hooks in place
+bool auditEnabled();
+
+/*
+ *  auditReport
+ * 
+ * What an auditRegion has seen: how many runs were recorded, the totals
+ * over them, the most any single run did, and how many runs allocated.
+ */
+class auditReport
+{
+    public:
+
+    uint64_t     runs               = 0;
+    uint64_t     allocating_runs    = 0;
+    auditCounts  total;
+    auditCounts  worst;
+
+    //One line: runs, allocations and syscalls per run, worst run
+    void print(std::ostream& dest) const;
+};
+
+/*
+ *  auditRegion
+ * 
+ * Counts what one region of code does each time it runs. begin() and end()
+ * must be called by the same thread, around the region. end(false) throws 
+ * the run away, for runs that are not of interest (e.g. outside ENGAGED).
+ * 
+ * Only one thread may record, any thread can call getReport() at any time.
+ * Like latencyHistogram, a reader may see a run in some totals and not yet
+ * in others.
+ */
+class auditRegion
+{
+    private:
+
+    auditCounts start;
+
+    std::atomic<uint64_t> runs{0};
+    std::atomic<uint64_t> allocatingRuns{0};
+    std::atomic<uint64_t> totals[4];
+    std::atomic<uint64_t> worst[4];
+
+    public:
+
+    auditRegion();
+
+    auditRegion(const auditRegion&) = delete;
+    auditRegion& operator=(const auditRegion&) = delete;
+
+    void begin();
+    void end(bool record = true);
+    void reset();
+
+    auditReport getReport() const;
+};
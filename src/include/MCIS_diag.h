@@ -0,0 +1,140 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <ostream>
+#include <thread>
+
+/*
+ *  Real-time safe diagnostics
+ * 
+ * The send, reactor and X-Plane receive threads must never print: a slow 
+ * terminal blocks them, and under curses it garbles the screen. Instead,
+ * they call diagReport with one of a fixed set of diagnostics and a value
+ * that goes with it (bytes sent, errno, ...), and a diagDrain thread 
+ * prints them somewhere harmless.
+ * 
+ * Theory of operation:
+ * 
+ * 1. Each diag_id has a slot of its own, with how many times it was 
+ *    reported and the latest value and time. diagReport only updates that
+ *    slot, with relaxed atomics: from any thread, without locks, without
+ *    allocating and without ever waiting.
+ * 2. The drain thread looks at every slot each DIAG_DRAIN_SLEEP_MS. If one
+ *    was reported since it last printed it, it prints one line, with the
+ *    latest value and how many times it happened since. 
+ * 3. That line waits until DIAG_REPORT_INTERVAL_NS after the last one for
+ *    the same diagnostic, so an error that repeats every tick costs one 
+ *    line a second, not a flood. Nothing is lost, only summed up.
+ * 
+ * The value printed is the latest one. If two threads report the same 
+ * diagnostic at once, it may be either one's.
+ */
+
+//Every diagnostic the real-time threads can report. The value is what 
+//diagText says.
+enum diag_id {DIAG_MB_SEND_FAILED, DIAG_MB_RECV_FAILED, DIAG_XP_RECV_FAILED, 
+              DIAG_XP_WRONG_LENGTH, DIAG_COUNT};
+
+//At most one line per diagnostic this often, in ns
+#define DIAG_REPORT_INTERVAL_NS 1000000000
+//How long the drain thread sleeps between looking, in ms
+#define DIAG_DRAIN_SLEEP_MS     50
+//Longest line diagFormat writes
+#define DIAG_LINE_LEN           128
+//Default file MCIS drains them to, appended to
+#define DIAG_FILENAME           "MCISdiag.log"
+
+/*
+ *  How often a diagnostic was reported, and the latest time (monotonicNs)
+ * and value
+ */
+class diagStatus
+{
+    public:
+
+    uint64_t count = 0;
+    int64_t last_time = 0;
+    int64_t last_value = 0;
+};
+
+//Report a diagnostic. Safe from any thread, never blocks or allocates.
+void diagReport(diag_id id, int64_t value = 0);
+diagStatus diagGetStatus(diag_id id);
+//Reports of every diagnostic so far
+uint64_t diagTotal();
+//What the diagnostic means, as a printf format for its value
+const char *diagText(diag_id id);
+//The diagnostic's text, with value in it
+void diagFormat(diag_id id, int64_t value, char *line, std::size_t length);
+//The most recently reported diagnostic. False if there was none.
+bool diagLatest(diag_id& id, diagStatus& status);
+
+/*
+ *  diagDrain
+ * 
+ * The thread that prints reported diagnostics, see the theory of operation.
+ * Diagnostics reported while none is running are still counted, and the 
+ * next one to start prints them.
+ */
+class diagDrain
+{
+    private:
+
+    std::ostream *out;
+
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> lines{0};
+    //Per diagnostic: reports already printed, and when the last line went
+    uint64_t printed[DIAG_COUNT] = {};
+    int64_t last_line[DIAG_COUNT] = {};
+
+    std::thread drain;
+
+    void drain_func();
+    //Print a line for every diagnostic that is due. All of them if force.
+    void print_due(bool force);
+
+    public:
+
+    //Starts the drain thread right away
+    diagDrain(std::ostream& output);
+    ~diagDrain();
+
+    diagDrain(const diagDrain&) = delete;
+    diagDrain& operator=(const diagDrain&) = delete;
+
+    //Print whatever is still pending and stop the drain thread
+    void stop();
+
+    //Lines printed so far
+    uint64_t get_lines() const;
+};
@@ -100,15 +100,25 @@ void writeMCISfullOutputs(std::ostream& outfile,
 /*
  *  Write MDA log
  * 
- * Writes six inputs (a_x, a_y, a_z, p, q, r) and six outputs 
- * (x, y, z, phi, theta, psi) to a CSV file
+ * Writes nine inputs (a_x, a_y, a_z, p, q, r, phi, theta, psi), six outputs 
+ * (x, y, z, phi, theta, psi), the input to output and MB round trip 
+ * latencies in us, and then the MB's feedback, transport delay in ms and
+ * RMS tracking error, six each (x, y, z, phi, theta, psi), to a CSV file
  */
 void write_MDA_log(std::ostream& outfile,
                     const MCISvector& acc_in,
                     const MCISvector& angv_in,
                     const MCISvector& att_in,
                     const MCISvector& pos_out,
-                    const MCISvector& ang_out);
+                    const MCISvector& ang_out,
+                    double input_to_output_us,
+                    double mb_rtt_us,
+                    const MCISvector& pos_fb,
+                    const MCISvector& ang_fb,
+                    const MCISvector& pos_delay_ms,
+                    const MCISvector& ang_delay_ms,
+                    const MCISvector& pos_error,
+                    const MCISvector& ang_error);
 
 
 /*
@@ -0,0 +1,104 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <ostream>
+
+/*
+ *  Latency histograms
+ * 
+ * latencyHistogram records durations in nanoseconds into HDR-style buckets:
+ * values below 2^HIST_SUB_BITS get a bucket each, above that every power of
+ * two is split into 2^HIST_SUB_BITS equal buckets. The relative error is 
+ * then at most 2^-HIST_SUB_BITS (about 3%) at any magnitude, with a fixed 
+ * number of buckets.
+ * 
+ * Recording is a handful of relaxed atomic increments, with no locks and no
+ * allocation, so it is safe in the send thread every tick. Any other thread 
+ * can read the histogram at any time. A reader may see a sample in one 
+ * counter and not yet in another, which only ever matters for the sample 
+ * being recorded.
+ */
+
+//Sub-buckets per power of two, as a power of two
+#define HIST_SUB_BITS       5
+//Largest value recorded exactly, as a power of two. 2^40 ns is over 18 
+//minutes, anything longer is recorded as 2^40 ns.
+#define HIST_MAX_BITS       40
+#define HIST_BUCKETS        ((HIST_MAX_BITS - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+/*
+ *  histogramSummary
+ * 
+ * Percentiles, maximum and mean of a latencyHistogram, in nanoseconds.
+ * Percentiles are the upper end of the bucket they fall in.
+ */
+class histogramSummary
+{
+    public:
+
+    uint64_t count  = 0;
+    int64_t  p50    = 0;
+    int64_t  p99    = 0;
+    int64_t  p999   = 0;
+    int64_t  max    = 0;
+    double   mean   = 0;
+
+    //One line: p50, p99, p99.9 and max in us, then the count
+    void print(std::ostream& dest) const;
+};
+
+class latencyHistogram
+{
+    private:
+
+    std::atomic<uint64_t> buckets[HIST_BUCKETS];
+    std::atomic<uint64_t> total;
+    std::atomic<int64_t>  sum;
+    std::atomic<int64_t>  maximum;
+
+    static unsigned int bucketIndex(uint64_t value);
+    //Largest value that falls in the bucket
+    static int64_t bucketValue(unsigned int index);
+
+    public:
+
+    latencyHistogram();
+
+    latencyHistogram(const latencyHistogram&) = delete;
+    latencyHistogram& operator=(const latencyHistogram&) = delete;
+
+    //Record one duration. Negative values are recorded as zero.
+    void record(int64_t ns);
+    void reset();
+
+    histogramSummary getSummary() const;
+};
@@ -0,0 +1,167 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MCIS_spsc.h"
+
+/*
+ *  Event journal
+ * 
+ * A record of everything that changes the interface's course: its state 
+ * transitions, the user commands behind them, and what the MB reports 
+ * about itself. Unlike the MDA log or the flight recorder, it is small 
+ * enough to keep for every session, so engage and park timing can be 
+ * compared across them (see MCIS-journal).
+ * 
+ * Theory of operation:
+ * 
+ * 1. The send thread, and only the send thread, calls log() with a 
+ *    journalEvent, stamped with monotonicNs(). The event is pushed onto a
+ *    lock-free ring. Nothing blocks or allocates. If the ring is full, the
+ *    event is dropped and counted.
+ * 2. A background thread pops the events every JOURNAL_WRITER_SLEEP_MS and
+ *    appends them to the journal file, flushing after each batch so that
+ *    not much is lost if the process dies.
+ * 3. The file starts with a journalHeader, which ties the monotonic clock to
+ *    the wall clock, and ends with JOURNAL_STOP, which holds the number of 
+ *    events dropped. A journal without it was cut short.
+ * 
+ * Events are written as they are in memory, so journals are ENDIAN-DEPENDENT,
+ * like the flight recorder's dumps.
+ */
+
+//Events the ring can hold. Transitions come a few per second at most.
+#define JOURNAL_RING_EVENTS     256
+//How long the writer sleeps when it has caught up, in ms
+#define JOURNAL_WRITER_SLEEP_MS 20
+//Journal file format
+#define JOURNAL_MAGIC           "MCISJRNL"
+#define JOURNAL_VERSION         1
+
+/*
+ *  What happened. What a, b and c hold depends on it:
+ * 
+ * JOURNAL_START:           a = cueing_engine, b = tick_mode
+ * JOURNAL_STATE:           a = iface_status before, b = after, c = iface_error
+ * JOURNAL_USER_COMMAND:    a = user_command, c = when it was issued
+ * JOURNAL_MB_STATE:        a = MB state before, b = after (MASK_STATE_ENCODED)
+ * JOURNAL_LATCHED_FAULT:   a = latched_fault_data before, b = after
+ * JOURNAL_DISCRETE_IO:     a = discrete_IO_info before, b = after
+ * JOURNAL_REPLY_TIMEOUT:   a = 1 when the MB stopped replying, 0 when it 
+ *                          came back, c = reply timeouts so far
+ * JOURNAL_STOP:            c = events dropped
+ * 
+ * The MB's words are in host order. For the MB's events, c is when the last
+ * reply arrived unless noted otherwise.
+ */
+enum journal_event_type {JOURNAL_START, JOURNAL_STATE, JOURNAL_USER_COMMAND, 
+                         JOURNAL_MB_STATE, JOURNAL_LATCHED_FAULT, JOURNAL_DISCRETE_IO,
+                         JOURNAL_REPLY_TIMEOUT, JOURNAL_STOP, JOURNAL_EVENT_TYPES};
+
+class journalEvent
+{
+    public:
+
+    //monotonicNs()
+    int64_t  time;
+    uint32_t type;
+    uint32_t a;
+    uint32_t b;
+    uint32_t reserved;
+    int64_t  c;
+};
+
+/*
+ *  The start of a journal file. The same instant on both clocks, so that 
+ * event times can be put on the wall clock.
+ */
+class journalHeader
+{
+    public:
+
+    char     magic[8];
+    uint32_t version;
+    uint32_t event_size;
+    int64_t  start_monotonic;
+    int64_t  start_realtime;
+};
+
+class eventJournal
+{
+    private:
+
+    std::ofstream outfile;
+    std::string path;
+
+    spscRing<journalEvent, JOURNAL_RING_EVENTS> ring;
+
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> dropped{0};
+
+    std::thread writer;
+
+    void writer_func();
+    void write_event(const journalEvent& event);
+
+    public:
+
+    //Journals to <file_prefix><n>.jnl, for the first n not already there.
+    //Starts the writer thread right away, unless the file won't open.
+    eventJournal(const std::string& file_prefix);
+    ~eventJournal();
+
+    eventJournal(const eventJournal&) = delete;
+    eventJournal& operator=(const eventJournal&) = delete;
+
+    //Queue an event, stamped now. Only ever call this from one thread. 
+    //Never blocks, returns false if the event had to be dropped.
+    bool log(journal_event_type type, uint32_t a = 0, uint32_t b = 0, int64_t c = 0);
+
+    //Write out whatever is still queued, end the journal and stop the 
+    //writer thread
+    void stop();
+
+    //False if the journal file couldn't be opened
+    bool isOpen() const;
+    const std::string& getPath() const;
+    uint64_t get_written() const;
+    uint64_t get_dropped() const;
+
+    static const char *eventName(journal_event_type type);
+    //Read a journal back. False if it is not one, or not from this build. 
+    //Events up to where a cut short journal ends are kept.
+    static bool load(const std::string& path, journalHeader& header, 
+                     std::vector<journalEvent>& events);
+};
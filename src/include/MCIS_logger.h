@@ -0,0 +1,125 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <ostream>
+#include <thread>
+#include "discreteMath.h"
+#include "MCIS_spsc.h"
+#include "MCIS_tracking.h"
+
+/*
+ *  Asynchronous MDA log
+ * 
+ * write_MDA_log formats a whole row through iostreams and flushes every 
+ * line, which is far too slow (and too unpredictable, the disk may stall) 
+ * for the send thread. Instead, the send thread copies the values into a 
+ * fixed-size binary record and pushes it onto a lock-free ring. A background
+ * thread pops the records and writes them with write_MDA_log.
+ * 
+ * Each row holds the nine MDA inputs and six outputs, the input to output 
+ * and MB round trip latencies in us, and then the MB's feedback, transport 
+ * delay in ms (NaN until there is an estimate) and RMS tracking error, six
+ * each (x, y, z, phi, theta, psi).
+ * 
+ * If the writer falls so far behind that the ring fills up, new records are
+ * dropped (and counted) rather than waiting for room.
+ */
+
+//Records the ring can hold. At 120 Hz, this is half a minute of logging.
+#define MDA_LOG_RING_RECORDS    4096
+//How long the writer sleeps when it has caught up, in ms
+#define MDA_LOG_WRITER_SLEEP_MS 5
+
+/*
+ *  mdaLogRecord
+ * 
+ * One line of the MDA log, in the order it is written. The latencies and
+ * the tracking figures are the latest measured when the line was queued. 
+ * Latencies are in ns, 0 if none yet. Delays are in ns, and there is none
+ * unless delay_valid.
+ */
+class mdaLogRecord
+{
+    public:
+
+    double acc_in[3];
+    double angv_in[3];
+    double att_in[3];
+    double pos_out[3];
+    double ang_out[3];
+    int64_t input_to_output;
+    int64_t mb_rtt;
+    double feedback[TRACKING_AXES];
+    bool delay_valid[TRACKING_AXES];
+    int64_t delay[TRACKING_AXES];
+    double error_rms[TRACKING_AXES];
+};
+
+class asyncMDAlog
+{
+    private:
+
+    std::ostream *outfile;
+
+    spscRing<mdaLogRecord, MDA_LOG_RING_RECORDS> ring;
+
+    std::atomic<bool> running;
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> dropped;
+
+    std::thread writer;
+
+    void writer_func();
+    void write_record(const mdaLogRecord& record);
+
+    public:
+
+    //Starts the writer thread right away
+    asyncMDAlog(std::ostream& out);
+    ~asyncMDAlog();
+
+    asyncMDAlog(const asyncMDAlog&) = delete;
+    asyncMDAlog& operator=(const asyncMDAlog&) = delete;
+
+    //Queue one line of the log. Only ever call this from one thread.
+    //Never blocks, returns false if the record had to be dropped.
+    bool log(const MCISvector& acc_in, const MCISvector& angv_in, const MCISvector& att_in,
+             const MCISvector& pos_out, const MCISvector& ang_out,
+             int64_t input_to_output = 0, int64_t mb_rtt = 0,
+             const trackingStatus& tracking = trackingStatus());
+
+    //Write out whatever is still queued and stop the writer thread
+    void stop();
+
+    uint64_t get_written() const;
+    uint64_t get_dropped() const;
+};
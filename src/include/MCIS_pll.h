@@ -0,0 +1,124 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+
+#pragma once
+
+#include <cstdint>
+
+/*
+ *  Tick to X-Plane frame alignment
+ * 
+ * X-Plane sends a message per frame, at its own frame rate, while the MB 
+ * send thread ticks at 120 Hz on its own clock. The two drift against each
+ * other, and where they beat some ticks see the same message twice and some
+ * messages are never seen at all, which comes out as stutter in the motion.
+ * 
+ * framePLL is a software phase-locked loop that moves the ticks instead, so
+ * that a tick lands a fixed offset after each message (or after every n-th
+ * message, or every n-th tick lands after one, depending on the rates).
+ * 
+ * Theory of operation:
+ * 
+ * 1. Every new message's sequence number and receive time go in through
+ *    arrival(). Receive times jitter with the network and with scheduling,
+ *    so they are run through an alpha-beta tracker: the next arrival is
+ *    predicted from the last prediction and the period, and the prediction
+ *    error corrects the phase (by PLL_ALPHA) and the period (by PLL_BETA).
+ *    Predictions step by the difference in sequence numbers, so a lost 
+ *    message doesn't read as a long frame. An error of more than half a 
+ *    period means the tracker has lost the messages and it restarts from 
+ *    the new one.
+ * 2. The ratio between the message period and the nominal tick period is
+ *    rounded to a whole number, either way round. If the tick period that 
+ *    makes the ratio exact is within PLL_MAX_RATE_PERCENT of nominal, the 
+ *    loop can lock and that becomes the tick period. Otherwise the rates 
+ *    are too far apart for alignment to mean anything and ticks stay at 
+ *    the nominal period.
+ * 3. Every tick, update() takes the phase error: how far the next deadline 
+ *    is from the predicted arrival plus the offset, wrapped to within half a 
+ *    tick period of zero. A fraction PLL_GAIN of that, at most 
+ *    PLL_MAX_STEP_NS, is what the deadline should move by. The period from
+ *    2 is the frequency term, so a proportional phase correction is enough.
+ * 4. With no message for PLL_TIMEOUT_NS, the loop unlocks and ticks go back
+ *    to the nominal period.
+ */
+
+//Time from a message arriving to the tick that should pick it up, ns.
+//Covers the recv thread decoding and publishing it, and arrival jitter.
+#define PLL_OFFSET_NS           1000000
+//How far from 120 Hz the tick rate may be pulled
+#define PLL_MAX_RATE_PERCENT    2
+//Fraction of the phase error corrected per tick, and the largest single step
+#define PLL_GAIN                0.1
+#define PLL_MAX_STEP_NS         50000
+//Arrival tracker gains, phase and period
+#define PLL_ALPHA               0.1
+#define PLL_BETA                0.005
+//Messages needed before the period estimate is trusted
+#define PLL_MIN_ARRIVALS        32
+//Unlock after this long without a message
+#define PLL_TIMEOUT_NS          500000000
+
+class framePLL
+{
+    private:
+
+    int64_t nominalPeriod;
+    int64_t offset;
+
+    uint64_t arrivals = 0;
+    uint64_t lastSequence = 0;
+    int64_t  lastArrival = 0;
+    //Tracker state: filtered time of the last message, and the period
+    double   predictedArrival = 0;
+    double   messagePeriod = 0;
+
+    bool     locked = false;
+    int64_t  tickPeriod;
+    int64_t  phaseError = 0;
+
+    public:
+
+    framePLL(int64_t nominal_period_ns, int64_t offset_ns = PLL_OFFSET_NS);
+
+    //Feed a new message. Repeats of the last sequence number are ignored.
+    void arrival(uint64_t sequence, int64_t recvTime);
+
+    //Once per tick. next_deadline is when the next tick is due, now is the
+    //current time. Returns how far to move next_deadline, and leaves the 
+    //period to tick at in getTickPeriod().
+    int64_t update(int64_t next_deadline, int64_t now);
+
+    bool     isLocked() const;
+    int64_t  getTickPeriod() const;
+    //Estimated X-Plane message period, ns. Zero until there is an estimate.
+    int64_t  getMessagePeriod() const;
+    //Phase error at the last update, ns
+    int64_t  getPhaseError() const;
+};
@@ -0,0 +1,177 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <sys/socket.h>
+#include "MCIS_rt.h"
+#include "MCIS_uring.h"
+#include "MCIS_audit.h"
+
+/*
+ *  I/O reactor
+ * 
+ * One thread services every socket the interface receives on, plus a 
+ * periodic timer, instead of one blocking thread per socket:
+ * 
+ *  - Each fd is watched with a reactorHandler, whose onReadable() is called
+ *      whenever the fd becomes readable. Handlers must not block: they read
+ *      with MSG_DONTWAIT until nothing is left.
+ *  - One timer, armed for an absolute deadline (e.g. a reply timeout) from
+ *      any handler. When it expires, onTimer() of the timer's handler is 
+ *      called, from the same thread, so handlers need no locking against
+ *      each other. It is one-shot, and only wakes the thread when it is 
+ *      actually due.
+ *  - stop() wakes the thread through an eventfd, so nothing has to be shut
+ *      down under it.
+ * 
+ * On Linux this is epoll, with a timerfd for the timer. Elsewhere it falls
+ * back to poll(), with the time left to the deadline as the poll timeout.
+ * 
+ * With NET_URING, it is an io_uring instead (see MCIS_uring.h), and the 
+ * thread sleeps in io_uring_enter. Fds watched with watchDatagrams() get a
+ * multishot recvmsg into provided buffers, so the datagrams themselves are
+ * handed to onDatagram(), one by one, with no syscall to read them, then 
+ * onDatagramsDone() is called once per wakeup. Each comes with its arrival
+ * time, from the kernel if the socket has receive timestamps on (see 
+ * enableRxTimestamps), else the time the reactor got it. The timerfd, the eventfd 
+ * and plain watch() fds are multishot polls. If the kernel won't do 
+ * io_uring, or a multishot receive fails for good, it is epoll and 
+ * onReadable() again.
+ * 
+ * Each wakeup, wait included, is an audited region (see MCIS_audit.h).
+ */
+
+//Most fds one reactor can watch, not counting its own
+#define REACTOR_MAX_SOURCES 8
+
+//Provided buffers for multishot receives, shared by all datagram fds. 
+//Enough for a burst of as many datagrams, each at most as large.
+#define REACTOR_URING_BUFFERS       64
+#define REACTOR_URING_BUFFER_SIZE   2048
+
+class reactorHandler
+{
+    public:
+
+    virtual ~reactorHandler() {}
+
+    //fd, which was watched with this handler, is readable
+    virtual void onReadable(int fd) = 0;
+    //The reactor timer expired. now is monotonicNs().
+    virtual void onTimer(int64_t now) { (void)now; }
+    //One datagram received on fd, watched with watchDatagrams, under 
+    //io_uring, and when it arrived (monotonicNs()). data is only valid 
+    //during the call.
+    virtual void onDatagram(int fd, const unsigned char *data, int length, int64_t rx_time)
+    {
+        (void)fd;
+        (void)data;
+        (void)length;
+        (void)rx_time;
+    }
+    //No more datagrams for fd this wakeup
+    virtual void onDatagramsDone(int fd) { (void)fd; }
+};
+
+class ioReactor
+{
+    private:
+
+    int epoll_fd = -1;
+    int timer_fd = -1;
+    int wake_fd  = -1;
+
+    int sourceFds[REACTOR_MAX_SOURCES];
+    reactorHandler *sourceHandlers[REACTOR_MAX_SOURCES];
+    //Receive datagrams for the handler (io_uring only)
+    bool sourceDatagrams[REACTOR_MAX_SOURCES];
+    unsigned int sourceCount = 0;
+
+#ifdef MCIS_HAVE_URING
+    uringQueue ring;
+    //What every multishot recvmsg reserves ahead of each datagram in its
+    //buffer: no address, and room for a timestamp
+    struct msghdr recvTemplate;
+#endif
+    bool uring = false;
+
+    //Armed deadline, monotonicNs(), 0 if disarmed
+    int64_t timerDeadline = 0;
+    reactorHandler *timerHandler = nullptr;
+
+    std::atomic<bool> running{false};
+    std::thread reactorThread;
+    //Times the thread woke up, for every reason
+    std::atomic<uint64_t> wakeups{0};
+    auditRegion wakeupAudit;
+
+    bool setupEpoll();
+    void runEpoll();
+    void runPoll();
+    void runUring();
+    //Queue the multishot request for a source or one of the reactor's fds
+    void armUring(uint32_t tag);
+    //Hand one provided buffer filled by a multishot recvmsg, res bytes of
+    //it, to the source's handler
+    void deliverDatagram(uint32_t tag, const unsigned char *buffer, int res);
+
+    public:
+
+    ioReactor(net_backend backend = NET_EPOLL);
+    ~ioReactor();
+
+    ioReactor(const ioReactor&) = delete;
+    ioReactor& operator=(const ioReactor&) = delete;
+
+    //Watch fd for reads. Only before start(). False if full.
+    bool watch(int fd, reactorHandler *handler);
+    //Same, for a datagram socket, whose handler can take onDatagram() too
+    bool watchDatagrams(int fd, reactorHandler *handler);
+    //Who gets onTimer. Only before start().
+    void setTimerHandler(reactorHandler *handler);
+    //Call onTimer once at deadline (monotonicNs()), replacing any deadline
+    //armed before. 0 disarms. Only from the reactor thread, i.e. handlers,
+    //or before start().
+    void armTimer(int64_t deadline);
+
+    void start();
+    //Wake the thread and join it. Handlers are not called after this.
+    void stop();
+
+    //False if it fell back to poll(), or uses io_uring
+    bool usesEpoll() const;
+    bool usesUring() const;
+    uint64_t getWakeups() const;
+    //Allocations and syscalls per wakeup, always empty unless auditEnabled().
+    //A reset may race with one wakeup in flight, which is then half counted.
+    auditReport getAuditReport() const;
+    void resetAudit();
+};
@@ -0,0 +1,241 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MCIS_seqlock.h"
+
+/*
+ *  Flight recorder
+ * 
+ * The MDA log has a line per tick, but only what the cueing engine saw and
+ * did, and it is a CSV written through iostreams. When something goes wrong
+ * with the MB, what we want is everything, at full rate, for the seconds 
+ * leading up to it: inputs, what the cueing engine did with them, what went
+ * out, what came back and when. flightRecorder keeps that in memory, always,
+ * and only writes it out when asked to.
+ * 
+ * Theory of operation:
+ * 
+ * 1. The send thread fills in a flightRecord every tick and hands it to 
+ *    record(), which copies it into the next slot of a fixed ring of 
+ *    FLIGHT_RECORDER_RECORDS. The ring is overwritten continuously, so it
+ *    always holds the last FLIGHT_RECORDER_SECONDS. No locks, no allocation.
+ * 2. On a fault, the send thread calls trigger(). Recording goes on for 
+ *    FLIGHT_RECORDER_POST_TRIGGER records, so that the dump shows what 
+ *    happened right after, then record() freezes the ring: it stops writing
+ *    to it (and counts what it would have written as missed) until the dump
+ *    is done.
+ * 3. A background thread looks for a frozen ring every 
+ *    FLIGHT_RECORDER_POLL_MS. It writes it out, oldest record first, to the
+ *    next free <prefix><n>.bin, and hands the ring back to the send thread.
+ *    File I/O never happens on the send thread.
+ * 4. dump() writes the ring out from the calling thread, once recording has
+ *    stopped for good, e.g. on shutdown after SIGINT.
+ * 
+ * The dump is a flightRecordingHeader followed by its records, as they are 
+ * in memory. That means it is ENDIAN-DEPENDENT, like the binary MDA inputs,
+ * and should be read back on the same kind of machine, see load().
+ */
+
+//The ring holds this long at the send thread's 120 Hz
+#define FLIGHT_RECORDER_SECONDS     30
+#define FLIGHT_RECORDER_RECORDS     (FLIGHT_RECORDER_SECONDS * 120)
+//Records taken after a trigger before the ring freezes, one second
+#define FLIGHT_RECORDER_POST_TRIGGER 120
+//How long the dump thread sleeps between looking for a frozen ring, ms
+#define FLIGHT_RECORDER_POLL_MS     20
+//Dump file format
+#define FLIGHT_RECORDER_MAGIC       "MCISFREC"
+#define FLIGHT_RECORDER_VERSION     1
+//Longest dump filename kept for flightRecorderStatus
+#define FLIGHT_RECORDER_PATH_LEN    128
+
+//Bits of flightRecord::flags
+#define FLIGHT_TOCK             0x01    //A command went out this tick
+#define FLIGHT_NEW_INPUT        0x02    //A new X-Plane message came in
+#define FLIGHT_LATE_TICK        0x04    //The tick started late
+#define FLIGHT_MDA_SHED         0x08    //The cueing engine didn't run
+#define FLIGHT_REPLY_TIMED_OUT  0x10    //The MB has stopped replying
+
+//Why a dump was written
+enum flight_trigger {TRIGGER_NONE, TRIGGER_MB_FAULT, TRIGGER_MB_RECOVERABLE_FAULT, 
+                     TRIGGER_SHUTDOWN};
+
+/*
+ *  One tick of the send thread
+ * 
+ * Times are monotonicNs(), durations ns. Positions are m, angles rad, in 
+ * the order x, y, z or roll, pitch, yaw. The MB's words are as received,
+ * in network order.
+ */
+class flightRecord
+{
+    public:
+
+    uint64_t tick;
+    int64_t  time;
+    //iface_status and iface_error, see MCIS_MB_interface.h
+    uint32_t status;
+    uint32_t error;
+    //FLIGHT_ bits
+    uint32_t flags;
+    //MCW of the last command sent
+    uint32_t mcw;
+
+    //Timing
+    int64_t  wake_lateness;
+    int64_t  mda_compute;
+    int64_t  send_time;
+    int64_t  input_to_output;
+    int64_t  mb_rtt;
+
+    //Inputs, and the X-Plane message they came from
+    uint64_t input_sequence;
+    int64_t  input_recv_time;
+    double   sf_in[3];
+    double   angv_in[3];
+    double   att_in[3];
+
+    //Cueing engine: its outputs before the output limiter, and the angles
+    //without tilt coordination
+    double   mda_pos[3];
+    double   mda_rot[3];
+    double   mda_rot_no_tc[3];
+
+    //Last command sent, surge, lateral, heave, roll, pitch, yaw
+    double   command[6];
+
+    //Last MB reply, its feedback in the same order as the command, and how
+    //many replies there have been
+    uint32_t mb_latched_fault;
+    uint32_t mb_discrete_io;
+    uint32_t mb_state_info;
+    uint32_t reserved;
+    uint64_t mb_replies;
+    int64_t  mb_last_reply;
+    double   feedback[6];
+};
+
+/*
+ *  The start of a dump file
+ */
+class flightRecordingHeader
+{
+    public:
+
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t records;
+    //flight_trigger, and when it came, monotonicNs(). 0 on TRIGGER_SHUTDOWN.
+    uint32_t trigger;
+    uint32_t trigger_status;
+    int64_t  trigger_time;
+    //Records written into the ring before the dump, and ones that weren't 
+    //because it was frozen for an earlier dump
+    uint64_t recorded;
+    uint64_t missed;
+};
+
+/*
+ *  Dumps so far, as the UI sees them
+ */
+class flightRecorderStatus
+{
+    public:
+
+    uint64_t dumps = 0;
+    uint64_t failed = 0;
+    flight_trigger last_trigger = TRIGGER_NONE;
+    char last_path[FLIGHT_RECORDER_PATH_LEN] = {};
+};
+
+class flightRecorder
+{
+    private:
+
+    enum ring_state {RECORDING, TRIGGERED, FROZEN};
+
+    flightRecord ring[FLIGHT_RECORDER_RECORDS];
+    //Records written so far, the next slot is recorded % FLIGHT_RECORDER_RECORDS
+    std::atomic<uint64_t> recorded{0};
+    std::atomic<uint64_t> missed{0};
+    std::atomic<ring_state> state{RECORDING};
+
+    //Set by trigger, read by the dump thread once the ring is frozen
+    uint64_t freeze_at = 0;
+    flight_trigger trigger_reason = TRIGGER_NONE;
+    uint32_t trigger_status = 0;
+    int64_t trigger_time = 0;
+
+    std::string prefix;
+    std::atomic<bool> running{true};
+    std::thread dumper;
+    seqlock<flightRecorderStatus> status;
+
+    void dumper_func();
+    //Write the ring out to the next free file, and publish how it went
+    bool dump_ring(flight_trigger reason, uint32_t trigger_status, int64_t trigger_time,
+                   std::string& path);
+    bool write_ring(const std::string& path, flight_trigger reason, 
+                    uint32_t trigger_status, int64_t trigger_time);
+
+    public:
+
+    //Dumps go to <file_prefix><n>.bin, for the first n not already there.
+    //Starts the dump thread right away.
+    flightRecorder(const std::string& file_prefix);
+    ~flightRecorder();
+
+    flightRecorder(const flightRecorder&) = delete;
+    flightRecorder& operator=(const flightRecorder&) = delete;
+
+    //Only ever call these from one thread, the one recording. They never 
+    //block. trigger is ignored while an earlier one is still being dumped.
+    void record(const flightRecord& rec);
+    void trigger(flight_trigger reason, uint32_t status_at_trigger, int64_t now);
+
+    //Stop the dump thread, after it writes out a ring frozen by now
+    void stop();
+    //Write the ring out now, from this thread. Recording must have stopped 
+    //and the dump thread with it. Returns the file written, empty on failure.
+    std::string dump(flight_trigger reason);
+
+    flightRecorderStatus getStatus() const;
+    uint64_t getRecorded() const;
+
+    static const char *triggerName(flight_trigger reason);
+    //Read a dump back. False if it is not one, or not from this build.
+    static bool load(const std::string& path, flightRecordingHeader& header, 
+                     std::vector<flightRecord>& records);
+};
@@ -0,0 +1,250 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+/*
+ *  Real-time timing for the MB send thread
+ * 
+ * The send thread has to tick at a steady 120 Hz. Under default scheduling,
+ * std::this_thread::sleep_until wakes up whenever the kernel gets around to
+ * it, so tick jitter follows system load. rtTicker provides the tick instead,
+ * with optional real-time settings for the calling thread:
+ * 
+ *  - The clock: sleep_until (the old behaviour), clock_nanosleep with an 
+ *      absolute deadline on CLOCK_MONOTONIC, or a periodic timerfd (Linux).
+ *      Absolute deadlines don't accumulate drift from late wakeups.
+ *  - SCHED_FIFO at a given priority, so that nothing at normal priority can
+ *      delay a tick.
+ *  - Pinning to one CPU (Linux).
+ *  - mlockall, so that no page the process uses can be paged out, and 
+ *      prefaulting RT_PREFAULT_STACK_BYTES of stack so that the first deep 
+ *      call doesn't take a page fault.
+ * 
+ * Most of these need privileges (CAP_SYS_NICE, CAP_IPC_LOCK or a large 
+ * enough RLIMIT_MEMLOCK). Anything that can't be had is skipped and MCIS 
+ * runs as before, rtTicker::getStatus tells what was actually applied.
+ */
+
+//Bytes of stack to prefault in the timed thread. Well below the default 
+//thread stack size.
+#define RT_PREFAULT_STACK_BYTES (256 * 1024)
+
+//Ways to wait for the next tick
+enum rt_clock_backend {RT_CLOCK_SLEEP_UNTIL, RT_CLOCK_NANOSLEEP, RT_CLOCK_TIMERFD};
+
+//When the send thread computes a new MDA sample within each tick:
+//  TICK_FIXED: right at the start of the tick, with whatever input is there
+//  TICK_EVENT: as soon as a new X-Plane message arrives, or just before the
+//      next tick if none does (Linux only)
+//  TICK_JIT: just in time for the next tick, as late as the measured 
+//      compute time allows
+//  TICK_PLL: at the start of the tick, with the ticks themselves slewed to 
+//      land a fixed time after X-Plane messages arrive (see MCIS_pll.h)
+enum tick_mode {TICK_FIXED, TICK_EVENT, TICK_JIT, TICK_PLL};
+
+//What to do with ticks whose deadline passed while the previous one was 
+//still running:
+//  RT_OVERRUN_CATCH_UP: run them all, back to back, until on schedule again
+//  RT_OVERRUN_DROP: run the late one right away, skip any others already 
+//      due, and carry on from the next deadline still in the future
+enum rt_overrun_policy {RT_OVERRUN_CATCH_UP, RT_OVERRUN_DROP};
+
+//How the MB interface does its socket I/O:
+//  NET_EPOLL: an epoll reactor thread receives, the send thread calls sendto
+//  NET_URING: io_uring for both, see MCIS_uring.h (Linux). Falls back to 
+//      NET_EPOLL if the kernel doesn't have it.
+enum net_backend {NET_EPOLL, NET_URING};
+
+/*
+ *  rtTimingConfig
+ * 
+ * Requested settings, as read from the RT section of MCISinit.cfg.
+ * The defaults apply no privileged setting.
+ */
+class rtTimingConfig
+{
+    public:
+
+    rt_clock_backend clock  = RT_CLOCK_NANOSLEEP;
+    int  fifo_priority      = 0;        //SCHED_FIFO priority, 0 keeps default scheduling
+    int  cpu                = -1;       //CPU to pin to, -1 for no affinity
+    bool lock_memory        = false;    //mlockall
+    bool prefault_stack     = false;
+    //Map the arena holding the interface (see rtArena) from huge pages
+    bool arena_huge_pages   = false;
+    //SO_BUSY_POLL on the X-Plane socket, us. 0 sleeps as usual.
+    int  xp_busy_poll_us    = 0;
+    net_backend net         = NET_EPOLL;
+    //With NET_URING, a kernel thread polls the send ring, so that sending
+    //takes no syscall. It keeps a core busy.
+    bool uring_sqpoll       = false;
+    tick_mode ticks         = TICK_FIXED;
+    rt_overrun_policy overrun = RT_OVERRUN_CATCH_UP;
+    //Load shedding on ticks that start late, see mbinterface
+    bool overrun_skip_logging = false;
+    bool overrun_resend     = false;
+};
+
+/*
+ *  rtStatus
+ * 
+ * What was actually applied, plus the number of ticks woken up for late 
+ * (after the next tick was already due).
+ */
+class rtStatus
+{
+    public:
+
+    bool started            = false;
+    rt_clock_backend clock  = RT_CLOCK_SLEEP_UNTIL;
+    int  fifo_priority      = 0;        //0 if SCHED_FIFO is not in use
+    int  cpu                = -1;
+    bool memory_locked      = false;
+    bool stack_prefaulted   = false;
+    unsigned long missed_ticks = 0;
+    unsigned long dropped_ticks = 0;    //RT_OVERRUN_DROP only
+};
+
+/*
+ *  rtTicker
+ * 
+ * Periodic tick source for one thread. start() must be called from the 
+ * thread to be timed, since scheduling and affinity are per thread. The first 
+ * tick is one period after start(). wait() then blocks until the next tick.
+ */
+class rtTicker
+{
+    private:
+
+    rtTimingConfig config;
+    int64_t period;         //ns
+    rtStatus status;
+    std::atomic<unsigned long> missed{0};
+    std::atomic<unsigned long> dropped{0};
+    //timerfd expirations read but not yet returned by wait(), for 
+    //RT_OVERRUN_CATCH_UP
+    uint64_t pendingTicks = 0;
+    int64_t lastDropped = 0;
+
+    //Next deadline, for each clock
+    struct timespec nextDeadline;
+    std::chrono::steady_clock::time_point nextTick;
+    int timer_fd = -1;
+
+    //How late the last wake-up was, ns
+    int64_t lastLateness = 0;
+
+    void applyThreadSettings();
+    bool startTimerfd();
+
+    public:
+
+    rtTicker(const rtTimingConfig& rt_config, int64_t period_ns);
+    ~rtTicker();
+
+    rtTicker(const rtTicker&) = delete;
+    rtTicker& operator=(const rtTicker&) = delete;
+
+    //Apply the settings to the calling thread and start counting ticks
+    void start();
+    //Block until the next tick. Returns true if it was already due on entry,
+    //meaning the caller overran it.
+    bool wait();
+    //Ticks skipped by the last wait(), under RT_OVERRUN_DROP
+    int64_t getLastDropped() const;
+    //How long after its deadline the last wait() returned, in ns
+    int64_t getLastLateness() const;
+    //When the next wait() is due to return, on the monotonicNs() clock
+    int64_t getNextDeadline() const;
+    //Move the next deadline by adjust ns (either way) and use period_ns 
+    //between ticks from then on
+    void retime(int64_t period_ns, int64_t adjust);
+    int64_t getPeriod() const;
+
+    //Settings applied by start(). Not synchronized with start(), other than
+    //the missed tick count.
+    rtStatus getStatus() const;
+};
+
+/*
+ *  rtEventWait
+ * 
+ * Wait for an eventfd to be signalled, but no later than an absolute 
+ * deadline. The deadline is a timerfd in the same epoll set, so it has
+ * the same resolution as the ticker rather than epoll_wait's milliseconds.
+ * 
+ * Linux only. Elsewhere, or if the fds can't be created, ready() is false
+ * and waitUntil returns right away.
+ */
+class rtEventWait
+{
+    private:
+
+    int event_fd;
+    int epoll_fd    = -1;
+    int deadline_fd = -1;
+
+    public:
+
+    //event_fd is not owned, the caller closes it
+    rtEventWait(int event_fd);
+    ~rtEventWait();
+
+    rtEventWait(const rtEventWait&) = delete;
+    rtEventWait& operator=(const rtEventWait&) = delete;
+
+    bool ready() const;
+    //Block until event_fd is signalled (returns true, and consumes the 
+    //event) or until the deadline passes (returns false). Deadline is on the
+    //monotonicNs() clock. An event already pending returns immediately.
+    bool waitUntil(int64_t deadline);
+};
+
+//Sleep until an absolute time on the monotonicNs() clock
+void sleepUntilNs(int64_t deadline);
+
+//Name of a clock backend, as used in MCISinit.cfg
+const char *rtClockName(rt_clock_backend clock);
+//Parse a clock backend name. Returns false for an unknown name.
+bool rtClockFromName(const std::string& name, rt_clock_backend& clock);
+//Same, for tick modes
+const char *tickModeName(tick_mode mode);
+bool tickModeFromName(const std::string& name, tick_mode& mode);
+//Same, for overrun policies
+const char *rtOverrunName(rt_overrun_policy policy);
+bool rtOverrunFromName(const std::string& name, rt_overrun_policy& policy);
+//Same, for network backends
+const char *netBackendName(net_backend backend);
+bool netBackendFromName(const std::string& name, net_backend& backend);
@@ -0,0 +1,144 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+
+/*
+ *  Sequence lock
+ * 
+ * Publishes a small value from exactly one writing thread to any number of
+ * reading threads. The writer never waits on a reader: a publish is a fixed
+ * number of stores, whatever the readers are doing. Readers never block the
+ * writer either, they just try again if the writer got in the way.
+ * 
+ * Theory of operation:
+ * 
+ * 1. The writer bumps the sequence number to an odd value, copies the new 
+ *    value in, then bumps the sequence number to the next even value.
+ * 2. A reader loads the sequence number, copies the value out, and loads the
+ *    sequence number again. If it was odd, or it changed, a publish was under
+ *    way and the copy may be torn, so the reader starts over.
+ * 3. The value is kept as an array of relaxed atomic words rather than a
+ *    plain T, so that the overlapping copies in 2 are not a data race. The 
+ *    fences order the word copies against the sequence number.
+ * 
+ * T must be trivially copyable, it is copied in and out with memcpy.
+ */
+template <typename T>
+class seqlock
+{
+    private:
+
+    static_assert(std::is_trivially_copyable<T>::value, 
+                  "seqlock values are copied with memcpy");
+
+    static const std::size_t words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    alignas(64) std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> data[words];
+
+    public:
+
+    seqlock() : sequence{0}
+    {
+        for (std::size_t i = 0; i < words; i++)
+        {
+            data[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    seqlock(const seqlock&) = delete;
+    seqlock& operator=(const seqlock&) = delete;
+
+    //Writer side. Only ever call this from one thread.
+    void store(const T& value)
+    {
+        uint64_t buffer[words] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+
+        uint64_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < words; i++)
+        {
+            data[i].store(buffer[i], std::memory_order_relaxed);
+        }
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    //Reader side, single attempt. Returns false, leaving value untouched, 
+    //if a publish got in the way.
+    bool tryLoad(T& value) const
+    {
+        uint64_t buffer[words];
+
+        uint64_t before = sequence.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            return false;
+        }
+        for (std::size_t i = 0; i < words; i++)
+        {
+            buffer[i] = data[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (before != sequence.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+
+        std::memcpy(&value, buffer, sizeof(T));
+        return true;
+    }
+
+    //Reader side. Retries until it gets a consistent copy, which with a 
+    //writer publishing every few ms is nearly always the first try.
+    T load() const
+    {
+        T value;
+        while (!tryLoad(value))
+        {
+            std::this_thread::yield();
+        }
+        return value;
+    }
+
+    //Number of completed publishes
+    uint64_t getVersion() const
+    {
+        return sequence.load(std::memory_order_acquire) / 2;
+    }
+};
@@ -0,0 +1,111 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+
+/*
+ *  Single producer, single consumer ring buffer
+ * 
+ * A fixed-size queue between exactly one producing thread and exactly one
+ * consuming thread, with no locks and no allocation after construction. 
+ * push() and pop() never block: push() fails when the ring is full and pop()
+ * fails when it's empty, and the caller decides what to do about it.
+ * 
+ * Theory of operation:
+ * 
+ * The producer owns head and the consumer owns tail. Each only ever writes
+ * its own index, so the only synchronization needed is release on the write
+ * of an index and acquire on the read of the other thread's index. That way
+ * a slot's contents are always visible before the index that hands it over.
+ * The indices count up forever and are reduced modulo the capacity, which 
+ * must be a power of two, so full and empty are told apart without wasting a
+ * slot. The indices live on separate cache lines so that the two threads 
+ * don't keep stealing the line from each other.
+ * 
+ * T must be trivially copyable in spirit: it is copied in and out by 
+ * assignment.
+ */
+template <typename T, std::size_t Capacity>
+class spscRing
+{
+    static_assert((Capacity > 0) && (0 == (Capacity & (Capacity - 1))), 
+                  "spscRing capacity must be a power of two");
+
+    private:
+
+    alignas(64) std::atomic<std::size_t> head;  //Next slot to write, producer only
+    alignas(64) std::atomic<std::size_t> tail;  //Next slot to read, consumer only
+    alignas(64) T slots[Capacity];
+
+    public:
+
+    spscRing() : head{0}, tail{0} {}
+
+    spscRing(const spscRing&) = delete;
+    spscRing& operator=(const spscRing&) = delete;
+
+    //Producer side. Returns false, leaving the ring untouched, if it is full.
+    bool push(const T& item)
+    {
+        std::size_t currHead = head.load(std::memory_order_relaxed);
+        if (currHead - tail.load(std::memory_order_acquire) >= Capacity)
+        {
+            return false;
+        }
+        slots[currHead & (Capacity - 1)] = item;
+        head.store(currHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Consumer side. Returns false if the ring is empty.
+    bool pop(T& item)
+    {
+        std::size_t currTail = tail.load(std::memory_order_relaxed);
+        if (currTail == head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = slots[currTail & (Capacity - 1)];
+        tail.store(currTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //Either side. Only a snapshot, the other side may be changing it.
+    bool empty() const
+    {
+        return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+    }
+
+    static constexpr std::size_t capacity()
+    {
+        return Capacity;
+    }
+};
@@ -0,0 +1,214 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include "MCIS_MB_interface.h"
+#include "MOOG6DOF2000E.h"
+#include "MCIS_util.h"
+
+/*
+ *  Interface test harness
+ * 
+ * For the standalone tests that run a whole mbinterface on loopback 
+ * (audittest, overruntest and uringbench). Header only, like 
+ * MCIS_testutil.h.
+ * 
+ *  - testMB stands in for the MB. It takes every command, and can record 
+ *      when each one arrived and answer it as an engaged MB would.
+ *  - testInterface is the mbinterface under test. It logs to /dev/null and
+ *      keeps its journals and flight recorder dumps in /tmp, under the 
+ *      test's name. engage() takes it to ENGAGED through the override.
+ *  - feedXplane stands in for X-Plane.
+ */
+
+#define TEST_MB_PORT        50001
+#define TEST_LOCAL_PORT     50002
+#define TEST_LOCALHOST      0x7f000001
+
+static inline sockaddr_in testLocalAddr(uint16_t port)
+{
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(TEST_LOCALHOST);
+    return addr;
+}
+
+/*
+ *  testMB
+ * 
+ * Listens on TEST_MB_PORT from construction to stop(). Until the interface
+ * is engaged it should keep quiet, or the state machine would go by its 
+ * answers instead of the override.
+ */
+class testMB
+{
+    private:
+
+    int sock;
+    bool bound;
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> answered{0};
+    std::vector<int64_t> arrivals;
+    std::thread listener;
+
+    void listen()
+    {
+        unsigned char command[64];
+        while (running)
+        {
+            sockaddr_in from;
+            socklen_t fromSize = sizeof(from);
+            ssize_t bytes = recvfrom(sock, command, sizeof(command), 0, (sockaddr *)&from, &fromSize);
+            if (sizeof(DOFpacket) != bytes)
+            {
+                continue;
+            }
+            if (recording)
+            {
+                arrivals.push_back(monotonicNs());
+            }
+            if (answering)
+            {
+                answered++;
+                DOFresponse response = {};
+                response.machine_state_info = htonl(MB_STATE_ENGAGED);
+                sendto(sock, &response, sizeof(response), 0, (sockaddr *)&from, fromSize);
+            }
+        }
+    }
+
+    public:
+
+    //Record when commands arrive, and answer them
+    std::atomic<bool> recording{false};
+    std::atomic<bool> answering{false};
+
+    testMB()
+    {
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr = testLocalAddr(TEST_MB_PORT);
+        bound = (0 == bind(sock, (sockaddr *)&addr, sizeof(addr)));
+        timeval timeout = {0, 100000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        listener = std::thread(&testMB::listen, this);
+    }
+
+    ~testMB()
+    {
+        stop();
+    }
+
+    bool isBound() const
+    {
+        return bound;
+    }
+
+    //Stop listening. The arrivals can only be read after this.
+    void stop()
+    {
+        running = false;
+        if (listener.joinable())
+        {
+            listener.join();
+            close(sock);
+        }
+    }
+
+    const std::vector<int64_t>& getArrivals() const
+    {
+        return arrivals;
+    }
+
+    uint64_t getAnswered() const
+    {
+        return answered;
+    }
+};
+
+/*
+ *  testInterface
+ */
+class testInterface
+{
+    public:
+
+    std::fstream log;
+    mbinterface mb;
+
+    testInterface(const std::string& name, uint16_t xplanePort, const rtTimingConfig& rtConfig = rtTimingConfig(),
+                  bool single_precision = false, cueing_engine engine = CUEING_CLASSICAL)
+        :   log("/dev/null", std::ios::out),
+            mb(TEST_MB_PORT, TEST_LOCAL_PORT, TEST_LOCALHOST, xplanePort, MCISconfig(), 
+               log, true, single_precision, engine, rtConfig,
+               "/tmp/" + name + "_flightrec", "/tmp/" + name + "_journal")
+    {}
+
+    //Four overrides take the state machine to ENGAGED without an MB
+    bool engage()
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            mb.setOverride();
+            usleep(40000);
+        }
+        return (ENGAGED == mb.get_iface_status());
+    }
+};
+
+/*
+ *  feedXplane
+ * 
+ * Send empty X-Plane messages to the given port, at rateHz for the given
+ * time
+ */
+static inline void feedXplane(uint16_t xplanePort, int rateHz, int seconds)
+{
+    int xplane = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in xplaneAddr = testLocalAddr(xplanePort);
+    unsigned char message[XP9_MSG_SIZE] = {};
+    int64_t period = 1000000000 / rateHz;
+    int64_t next = monotonicNs();
+    for (int i = 0; i < rateHz * seconds; i++)
+    {
+        next += period;
+        sleepUntilNs(next);
+        sendto(xplane, message, sizeof(message), 0, (sockaddr *)&xplaneAddr, sizeof(xplaneAddr));
+    }
+    close(xplane);
+}
@@ -0,0 +1,155 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <cstdint>
+
+/*
+ *  MB tracking monitor
+ * 
+ * The MB answers every command with where it actually is. trackingMonitor
+ * pairs each command with the feedback in the reply to it and works out, 
+ * per axis, how far behind the command the MB is (its transport delay) and
+ * how far off it is (its tracking error), over a sliding window of the last
+ * TRACKING_WINDOW pairs.
+ * 
+ * Theory of operation:
+ * 
+ * 1. Commands c[n] and feedback f[n] go into a history deep enough for the
+ *    window plus the largest lag. Values are kept as integers, in um or 
+ *    urad (TRACKING_SCALE), so that the running sums below are exact: a 
+ *    value leaving the window takes off exactly what it added, and nothing
+ *    drifts however long it runs.
+ * 2. For each lag k up to TRACKING_MAX_LAG, the window keeps running sums
+ *    of f[n], f[n]^2, c[n-k], c[n-k]^2 and f[n]*c[n-k]. A new pair adds its
+ *    terms and takes off those of the pair leaving the window, so a sample
+ *    costs the same whatever the window length.
+ * 3. From the sums, the correlation coefficient between f[n] and c[n-k] for
+ *    every k. The delay is the lag with the highest one, refined between 
+ *    samples by fitting a parabola through it and its neighbours, times the
+ *    mean command period over the window. A command that barely moved 
+ *    (TRACKING_MIN_STDDEV) says nothing about delay, so then there is no 
+ *    estimate.
+ * 4. The mean square of f[n] - c[n-k] is sum f^2 - 2 sum fc + sum c^2, over
+ *    the window length, so the tracking error also falls out of the sums: 
+ *    as is (k = 0), and with the command delayed by the estimated delay.
+ * 
+ * Everything is fixed-size, nothing allocates. Only one thread may add 
+ * samples.
+ */
+
+//Axes, in the order surge, lateral, heave, roll, pitch, yaw, i.e. the 
+//position vector then the angle vector
+#define TRACKING_AXES           6
+//Pairs the estimates are taken over. At the MB's 60 Hz, two seconds.
+#define TRACKING_WINDOW         120
+//Largest delay looked for, in commands. At 60 Hz, 250 ms.
+#define TRACKING_MAX_LAG        15
+//Values are kept in units of 1/TRACKING_SCALE m or rad
+#define TRACKING_SCALE          1e6
+//Below this standard deviation over the window, in m or rad, a command
+//has no delay estimate
+#define TRACKING_MIN_STDDEV     1e-4
+
+class trackingAxisStatus
+{
+    public:
+
+    //False if there is no delay estimate, see TRACKING_MIN_STDDEV
+    bool delay_valid = false;
+    //Estimated transport delay, ns, and the correlation coefficient there
+    int64_t delay = 0;
+    double correlation = 0;
+    //RMS of feedback minus command over the window, m or rad. As is, and 
+    //against the command delayed by the estimated delay (whole commands).
+    double error_rms = 0;
+    double aligned_error_rms = 0;
+};
+
+/*
+ *  Everything trackingMonitor works out, as one plain copyable record
+ */
+class trackingStatus
+{
+    public:
+
+    //Pairs so far. Nothing below means much until there are a full window's
+    //worth, see trackingMonitor::isReady.
+    uint64_t samples = 0;
+    bool ready = false;
+    //Mean command period over the window, ns
+    int64_t command_period = 0;
+    //Latest feedback and the command it answered, m or rad
+    double feedback[TRACKING_AXES] = {};
+    double command[TRACKING_AXES] = {};
+    trackingAxisStatus axes[TRACKING_AXES];
+};
+
+class trackingMonitor
+{
+    private:
+
+    //History depth: the window, the lags behind it, and the pair leaving it
+    static const unsigned int depth = TRACKING_WINDOW + TRACKING_MAX_LAG + 1;
+
+    //Circular, newest at newestSlot. Zero before the first pair, which the
+    //running sums then take off as nothing.
+    unsigned int newestSlot = depth - 1;
+    int64_t commands[depth][TRACKING_AXES];
+    int64_t feedbacks[depth][TRACKING_AXES];
+    int64_t sendTimes[depth];
+
+    //Running sums over the window, see the theory of operation
+    int64_t sumF[TRACKING_AXES];
+    int64_t sumFF[TRACKING_AXES];
+    int64_t sumC[TRACKING_AXES][TRACKING_MAX_LAG + 1];
+    int64_t sumCC[TRACKING_AXES][TRACKING_MAX_LAG + 1];
+    int64_t sumFC[TRACKING_AXES][TRACKING_MAX_LAG + 1];
+
+    trackingStatus status;
+
+    //History slot of the pair age pairs before the newest
+    unsigned int slot(unsigned int age) const;
+    void estimate(unsigned int axis);
+
+    public:
+
+    trackingMonitor();
+
+    void reset();
+    //One pair: a command, when it was sent (ns), and the feedback in the 
+    //reply to it, in m and rad
+    void addSample(const double (&command)[TRACKING_AXES], int64_t sent, 
+                   const double (&feedback)[TRACKING_AXES]);
+    //True once a full window of pairs is in
+    bool isReady() const;
+    const trackingStatus& getStatus() const;
+
+    //Name of an axis, for display
+    static const char *axisName(unsigned int axis);
+};
@@ -0,0 +1,150 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#endif
+
+/*
+ *  io_uring, without liburing
+ * 
+ * uringQueue is just enough io_uring for MCIS' sockets, on the raw syscalls:
+ * 
+ *  - One submission and one completion queue, shared with the kernel. 
+ *      Submitting is one io_uring_enter for any number of requests, or none
+ *      at all if a kernel thread polls the submission queue (SQPOLL). 
+ *      Reaping completions is plain memory access.
+ *  - Registered buffers and files, so that sends go straight out of memory
+ *      the kernel has already pinned, through a file it has already looked
+ *      up.
+ *  - A ring of provided buffers, for multishot receives: one request keeps
+ *      receiving datagrams into whichever buffer is free, posting a 
+ *      completion with the buffer's id for each, until it runs out.
+ * 
+ * It needs the io_uring definitions of Linux 6.0 or later, for multishot 
+ * receive. Without them MCIS_HAVE_URING is not defined and there is no 
+ * uringQueue. If the kernel refuses (too old, io_uring_disabled, seccomp),
+ * init() returns false and callers carry on with plain sockets.
+ * 
+ * Only one thread at a time may use a queue.
+ */
+
+#if defined(__linux__) && defined(IORING_RECV_MULTISHOT)
+#define MCIS_HAVE_URING 1
+#endif
+
+//How long an SQPOLL kernel thread spins without work before it goes to 
+//sleep (and the next submission has to wake it up), ms
+#define URING_SQPOLL_IDLE_MS 1000
+
+#ifdef MCIS_HAVE_URING
+
+class uringQueue
+{
+    private:
+
+    int ring_fd = -1;
+    bool sqPolled = false;
+
+    //The rings, as mapped
+    void *sqRing = nullptr;
+    void *cqRing = nullptr;
+    size_t sqRingBytes = 0;
+    size_t cqRingBytes = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqesBytes = 0;
+
+    //Inside the rings
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned *sqFlags = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe *cqes = nullptr;
+    //Tail including SQEs handed out by getSqe() but not yet submitted
+    unsigned sqLocalTail = 0;
+
+    //Provided buffers. The ring is an array of io_uring_buf, see addBuffer
+    io_uring_buf *bufRing = nullptr;
+    unsigned char *bufMemory = nullptr;
+    size_t bufRingBytes = 0;
+    size_t bufMemoryBytes = 0;
+    unsigned bufCount = 0;
+    unsigned bufSize = 0;
+    uint16_t bufTail = 0;
+
+    void release();
+    void addBuffer(unsigned id);
+
+    public:
+
+    uringQueue() {}
+    ~uringQueue();
+
+    uringQueue(const uringQueue&) = delete;
+    uringQueue& operator=(const uringQueue&) = delete;
+
+    //Set up with room for entries requests, optionally with a kernel thread
+    //polling for them. False if io_uring can't be had.
+    bool init(unsigned entries, bool sq_poll = false);
+    bool isReady() const;
+    bool isSqPolled() const;
+
+    //A zeroed SQE to fill in, nullptr if the queue is full. Nothing goes to
+    //the kernel until submit().
+    io_uring_sqe *getSqe();
+    //Submit everything from getSqe() and wait for at least wait_for 
+    //completions. Returns what io_uring_enter did, or -errno.
+    int submit(unsigned wait_for = 0);
+    //The oldest completion not yet seen, nullptr if there is none. Never 
+    //enters the kernel.
+    io_uring_cqe *peekCqe();
+    //Done with the completion from peekCqe()
+    void seenCqe();
+
+    //IORING_REGISTER_BUFFERS and IORING_REGISTER_FILES
+    bool registerBuffers(const struct iovec *buffers, unsigned count);
+    bool registerFiles(const int *fds, unsigned count);
+
+    //Provide count buffers of size bytes each (count a power of 2), as 
+    //buffer group group, for IOSQE_BUFFER_SELECT requests. Only once.
+    bool provideBuffers(uint16_t group, unsigned count, unsigned size);
+    //Buffer id, from a completion's IORING_CQE_F_BUFFER flags
+    const unsigned char *getBuffer(unsigned id) const;
+    //Hand buffer id back to the kernel once its contents have been used
+    void recycleBuffer(unsigned id);
+};
+
+#endif
@@ -32,6 +32,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <utility>
 
 /*
  *  floatNetToHost
@@ -71,4 +75,145 @@ double doubleNetToHost(double netDouble);
  *  Convert a 64-bit double from Network byte order to Host byte order
  *
  */
-double doubleNetToHost(uint64_t netDouble);
\ No newline at end of file
+double doubleNetToHost(uint64_t netDouble);
+
+/*
+ *  monotonicNs
+ * 
+ * Current CLOCK_MONOTONIC time in nanoseconds. For measuring intervals,
+ * the epoch is arbitrary.
+ */
+int64_t monotonicNs();
+
+/*
+ *  realtimeNs
+ * 
+ * Current CLOCK_REALTIME time in nanoseconds since the Unix epoch, for 
+ * putting a wall clock time on monotonicNs() stamps
+ */
+int64_t realtimeNs();
+
+/*
+ *  nextFreeFilename
+ * 
+ * stem, a sequential number and ext, for the first number that isn't taken
+ * by an existing file
+ */
+std::string nextFreeFilename(const std::string& stem, const std::string& ext);
+
+struct msghdr;
+
+//Room for the control message rxTimestampNs looks for, in a recvmsg 
+//control buffer
+#define RX_TIMESTAMP_CONTROL_SIZE 64
+
+/*
+ *  enableRxTimestamps
+ * 
+ * Have the kernel stamp every datagram received on fd with its arrival time
+ * (SO_TIMESTAMPNS). False if it won't.
+ */
+bool enableRxTimestamps(int fd);
+
+/*
+ *  rxTimestampNs
+ * 
+ * The arrival time of a datagram received with recvmsg on a socket with 
+ * enableRxTimestamps, converted to monotonicNs(). 0 if msg carries no 
+ * timestamp.
+ */
+int64_t rxTimestampNs(const struct msghdr *msg);
+
+/*
+ *  pageFaultCounts
+ * 
+ * Minor (no I/O) and major (I/O) page faults, from getrusage
+ */
+class pageFaultCounts
+{
+    public:
+
+    uint64_t minor = 0;
+    uint64_t major = 0;
+
+    pageFaultCounts operator-(const pageFaultCounts& rhs) const;
+};
+
+//Page faults taken by the calling thread so far (Linux), or by the whole 
+//process elsewhere
+pageFaultCounts threadPageFaults();
+//Page faults taken by the whole process so far
+pageFaultCounts processPageFaults();
+
+//Most objects an rtArena can hold
+#define RT_ARENA_MAX_OBJECTS 16
+
+/*
+ *  rtArena
+ * 
+ * A fixed block of memory for objects the real-time path touches, so that
+ * none of it can take a page fault once running:
+ * 
+ *  1. The whole block is mapped up front, from huge pages if asked for and 
+ *      available (MAP_HUGETLB, which needs pages reserved in 
+ *      /proc/sys/vm/nr_hugepages). Otherwise from normal pages, advised for
+ *      transparent huge pages.
+ *  2. It is mlock'd, so that it stays resident. This only needs 
+ *      RLIMIT_MEMLOCK to be large enough, and failing it is not fatal.
+ *  3. Every page is written to, so that all of them are mapped before 
+ *      anything is placed in the arena.
+ * 
+ * Objects are placed with create() and live as long as the arena, which 
+ * destroys them in reverse order. Memory is never reused. Running out of 
+ * space, or of object slots, throws std::bad_alloc.
+ */
+class rtArena
+{
+    private:
+
+    char *base = nullptr;
+    std::size_t size = 0;
+    std::size_t used = 0;
+    bool locked = false;
+    bool hugePages = false;
+
+    //Destructors of the objects created, in creation order
+    void (*destructors[RT_ARENA_MAX_OBJECTS])(void *);
+    void *objects[RT_ARENA_MAX_OBJECTS];
+    unsigned int objectCount = 0;
+
+    template <typename T>
+    static void destroyObject(void *object)
+    {
+        static_cast<T *>(object)->~T();
+    }
+
+    void addObject(void (*destructor)(void *), void *object);
+
+    public:
+
+    //Map, lock and prefault at least bytes of memory
+    rtArena(std::size_t bytes, bool huge_pages = false);
+    ~rtArena();
+
+    rtArena(const rtArena&) = delete;
+    rtArena& operator=(const rtArena&) = delete;
+
+    //Raw memory, never freed before the arena is
+    void *allocate(std::size_t bytes, std::size_t alignment);
+
+    //Construct a T in the arena
+    template <typename T, typename... Args>
+    T *create(Args&&... args)
+    {
+        void *memory = allocate(sizeof(T), alignof(T));
+        T *object = new (memory) T(std::forward<Args>(args)...);
+        addObject(&destroyObject<T>, object);
+        return object;
+    }
+
+    std::size_t getSize() const { return size; }
+    std::size_t getUsed() const { return used; }
+    bool isLocked() const { return locked; }
+    bool usesHugePages() const { return hugePages; }
+};
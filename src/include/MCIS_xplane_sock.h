@@ -30,18 +30,31 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <thread>
 #include <chrono>
+#include <atomic>
 #include <stdexcept>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/uio.h>
 
 
 #include "discreteMath.h"
+#include "MCIS_seqlock.h"
+#include "MCIS_reactor.h"
+#include "MCIS_util.h"
 
 
 #define XP9_MSG_SIZE 185
 
+//How many times getData retries a read that overlapped a new message 
+//before giving up and keeping the previous sample
+#define XP_GETDATA_MAX_TRIES 4
+
+//Datagrams taken per recvmmsg when an ioReactor does the receiving. If
+//more are waiting, it goes around again.
+#define XP_RECV_BATCH 8
+
 
 
 
@@ -158,7 +171,44 @@ union xplaneMsgFormats
 };
 
 
-class xplaneSocket
+/*
+ *  One decoded X-Plane message, as handed from the recv thread to the send
+ * thread.
+ */
+class xplaneSample
+{
+    public:
+
+    MCISvector sf{0, 0, gravity}, angv{0, 0, 0}, att{0, 0, 0};
+    //Counts messages received, zero until the first one arrives
+    uint64_t sequence = 0;
+    //When the message arrived, on the monotonicNs() clock. Stamped by the 
+    //kernel, if the socket has receive timestamps, else when it was read.
+    int64_t recvTimeNs = 0;
+};
+
+/*
+ *  xplaneSocket receives X-Plane messages and keeps the latest one for 
+ * getData. Either it spawns its own thread to receive them, or an ioReactor
+ * watching getSocketFd() calls onReadable() whenever some are waiting.
+ * 
+ * Under a reactor, everything waiting is taken in batches with recvmmsg 
+ * (Linux), or handed over by an io_uring reactor one datagram at a time,
+ * and only the newest valid message is decoded. The older ones in
+ * the burst would be overwritten before anyone read them anyway. They still
+ * get sequence numbers, so that the send thread sees them as skipped, and 
+ * are counted in getMessagesDropped.
+ * 
+ * The kernel timestamps each datagram as it arrives (SO_TIMESTAMPNS), and
+ * that is the receive time handed out with the sample, so that it doesn't
+ * include however long the message waited for the recv thread or reactor.
+ * If the kernel won't, it is the time the message was read.
+ * 
+ * Optionally, the socket busy-polls (SO_BUSY_POLL) for that many us before
+ * sleeping, for the lowest latency when there is a core to spare. It needs
+ * CAP_NET_ADMIN, and for epoll waits net.core.busy_poll must be set as well.
+ */
+class xplaneSocket : public reactorHandler
 {
     protected:
 
@@ -174,28 +224,97 @@ class xplaneSocket
     unsigned char rawMsg[XP9_MSG_SIZE];
     unsigned char *msgPointer = (unsigned char *)&rawMsg;
 
-    //This mutex controls access to the output buffer
-    std::mutex stateMutex;
     //C++11 thread object for the recv thread (fancy fd sort of thing)
+    //Not started if an ioReactor does the receiving
     std::thread recvThread;
-    //Output buffers
-    MCISvector sfBuffer{0, 0, gravity}, angvBuffer{0, 0, 0}, attBuffer{0, 0, 0};
+    bool ownThread;
+    //Latest sample. Written only by the recv thread, so it never waits on
+    //the reader and the reader never waits on it.
+    seqlock<xplaneSample> latestSample;
+    uint64_t samplesReceived = 0;
+    //Sequence number of the last sample handed out by getData
+    uint64_t lastSequence = 0;
+    //Signalled after each new sample is published (Linux only, else -1)
+    int event_fd = -1;
+    //Valid messages never decoded, because a newer one came in the same burst
+    std::atomic<uint64_t> messagesDropped{0};
+    //SO_BUSY_POLL in effect, us
+    int busyPollUs = 0;
+    //Valid messages in the burst onDatagram is going through, and when the
+    //newest of them arrived
+    uint64_t burstValid = 0;
+    int64_t burstRecvTime = 0;
+    //SO_TIMESTAMPNS in effect
+    bool kernelTimestamps = false;
+
+    //Control buffer for recvmsg outside of batches
+    alignas(struct cmsghdr) unsigned char msgControl[RX_TIMESTAMP_CONTROL_SIZE];
+
+#ifdef __linux__
+    //recvmmsg buffers
+    unsigned char batchMsgs[XP_RECV_BATCH][XP9_MSG_SIZE];
+    alignas(struct cmsghdr) unsigned char batchControl[XP_RECV_BATCH][RX_TIMESTAMP_CONTROL_SIZE];
+    struct iovec batchIov[XP_RECV_BATCH];
+    struct mmsghdr batchHdrs[XP_RECV_BATCH];
+#endif
 
     //The function that loops around, receiving.
     void recvThreadFunc();
+    //recvmsg one message into rawMsg, with its receive time
+    int recvOne(int flags, int64_t& recvTime);
+    //Check and decode one message of receivedBytes in rawMsg
+    void handleMessage(int receivedBytes, int64_t recvTime);
+    //True if receivedBytes is right for the message type
+    bool checkMessage(int receivedBytes);
+    //Decode rawMsg, the newest of valid messages just received
+    void decodeNewest(uint64_t valid, int64_t recvTime);
     //void init(int localPort, xplaneMsgType msgType);
 
-    void interpretXP9msg();
+    //recvTime is 0 if the kernel didn't stamp the message
+    void interpretXP9msg(int64_t recvTime);
     void interpretXP11msg();
 
     public:
 
-    xplaneSocket(uint16_t localPort, xplaneMsgType msgType);
+    //With own_thread false, nothing is received until the socket is handed
+    //to an ioReactor
+    xplaneSocket(uint16_t localPort, xplaneMsgType msgType, bool own_thread = true,
+                 int busy_poll_us = 0);
     //~xplaneSocket();
 
+    int getSocketFd() const;
+    //Receive and decode every message waiting, without blocking. Called 
+    //by the ioReactor, never while the socket's own thread runs.
+    void onReadable(int fd) override;
+    //Same, for an io_uring reactor (watchDatagrams)
+    void onDatagram(int fd, const unsigned char *data, int length, int64_t rx_time) override;
+    void onDatagramsDone(int fd) override;
+
+    //See the class description
+    uint64_t getMessagesDropped() const;
+    //SO_BUSY_POLL in effect, us. 0 if not requested or not allowed.
+    int getBusyPollUs() const;
+    //True if receive times come from the kernel (SO_TIMESTAMPNS)
+    bool hasKernelTimestamps() const;
+
     void stop();
-    void getData(MCISvector& spForces, MCISvector& angVelocities,
+    /*
+     *  Copy out the latest sample. Returns true if it is a different sample
+     * from the one the previous call returned. Runs in bounded time: if a 
+     * message keeps landing while it copies, it gives up, leaves the 
+     * arguments untouched and returns false. 
+     *
+     * Only one thread may call getData.
+     */
+    bool getData(MCISvector& spForces, MCISvector& angVelocities,
                     MCISvector& attitude);
+    //Same, also reporting the sample's sequence number and receive time
+    bool getData(MCISvector& spForces, MCISvector& angVelocities,
+                    MCISvector& attitude, uint64_t& sequence, int64_t& recvTimeNs);
+
+    //An eventfd that becomes readable whenever a new sample is published,
+    //for waiting on new data with epoll. -1 if not available. 
+    int getEventFd() const;
 
 
 
@@ -25,6 +25,7 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
 */
 
+
 #pragma once
 
 #include <mutex>
@@ -34,21 +35,39 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define gravity 9.80665
 
+/*
+ *  A note on scalar types
+ * 
+ * Everything in here is templated on the scalar type, T, so that the MDA can 
+ * run in either double or single precision. X-Plane sends floats and the MB 
+ * takes floats, so single precision is enough for the signal path and halves
+ * the size of everything, doubling the SIMD width on the way.
+ * 
+ * The templates are only instantiated for float and double (at the end of
+ * discreteMath.cpp). The double versions keep their original names through 
+ * typedefs, and the float versions get an f suffix: MCISvector and MCISvectorf,
+ * discreteFilt2ndOrder and discreteFilt2ndOrderf, and so on.
+ * 
+ * Configuration parameters are always stored as doubles (see MCIS_config.h),
+ * so constructors and setters taking configuration values take doubles.
+ */
+
 
 /*
  * The discreteFilt class implemets a discrete-time, 2nd order direct form II filter.
  * 
  *
  */
-class discreteFilt2ndOrder
+template <typename T>
+class basicDiscreteFilt2ndOrder
 {
     private:
 
-    double delays[3];
-    double aGains[3];
-    double bGains[3];
+    T delays[3];
+    T aGains[3];
+    T bGains[3];
     
-    double currOutput;
+    T currOutput;
 
     
     public:
@@ -58,8 +77,8 @@ class discreteFilt2ndOrder
      * 
      * Filter order must be one lower than the lengths of aGainIn and bGainIn
      */
-    discreteFilt2ndOrder(const discreteBiquadSectionParams& config);
-    discreteFilt2ndOrder(const std::vector<double>& bGainIn, const std::vector<double>& aGainIn);
+    basicDiscreteFilt2ndOrder(const discreteBiquadSectionParams& config);
+    basicDiscreteFilt2ndOrder(const std::vector<double>& bGainIn, const std::vector<double>& aGainIn);
     
     //Change filter parameters.
     void setParams(const discreteBiquadSectionParams&);
@@ -68,14 +87,51 @@ class discreteFilt2ndOrder
     void resetState();
     //Set a specific state
     void setState(const std::vector<double>& newState);
+    //Set the state reached for a constant input and return the matching output
+    T initSteadyState(T input);
 
     // Run filter for one sample and output the new output
-    double nextSample(double newInput);
+    T nextSample(T newInput);
     
 };
 
+typedef basicDiscreteFilt2ndOrder<double> discreteFilt2ndOrder;
+typedef basicDiscreteFilt2ndOrder<float>  discreteFilt2ndOrderf;
+
+/*
+ *  The biquadCoeffs class holds only the coefficients of a discreteFilt2ndOrder.
+ * 
+ * The state (the two delays) is kept by the caller and passed in, so that one
+ * set of coefficients can be shared by any number of filters, each of which 
+ * then costs two scalars. The difference equation is the same as in 
+ * discreteFilt2ndOrder, operation for operation, so the outputs are identical.
+ * 
+ * state[0] is the output of the first delay, state[1] that of the second.
+ */
+template <typename T>
+class basicBiquadCoeffs
+{
+    private:
+
+    T a1, a2;
+    T b0, b1, b2;
+
+    public:
+
+    basicBiquadCoeffs();
+
+    void setParams(const discreteBiquadSectionParams& config);
+    //Set the state reached for a constant input and return the matching output
+    T initSteadyState(T (&state)[2], T input) const;
+    //Run one sample on the given state and return the new output
+    T nextSample(T (&state)[2], T newInput) const;
+};
+
+typedef basicBiquadCoeffs<double> biquadCoeffs;
+typedef basicBiquadCoeffs<float>  biquadCoeffsf;
+
 /*
- *  The genericVector class implements the very basics needed for
+ *  The basicGenericVector class implements the very basics needed for
  * vector math: storage, read/write access, vector addition and subtraction
  * and multiplication/division by a scalar, as well as some basic constructors.
  * 
@@ -86,129 +142,99 @@ class discreteFilt2ndOrder
  * Notably absent are the dot and cross products, as well as any sort of matrix 
  * operations. These are defined in the subclasses of interest.
  * 
- * For storage, std::vector is used.
+ * For storage, a plain array of N elements is used. The sizes are known at
+ * compile time, so there is no reason to go to the heap (and every reason not
+ * to, since these are created and destroyed several times per sample).
  */
-class genericVector
+template <typename T, unsigned int N>
+class basicGenericVector
 {
     protected:
     
     //The actual storage
-    std::vector<double> elements;
+    T elements[N];
 
-    // Protected constructor for initial length
-    //  Used by subclasses with known sizes
-    genericVector(const unsigned int vectorLen);
+    // Protected constructor, zero-initializes the storage
+    //  Used by subclasses
+    basicGenericVector();
     
     
     public:
+
+    typedef T value_type;
     
-    genericVector(genericVector&& toBeMoved);  //Move constructor
-    genericVector(const genericVector& toBeCopied);  //Copy constructor
+    basicGenericVector(const basicGenericVector& toBeCopied) = default;  //Copy constructor
     
-    genericVector(const std::vector<double>& scalars); //New generic-size vector
-    genericVector(std::vector<double>&& scalars); //New generic-size vector, move version
-    //~genericVector();   //Destructor is trivial
+    basicGenericVector(const std::vector<T>& scalars); //New vector, size must be N
+    //~basicGenericVector();   //Destructor is trivial
     
-    //Copy and move assignment operators
-    genericVector& operator=(const genericVector& rhs);
-    genericVector& operator=(genericVector&& rhs);
+    //Copy assignment operator. Moving is the same as copying.
+    basicGenericVector& operator=(const basicGenericVector& rhs) = default;
     
     //Equality and inequality operators
-    bool operator==(const genericVector& rhs);
-    bool operator!=(const genericVector& rhs);
+    bool operator==(const basicGenericVector& rhs) const;
+    bool operator!=(const basicGenericVector& rhs) const;
     
     //Compound arithmetic assignment operators
-    genericVector& operator+=(const genericVector& rhs);
-    genericVector& operator-=(const genericVector& rhs);
-    /*
-     *  Sum and subtraction can introduce a subtle bug if used incorrectly:
-     * They will not fail when trying to sum a 3x3 matrix and a 1x9 vector, 
-     * for instance. Since we have no use for 1x9 vectors in MCIS, we
-     * don't care about this scenario.
-     */
-    genericVector& operator*=(double rhs);
-    genericVector& operator/=(double rhs);
-
-    //Regular ol' binary arithmetic operators
-    friend genericVector operator+(genericVector lhs, const genericVector& rhs);
-    friend genericVector operator-(genericVector lhs, const genericVector& rhs);
-    friend genericVector operator*(genericVector lhs, double rhs);
-    friend genericVector operator/(genericVector lhs, double rhs);
+    basicGenericVector& operator+=(const basicGenericVector& rhs);
+    basicGenericVector& operator-=(const basicGenericVector& rhs);
+    basicGenericVector& operator*=(T rhs);
+    basicGenericVector& operator/=(T rhs);
  
     //Bounds-safe getter and setter for individual values    
-    double  getVal(unsigned int position) const;
-    void    setVal(unsigned int position, double value);
+    T       getVal(unsigned int position) const;
+    void    setVal(unsigned int position, T value);
+
+    //Unchecked element access, for the inner loops
+    T&       operator[](unsigned int position)       { return elements[position]; }
+    const T& operator[](unsigned int position) const { return elements[position]; }
 
     //Pretty-print a linear vector
     void print(std::ostream& dest);
 };
 
-/*
- *  All these declarations correspond to previously-declared friends of -------
- * genericVector. Skip to the next comment.
- */
-genericVector operator+(const genericVector& rhs);
-genericVector operator-(const genericVector& rhs);
-
-genericVector operator*(genericVector lhs, const double rhs);
-genericVector operator/(genericVector lhs, const double rhs);
-genericVector operator*(double lhs, const genericVector& rhs);
-
-/*
- *  Friends of genericVector end here. Skip to here. --------------------------
- */
-
 
 
 /*
- *  MCISvector defines a standard three-dimension vector, useful for physics
+ *  basicMCISvector defines a standard three-dimension vector, useful for physics
  * calculations in three-dimensional space.
  * 
  * Length is guaranteed to be 3
  */
-class MCISvector: public genericVector
+template <typename T>
+class basicMCISvector: public basicGenericVector<T, 3>
 {
     public:
 
     //Default constructor
-    MCISvector();
+    basicMCISvector();
 
     //Convenient constructor
-    MCISvector(double a, double b, double c);    
+    basicMCISvector(T a, T b, T c);    
     
-    //Copy and move constructors for std::vector
-    MCISvector(const std::vector<double>& scalars);
-    MCISvector(std::vector<double>&& scalars); 
+    //Copy constructor for std::vector
+    basicMCISvector(const std::vector<T>& scalars);
 
-    //Copy and move constructors
-    MCISvector(const MCISvector& toBeCopied);
-    MCISvector(MCISvector&& toBeMoved);
+    //Converting constructor, between single and double precision
+    template <typename U>
+    explicit basicMCISvector(const basicMCISvector<U>& other) : 
+        basicMCISvector((T)other[0], (T)other[1], (T)other[2]) {}
 
     //Operator overloads
-
-    //Copy and move assignment operators
-    MCISvector& operator=(const MCISvector& rhs);
-    MCISvector& operator=(MCISvector&& rhs);
     
     //Equality and inequality operators
-    bool operator==(const MCISvector& rhs);
-    bool operator!=(const MCISvector& rhs);
+    bool operator==(const basicMCISvector& rhs) const;
+    bool operator!=(const basicMCISvector& rhs) const;
     
     //Compound arithmetic assignment operators
-    MCISvector& operator+=(const MCISvector& rhs);
-    MCISvector& operator-=(const MCISvector& rhs);
-    MCISvector& operator*=(double rhs);
-    MCISvector& operator/=(double rhs);
-
-    //Regular ol' binary arithmetic operators
-    friend MCISvector operator+(MCISvector lhs, const MCISvector& rhs);
-    friend MCISvector operator-(MCISvector lhs, const MCISvector& rhs);
-    friend MCISvector operator*(MCISvector lhs, double rhs);
-    friend MCISvector operator/(MCISvector lhs, double rhs);
+    basicMCISvector& operator+=(const basicMCISvector& rhs);
+    basicMCISvector& operator-=(const basicMCISvector& rhs);
+    basicMCISvector& operator*=(T rhs);
+    basicMCISvector& operator/=(T rhs);
 
 
-    void assign(double a, double b, double c);  //Convenient assignment
-                                                //for existing vectors.
+    void assign(T a, T b, T c);  //Convenient assignment
+                                 //for existing vectors.
 
     /*
      *  The main reason why dot product is here and not in genericVector is
@@ -222,23 +248,51 @@ class MCISvector: public genericVector
      * This is a good point, but the added complexity is not needed for MCIS
      * and this is not a MATLAB replacement.
      */
-    static double       dotProduct(const MCISvector& aVector, const MCISvector& bVector);
+    static T                dotProduct(const basicMCISvector& aVector, const basicMCISvector& bVector);
 
     //Cross product is only defined for 1x3 or 3x1 vectors, so it goes here.
-    static MCISvector   crossProduct(const MCISvector& aVector, const MCISvector& bVector);
+    static basicMCISvector  crossProduct(const basicMCISvector& aVector, const basicMCISvector& bVector);
 
     //Apply scalar gains to each element of the vector
-    void applyScalarGains(double a, double b, double c);   
+    void applyScalarGains(T a, T b, T c);   
 };
 
-MCISvector operator+(MCISvector lhs, const MCISvector& rhs);
-MCISvector operator-(MCISvector lhs, const MCISvector& rhs);
-MCISvector operator*(MCISvector lhs, double rhs);
-MCISvector operator*(double lhs, MCISvector rhs);
-MCISvector operator/(MCISvector lhs, double rhs);
+typedef basicMCISvector<double> MCISvector;
+typedef basicMCISvector<float>  MCISvectorf;
+
+/*
+ *  Regular ol' binary arithmetic operators, using the compound operators for
+ * heavy lifting. The scalar is taken as value_type so that the vector alone
+ * determines T (2.0 * MCISvectorf is fine).
+ */
+template <typename T>
+basicMCISvector<T> operator+(basicMCISvector<T> lhs, const basicMCISvector<T>& rhs)
+{
+    return lhs += rhs;
+}
+template <typename T>
+basicMCISvector<T> operator-(basicMCISvector<T> lhs, const basicMCISvector<T>& rhs)
+{
+    return lhs -= rhs;
+}
+template <typename T>
+basicMCISvector<T> operator*(basicMCISvector<T> lhs, typename basicMCISvector<T>::value_type rhs)
+{
+    return lhs *= rhs;
+}
+template <typename T>
+basicMCISvector<T> operator*(typename basicMCISvector<T>::value_type lhs, basicMCISvector<T> rhs)
+{
+    return rhs *= lhs;
+}
+template <typename T>
+basicMCISvector<T> operator/(basicMCISvector<T> lhs, typename basicMCISvector<T>::value_type rhs)
+{
+    return lhs /= rhs;
+}
 
 /*
- *  MCISmatrix defines a standard 3x3 matrix, useful for transformations on
+ *  basicMCISmatrix defines a standard 3x3 matrix, useful for transformations on
  * 1x3 vectors common in physics.
  * 
  * Length is guaranteed to be 9.
@@ -259,54 +313,37 @@ MCISvector operator/(MCISvector lhs, double rhs);
  *      - getMAtrixElement: get an element in matrix notation
  * 
  */
-class MCISmatrix: public genericVector
+template <typename T>
+class basicMCISmatrix: public basicGenericVector<T, 9>
 {
     public:
     //Default constructor
-    MCISmatrix();
+    basicMCISmatrix();
 
     //Convenient constructor
-    MCISmatrix( double a, double b, double c,
-                double d, double e, double f,
-                double g, double h, double i);
-
-    //Copy and move constructors for std::vector
-    MCISmatrix(const std::vector<double>& scalars);
-    MCISmatrix(std::vector<double>&& scalars);
+    basicMCISmatrix( T a, T b, T c,
+                     T d, T e, T f,
+                     T g, T h, T i);
 
-    //Copy and move constructors
-    MCISmatrix(const MCISmatrix& toBeCopied);
-    MCISmatrix(MCISmatrix&& toBeMoved);
+    //Copy constructor for std::vector
+    basicMCISmatrix(const std::vector<T>& scalars);
 
     //Convenient all-at-once assignment
-    void assign(double a, double b, double c,
-                double d, double e, double f,
-                double g, double h, double i);
+    void assign(T a, T b, T c,
+                T d, T e, T f,
+                T g, T h, T i);
 
     //Operator overloads
-
-    //Copy and move assignment operators
-    MCISmatrix& operator=(const MCISmatrix& rhs);
-    MCISmatrix& operator=(MCISmatrix&& rhs);
     
     //Equality and inequality operators
-    bool operator==(const MCISmatrix& rhs);
-    bool operator!=(const MCISmatrix& rhs);
+    bool operator==(const basicMCISmatrix& rhs) const;
+    bool operator!=(const basicMCISmatrix& rhs) const;
     
     //Compound arithmetic assignment operators
-    MCISmatrix& operator+=(const MCISmatrix& rhs);
-    MCISmatrix& operator-=(const MCISmatrix& rhs);
-    MCISmatrix& operator*=(double rhs);
-    MCISmatrix& operator/=(double rhs);
-
-    //Regular ol' binary arithmetic operators
-    friend MCISmatrix operator+(MCISmatrix lhs, const MCISmatrix& rhs);
-    friend MCISmatrix operator-(MCISmatrix lhs, const MCISmatrix& rhs);
-    friend MCISmatrix operator*(MCISmatrix lhs, double rhs);
-    friend MCISmatrix operator/(MCISmatrix lhs, double rhs);
-
-    //operator* for A*b = c
-    friend MCISvector operator*(const MCISmatrix& lhs, const MCISvector& rhs);
+    basicMCISmatrix& operator+=(const basicMCISmatrix& rhs);
+    basicMCISmatrix& operator-=(const basicMCISmatrix& rhs);
+    basicMCISmatrix& operator*=(T rhs);
+    basicMCISmatrix& operator/=(T rhs);
 
 
     /*  
@@ -314,8 +351,8 @@ class MCISmatrix: public genericVector
      * The linear version from the base class is also usable, but this
      * one is more convenient. 
      */
-    double getMatrixElement(unsigned int row, unsigned int column) const;
-    void   setMatrixElement(unsigned int row, unsigned int column, double value);   
+    T    getMatrixElement(unsigned int row, unsigned int column) const;
+    void setMatrixElement(unsigned int row, unsigned int column, T value);   
 
 
     /* 
@@ -347,7 +384,7 @@ class MCISmatrix: public genericVector
     void print(std::ostream& dest); 
     
     //Right-multiply 3x3 matrix with 3x1 vector. Result is 3x1 vector.
-    MCISvector rightMultiplyVector(const MCISvector& vec) const;
+    basicMCISvector<T> rightMultiplyVector(const basicMCISvector<T>& vec) const;
 
     
     /*  Transpose this matrix
@@ -375,7 +412,7 @@ class MCISmatrix: public genericVector
      * - Roll, Pitch and Yaw are defined as a ZYX rotation, as this makes
      *   a zero rotation correspond to "level" attitude.
      */
-    void euler2DCM_ZYX(const MCISvector& eulerAngles);
+    void euler2DCM_ZYX(const basicMCISvector<T>& eulerAngles);
     
     /*
      *  Calculate the inverse Direction Cosines Matrix for ZYX rotation
@@ -400,7 +437,7 @@ class MCISmatrix: public genericVector
      * - Roll, Pitch and Yaw are defined as a ZYX rotation, as this makes
      *   a zero rotation correspond to "level" attitude.
      */
-    void euler2DCM_ZYX_inv(const MCISvector& eulerAngles);
+    void euler2DCM_ZYX_inv(const basicMCISvector<T>& eulerAngles);
 
     /*
      *
@@ -408,20 +445,49 @@ class MCISmatrix: public genericVector
      * Euler angle rates. 
      * 
      */
-    void pqr2eulerRates(const MCISvector& eulerAngles);
+    void pqr2eulerRates(const basicMCISvector<T>& eulerAngles);
 
     
 
 };
 
-MCISmatrix operator+(MCISmatrix lhs, const MCISmatrix& rhs);
-MCISmatrix operator-(MCISmatrix lhs, const MCISmatrix& rhs);
-MCISmatrix operator*(MCISmatrix lhs, double rhs);
-MCISmatrix operator*(double lhs, MCISmatrix rhs);
-MCISmatrix operator/(MCISmatrix lhs, double rhs);
+typedef basicMCISmatrix<double> MCISmatrix;
+typedef basicMCISmatrix<float>  MCISmatrixf;
+
+template <typename T>
+basicMCISmatrix<T> operator+(basicMCISmatrix<T> lhs, const basicMCISmatrix<T>& rhs)
+{
+    return lhs += rhs;
+}
+template <typename T>
+basicMCISmatrix<T> operator-(basicMCISmatrix<T> lhs, const basicMCISmatrix<T>& rhs)
+{
+    return lhs -= rhs;
+}
+template <typename T>
+basicMCISmatrix<T> operator*(basicMCISmatrix<T> lhs, typename basicMCISmatrix<T>::value_type rhs)
+{
+    return lhs *= rhs;
+}
+template <typename T>
+basicMCISmatrix<T> operator*(typename basicMCISmatrix<T>::value_type lhs, basicMCISmatrix<T> rhs)
+{
+    return rhs *= lhs;
+}
+template <typename T>
+basicMCISmatrix<T> operator/(basicMCISmatrix<T> lhs, typename basicMCISmatrix<T>::value_type rhs)
+{
+    return lhs /= rhs;
+}
 
 //operator* for A*b = c
-MCISvector operator*(const MCISmatrix& lhs, const MCISvector& rhs);
+//Multiplying a 3x3 matrix with a 3x1 column vector is done by calling
+//MCISmatrix::rightMultiplyVector()
+template <typename T>
+basicMCISvector<T> operator*(const basicMCISmatrix<T>& lhs, const basicMCISvector<T>& rhs)
+{
+    return lhs.rightMultiplyVector(rhs);
+}
 
 
 /*
@@ -430,24 +496,25 @@ MCISvector operator*(const MCISmatrix& lhs, const MCISvector& rhs);
  * Values are not allowed to exceed the magnitude of the limit member.
  * In other words, limits are imposed as 0+-limit, so +limit and -limit
  */
-class saturation
+template <typename T>
+class basicSaturation
 {
     protected:
     
     //The limit to set
-    double  limit;
+    T  limit;
     //Output storage. Not very useful here, but needed in rateLimit
-    double  output;
+    T  output;
     
     
     public:
     
     //Constructors
-    saturation(){};
-    saturation(double limSetting, double initOutput);
+    basicSaturation(){};
+    basicSaturation(double limSetting, double initOutput);
     
     //Do one iteration using the input parameter as input and return the output
-    double nextSample(double input);
+    T nextSample(T input);
     
     //Change the limit after construction
     //Potentially dangerous, don't use willy-nilly.
@@ -455,27 +522,34 @@ class saturation
     
 };
 
+typedef basicSaturation<double> saturation;
+typedef basicSaturation<float>  saturationf;
+
 /*
  *  The rate limit class inherits from saturation.
  * This will tickle your OCD, but is fine here. Actual functionality is 
  * provided by an overriden nextSample function
  */
-class rateLimit: public saturation
+template <typename T>
+class basicRateLimit: public basicSaturation<T>
 {
     public:
 
     //Formality, calls parent constructor
-    rateLimit(double limSetting, double initOutput);
+    basicRateLimit(double limSetting, double initOutput);
     
     //Overriden to do a rate limit using the stored previous output
-    double nextSample(double input);
+    T nextSample(T input);
 
     //Allow the output to be overriden. Useful when an instantaneous change 
     //is needed. When you'd need it is a good question.
-    void overrideOutput(double newOutput);
+    void overrideOutput(T newOutput);
     
 };
 
+typedef basicRateLimit<double> rateLimit;
+typedef basicRateLimit<float>  rateLimitf;
+
 /*
  *  vectorRateLimit
  * 
@@ -483,17 +557,20 @@ class rateLimit: public saturation
  * 
  * This class could be refactored for genericVector, but MCISvector is fine for us
  */
-class vectorRateLimit
+template <typename T>
+class basicVectorRateLimit
 {
     private:
     //Scalar rate limits
-    rateLimit lim0, lim1, lim2;
+    basicRateLimit<T> lim0, lim1, lim2;
 
     public:
     //Constructor
-    vectorRateLimit(double rateLimit, const MCISvector& initOutput);
+    basicVectorRateLimit(double rateLimit, const basicMCISvector<T>& initOutput);
 
-    void nextSample(MCISvector& input);
-    void overrideOutput(const MCISvector& newOutput);
+    void nextSample(basicMCISvector<T>& input);
+    void overrideOutput(const basicMCISvector<T>& newOutput);
 };
 
+typedef basicVectorRateLimit<double> vectorRateLimit;
+typedef basicVectorRateLimit<float>  vectorRateLimitf;
@@ -0,0 +1,104 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+//Test for eventJournal:
+//  - Events read back exactly as logged, in order, between the header and
+//      JOURNAL_STOP
+//  - A burst larger than the ring drops the excess, counts it, and the 
+//      count ends up in JOURNAL_STOP
+//  - Each journal gets a file of its own
+//
+//Build: g++ -std=c++11 -O2 -pthread journaltest.cpp -o journaltest -lMCIS_journal -lMCIS_util
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include "include/MCIS_journal.h"
+#include "include/MCIS_util.h"
+#include "include/MCIS_testutil.h"
+
+#define TEST_PREFIX "/tmp/journaltest"
+
+int main()
+{
+    for (int i = 0; i < 4; i++)
+    {
+        std::remove((TEST_PREFIX + std::to_string(i) + ".jnl").c_str());
+    }
+
+    //A few events, as the send thread would log them
+    std::string firstPath;
+    int64_t before = monotonicNs();
+    {
+        eventJournal journal(TEST_PREFIX);
+        check(journal.isOpen(), "journal opens");
+        firstPath = journal.getPath();
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            check(journal.log(JOURNAL_STATE, i, i + 1, -(int64_t)i), "event queued");
+        }
+        journal.stop();
+        check(100 == journal.get_written() - 1, "events written, and JOURNAL_STOP");
+    }
+
+    journalHeader header;
+    std::vector<journalEvent> events;
+    check(eventJournal::load(firstPath, header, events), "journal loads");
+    check(header.start_monotonic >= before, "header start time");
+    check(101 == events.size(), "every event read back");
+    bool inOrder = true;
+    for (uint32_t i = 0; (i < 100) && (i < events.size()); i++)
+    {
+        const journalEvent& event = events[i];
+        inOrder = inOrder && (JOURNAL_STATE == event.type) && (i == event.a) && (i + 1 == event.b) &&
+                  (-(int64_t)i == event.c) && ((0 == i) || (event.time >= events[i - 1].time));
+    }
+    check(inOrder, "events as logged, in order");
+    check(!events.empty() && (JOURNAL_STOP == events.back().type) && (0 == events.back().c), 
+          "JOURNAL_STOP with nothing dropped");
+
+    //Twice the ring at once, faster than the writer's nap
+    {
+        eventJournal journal(TEST_PREFIX);
+        check(journal.getPath() != firstPath, "a new file per journal");
+        unsigned int queued = 0;
+        for (uint32_t i = 0; i < 2 * JOURNAL_RING_EVENTS; i++)
+        {
+            queued += journal.log(JOURNAL_USER_COMMAND, i) ? 1 : 0;
+        }
+        journal.stop();
+        check(queued + journal.get_dropped() == 2 * JOURNAL_RING_EVENTS, "drops counted");
+        check(journal.get_dropped() > 0, "a full ring drops");
+
+        check(eventJournal::load(journal.getPath(), header, events), "second journal loads");
+        check(queued + 1 == events.size(), "queued events written");
+        check(!events.empty() && ((int64_t)journal.get_dropped() == events.back().c), 
+              "JOURNAL_STOP holds the drop count");
+    }
+
+    return testSummary("eventJournal");
+}
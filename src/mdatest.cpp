@@ -0,0 +1,170 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+//Test for the shared MDA signal path:
+//  - MCIS_MDA and MDAnextSample, on one MDAparams shared by several 
+//      MDAstates, give bit-identical outputs on the same input, both from 
+//      rest and from the steady state
+//  - The blocks driven one by one, as MCIS_MPC and MCIS_MDA_adaptive do,
+//      give the same outputs too
+//  - A reset MDAstate starts over exactly like a new one
+//  - All of the above in double and single precision
+//
+//Build: g++ -std=c++11 -O2 mdatest.cpp -o mdatest -lMCIS_MDA -lMCIS_discreteMath 
+//          -lMCIS_config -lMCIS_crc -lMCIS_util
+//Run from the top directory, or pass the path to MDAconfig.bin
+
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include "include/MCIS_MDA.h"
+#include "include/MCIS_config.h"
+#include "include/MCIS_testutil.h"
+
+#define TEST_SAMPLES    4000
+
+//Bit for bit, so that -0 and 0 differ and NaN matches itself
+template <typename T>
+static bool identical(const basicMCISvector<T>& a, const basicMCISvector<T>& b)
+{
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        if (0 != std::memcmp(&a[i], &b[i], sizeof(T)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Synthetic flight: gusts, a sustained turn and a hard stop, large enough 
+//to reach the saturations and the tilt rate limits
+template <typename T>
+static void syntheticInput(int n, basicMCISvector<T>& sf, basicMCISvector<T>& angv, basicMCISvector<T>& att)
+{
+    double t = n / 60.0;
+    double stop = (n > TEST_SAMPLES / 2 && n < TEST_SAMPLES / 2 + 60) ? -8 : 0;
+    sf.assign((T)(2 * std::sin(0.7 * t) + stop), (T)(1.5 * std::sin(1.3 * t)), (T)(-9.81 + 0.5 * std::sin(3.1 * t)));
+    angv.assign((T)(0.3 * std::sin(0.9 * t)), (T)(0.2 * std::cos(0.4 * t)), (T)0.05);
+    att.assign((T)(0.1 * std::sin(0.2 * t)), (T)(0.05 * std::cos(0.3 * t)), (T)(0.05 * t));
+}
+
+template <typename T>
+static void testPrecision(const MCISconfig& config, const char *name)
+{
+    std::cout << "Testing " << name << std::endl;
+
+    static const basicMDAparams<T> params{config, true};
+    basicMDAstate<T> state, stateSS;
+    basicMCIS_MDA<T> mda{config, true}, mdaSS{config, true};
+
+    //Blocks on their own, without gravity subtraction so that only the
+    //input scaling needs repeating here
+    basicAngHPchannel<T> angleBlock{config};
+    basicTiltCoordination<T> tiltBlock{config};
+    basicPosHPchannel<T> posBlock{config, false};
+    basicMDAparams<T> paramsNoGrav{config, false};
+    basicMDAstate<T> stateNoGrav;
+    basicMCISvector<T> angleOut{0, 0, 0};
+
+    bool sameMDA = true, sameSS = true, sameBlocks = true, sameReset = true, moved = false;
+    basicMCISvector<T> sf, angv, att;
+
+    for (int n = 0; n < TEST_SAMPLES; n++)
+    {
+        syntheticInput(n, sf, angv, att);
+
+        if (0 == n)
+        {
+            mdaSS.initSteadyState(sf, angv, att);
+            MDAinitSteadyState(params, stateSS, sf, angv, att);
+            sameSS = identical(mdaSS.getPos(), stateSS.posOut) && identical(mdaSS.getangle(), stateSS.angleOut) && 
+                     identical(mdaSS.getAngleNoTC(), stateSS.angleNoTCout);
+        }
+
+        mda.nextSample(sf, angv, att);
+        mdaSS.nextSample(sf, angv, att);
+        MDAnextSample(params, state, sf, angv, att);
+        MDAnextSample(params, stateSS, sf, angv, att);
+
+        sameMDA = sameMDA && identical(mda.getPos(), state.posOut) && identical(mda.getangle(), state.angleOut) && 
+                  identical(mda.getAngleNoTC(), state.angleNoTCout);
+        sameSS  = sameSS && identical(mdaSS.getPos(), stateSS.posOut) && identical(mdaSS.getangle(), stateSS.angleOut) && 
+                  identical(mdaSS.getAngleNoTC(), stateSS.angleNoTCout);
+        //Same chain as MDAnextSample, block by block
+        basicMCISvector<T> accInput = sf, angvInput = angv;
+        accInput.applyScalarGains((T)config.K_SF_x, (T)config.K_SF_y, (T)config.K_SF_z);
+        angvInput.applyScalarGains((T)config.K_p, (T)config.K_q, (T)config.K_r);
+        basicMCISvector<T> angleNoTC = angleBlock.nextSample(angvInput, angleOut);
+        angleOut = tiltBlock.nextSample(accInput, angleOut, angleNoTC);
+        basicMCISvector<T> posOut = posBlock.nextSample(accInput, angleOut);
+        MDAnextSample(paramsNoGrav, stateNoGrav, sf, angv, att);
+        sameBlocks = sameBlocks && identical(posOut, stateNoGrav.posOut) && identical(angleOut, stateNoGrav.angleOut) &&
+                     identical(angleNoTC, stateNoGrav.angleNoTCout);
+
+        moved = moved || (std::fabs(state.posOut[0]) > (T)0.01 && std::fabs(state.angleOut[1]) > (T)0.01);
+    }
+
+    //state has been through the whole flight, a reset must forget all of it
+    state.reset();
+    basicMDAstate<T> fresh;
+    for (int n = 0; n < TEST_SAMPLES; n++)
+    {
+        syntheticInput(n, sf, angv, att);
+        MDAnextSample(params, state, sf, angv, att);
+        MDAnextSample(params, fresh, sf, angv, att);
+        sameReset = sameReset && identical(state.posOut, fresh.posOut) && identical(state.angleOut, fresh.angleOut) && 
+                    identical(state.angleNoTCout, fresh.angleNoTCout);
+    }
+
+    check(moved, "the input moves the MDA");
+    check(sameMDA, "MCIS_MDA and MDAnextSample are bit-identical from rest");
+    check(sameSS, "MCIS_MDA and MDAnextSample are bit-identical from the steady state");
+    check(sameBlocks, "the blocks driven one by one are bit-identical to MDAnextSample");
+    check(sameReset, "a reset MDAstate runs exactly like a new one");
+}
+
+int main(int argc, char **argv)
+{
+    std::string configPath = (argc > 1) ? argv[1] : "MDAconfig.bin";
+    MCISconfig config;
+    try
+    {
+        config.load(configPath);
+    }
+    catch (std::exception& e)
+    {
+        std::cout << "Failed to load " << configPath << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    testPrecision<double>(config, "double precision");
+    testPrecision<float>(config, "single precision");
+
+    return testSummary("MDA");
+}
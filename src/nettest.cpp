@@ -35,6 +35,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "include/discreteMath.h"
 #include "include/MCIS_xplane_sock.h"
 #include "include/MCIS_fileio.h"
+#include "include/MCIS_diag.h"
 
 #define configFileName "MCISconfig.bin"
 #define outFilename "nettest.csv"
@@ -86,6 +87,8 @@ int main()
 
     MCISvector sfIn, angIn, posOut, angOut;
 
+    //Receive errors are reported as diagnostics, print them
+    diagDrain diagnostics(std::cerr);
     xplaneSocket inSock(inPort, XP9);
 
     auto nextTick = std::chrono::high_resolution_clock::now();
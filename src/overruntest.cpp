@@ -0,0 +1,231 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+
+//Delay-injection test for the send thread's overrun policies.
+//The interface is engaged through the override (no MB needed), then the
+//send thread is stalled for INJECTED_DELAY_MS every INJECT_EVERY_MS while 
+//a socket standing in for the MB timestamps every command it gets.
+//Under "drop" the commands must not bunch up after a stall (two closer than
+//a quarter of a tock count as bunched; scheduling noise may cause the odd
+//one, a stall caught up on causes several) and the gap over a stall must stay
+//within the stall plus two tocks. Under "catch_up" nothing may be dropped,
+//and the late ticks must have been caught up on, bunching commands.
+//Skip logging must shed log lines on late ticks, and resend must shed the 
+//whole tick, MDA step included, which leaves no log line to shed. Neither
+//may shed anything unless enabled.
+//
+//The stalls come from mbinterface::inject_delay, which only exists in the 
+//instrumentation build of the libraries (cmake -DMCIS_AUDIT=ON).
+//Build: g++ -std=c++11 -O2 -pthread -DMCIS_AUDIT overruntest.cpp -o overruntest -lMCIS_MB_interface 
+//          -lMCIS_xplane_sock -lMCIS_MDA -lMCIS_MPC -lMCIS_MDA_adaptive -lMCIS_logger 
+//          -lMCIS_fileio -lMCIS_rt -lMCIS_pll -lMCIS_tracking -lMCIS_recorder -lMCIS_journal 
+//          -lMCIS_histogram -lMCIS_audit -lMCIS_reactor -lMCIS_uring -lMCIS_discreteMath -lMCIS_diag -lMCIS_util 
+//          -lMCIS_config -lMCIS_crc -ldl
+
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+#include "include/MCIS_MB_interface.h"
+#include "include/MCIS_rt.h"
+#include "include/MCIS_util.h"
+#include "include/MCIS_testharness.h"
+
+#ifndef MCIS_AUDIT
+#error "overruntest needs the MCIS_AUDIT build for inject_delay, see the Build line"
+#endif
+
+#define TEST_XPLANE_PORT    49700
+
+#define INJECTED_DELAY_MS   40
+#define INJECT_EVERY_MS     500
+#define INJECTIONS          10
+//Allowance for scheduling noise. Catching up on every stall bunches at least
+//two commands per injection.
+#define MAX_BUNCHED         (INJECTIONS / 5)
+//Catching up bunches one or two per injection, depending on where the stall
+//falls between tocks. Dropping loses about two tocks per injection, catching
+//up none, give or take the ones cut off at either end of the recording.
+#define MIN_CAUGHT_UP       (INJECTIONS / 2)
+#define MAX_TOCKS_LOST      3
+
+class overrunCase
+{
+    public:
+
+    const char *name;
+    rt_overrun_policy policy;
+    bool skip_logging;
+    bool resend;
+};
+
+static bool runCase(const overrunCase& test, uint16_t xplanePort)
+{
+    const double tockMs = 1000.0 / MB_SAMPLE_RATE;
+
+    //Stand-in for the MB, only records when commands arrive
+    testMB fakeMB;
+    if (!fakeMB.isBound())
+    {
+        std::cout << "Could not bind the MB stand-in" << std::endl;
+        return false;
+    }
+
+    rtTimingConfig rtConfig;
+    rtConfig.overrun = test.policy;
+    rtConfig.overrun_skip_logging = test.skip_logging;
+    rtConfig.overrun_resend = test.resend;
+    testInterface iface("overruntest", xplanePort, rtConfig);
+    mbinterface& mb = iface.mb;
+    bool engaged = iface.engage();
+
+    fakeMB.recording = true;
+    int64_t recordStart = monotonicNs();
+    for (int i = 0; i < INJECTIONS; i++)
+    {
+        usleep(INJECT_EVERY_MS * 1000);
+        mb.inject_delay((int64_t)INJECTED_DELAY_MS * 1000000);
+    }
+    usleep(INJECT_EVERY_MS * 1000);
+    fakeMB.recording = false;
+    double recordedTocks = (monotonicNs() - recordStart) / 1e6 / tockMs;
+
+    rtStatus rt = mb.get_rt_status();
+    uint64_t logLines, mdaSteps;
+    mb.get_shed_counts(logLines, mdaSteps);
+    mb.stop();
+    fakeMB.stop();
+    const std::vector<int64_t>& arrivals = fakeMB.getArrivals();
+
+    double minMs = 1e9, maxMs = 0;
+    int bunched = 0;
+    for (size_t i = 1; i < arrivals.size(); i++)
+    {
+        double intervalMs = (arrivals[i] - arrivals[i - 1]) / 1e6;
+        minMs = (intervalMs < minMs) ? intervalMs : minMs;
+        maxMs = (intervalMs > maxMs) ? intervalMs : maxMs;
+        if (intervalMs < tockMs / 4)
+        {
+            bunched++;
+        }
+    }
+
+    std::cout << test.name << ": " << arrivals.size() << " commands, interval min " 
+              << minMs << " ms max " << maxMs << " ms, " << bunched << " bunched; late ticks " << rt.missed_ticks 
+              << ", dropped " << rt.dropped_ticks << ", log lines shed " << logLines 
+              << ", MDA steps shed " << mdaSteps << std::endl;
+
+    if (!engaged || (arrivals.size() < 2))
+    {
+        std::cout << "  never engaged or sent nothing" << std::endl;
+        return false;
+    }
+    bool ok = true;
+    if (RT_OVERRUN_DROP == test.policy)
+    {
+        if (bunched > MAX_BUNCHED)
+        {
+            std::cout << "  commands bunched up after a stall" << std::endl;
+            ok = false;
+        }
+        if (maxMs > INJECTED_DELAY_MS + 2 * tockMs)
+        {
+            std::cout << "  gap over a stall too long" << std::endl;
+            ok = false;
+        }
+        if (0 == rt.dropped_ticks)
+        {
+            std::cout << "  no ticks dropped" << std::endl;
+            ok = false;
+        }
+    }
+    else
+    {
+        if (rt.dropped_ticks)
+        {
+            std::cout << "  ticks dropped" << std::endl;
+            ok = false;
+        }
+        if ((rt.missed_ticks < MIN_CAUGHT_UP) || (bunched < MIN_CAUGHT_UP) ||
+            (arrivals.size() + MAX_TOCKS_LOST < recordedTocks))
+        {
+            std::cout << "  late ticks not caught up on" << std::endl;
+            ok = false;
+        }
+    }
+    //Resend sheds the tick before there is anything to log
+    if (test.skip_logging && !test.resend && (0 == logLines))
+    {
+        std::cout << "  no log lines shed" << std::endl;
+        ok = false;
+    }
+    if ((!test.skip_logging || test.resend) && logLines)
+    {
+        std::cout << "  log lines shed" << std::endl;
+        ok = false;
+    }
+    if (test.resend && (0 == mdaSteps))
+    {
+        std::cout << "  no MDA steps shed" << std::endl;
+        ok = false;
+    }
+    if (!test.resend && mdaSteps)
+    {
+        std::cout << "  MDA steps shed" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    const overrunCase cases[] =
+    {
+        {"catch_up",                      RT_OVERRUN_CATCH_UP, false, false},
+        {"drop",                          RT_OVERRUN_DROP,     false, false},
+        {"drop, skip logging",            RT_OVERRUN_DROP,     true,  false},
+        {"drop, resend, skip logging",    RT_OVERRUN_DROP,     true,  true},
+    };
+
+    bool passed = true;
+    uint16_t xplanePort = TEST_XPLANE_PORT;
+    for (const overrunCase& test : cases)
+    {
+        passed &= runCase(test, xplanePort++);
+    }
+
+    if (!passed)
+    {
+        std::cout << "FAILED" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
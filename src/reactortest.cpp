@@ -0,0 +1,152 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+//Test for the ioReactor timer, under each backend:
+//  - A deadline armed before start() fires once, on time, and not early
+//  - A deadline armed again from onTimer fires again
+//  - Disarming (0) keeps a deadline from firing
+//If the kernel won't do io_uring, NET_URING falls back to epoll, and that
+//is what gets tested twice.
+//
+//Build: g++ -std=c++11 -O2 -pthread reactortest.cpp -o reactortest -lMCIS_reactor 
+//          -lMCIS_uring -lMCIS_audit -lMCIS_rt -lMCIS_util -ldl
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "include/MCIS_reactor.h"
+#include "include/MCIS_util.h"
+#include "include/MCIS_testutil.h"
+
+//How far out the deadlines are, and how late they may fire, in ns
+#define TEST_DEADLINE_NS    50000000
+#define TEST_SLACK_NS       50000000
+
+//Every check runs once per backend
+static void check(bool condition, const char *what, net_backend backend)
+{
+    check(condition, (std::string(what) + " (" + netBackendName(backend) + ")").c_str());
+}
+
+/*
+ *  Counts onTimer calls, re-arming the timer rearms more times
+ */
+class timerCounter : public reactorHandler
+{
+    public:
+
+    ioReactor *reactor = nullptr;
+    int rearms = 0;
+    std::atomic<int> fired{0};
+    std::atomic<int64_t> firstFired{0};
+    std::atomic<int64_t> lastFired{0};
+
+    void onReadable(int fd) override { (void)fd; }
+
+    void onTimer(int64_t now) override
+    {
+        if (!fired)
+        {
+            firstFired = now;
+        }
+        lastFired = now;
+        fired++;
+        if (rearms > 0)
+        {
+            rearms--;
+            reactor->armTimer(now + TEST_DEADLINE_NS);
+        }
+    }
+};
+
+static void testBackend(net_backend backend)
+{
+    //Fires once, on time
+    {
+        ioReactor reactor(backend);
+        timerCounter counter;
+        counter.reactor = &reactor;
+        reactor.setTimerHandler(&counter);
+        int64_t deadline = monotonicNs() + TEST_DEADLINE_NS;
+        reactor.armTimer(deadline);
+        reactor.start();
+        std::this_thread::sleep_for(std::chrono::nanoseconds(3 * TEST_DEADLINE_NS));
+        reactor.stop();
+
+        std::cout << netBackendName(backend) << (reactor.usesUring() ? ", on io_uring" : ", on epoll") 
+                  << ": fired " << counter.fired << " time(s)";
+        if (counter.fired)
+        {
+            std::cout << ", " << (counter.firstFired - deadline) / 1000 << " us after the deadline";
+        }
+        std::cout << std::endl;
+        check(1 == counter.fired, "deadline fires once", backend);
+        check(counter.firstFired >= deadline, "not before the deadline", backend);
+        check(counter.firstFired < deadline + TEST_SLACK_NS, "on time", backend);
+    }
+
+    //Re-armed from onTimer
+    {
+        ioReactor reactor(backend);
+        timerCounter counter;
+        counter.reactor = &reactor;
+        counter.rearms = 2;
+        reactor.setTimerHandler(&counter);
+        reactor.armTimer(monotonicNs() + TEST_DEADLINE_NS);
+        reactor.start();
+        std::this_thread::sleep_for(std::chrono::nanoseconds(6 * TEST_DEADLINE_NS));
+        reactor.stop();
+        check(3 == counter.fired, "re-armed deadlines fire", backend);
+        check(counter.lastFired - counter.firstFired >= 2 * TEST_DEADLINE_NS, 
+              "re-armed deadlines wait", backend);
+    }
+
+    //Disarmed
+    {
+        ioReactor reactor(backend);
+        timerCounter counter;
+        counter.reactor = &reactor;
+        reactor.setTimerHandler(&counter);
+        reactor.armTimer(monotonicNs() + TEST_DEADLINE_NS);
+        reactor.armTimer(0);
+        reactor.start();
+        std::this_thread::sleep_for(std::chrono::nanoseconds(3 * TEST_DEADLINE_NS));
+        reactor.stop();
+        check(0 == counter.fired, "disarmed deadline doesn't fire", backend);
+    }
+}
+
+int main()
+{
+    testBackend(NET_EPOLL);
+    testBackend(NET_URING);
+
+    return testSummary("ioReactor timer");
+}
@@ -0,0 +1,141 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+//Test for flightRecorder:
+//  - Before a trigger, the ring keeps only the newest FLIGHT_RECORDER_RECORDS
+//  - After a trigger, FLIGHT_RECORDER_POST_TRIGGER more are taken, then the
+//      ring freezes, the dump thread writes it out, oldest first, and 
+//      recording carries on
+//  - Records that came while it was frozen are counted as missed
+//  - A dump reads back exactly as recorded, and dump() works on its own
+//
+//Build: g++ -std=c++11 -O2 -pthread recordertest.cpp -o recordertest -lMCIS_recorder -lMCIS_util
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "include/MCIS_recorder.h"
+#include "include/MCIS_testutil.h"
+
+#define TEST_PREFIX "/tmp/recordertest"
+
+static flightRecord recordFor(uint64_t tick)
+{
+    flightRecord rec;
+    std::memset(&rec, 0, sizeof(rec));
+    rec.tick = tick;
+    rec.time = (int64_t)tick * 8333333;
+    rec.sf_in[0] = tick * 0.5;
+    rec.command[5] = -(double)tick;
+    return rec;
+}
+
+//The records must be consecutive ticks, ending at last
+static bool consecutive(const std::vector<flightRecord>& records, uint64_t last)
+{
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        flightRecord expected = recordFor(last - (records.size() - 1 - i));
+        if (std::memcmp(&records[i], &expected, sizeof(flightRecord)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    for (int i = 0; i < 4; i++)
+    {
+        std::remove((TEST_PREFIX + std::to_string(i) + ".bin").c_str());
+    }
+
+    flightRecorder recorder(TEST_PREFIX);
+
+    //Fill the ring twice over
+    uint64_t tick = 0;
+    for (; tick < 2 * FLIGHT_RECORDER_RECORDS + 17; tick++)
+    {
+        recorder.record(recordFor(tick));
+    }
+    check(0 == recorder.getStatus().dumps, "nothing dumped before a trigger");
+
+    //Trigger, then keep recording for a while as the send thread would
+    uint64_t trigger_tick = tick;
+    recorder.trigger(TRIGGER_MB_FAULT, 7, 12345);
+    for (unsigned int i = 0; i < FLIGHT_RECORDER_POST_TRIGGER + 50; i++, tick++)
+    {
+        recorder.record(recordFor(tick));
+    }
+    //A second trigger while the first is pending is ignored
+    recorder.trigger(TRIGGER_MB_RECOVERABLE_FAULT, 8, 67890);
+
+    for (int i = 0; (i < 100) && !recorder.getStatus().dumps; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(FLIGHT_RECORDER_POLL_MS));
+    }
+    flightRecorderStatus status = recorder.getStatus();
+    check(1 == status.dumps, "one dump after a trigger");
+    check(0 == status.failed, "dump written");
+    check(TRIGGER_MB_FAULT == status.last_trigger, "dump trigger");
+
+    flightRecordingHeader header;
+    std::vector<flightRecord> records;
+    check(flightRecorder::load(status.last_path, header, records), "dump loads");
+    check(FLIGHT_RECORDER_RECORDS == records.size(), "dump holds a full ring");
+    check(TRIGGER_MB_FAULT == header.trigger, "header trigger");
+    check((7 == header.trigger_status) && (12345 == header.trigger_time), "header trigger details");
+    uint64_t frozen_after = trigger_tick + FLIGHT_RECORDER_POST_TRIGGER;
+    check(frozen_after == header.recorded, "ring froze after the post-trigger records");
+    check(consecutive(records, frozen_after - 1), "dump is the newest records, oldest first");
+    check(50 == header.missed, "records while frozen are missed");
+
+    //Recording carries on once the dump is done
+    uint64_t resumed_at = tick;
+    for (unsigned int i = 0; i < 10; i++, tick++)
+    {
+        recorder.record(recordFor(tick));
+    }
+    check(frozen_after + 10 == recorder.getRecorded(), "recording resumes after the dump");
+
+    //A dump on demand, once stopped. The ring now wraps a gap, where it 
+    //was frozen, so only its newest 10 records are consecutive.
+    recorder.stop();
+    std::string path = recorder.dump(TRIGGER_SHUTDOWN);
+    check(!path.empty(), "dump on demand");
+    check(flightRecorder::load(path, header, records), "dump on demand loads");
+    check(TRIGGER_SHUTDOWN == header.trigger, "dump on demand trigger");
+    std::vector<flightRecord> newest(records.end() - 10, records.end());
+    check(consecutive(newest, resumed_at + 9), "dump on demand holds the resumed records");
+    check(2 == recorder.getStatus().dumps, "two dumps");
+
+    return testSummary("flightRecorder");
+}
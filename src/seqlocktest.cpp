@@ -0,0 +1,169 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+
+//Stress test for the seqlock that carries the UI status snapshot.
+//One writer publishes as fast as it can while several readers hammer it.
+//Every field of a published record is derived from the same counter, so a 
+//torn read shows up as a record whose fields disagree.
+//
+//Build: g++ -std=c++11 -O2 -pthread seqlocktest.cpp -o seqlocktest -lMCIS_discreteMath
+
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include "include/MCIS_seqlock.h"
+#include "include/discreteMath.h"
+
+//Same shape as mbStatusSnapshot: a stack of vectors and a counter
+class testRecord
+{
+    public:
+
+    MCISvector vectors[8];
+    int64_t counter = 0;
+};
+
+static testRecord makeRecord(int64_t counter)
+{
+    testRecord record;
+    for (int i = 0; i < 8; i++)
+    {
+        record.vectors[i].assign(counter + 3 * i, counter + 3 * i + 1, counter + 3 * i + 2);
+    }
+    record.counter = counter;
+    return record;
+}
+
+static bool isConsistent(const testRecord& record)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            if (record.vectors[i][j] != (double)(record.counter + 3 * i + j))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(void)
+{
+    const int readerCount = 3;
+    const auto runTime = std::chrono::seconds(3);
+
+    seqlock<testRecord> lock;
+    lock.store(makeRecord(0));
+
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> torn{0};
+    std::atomic<uint64_t> backwards{0};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> retries{0};
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < readerCount; r++)
+    {
+        readers.emplace_back([&]()
+        {
+            int64_t lastSeen = 0;
+            uint64_t myReads = 0, myRetries = 0;
+            testRecord record;
+            while (running.load(std::memory_order_relaxed))
+            {
+                if (!lock.tryLoad(record))
+                {
+                    myRetries++;
+                    continue;
+                }
+                myReads++;
+                if (!isConsistent(record))
+                {
+                    torn++;
+                }
+                if (record.counter < lastSeen)
+                {
+                    backwards++;
+                }
+                lastSeen = record.counter;
+            }
+            reads += myReads;
+            retries += myRetries;
+        });
+    }
+
+    //The writer, standing in for the send thread. It must never wait.
+    int64_t counter = 0;
+    int64_t worstStoreNs = 0;
+    auto end = std::chrono::steady_clock::now() + runTime;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        testRecord record = makeRecord(++counter);
+        auto start = std::chrono::steady_clock::now();
+        lock.store(record);
+        int64_t storeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start).count();
+        if (storeNs > worstStoreNs)
+        {
+            worstStoreNs = storeNs;
+        }
+    }
+
+    running = false;
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+
+    //A last read with the writer stopped must see the final record
+    testRecord last = lock.load();
+    bool lastOk = isConsistent(last) && (last.counter == counter) && 
+                  (lock.getVersion() == (uint64_t)counter + 1);
+
+    std::cout << "Publishes:          " << counter << std::endl;
+    std::cout << "Consistent reads:   " << reads << std::endl;
+    std::cout << "Retried reads:      " << retries << std::endl;
+    std::cout << "Torn reads:         " << torn << std::endl;
+    std::cout << "Out of order reads: " << backwards << std::endl;
+    std::cout << "Worst store:        " << worstStoreNs << " ns" << std::endl;
+    std::cout << "Final record:       " << (lastOk ? "OK" : "WRONG") << std::endl;
+
+    if (torn || backwards || !lastOk)
+    {
+        std::cout << "FAILED" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+
+//Test for trackingMonitor. An MB is faked by delaying and attenuating the
+//commands, per axis, by known amounts:
+//  - The estimated delay must land within a fifth of a command period of 
+//      the true one, fractional delays included
+//  - Aligning on the delay must take most of the tracking error away
+//  - An axis whose command stands still must have no delay estimate
+//  - After many windows, the running sums must give exactly what a fresh 
+//      monitor, fed just the last window, gives
+//
+//Build: g++ -std=c++11 -O2 trackingtest.cpp -o trackingtest -lMCIS_tracking
+
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <iostream>
+#include "include/MCIS_tracking.h"
+
+//60 Hz, as the MB
+#define TEST_PERIOD_NS  16666667
+#define TEST_SAMPLES    100000
+
+//True delay per axis, in commands. The last axis stands still.
+static const double delays[TRACKING_AXES] = {2.0, 3.4, 0.0, 5.7, 1.25, 0.0};
+static const double amplitudes[TRACKING_AXES] = {0.1, 0.05, 0.02, 0.2, 0.1, 0.0};
+
+//A command with a few frequencies in it, so that the correlation has one 
+//clear peak. n may be fractional.
+static double commandAt(unsigned int axis, double n)
+{
+    double t = n * TEST_PERIOD_NS / 1e9;
+    return amplitudes[axis] * (std::sin(2 * M_PI * 0.7 * t + axis) + 
+                               0.5 * std::sin(2 * M_PI * 1.9 * t + 2 * axis) +
+                               0.3 * std::sin(2 * M_PI * 3.1 * t));
+}
+
+static void pairAt(uint64_t n, double (&command)[TRACKING_AXES], double (&feedback)[TRACKING_AXES])
+{
+    for (unsigned int axis = 0; axis < TRACKING_AXES; axis++)
+    {
+        command[axis]  = commandAt(axis, (double)n);
+        feedback[axis] = 0.95 * commandAt(axis, (double)n - delays[axis]) + 
+                         0.001 * amplitudes[axis] * std::sin(12345.678 * n);
+    }
+}
+
+int main(void)
+{
+    bool passed = true;
+    trackingMonitor monitor;
+    double command[TRACKING_AXES], feedback[TRACKING_AXES];
+
+    for (uint64_t n = 0; n < TEST_SAMPLES; n++)
+    {
+        pairAt(n, command, feedback);
+        monitor.addSample(command, (int64_t)n * TEST_PERIOD_NS, feedback);
+    }
+    const trackingStatus& status = monitor.getStatus();
+
+    std::cout << "Command period " << status.command_period / 1e6 << " ms" << std::endl;
+    for (unsigned int axis = 0; axis < TRACKING_AXES; axis++)
+    {
+        const trackingAxisStatus& result = status.axes[axis];
+        double expected = delays[axis] * TEST_PERIOD_NS;
+        std::cout << trackingMonitor::axisName(axis) << ": delay " << result.delay / 1e6 
+                  << " ms (true " << expected / 1e6 << "), valid " << result.delay_valid
+                  << ", correlation " << result.correlation 
+                  << ", error " << result.error_rms << " aligned " << result.aligned_error_rms 
+                  << std::endl;
+
+        if (0 == amplitudes[axis])
+        {
+            if (result.delay_valid)
+            {
+                std::cout << "  a still command should give no delay" << std::endl;
+                passed = false;
+            }
+            continue;
+        }
+        if (!result.delay_valid || (std::fabs(result.delay - expected) > 0.2 * TEST_PERIOD_NS))
+        {
+            std::cout << "  delay is off" << std::endl;
+            passed = false;
+        }
+        if ((delays[axis] >= 1) && !(result.aligned_error_rms < 0.5 * result.error_rms))
+        {
+            std::cout << "  aligning should take most of the error away" << std::endl;
+            passed = false;
+        }
+    }
+
+    //A fresh monitor, fed only what the window and the lags behind it cover
+    trackingMonitor fresh;
+    for (uint64_t n = TEST_SAMPLES - TRACKING_WINDOW - TRACKING_MAX_LAG; n < TEST_SAMPLES; n++)
+    {
+        pairAt(n, command, feedback);
+        fresh.addSample(command, (int64_t)n * TEST_PERIOD_NS, feedback);
+    }
+    for (unsigned int axis = 0; axis < TRACKING_AXES; axis++)
+    {
+        const trackingAxisStatus& a = status.axes[axis];
+        const trackingAxisStatus& b = fresh.getStatus().axes[axis];
+        if ((a.delay != b.delay) || (a.correlation != b.correlation) || 
+            (a.error_rms != b.error_rms) || (a.aligned_error_rms != b.aligned_error_rms))
+        {
+            std::cout << trackingMonitor::axisName(axis) << ": running sums drifted" << std::endl;
+            passed = false;
+        }
+    }
+
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
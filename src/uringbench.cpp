@@ -0,0 +1,265 @@
+/* 
+Copyright (c) 2018, Eric Loewenthal
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the organization nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. 
+*/
+//Benchmarks the io_uring network backend against epoll and sendto, on 
+//loopback:
+//  - X-Plane receive: an ioReactor and an xplaneSocket on their own, fed 
+//      XPLANE_BENCH_RATE_HZ messages per second. Latency from each sendto
+//      to the arrival time its sample carries, and syscalls per reactor 
+//      wakeup.
+//  - The whole interface, engaged through the override, fed at 60 Hz, with
+//      a stand-in MB that answers every command once engaged. Syscalls per 
+//      send tick and per reactor wakeup, how long handing a command over 
+//      takes, the input to output latency and the MB round trip.
+//It only fails if nothing gets through, or if io_uring was there to be had
+//and went unused.
+//
+//Arrival times are the kernel's timestamps, where the sockets have them, so
+//they leave out how long a datagram sat in the socket.
+//
+//Needs the instrumentation build of the libraries (cmake -DMCIS_AUDIT=ON)
+//for the syscall counts.
+//Build: g++ -std=c++11 -O2 -pthread -DMCIS_AUDIT uringbench.cpp -o uringbench 
+//          -lMCIS_MB_interface -lMCIS_xplane_sock -lMCIS_MDA -lMCIS_MPC 
+//          -lMCIS_MDA_adaptive -lMCIS_logger -lMCIS_fileio -lMCIS_rt -lMCIS_pll -lMCIS_tracking
+//          -lMCIS_recorder -lMCIS_journal -lMCIS_histogram -lMCIS_audit -lMCIS_reactor -lMCIS_uring 
+//          -lMCIS_discreteMath -lMCIS_diag -lMCIS_util -lMCIS_config -lMCIS_crc -ldl
+
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "include/MCIS_MB_interface.h"
+#include "include/MOOG6DOF2000E.h"
+#include "include/MCIS_reactor.h"
+#include "include/MCIS_uring.h"
+#include "include/MCIS_histogram.h"
+#include "include/MCIS_audit.h"
+#include "include/MCIS_util.h"
+#include "include/MCIS_testharness.h"
+
+#define TEST_XPLANE_PORT    49730
+
+#define XPLANE_BENCH_RATE_HZ    250
+#define XPLANE_BENCH_SECONDS    2
+#define XPLANE_RATE_HZ          60
+#define ENGAGED_SECONDS         3
+
+class benchCase
+{
+    public:
+
+    const char *name;
+    net_backend backend;
+    bool sq_poll;
+};
+
+static bool uringAvailable()
+{
+#ifdef MCIS_HAVE_URING
+    uringQueue probe;
+    return probe.init(4);
+#else
+    return false;
+#endif
+}
+
+/*
+ *  benchReceive
+ * 
+ * Each message is sent, then picked up well after it must have arrived. 
+ * The sample's receive time was taken by the reactor thread when it 
+ * published it, so polling late costs nothing in accuracy.
+ */
+static bool benchReceive(const benchCase& test, uint16_t xplanePort)
+{
+    xplaneSocket sim(xplanePort, XP9, false);
+    ioReactor reactor(test.backend);
+    reactor.watchDatagrams(sim.getSocketFd(), &sim);
+    reactor.start();
+
+    int xplane = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in xplaneAddr = testLocalAddr(xplanePort);
+    unsigned char message[XP9_MSG_SIZE] = {};
+    latencyHistogram latency;
+    MCISvector spForces, angVelocities, attitude;
+    uint64_t lastSequence = 0;
+    int64_t period = 1000000000 / XPLANE_BENCH_RATE_HZ;
+    int64_t next = monotonicNs();
+    for (int i = 0; i < XPLANE_BENCH_RATE_HZ * XPLANE_BENCH_SECONDS; i++)
+    {
+        next += period;
+        sleepUntilNs(next);
+        int64_t sent = monotonicNs();
+        sendto(xplane, message, sizeof(message), 0, (sockaddr *)&xplaneAddr, sizeof(xplaneAddr));
+        sleepUntilNs(next + period / 2);
+
+        uint64_t sequence;
+        int64_t recvTimeNs;
+        if (sim.getData(spForces, angVelocities, attitude, sequence, recvTimeNs) &&
+            (sequence != lastSequence))
+        {
+            latency.record(recvTimeNs - sent);
+            lastSequence = sequence;
+        }
+    }
+
+    auditReport wakeups = reactor.getAuditReport();
+    bool usedUring = reactor.usesUring();
+    reactor.stop();
+    sim.stop();
+    close(xplane);
+
+    histogramSummary summary = latency.getSummary();
+    std::cout << "  X-Plane receive:  ";
+    summary.print(std::cout);
+    std::cout << std::endl;
+    std::cout << "  Reactor wakeup:   ";
+    wakeups.print(std::cout);
+    std::cout << std::endl;
+
+    bool ok = true;
+    if (summary.count < (uint64_t)(XPLANE_BENCH_RATE_HZ * XPLANE_BENCH_SECONDS * 9 / 10))
+    {
+        std::cout << "  messages went missing" << std::endl;
+        ok = false;
+    }
+    if ((NET_URING == test.backend) && uringAvailable() && !usedUring)
+    {
+        std::cout << "  io_uring is available, but the reactor didn't use it" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+/*
+ *  benchInterface
+ */
+static bool benchInterface(const benchCase& test, uint16_t xplanePort)
+{
+    //Stand-in for the MB, answering each command as an engaged MB would,
+    //once the override has engaged the interface
+    testMB fakeMB;
+    rtTimingConfig rtConfig;
+    rtConfig.net = test.backend;
+    rtConfig.uring_sqpoll = test.sq_poll;
+    testInterface iface("uringbench", xplanePort, rtConfig);
+    mbinterface& mb = iface.mb;
+    bool engaged = iface.engage();
+    fakeMB.answering = true;
+
+    feedXplane(xplanePort, XPLANE_RATE_HZ, ENGAGED_SECONDS);
+
+    engaged = engaged && (ENGAGED == mb.get_iface_status());
+    auditReport tick = mb.get_audit_report(AUDIT_TICK);
+    auditReport wakeups = mb.get_audit_report(AUDIT_REACTOR);
+    histogramSummary send = mb.get_timing_summary(HIST_SEND);
+    histogramSummary chain = mb.get_timing_summary(HIST_INPUT_TO_OUTPUT);
+    histogramSummary roundTrip = mb.get_timing_summary(HIST_MB_RTT);
+    bool xplaneKernel, mbKernel;
+    mb.get_timestamp_status(xplaneKernel, mbKernel);
+    uint64_t replies, timeouts;
+    int64_t lastReplyAge;
+    bool timedOut;
+    mb.get_MB_reply_status(replies, lastReplyAge, timedOut, timeouts);
+    bool uringReceive, uringSend, sqPolled;
+    mb.get_net_status(uringReceive, uringSend, sqPolled);
+    mb.stop();
+    fakeMB.stop();
+
+    std::cout << "  Send tick:        ";
+    tick.print(std::cout);
+    std::cout << std::endl;
+    std::cout << "  Reactor wakeup:   ";
+    wakeups.print(std::cout);
+    std::cout << std::endl;
+    std::cout << "  Command send:     ";
+    send.print(std::cout);
+    std::cout << std::endl;
+    std::cout << "  Input to output:  ";
+    chain.print(std::cout);
+    std::cout << std::endl;
+    std::cout << "  MB round trip:    ";
+    roundTrip.print(std::cout);
+    std::cout << std::endl;
+    std::cout << "  Commands " << fakeMB.getAnswered() << ", replies " << replies 
+              << ", io_uring receive " << uringReceive << " send " << uringSend 
+              << " SQPOLL " << sqPolled << ", kernel timestamps X-Plane " << xplaneKernel
+              << " MB " << mbKernel << std::endl;
+
+    bool ok = true;
+    if (!engaged || !tick.runs || !replies)
+    {
+        std::cout << "  never engaged, or the MB never got through" << std::endl;
+        ok = false;
+    }
+    if (!chain.count || !roundTrip.count)
+    {
+        std::cout << "  no input to output or round trip latencies" << std::endl;
+        ok = false;
+    }
+    if ((NET_URING == test.backend) && uringAvailable() && !(uringReceive && uringSend))
+    {
+        std::cout << "  io_uring is available, but the interface didn't use it" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    if (!auditEnabled())
+    {
+        std::cout << "Not an MCIS_AUDIT build, syscalls will not be counted" << std::endl;
+    }
+    std::cout << "io_uring " << (uringAvailable() ? "available" : "NOT available") << std::endl;
+
+    const benchCase cases[] =
+    {
+        {"epoll and sendto",    NET_EPOLL,  false},
+        {"io_uring",            NET_URING,  false},
+        {"io_uring, SQPOLL",    NET_URING,  true},
+    };
+
+    bool passed = true;
+    uint16_t xplanePort = TEST_XPLANE_PORT;
+    for (const benchCase& test : cases)
+    {
+        std::cout << test.name << ":" << std::endl;
+        passed &= benchReceive(test, xplanePort++);
+        passed &= benchInterface(test, xplanePort++);
+    }
+
+    if (!passed)
+    {
+        std::cout << "FAILED" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "PASSED" << std::endl;
+    return EXIT_SUCCESS;
+}